@@ -83,8 +83,8 @@ EditorApplication::EditorApplication(ImGuiPlatform* platform) : _platform(platfo
     _resources = std::make_unique<EditorResources>();
     _ui = std::make_unique<UiManager>();
 
-    _asset_store = std::make_shared<FolderAssetStore>(store_dir);
-    _loader = std::make_unique<AssetLoader>(_asset_store, AssetLoadingFlags::SkipFailedDependenciesBit, 4);
+    _asset_store = std::make_shared<FolderAssetStore>(store_dir, app_settings().editor.compress_assets);
+    _loader = std::make_unique<AssetLoader>(_asset_store, AssetLoadingFlags::SkipFailedDependenciesBit, 2);
     _thumbmail_renderer = std::make_unique<ThumbmailRenderer>(*_loader);
 
     _world = std::make_unique<EditorWorld>(*_loader);
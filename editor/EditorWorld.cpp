@@ -22,6 +22,7 @@ SOFTWARE.
 
 #include "EditorWorld.h"
 
+#include <editor/Settings.h>
 #include <editor/components/EditorComponent.h>
 
 #include <yave/ecs/EntityScene.h>
@@ -39,6 +40,7 @@ SOFTWARE.
 #include <yave/systems/AABBUpdateSystem.h>
 #include <yave/systems/OctreeSystem.h>
 #include <yave/systems/ScriptSystem.h>
+#include <yave/systems/TextureStreamingSystem.h>
 
 #include <y/utils/format.h>
 
@@ -54,9 +56,16 @@ EditorWorld::EditorWorld(AssetLoader& loader) {
     add_required_component<EditorComponent>();
     add_system<AssetLoaderSystem>(loader);
     add_system<AABBUpdateSystem>();
-    add_system<OctreeSystem>();
+    add_system<OctreeSystem>(app_settings().editor.bvh_scene_index ? SpatialIndexType::BVH : SpatialIndexType::Octree);
     add_system<ScriptSystem>();
+    add_system<TextureStreamingSystem>(loader);
     // add_system<ASUpdateSystem>();
+
+    // Run every frame by the renderer
+    const std::array not_hidden = {ecs::tags::not_hidden};
+    register_query<TransformableComponent, PointLightComponent>(not_hidden);
+    register_query<TransformableComponent, SpotLightComponent>(not_hidden);
+    register_query<TransformableComponent, StaticMeshComponent>(not_hidden);
 }
 
 void EditorWorld::clear() {
@@ -165,8 +174,10 @@ void EditorWorld::add_scene(AssetId asset, ecs::EntityId parent) {
     y_profile();
 
     if(const auto scene = asset_loader().load_res<ecs::EntityScene>(asset)) {
-        for(const auto& prefab : scene.unwrap()->prefabs()) {
-            set_parent(create_entity(prefab), parent);
+        find_system<AssetLoaderSystem>()->preload(*scene.unwrap());
+
+        for(const ecs::EntityId id : create_entities(*scene.unwrap())) {
+            set_parent(id, parent);
         }
     }
 }
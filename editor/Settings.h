@@ -40,7 +40,13 @@ struct EditorSettings {
 
     float max_fps = 60.0f;
 
-    y_reflect(EditorSettings, world_file, asset_store, max_fps)
+    // Block compress newly written asset data
+    bool compress_assets = false;
+
+    // Cull with a BVH instead of the octree, only affects worlds created from now on
+    bool bvh_scene_index = false;
+
+    y_reflect(EditorSettings, world_file, asset_store, max_fps, compress_assets, bvh_scene_index)
 };
 
 struct CameraSettings {
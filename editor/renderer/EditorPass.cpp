@@ -212,8 +212,8 @@ static void visit_octree(DirectDrawPrimitive* primitive, const Frustum& frustum,
 
     primitive->add_box(node.strict_aabb());
 
-    for(const auto& child : node.children()) {
-        visit_octree(primitive, frustum, *child);
+    for(usize i = 0; i != node.child_count(); ++i) {
+        visit_octree(primitive, frustum, node.child(i));
     }
 }
 
@@ -221,8 +221,10 @@ static void render_octree(DirectDrawPrimitive* primitive,
                           const SceneView& scene_view) {
 
     const ecs::EntityWorld& world = scene_view.world();
-    if(const OctreeSystem* octree = world.find_system<OctreeSystem>()) {
-        visit_octree(primitive, scene_view.camera().frustum(), octree->root());
+    if(const OctreeSystem* octree_system = world.find_system<OctreeSystem>()) {
+        if(const Octree* octree = octree_system->octree()) {
+            visit_octree(primitive, scene_view.camera().frustum(), octree->root());
+        }
     }
 }
 
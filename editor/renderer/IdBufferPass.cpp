@@ -75,7 +75,7 @@ static void render_world(RenderPassRecorder& recorder, const FrameGraphPass* pas
         use_entity_list = true;
     } else {
         if(const OctreeSystem* octree_system = world.find_system<OctreeSystem>()) {
-            entities = octree_system->octree().find_entities(camera.frustum(), camera.far_plane_dist());
+            entities = octree_system->spatial_index().find_entities(camera.frustum(), camera.far_plane_dist());
             use_entity_list = true;
         }
     }
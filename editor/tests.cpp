@@ -26,8 +26,10 @@ SOFTWARE.
 #include <editor/UiManager.h>
 
 #include <yave/utils/FileSystemModel.h>
+#include <yave/assets/ArchiveAssetStore.h>
 
 #include <y/io2/File.h>
+#include <y/io2/Buffer.h>
 #include <y/utils/log.h>
 
 #include <external/imgui_test_engine/imgui_te_context.h>
@@ -199,6 +201,51 @@ void register_editor_tests(ImGuiTestEngine* engine) {
     };
 #endif
 
+    IM_REGISTER_TEST(engine, "tests", "failed archive compaction")->TestFunc = [](ImGuiTestContext* ctx) {
+        unused(ctx);
+
+        auto bytes = [](std::string_view str) {
+            core::Vector<byte> data;
+            data.push_back(reinterpret_cast<const byte*>(str.data()), reinterpret_cast<const byte*>(str.data() + str.size()));
+            return data;
+        };
+
+        auto read_all = [](const AssetStore& store, AssetId id) {
+            core::Vector<byte> data;
+            if(auto reader = store.data(id)) {
+                reader.unwrap()->read_all(data).ignore();
+            }
+            return data;
+        };
+
+        const FileSystemModel* filesystem = FileSystemModel::local_filesystem();
+        const core::String root = filesystem->join(filesystem->current_path().unwrap(), "failed_archive_compaction");
+        filesystem->remove(root).ignore();
+        y_defer(filesystem->remove(root).ignore());
+
+        ArchiveAssetStore store(root);
+
+        {
+            io2::Buffer data(bytes("first asset"));
+            IM_CHECK_EQ(store.import(data, "first", AssetType::Unknown).is_error(), false);
+        }
+
+        {
+            // Same size but different content: compaction will fail to validate it
+            auto file = io2::File::create(filesystem->join(root, "0.archive"));
+            IM_CHECK_EQ(file.is_error(), false);
+            IM_CHECK_EQ(file.unwrap().write_array("FIRST ASSET", 11).is_error(), false);
+        }
+
+        IM_CHECK_EQ(store.compact().is_error(), true);
+
+        const core::Vector<byte> second = bytes("second asset");
+        io2::Buffer data(second);
+        const auto id = store.import(data, "second", AssetType::Unknown);
+        IM_CHECK_EQ(id.is_error(), false);
+        IM_CHECK_EQ(read_all(store, id.unwrap()) == second, true);
+    };
+
     IM_REGISTER_TEST(engine, "tests", "add static mesh")->TestFunc = [](ImGuiTestContext* ctx) {
         const auto ids = all_ids();
         IM_CHECK_NE(ids.size(), 0_uu);
@@ -0,0 +1,555 @@
+/*******************************
+Copyright (c) 2016-2023 Grégoire Angerand
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+**********************************/
+#include <editor/editor.h>
+
+#include <yave/ecs/EntityWorld.h>
+
+#include <yave/components/TransformableComponent.h>
+#include <yave/components/PointLightComponent.h>
+#include <yave/components/SpotLightComponent.h>
+#include <yave/components/DirectionalLightComponent.h>
+#include <yave/components/SkyLightComponent.h>
+#include <yave/components/StaticMeshComponent.h>
+
+#include <yave/assets/AssetLoader.h>
+#include <yave/assets/AssetPreloader.h>
+#include <yave/assets/ArchiveAssetStore.h>
+#include <yave/ecs/EntityScene.h>
+#include <yave/scene/Octree.h>
+#include <yave/scene/BVH.h>
+#include <yave/camera/Frustum.h>
+#include <yave/utils/FileSystemModel.h>
+
+#include <y/io2/Buffer.h>
+#include <y/serde3/archives.h>
+
+#include <y/core/Chrono.h>
+#include <y/math/random.h>
+
+#include <y/utils/log.h>
+#include <y/utils/format.h>
+
+#include <algorithm>
+#include <bitset>
+
+namespace editor {
+
+static constexpr usize benchmark_runs = 5;
+
+
+// ---------------------------------------- ECS storage ----------------------------------------
+
+static float benchmark_value(const TransformableComponent& c) { return c.position().x(); }
+static float benchmark_value(const PointLightComponent& c) { return c.range(); }
+static float benchmark_value(const SpotLightComponent& c) { return c.range(); }
+static float benchmark_value(const DirectionalLightComponent& c) { return c.intensity(); }
+static float benchmark_value(const StaticMeshComponent& c) { return c.is_fully_loaded() ? 1.0f : 0.0f; }
+static float benchmark_value(const SkyLightComponent& c) { return c.intensity(); }
+
+template<typename... Args>
+static void benchmark_query(ecs::EntityWorld& world, std::string_view storage) {
+    usize matched = 0;
+    float total = 0.0f;
+
+    core::Chrono chrono;
+    for(usize i = 0; i != benchmark_runs; ++i) {
+        auto query = world.query<Args...>();
+        matched = query.size();
+        for(const auto& components : query.components()) {
+            total += std::apply([](const auto&... c) { return (benchmark_value(c) + ...); }, components);
+        }
+    }
+
+    log_msg(fmt("[%] % components: % entities in %ms (checksum: %)", storage, sizeof...(Args), matched, chrono.elapsed().to_millis() / benchmark_runs, total), Log::Perf);
+}
+
+template<typename T>
+static void add_to_random_entities(ecs::EntityWorld& world, core::Vector<ecs::EntityId>& ids, math::FastRandom& rng) {
+    // Shuffle so each component set ends up in a different order
+    std::shuffle(ids.begin(), ids.end(), rng);
+    for(const ecs::EntityId id : ids) {
+        if(rng() % 100 < 60) {
+            world.add_component<T>(id);
+        }
+    }
+}
+
+static void benchmark_ecs_storage(ecs::EntityWorld& world, std::string_view storage) {
+    benchmark_query<TransformableComponent, PointLightComponent>(world, storage);
+    benchmark_query<TransformableComponent, PointLightComponent, SpotLightComponent>(world, storage);
+    benchmark_query<TransformableComponent, PointLightComponent, SpotLightComponent, DirectionalLightComponent>(world, storage);
+    benchmark_query<TransformableComponent, PointLightComponent, SpotLightComponent, DirectionalLightComponent, StaticMeshComponent>(world, storage);
+    benchmark_query<TransformableComponent, PointLightComponent, SpotLightComponent, DirectionalLightComponent, StaticMeshComponent, SkyLightComponent>(world, storage);
+}
+
+static void ecs_storage_benchmark() {
+    static constexpr usize entity_count = 1'000'000;
+
+    ecs::EntityWorld world;
+    math::FastRandom rng;
+
+    core::Vector<ecs::EntityId> ids;
+    ids.set_min_capacity(entity_count);
+    for(usize i = 0; i != entity_count; ++i) {
+        const ecs::EntityId id = world.create_entity();
+        world.add_component<TransformableComponent>(id);
+        ids << id;
+    }
+
+    add_to_random_entities<PointLightComponent>(world, ids, rng);
+    add_to_random_entities<SpotLightComponent>(world, ids, rng);
+    add_to_random_entities<DirectionalLightComponent>(world, ids, rng);
+    add_to_random_entities<StaticMeshComponent>(world, ids, rng);
+    add_to_random_entities<SkyLightComponent>(world, ids, rng);
+
+    benchmark_ecs_storage(world, "sparse");
+
+    {
+        core::Chrono chrono;
+        world.set_archetype_storage(true);
+        log_msg(fmt("Archetypes built in %ms", chrono.elapsed().to_millis()), Log::Perf);
+    }
+
+    benchmark_ecs_storage(world, "archetype");
+}
+
+editor_action("ECS storage benchmark", ecs_storage_benchmark, "Debug")
+
+
+
+// ---------------------------------------- Asset loading ----------------------------------------
+
+struct StressTestAsset {
+    core::Vector<AssetPtr<StressTestAsset>> dependencies;
+    core::Vector<u8> payload;
+
+    y_reflect(StressTestAsset, dependencies, payload)
+};
+
+}
+
+namespace yave {
+YAVE_DECLARE_GENERIC_ASSET_TRAITS(editor::StressTestAsset, AssetType::Unknown);
+}
+
+namespace editor {
+
+static core::Vector<AssetId> create_stress_test_assets(AssetStore& store, usize asset_count, math::FastRandom& rng) {
+    static constexpr usize dependency_count = 4;
+    static constexpr usize payload_size = 4 * 1024;
+
+    core::Vector<AssetId> ids;
+    ids.set_min_capacity(asset_count);
+    for(usize i = 0; i != asset_count; ++i) {
+        StressTestAsset asset;
+        asset.payload = core::Vector<u8>(payload_size, u8(i));
+
+        // Only depend on previous assets, so there are no cycles
+        for(usize d = 0; i && d != dependency_count; ++d) {
+            asset.dependencies << make_asset_with_id<StressTestAsset>(ids[rng() % i]);
+        }
+
+        io2::Buffer buffer;
+        serde3::WritableArchive(buffer).serialize(asset).unwrap();
+        buffer.reset();
+        ids << store.import(buffer, fmt("asset_%", i), AssetType::Unknown).unwrap();
+    }
+
+    return ids;
+}
+
+static void asset_loading_stress_test_run(const std::shared_ptr<AssetStore>& store, core::Span<AssetId> ids, AssetLoadingPriority visible_priority) {
+    AssetLoader loader(store, AssetLoadingFlags::None, 4);
+    loader.set_cache_budget(AssetType::Unknown, 0);
+
+    core::Chrono chrono;
+
+    // Request the whole "level" at low priority, then the one asset the camera is looking at
+    core::Vector<AssetPtr<StressTestAsset>> assets;
+    for(const AssetId id : ids) {
+        assets << loader.load_async<StressTestAsset>(id, AssetLoadingPriority::Low);
+    }
+    const auto visible = loader.load_async<StressTestAsset>(ids[ids.size() / 2], visible_priority);
+
+    while(!visible.is_loaded()) {
+        std::this_thread::yield();
+    }
+    const auto first_visible = chrono.elapsed();
+
+    // Drop half of the requests, as if the camera moved away
+    for(usize i = 0; i < assets.size(); i += 2) {
+        assets[i] = nullptr;
+    }
+
+    for(const auto& asset : assets) {
+        loader.wait_until_loaded(asset);
+    }
+    while(loader.is_loading()) {
+        std::this_thread::yield();
+    }
+
+    log_msg(fmt("[%] first visible asset in %ms, all assets in %ms, % cancelled", visible_priority == AssetLoadingPriority::Low ? "fifo" : "priority", first_visible.to_millis(), chrono.elapsed().to_millis(), loader.cancelled_jobs()), Log::Perf);
+}
+
+static void asset_loading_stress_test() {
+    static constexpr usize asset_count = 4'000;
+
+    const FileSystemModel* fs = FileSystemModel::local_filesystem();
+    const core::String store_path = "./asset_stress_test.archive";
+
+    {
+        auto store = std::make_shared<ArchiveAssetStore>(store_path);
+
+        math::FastRandom rng;
+        const auto ids = create_stress_test_assets(*store, asset_count, rng);
+
+        for(usize i = 0; i != benchmark_runs; ++i) {
+            asset_loading_stress_test_run(store, ids, AssetLoadingPriority::Low);
+            asset_loading_stress_test_run(store, ids, AssetLoadingPriority::High);
+        }
+    }
+
+    if(!fs->remove(store_path)) {
+        log_msg("Unable to remove stress test asset store", Log::Warning);
+    }
+}
+
+editor_action("Asset loading stress test", asset_loading_stress_test, "Debug")
+
+
+
+// ---------------------------------------- Scene loading ----------------------------------------
+
+struct StressTestComponent {
+    AssetPtr<StressTestAsset> asset;
+
+    y_reflect(StressTestComponent, asset)
+};
+
+static void scene_load_benchmark_run(const std::shared_ptr<AssetStore>& store, const ecs::EntityScene& scene, core::Span<AssetId> scene_assets, bool preload) {
+    AssetLoader loader(store, AssetLoadingFlags::None, 4);
+    loader.set_cache_budget(AssetType::Unknown, 0);
+
+    if(preload) {
+        AssetPreloader preloader(loader);
+        // The scene only contains StressTestComponents
+        for(const auto& column : scene.columns()) {
+            for(const StressTestComponent& component : static_cast<const ecs::ComponentColumn<StressTestComponent>&>(*column).components()) {
+                preloader.add_recursive(component);
+            }
+        }
+        preloader.start();
+        preloader.wait();
+
+        log_msg(fmt("[preload] %", preloader.report().to_string()), Log::Perf);
+    } else {
+        core::Chrono chrono;
+
+        // Each component requests its asset when it gets to it
+        core::Vector<AssetPtr<StressTestAsset>> assets;
+        for(const AssetId id : scene_assets) {
+            assets << loader.load<StressTestAsset>(id);
+        }
+
+        const auto stats = loader.loading_stats();
+        const double secs = chrono.elapsed().to_secs();
+        log_msg(fmt("[one by one] % assets (% loaded with dependencies), %MB in %ms (%MB/s)", scene_assets.size(), stats.loaded_assets, stats.bytes / (1024.0 * 1024.0), secs * 1000.0, stats.bytes / (1024.0 * 1024.0) / secs), Log::Perf);
+    }
+}
+
+static void scene_load_benchmark() {
+    static constexpr usize asset_count = 4'000;
+    static constexpr usize entity_count = 20'000;
+
+    const FileSystemModel* fs = FileSystemModel::local_filesystem();
+    const core::String store_path = "./scene_load_benchmark.archive";
+
+    {
+        auto store = std::make_shared<ArchiveAssetStore>(store_path);
+
+        math::FastRandom rng;
+        const auto ids = create_stress_test_assets(*store, asset_count, rng);
+
+        // Entities share assets, like instances of the same mesh would
+        core::Vector<AssetId> scene_assets;
+        core::Vector<ecs::EntityPrefab> prefabs;
+        for(usize i = 0; i != entity_count; ++i) {
+            const AssetId id = ids[rng() % ids.size()];
+            scene_assets << id;
+            prefabs.emplace_back().add(StressTestComponent{make_asset_with_id<StressTestAsset>(id)});
+        }
+
+        const ecs::EntityScene scene(std::move(prefabs));
+
+        for(usize i = 0; i != benchmark_runs; ++i) {
+            scene_load_benchmark_run(store, scene, scene_assets, false);
+            scene_load_benchmark_run(store, scene, scene_assets, true);
+        }
+    }
+
+    if(!fs->remove(store_path)) {
+        log_msg("Unable to remove scene load benchmark asset store", Log::Warning);
+    }
+}
+
+editor_action("Scene load benchmark", scene_load_benchmark, "Debug")
+
+
+
+// Shared by the culling and spatial index benchmarks
+static constexpr float culling_scene_size = 2000.0f;
+
+static float random_float(math::FastRandom& rng, float min, float max) {
+    return min + (max - min) * (float(rng() % 65536) / 65536.0f);
+}
+
+// Small prop somewhere in a flat scene
+static AABB random_prop_aabb(math::FastRandom& rng) {
+    const math::Vec3 center(random_float(rng, -culling_scene_size, culling_scene_size), random_float(rng, -culling_scene_size, culling_scene_size), random_float(rng, -50.0f, 50.0f));
+    const math::Vec3 extent(random_float(rng, 0.5f, 8.0f), random_float(rng, 0.5f, 8.0f), random_float(rng, 0.5f, 8.0f));
+    return AABB::from_center_extent(center, extent);
+}
+
+// Cameras looking down, so only part of the scene is visible from each
+static core::Vector<Frustum> random_views(math::FastRandom& rng, usize count) {
+    core::Vector<Frustum> frustums = core::vector_with_capacity<Frustum>(count);
+    for(usize i = 0; i != count; ++i) {
+        const math::Vec3 pos(random_float(rng, -culling_scene_size, culling_scene_size), random_float(rng, -culling_scene_size, culling_scene_size), random_float(rng, 100.0f, 400.0f));
+        const math::Vec3 target = pos + math::Vec3(random_float(rng, -200.0f, 200.0f), random_float(rng, -200.0f, 200.0f), -pos.z());
+        const math::Matrix4<> view = math::look_at(pos, target, math::Vec3(0.0f, 0.0f, 1.0f));
+        const math::Matrix4<> proj = math::perspective(math::to_rad(60.0f), 16.0f / 9.0f, 0.1f);
+        frustums << Frustum::from_view_proj(view, proj);
+    }
+    return frustums;
+}
+
+// Entities of every node that is not outside the frustum, which is what gets drawn without per entity culling
+static usize count_node_entities(const Frustum& frustum, const OctreeNode& node) {
+    if(frustum.intersection(node.aabb()) == Intersection::Outside) {
+        return 0;
+    }
+
+    usize count = node.entity_count();
+    for(usize i = 0; i != node.child_count(); ++i) {
+        count += count_node_entities(frustum, node.child(i));
+    }
+    return count;
+}
+
+static void frustum_culling_benchmark() {
+    static constexpr usize object_count = 500'000;
+    static constexpr usize view_count = 64;
+
+    math::FastRandom rng;
+
+    Octree octree;
+    core::Vector<AABBBatch> batches;
+    {
+        core::Chrono chrono;
+        for(usize i = 0; i != object_count; ++i) {
+            const AABB aabb = random_prop_aabb(rng);
+            octree.insert(ecs::EntityId(u32(i)), aabb);
+
+            if(i % AABBBatch::size == 0) {
+                batches.emplace_back();
+            }
+            batches.last().set(i % AABBBatch::size, aabb);
+        }
+        log_msg(fmt("% objects inserted in %ms", object_count, chrono.elapsed().to_millis()), Log::Perf);
+    }
+
+    const core::Vector<Frustum> frustums = random_views(rng, view_count);
+
+    for(usize run = 0; run != benchmark_runs; ++run) {
+        usize node_entities = 0;
+        usize visible_entities = 0;
+        usize tested_visible = 0;
+        double node_ms = 0.0;
+        double culled_ms = 0.0;
+        double test_ms = 0.0;
+
+        for(const Frustum& frustum : frustums) {
+            {
+                core::Chrono chrono;
+                node_entities += count_node_entities(frustum, octree.root());
+                node_ms += chrono.elapsed().to_millis();
+            }
+            {
+                core::Chrono chrono;
+                visible_entities += octree.find_entities(frustum).size();
+                culled_ms += chrono.elapsed().to_millis();
+            }
+            {
+                // Raw throughput of the batch test, on every object
+                core::Chrono chrono;
+                for(const AABBBatch& batch : batches) {
+                    tested_visible += usize(std::bitset<AABBBatch::size>(frustum.visible_mask(batch)).count());
+                }
+                test_ms += chrono.elapsed().to_millis();
+            }
+        }
+
+        const usize culled = node_entities - visible_entities;
+        const usize tested_culled = batches.size() * AABBBatch::size * view_count - tested_visible;
+        log_msg(fmt("% views: % entities in visible nodes (%ms), % after culling (%ms), draw count reduced by % percent. Batch test: % entities culled per ms",
+            view_count, node_entities, node_ms, visible_entities, culled_ms,
+            (100.0 * double(culled)) / double(std::max(node_entities, 1_uu)),
+            usize(double(tested_culled) / std::max(test_ms, 0.001))
+        ), Log::Perf);
+    }
+}
+
+editor_action("Frustum culling benchmark", frustum_culling_benchmark, "Debug")
+
+
+
+static void octree_benchmark() {
+    static constexpr usize object_count = 500'000;
+    static constexpr usize view_count = 64;
+
+    math::FastRandom rng;
+
+    const core::Vector<Frustum> frustums = random_views(rng, view_count);
+
+    for(usize run = 0; run != benchmark_runs; ++run) {
+        Octree octree;
+
+        core::Chrono chrono;
+        for(usize i = 0; i != object_count; ++i) {
+            octree.insert(ecs::EntityId(u32(i)), random_prop_aabb(rng));
+        }
+        const double insert_ms = chrono.elapsed().to_millis();
+
+        chrono.start();
+        usize visible = 0;
+        for(const Frustum& frustum : frustums) {
+            visible += octree.find_entities(frustum).size();
+        }
+        const double find_ms = chrono.elapsed().to_millis();
+
+        chrono.start();
+        usize multi_visible = 0;
+        for(const auto& entities : octree.find_entities_for_views(frustums)) {
+            multi_visible += entities.size();
+        }
+        const double multi_ms = chrono.elapsed().to_millis();
+        y_always_assert(multi_visible == visible, "Multi view query mismatch");
+
+        chrono.start();
+        const usize all = octree.all_entities().size();
+        const double all_ms = chrono.elapsed().to_millis();
+
+        log_msg(fmt("% objects inserted in %ms, % views queried in %ms (% entities), % entities listed in %ms",
+            object_count, insert_ms, view_count, find_ms, visible, all, all_ms
+        ), Log::Perf);
+        log_msg(fmt("% views queried in a single traversal in %ms", view_count, multi_ms), Log::Perf);
+    }
+}
+
+editor_action("Octree benchmark", octree_benchmark, "Debug")
+
+
+
+static void spatial_index_benchmark() {
+    static constexpr usize object_count = 500'000;
+    static constexpr usize moved_count = 50'000;
+    static constexpr usize view_count = 64;
+
+    math::FastRandom rng;
+
+    // Mostly small props with a few very large objects, which the octree has to keep close to the root
+    core::Vector<SpatialIndex::Entry> entries;
+    for(usize i = 0; i != object_count; ++i) {
+        const math::Vec3 center(random_float(rng, -culling_scene_size, culling_scene_size), random_float(rng, -culling_scene_size, culling_scene_size), random_float(rng, -50.0f, 50.0f));
+        const float size = i % 100 ? random_float(rng, 0.5f, 8.0f) : random_float(rng, 50.0f, 500.0f);
+        const math::Vec3 extent(size, size * random_float(rng, 0.25f, 1.0f), size * random_float(rng, 0.25f, 1.0f));
+        entries.emplace_back(SpatialIndex::Entry{ecs::EntityId(u32(i)), AABB::from_center_extent(center, extent)});
+    }
+
+    core::Vector<SpatialIndex::Entry> moved;
+    for(usize i = 0; i != moved_count; ++i) {
+        const SpatialIndex::Entry& entry = entries[rng() % object_count];
+        const math::Vec3 offset(random_float(rng, -4.0f, 4.0f), random_float(rng, -4.0f, 4.0f), random_float(rng, -1.0f, 1.0f));
+        moved.emplace_back(SpatialIndex::Entry{entry.id, AABB::from_center_extent(entry.aabb.center() + offset, entry.aabb.extent())});
+    }
+    {
+        // Indices expect each entity at most once per update
+        std::sort(moved.begin(), moved.end(), [](const auto& a, const auto& b) { return a.id < b.id; });
+        const auto end = std::unique(moved.begin(), moved.end(), [](const auto& a, const auto& b) { return a.id == b.id; });
+        moved.shrink_to(usize(end - moved.begin()));
+    }
+
+    const core::Vector<Frustum> frustums = random_views(rng, view_count);
+
+    for(const SpatialIndexType type : {SpatialIndexType::Octree, SpatialIndexType::BVH}) {
+        const char* type_name = type == SpatialIndexType::BVH ? "BVH" : "Octree";
+
+        for(usize run = 0; run != benchmark_runs; ++run) {
+            std::unique_ptr<SpatialIndex> index = SpatialIndex::create(type);
+
+            core::Chrono chrono;
+            index->update(entries);
+            if(BVH* bvh = dynamic_cast<BVH*>(index.get())) {
+                bvh->rebuild();
+            }
+            const double build_ms = chrono.elapsed().to_millis();
+
+            chrono.start();
+            usize visible = 0;
+            for(const Frustum& frustum : frustums) {
+                visible += index->find_entities(frustum).size();
+            }
+            const double find_ms = chrono.elapsed().to_millis();
+
+            chrono.start();
+            usize multi_visible = 0;
+            for(const auto& entities : index->find_entities_for_views(frustums)) {
+                multi_visible += entities.size();
+            }
+            const double multi_ms = chrono.elapsed().to_millis();
+            y_always_assert(multi_visible == visible, "Multi view query mismatch");
+
+            chrono.start();
+            index->update(moved);
+            const double update_ms = chrono.elapsed().to_millis();
+
+            chrono.start();
+            usize moved_visible = 0;
+            for(const Frustum& frustum : frustums) {
+                moved_visible += index->find_entities(frustum).size();
+            }
+            const double moved_find_ms = chrono.elapsed().to_millis();
+
+            log_msg(fmt("%: % objects built in %ms (% MB), % views queried in %ms (% entities), %ms in a single traversal",
+                type_name, object_count, build_ms, index->memory_usage() / (1024 * 1024), view_count, find_ms, visible, multi_ms
+            ), Log::Perf);
+            log_msg(fmt("%: % objects moved in %ms, % views queried in %ms after the move (% entities)",
+                type_name, moved.size(), update_ms, view_count, moved_find_ms, moved_visible
+            ), Log::Perf);
+        }
+    }
+}
+
+editor_action("Spatial index benchmark", spatial_index_benchmark, "Debug")
+
+}
+
@@ -102,7 +102,7 @@ class CullingDebug : public Widget {
 
             core::Vector<ecs::EntityId> visible;
             if(const OctreeSystem* octree_system = world.find_system<OctreeSystem>()) {
-                visible = octree_system->octree().find_entities(camera.frustum());
+                visible = octree_system->spatial_index().find_entities(camera.frustum());
             }
 
             const usize in_frustum = visible.size();
@@ -37,6 +37,7 @@ SOFTWARE.
 #include <yave/graphics/commands/CmdBufferRecorder.h>
 #include <yave/graphics/commands/CmdTimingRecorder.h>
 #include <yave/graphics/device/DeviceResources.h>
+#include <yave/systems/TextureStreamingSystem.h>
 
 #include <yave/utils/color.h>
 
@@ -154,6 +155,10 @@ void EngineView::draw(CmdBufferRecorder& recorder) {
 
     const math::Vec2ui output_size = _resolution < 0 ? content_size() : standard_resolutions()[_resolution].second;
 
+    if(TextureStreamingSystem* streaming = current_world().find_system<TextureStreamingSystem>()) {
+        streaming->request_visible(_scene_view, output_size);
+    }
+
     UiTexture output;
     FrameGraph graph(_resource_pool);
     const EditorRenderer renderer = EditorRenderer::create(graph, _scene_view, output_size, _settings);
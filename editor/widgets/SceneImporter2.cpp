@@ -29,7 +29,7 @@ SOFTWARE.
 #include <yave/meshes/MeshData.h>
 #include <yave/animations/Animation.h>
 #include <yave/material/Material.h>
-#include <yave/graphics/images/ImageData.h>
+#include <yave/graphics/images/StreamedImageData.h>
 #include <yave/assets/AssetLoader.h>
 #include <yave/utils/FileSystemModel.h>
 #include <yave/ecs/EntityWorld.h>
@@ -87,8 +87,18 @@ static AssetId import_single_asset(const T& asset, std::string_view name, AssetT
     io2::Buffer buffer;
     {
         y_profile_zone("serialize");
-        serde3::WritableArchive arc(buffer);
-        if(auto sr = arc.serialize(asset); sr.is_error()) {
+
+        // Scene textures are streamed: only their low mips are loaded until they are needed on screen
+        const auto serialize = [&] {
+            if constexpr(std::is_same_v<T, ImageData>) {
+                return write_streamed_image(buffer, asset);
+            } else {
+                serde3::WritableArchive arc(buffer);
+                return arc.serialize(asset);
+            }
+        };
+
+        if(auto sr = serialize(); sr.is_error()) {
             log_func(fmt("Unable serialize \"%\": error %", name, sr.error().type), Log::Error);
             return {};
         }
@@ -0,0 +1,156 @@
+/*******************************
+Copyright (c) 2016-2023 Grégoire Angerand
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+**********************************/
+#include <y/io2/AsyncFileReader.h>
+#include <y/io2/File.h>
+#include <y/test/test.h>
+
+#include <y/utils/log.h>
+#include <y/utils/format.h>
+
+#include <cstdio>
+#include <cstring>
+
+namespace {
+using namespace y;
+
+static const char* test_file_name = "async_file_reader_test.bin";
+
+enum class ReadStatus : u32 {
+    Pending,
+    Ok,
+    Failed
+};
+
+struct ReadResult {
+    std::atomic<ReadStatus> status = ReadStatus::Pending;
+    core::Vector<byte> data;
+};
+
+class TestRequest : public io2::AsyncFileReader::Request {
+    public:
+        TestRequest(ReadResult* result, core::String file_name, u64 offset = 0, u64 size = 0) : Request(std::move(file_name), offset, size), _result(result) {
+        }
+
+        void done(core::Result<core::Vector<byte>> data) override {
+            if(data) {
+                _result->data = std::move(data.unwrap());
+                _result->status = ReadStatus::Ok;
+            } else {
+                _result->status = ReadStatus::Failed;
+            }
+        }
+
+    private:
+        ReadResult* _result = nullptr;
+};
+
+static core::Vector<byte> create_test_file(usize size) {
+    core::Vector<byte> content;
+    for(usize i = 0; i != size; ++i) {
+        content.push_back(byte((i * 7) ^ (i >> 8)));
+    }
+
+    if(auto file = io2::File::create(test_file_name)) {
+        if(file.unwrap().write(content.data(), content.size())) {
+            return content;
+        }
+    }
+    return {};
+}
+
+static bool read_and_compare(bool allow_io_uring) {
+    const usize file_size = 3 * 1024 * 1024 + 17;
+    const core::Vector<byte> content = create_test_file(file_size);
+    y_defer(std::remove(test_file_name));
+
+    if(content.size() != file_size) {
+        return false;
+    }
+
+    struct Range {
+        u64 offset;
+        u64 size;
+    };
+
+    core::Vector<Range> ranges;
+    const u64 until_end = io2::AsyncFileReader::Request::until_end;
+    ranges << Range{0, until_end} << Range{0, file_size} << Range{file_size, until_end} << Range{file_size - 1, 1} << Range{17, 0};
+    for(usize i = 0; i != 200; ++i) {
+        const u64 offset = (i * 7919) % file_size;
+        ranges << Range{offset, std::min<u64>(file_size - offset, i * 613)};
+    }
+
+    const usize request_count = ranges.size() + 2;
+    std::unique_ptr<ReadResult[]> results = std::make_unique<ReadResult[]>(request_count);
+
+    bool used_io_uring = false;
+
+    {
+        // Fewer slots than requests to exercise the queue
+        io2::AsyncFileReader reader(16, allow_io_uring);
+        used_io_uring = reader.is_using_io_uring();
+
+        // Half of the requests are submitted as a single batch
+        core::Vector<std::unique_ptr<io2::AsyncFileReader::Request>> batch;
+        for(usize i = 0; i != ranges.size(); ++i) {
+            auto request = std::make_unique<TestRequest>(&results[i], test_file_name, ranges[i].offset, ranges[i].size);
+            if(i % 2) {
+                batch.emplace_back(std::move(request));
+            } else {
+                reader.submit(std::move(request));
+            }
+        }
+        reader.submit(std::move(batch));
+
+        reader.submit(std::make_unique<TestRequest>(&results[ranges.size()], "this_file_does_not_exist.bin"));
+        reader.submit(std::make_unique<TestRequest>(&results[ranges.size() + 1], test_file_name, file_size - 4, 8));
+    }
+
+    if(allow_io_uring && !used_io_uring) {
+        log_msg("io_uring is not available, AsyncFileReader used blocking reads", Log::Warning);
+    }
+
+    for(usize i = 0; i != ranges.size(); ++i) {
+        const ReadResult& result = results[i];
+        const u64 size = ranges[i].size == until_end ? file_size - ranges[i].offset : ranges[i].size;
+        if(result.status != ReadStatus::Ok || result.data.size() != size) {
+            return false;
+        }
+        if(size && std::memcmp(result.data.data(), content.data() + ranges[i].offset, size) != 0) {
+            return false;
+        }
+    }
+
+    // Missing file and out of range read
+    return results[ranges.size()].status == ReadStatus::Failed && results[ranges.size() + 1].status == ReadStatus::Failed;
+}
+
+y_test_func("AsyncFileReader read") {
+    y_test_assert(read_and_compare(true));
+}
+
+y_test_func("AsyncFileReader blocking reads") {
+    y_test_assert(read_and_compare(false));
+}
+
+}
+
@@ -0,0 +1,261 @@
+/*******************************
+Copyright (c) 2016-2023 Grégoire Angerand
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+**********************************/
+#include <y/io2/BlockCompression.h>
+#include <y/serde3/archives.h>
+#include <y/test/test.h>
+
+#include <y/core/String.h>
+#include <y/math/Vec.h>
+#include <y/math/random.h>
+
+#include <thread>
+#include <cstring>
+
+namespace {
+using namespace y;
+
+struct Vertex {
+    math::Vec3 position;
+    u32 normal = 0;
+
+    y_reflect(Vertex, position, normal)
+};
+
+struct Mesh {
+    core::String name;
+    core::Vector<Vertex> vertices;
+    core::Vector<u32> indices;
+
+    y_reflect(Mesh, name, vertices, indices)
+};
+
+static core::Vector<byte> compressible_data(usize size) {
+    core::Vector<byte> data;
+    for(usize i = 0; i != size; ++i) {
+        data << byte((i / 7) % 13 + (i % 256 < 40 ? i % 5 : 0));
+    }
+    return data;
+}
+
+static core::Vector<byte> random_data(usize size) {
+    math::FastRandom rng;
+    core::Vector<byte> data;
+    for(usize i = 0; i != size; ++i) {
+        data << byte(rng());
+    }
+    return data;
+}
+
+static Mesh create_mesh(usize size) {
+    Mesh mesh;
+    mesh.name = "mesh";
+    for(usize i = 0; i != size; ++i) {
+        mesh.vertices << Vertex{{float(i % 100), 1.0f, float(i / 100)}, 7};
+        mesh.indices << u32(i) << u32(i + 1) << u32(i + 2);
+    }
+    return mesh;
+}
+
+static bool lz_roundtrip(const core::Vector<byte>& data) {
+    core::Vector<byte> compressed(io2::lz::max_compressed_size(data.size()), byte(0));
+    const usize compressed_size = io2::lz::compress(data.data(), data.size(), compressed.data(), compressed.size());
+    if(!compressed_size) {
+        return false;
+    }
+
+    core::Vector<byte> decompressed(data.size(), byte(0));
+    if(!io2::lz::decompress(compressed.data(), compressed_size, decompressed.data(), decompressed.size())) {
+        return false;
+    }
+
+    // Truncated data and wrong sizes are caught
+    if(compressed_size > 1 && io2::lz::decompress(compressed.data(), compressed_size - 1, decompressed.data(), decompressed.size())) {
+        return false;
+    }
+    if(data.size() && io2::lz::decompress(compressed.data(), compressed_size, decompressed.data(), decompressed.size() / 2)) {
+        return false;
+    }
+
+    return decompressed == data;
+}
+
+static core::Vector<byte> compress(const core::Vector<byte>& data, usize block_size) {
+    io2::Buffer buffer;
+    {
+        io2::CompressedWriter writer(buffer, block_size);
+        if(!writer.write(data.data(), data.size()) || !writer.flush() || writer.compressed_size() != buffer.size()) {
+            return {};
+        }
+    }
+    return core::Vector<byte>(buffer.data(), buffer.data() + buffer.size());
+}
+
+static std::unique_ptr<io2::CompressedReader> open(const core::Vector<byte>& compressed) {
+    auto reader = io2::CompressedReader::open(std::make_unique<io2::Buffer>(compressed));
+    return reader ? std::move(reader.unwrap()) : nullptr;
+}
+
+static bool stream_roundtrip(const core::Vector<byte>& data, usize block_size) {
+    const core::Vector<byte> compressed = compress(data, block_size);
+    auto reader = open(compressed);
+    if(!reader || reader->size() != data.size()) {
+        return false;
+    }
+
+    // Reads spanning several blocks, in a random order
+    math::FastRandom rng;
+    for(usize i = 0; i != 64 && data.size(); ++i) {
+        const usize offset = rng() % data.size();
+        const usize size = std::min<usize>(data.size() - offset, rng() % (block_size * 3));
+        core::Vector<byte> part(size, byte(0));
+        reader->seek(offset);
+        if(!reader->read(part.data(), size) || reader->tell() != offset + size) {
+            return false;
+        }
+        if(!std::equal(part.begin(), part.end(), data.begin() + offset)) {
+            return false;
+        }
+    }
+
+    reader->seek(0);
+    core::Vector<byte> all;
+    return reader->read_all(all) && all == data && reader->at_end();
+}
+
+y_test_func("lz roundtrip") {
+    for(const usize size : {0, 1, 4, 9, 10, 13, 100, 4097, 65536}) {
+        y_test_assert(lz_roundtrip(compressible_data(size)));
+        y_test_assert(lz_roundtrip(random_data(size)));
+    }
+}
+
+y_test_func("lz compresses") {
+    const core::Vector<byte> data = compressible_data(64 * 1024);
+    core::Vector<byte> compressed(io2::lz::max_compressed_size(data.size()), byte(0));
+    const usize compressed_size = io2::lz::compress(data.data(), data.size(), compressed.data(), compressed.size());
+    y_test_assert(compressed_size && compressed_size < data.size() / 4);
+
+    // Incompressible data doesn't fit in its own size
+    const core::Vector<byte> random = random_data(64 * 1024);
+    y_test_assert(!io2::lz::compress(random.data(), random.size(), compressed.data(), random.size() - 1));
+}
+
+y_test_func("CompressedReader roundtrip") {
+    for(const usize block_size : {usize(1024), io2::CompressedWriter::default_block_size}) {
+        for(const usize size : {usize(0), usize(5), block_size, block_size * 7 + 3}) {
+            y_test_assert(stream_roundtrip(compressible_data(size), block_size));
+            y_test_assert(stream_roundtrip(random_data(size), block_size));
+        }
+    }
+}
+
+y_test_func("CompressedReader detects compressed data") {
+    const core::Vector<byte> data = compressible_data(1000);
+
+    io2::Buffer raw(data);
+    y_test_assert(!io2::CompressedReader::is_compressed(raw));
+
+    io2::Buffer compressed(compress(data, 256));
+    y_test_assert(io2::CompressedReader::is_compressed(compressed));
+    y_test_assert(compressed.tell() == 0);
+
+    auto passthrough = io2::CompressedReader::open_if_compressed(std::make_unique<io2::Buffer>(data));
+    y_test_assert(passthrough && passthrough.unwrap()->remaining() == data.size());
+
+    // Corrupt blocks fail to read
+    core::Vector<byte> corrupt = compress(data, 256);
+    const usize payload = sizeof(io2::BlockCompressionHeader) + sizeof(u32) * 4;
+    y_test_assert(corrupt.size() > payload + 16);
+    std::fill(corrupt.begin() + payload, corrupt.begin() + payload + 16, byte(0xFF));
+    auto reader = open(corrupt);
+    y_test_assert(reader);
+    core::Vector<byte> all;
+    y_test_assert(!reader->read_all(all));
+    y_test_assert(!open(core::Vector<byte>(corrupt.begin(), corrupt.begin() + 30)));
+}
+
+y_test_func("CompressedReader rejects corrupt headers") {
+    const auto header_only = [](u32 block_size, u32 block_count, u64 uncompressed_size) {
+        io2::BlockCompressionHeader header;
+        header.block_size = block_size;
+        header.block_count = block_count;
+        header.uncompressed_size = uncompressed_size;
+        core::Vector<byte> bytes(sizeof(header), byte(0));
+        std::memcpy(bytes.data(), &header, sizeof(header));
+        return bytes;
+    };
+
+    // Would divide by the block size on the first read
+    y_test_assert(!open(header_only(0, 0, 1000)));
+
+    // Block tables or data bigger than the stream
+    y_test_assert(!open(header_only(1024, 1024 * 1024, u64(1024) * 1024 * 1024)));
+    y_test_assert(!open(header_only(1024, 1, 1000)));
+
+    // Blocks too small for the data they claim to hold
+    core::Vector<byte> too_big = header_only(1024, 1, 1000);
+    const u32 stored_size = 3 | io2::BlockCompressionHeader::uncompressed_block_bit;
+    too_big.set_min_size(too_big.size() + sizeof(u32), byte(0));
+    std::memcpy(too_big.data() + sizeof(io2::BlockCompressionHeader), &stored_size, sizeof(u32));
+    too_big << byte(1) << byte(2) << byte(3);
+    y_test_assert(!open(too_big));
+
+    auto empty = open(header_only(0, 0, 0));
+    y_test_assert(empty && empty->size() == 0);
+    core::Vector<byte> all;
+    y_test_assert(empty->read_all(all) && all.is_empty());
+}
+
+y_test_func("CompressedReader parallel decompression") {
+    const core::Vector<byte> data = compressible_data(1024 * 1024 + 17);
+    auto reader = open(compress(data, 4096));
+    y_test_assert(reader && reader->block_count() == 257);
+
+    std::thread helper([&] { reader->decompress_blocks(); });
+    y_test_assert(reader->decompress_all());
+    helper.join();
+
+    y_test_assert(!reader->has_pending_blocks());
+    const byte* in_place = reader->read_in_place(data.size());
+    y_test_assert(in_place && std::equal(data.begin(), data.end(), in_place));
+}
+
+y_test_func("CompressedReader serde3") {
+    const Mesh mesh = create_mesh(10000);
+
+    io2::Buffer buffer;
+    io2::CompressedWriter writer(buffer);
+    y_test_assert(serde3::WritableArchive(writer).serialize(mesh));
+    y_test_assert(writer.flush());
+    y_test_assert(buffer.size() < writer.tell() / 2);
+
+    auto reader = io2::CompressedReader::open_if_compressed(std::make_unique<io2::Buffer>(core::Vector<byte>(buffer.data(), buffer.data() + buffer.size())));
+    y_test_assert(reader);
+
+    Mesh read;
+    y_test_assert(serde3::ReadableArchive(*reader.unwrap()).deserialize(read));
+    y_test_assert(read.name == mesh.name && read.indices == mesh.indices && read.vertices.size() == mesh.vertices.size());
+    y_test_assert(std::memcmp(read.vertices.data(), mesh.vertices.data(), mesh.vertices.size() * sizeof(Vertex)) == 0);
+}
+
+}
+
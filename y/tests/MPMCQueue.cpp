@@ -0,0 +1,214 @@
+/*******************************
+Copyright (c) 2016-2023 Grégoire Angerand
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+**********************************/
+#include <y/concurrent/MPMCQueue.h>
+#include <y/test/test.h>
+
+#include <y/core/Vector.h>
+#include <y/core/Chrono.h>
+#include <y/utils/log.h>
+#include <y/utils/format.h>
+
+#include <deque>
+#include <thread>
+
+namespace {
+using namespace y;
+using namespace y::concurrent;
+
+// What the engine used before MPMCQueue
+template<typename T>
+class LockedQueue {
+    public:
+        bool push(T t) {
+            {
+                const std::unique_lock lock(_lock);
+                _queue.push_back(std::move(t));
+            }
+            _condition.notify_one();
+            return true;
+        }
+
+        bool pop(T& t) {
+            std::unique_lock lock(_lock);
+            _condition.wait(lock, [&] { return !_queue.empty() || _closed; });
+            if(_queue.empty()) {
+                return false;
+            }
+            t = std::move(_queue.front());
+            _queue.pop_front();
+            return true;
+        }
+
+        void close() {
+            const std::unique_lock lock(_lock);
+            _closed = true;
+            _condition.notify_all();
+        }
+
+    private:
+        std::deque<T> _queue;
+        bool _closed = false;
+        std::mutex _lock;
+        std::condition_variable _condition;
+};
+
+template<typename Queue>
+usize transfer(Queue& queue, usize producers, usize consumers, usize items_per_producer, double& time_ms) {
+    std::atomic<usize> sum = 0;
+
+    core::Chrono chrono;
+    {
+        core::Vector<std::thread> consumer_threads;
+        for(usize i = 0; i != consumers; ++i) {
+            consumer_threads.emplace_back([&] {
+                usize local = 0;
+                usize value = 0;
+                while(queue.pop(value)) {
+                    local += value;
+                }
+                sum += local;
+            });
+        }
+
+        core::Vector<std::thread> producer_threads;
+        for(usize i = 0; i != producers; ++i) {
+            producer_threads.emplace_back([&] {
+                for(usize k = 0; k != items_per_producer; ++k) {
+                    queue.push(k + 1);
+                }
+            });
+        }
+
+        for(auto& thread : producer_threads) {
+            thread.join();
+        }
+        queue.close();
+        for(auto& thread : consumer_threads) {
+            thread.join();
+        }
+    }
+
+    time_ms = chrono.elapsed().to_millis();
+    return sum;
+}
+
+y_test_func("MPMCQueue push/pop") {
+    MPMCQueue<usize> queue(5);
+    y_test_assert(queue.capacity() == 8);
+    y_test_assert(queue.is_empty());
+
+    for(usize i = 0; i != 8; ++i) {
+        y_test_assert(queue.try_push(i));
+    }
+    y_test_assert(!queue.try_push(8));
+    y_test_assert(queue.size() == 8);
+
+    usize value = 0;
+    for(usize i = 0; i != 8; ++i) {
+        y_test_assert(queue.try_pop(value));
+        y_test_assert(value == i);
+    }
+    y_test_assert(!queue.try_pop(value));
+
+    // Wrap around a few times
+    for(usize i = 0; i != 100; ++i) {
+        y_test_assert(queue.try_push(i));
+        y_test_assert(queue.try_pop(value));
+        y_test_assert(value == i);
+    }
+    y_test_assert(queue.is_empty());
+}
+
+y_test_func("MPMCQueue non trivial types") {
+    auto counter = std::make_shared<int>(0);
+    {
+        MPMCQueue<std::shared_ptr<int>> queue(4);
+        for(usize i = 0; i != 4; ++i) {
+            y_test_assert(queue.try_push(counter));
+        }
+
+        auto extra = counter;
+        y_test_assert(!queue.try_push(std::move(extra)));
+        y_test_assert(extra == counter);
+        extra = nullptr;
+
+        std::shared_ptr<int> value;
+        y_test_assert(queue.try_pop(value));
+        y_test_assert(value == counter);
+        y_test_assert(counter.use_count() == 5);
+    }
+    y_test_assert(counter.use_count() == 1);
+}
+
+y_test_func("BlockingMPMCQueue close") {
+    BlockingMPMCQueue<usize> queue(2);
+    y_test_assert(queue.push(1));
+    queue.close();
+    y_test_assert(!queue.push(2));
+
+    usize value = 0;
+    y_test_assert(queue.pop(value));
+    y_test_assert(value == 1);
+    y_test_assert(!queue.pop(value));
+}
+
+y_test_func("BlockingMPMCQueue wake_all") {
+    BlockingMPMCQueue<usize> queue(2);
+    std::atomic<bool> stop = false;
+    bool popped = true;
+    std::thread thread([&] {
+        usize value = 0;
+        popped = queue.pop(value, [&] { return bool(stop); });
+    });
+
+    stop = true;
+    queue.wake_all();
+    thread.join();
+    y_test_assert(!popped);
+    y_test_assert(queue.is_empty());
+}
+
+y_test_func("BlockingMPMCQueue contention") {
+    const usize items = 1024 * 64;
+    const usize expected_per_producer = items * (items + 1) / 2;
+
+    for(const usize threads : {1_uu, 2_uu, 4_uu, 8_uu}) {
+        double locked_time = 0.0;
+        double mpmc_time = 0.0;
+
+        {
+            LockedQueue<usize> queue;
+            y_test_assert(transfer(queue, threads, threads, items, locked_time) == expected_per_producer * threads);
+        }
+        {
+            BlockingMPMCQueue<usize> queue(1024);
+            y_test_assert(transfer(queue, threads, threads, items, mpmc_time) == expected_per_producer * threads);
+        }
+
+        const double total = double(items * threads);
+        log_msg(fmt("% producers, % consumers: mutex queue % Mitems/s, BlockingMPMCQueue % Mitems/s",
+            threads, threads, total / (locked_time * 1000.0), total / (mpmc_time * 1000.0)), Log::Perf);
+    }
+}
+
+}
+
@@ -0,0 +1,184 @@
+/*******************************
+Copyright (c) 2016-2023 Grégoire Angerand
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+**********************************/
+#include <y/io2/MappedFile.h>
+#include <y/io2/File.h>
+#include <y/serde3/archives.h>
+#include <y/test/test.h>
+
+#include <y/core/Chrono.h>
+#include <y/math/Vec.h>
+#include <y/utils/log.h>
+#include <y/utils/format.h>
+
+#include <array>
+#include <cstdio>
+
+namespace {
+using namespace y;
+
+static const char* test_file_name = "mapped_file_test.bin";
+
+struct Vertex {
+    math::Vec3 position;
+    u32 normal = 0;
+
+    y_reflect(Vertex, position, normal)
+};
+
+struct Mesh {
+    core::Vector<std::array<u32, 3>> triangles;
+    core::Vector<Vertex> vertices;
+    core::FixedArray<u8> bytes;
+
+    y_reflect(Mesh, triangles, vertices, bytes)
+};
+
+static Mesh create_mesh(usize size) {
+    Mesh mesh;
+    mesh.bytes = core::FixedArray<u8>(size * 4);
+    for(usize i = 0; i != size; ++i) {
+        mesh.triangles << std::array<u32, 3>{u32(i), u32(i + 1), u32(i + 2)};
+        mesh.vertices << Vertex{{float(i), 1.0f, 2.0f}, u32(i * 3)};
+        for(usize k = 0; k != 4; ++k) {
+            mesh.bytes[i * 4 + k] = u8(i + k);
+        }
+    }
+    return mesh;
+}
+
+static bool is_same(const Mesh& a, const Mesh& b) {
+    if(a.triangles != b.triangles || a.bytes != b.bytes || a.vertices.size() != b.vertices.size()) {
+        return false;
+    }
+    for(usize i = 0; i != a.vertices.size(); ++i) {
+        if(std::memcmp(&a.vertices[i], &b.vertices[i], sizeof(Vertex))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool write_test_file(const Mesh& mesh) {
+    auto file = io2::File::create(test_file_name);
+    if(!file) {
+        return false;
+    }
+    serde3::WritableArchive arc(file.unwrap());
+    return arc.serialize(mesh).is_ok();
+}
+
+static bool load_and_compare(io2::Reader& reader, const Mesh& mesh) {
+    Mesh loaded;
+    serde3::ReadableArchive arc(reader);
+    if(const auto res = arc.deserialize(loaded); !res || res.unwrap() != serde3::Success::Full) {
+        return false;
+    }
+    return is_same(mesh, loaded);
+}
+
+y_test_func("MappedFile read") {
+    {
+        auto file = io2::File::create(test_file_name);
+        y_test_assert(file);
+        for(u32 i = 0; i != 1024; ++i) {
+            y_test_assert(file.unwrap().write_one(i));
+        }
+    }
+
+    {
+        auto res = io2::MappedFile::open(test_file_name);
+        y_test_assert(res);
+        io2::MappedFile& file = res.unwrap();
+
+        y_test_assert(file.is_open());
+        y_test_assert(file.size() == 1024 * sizeof(u32));
+        y_test_assert(file.span().size() == file.size());
+
+        u32 value = 0;
+        y_test_assert(file.read_one(value));
+        y_test_assert(value == 0);
+
+        file.seek(100 * sizeof(u32));
+        y_test_assert(file.read_one(value));
+        y_test_assert(value == 100);
+
+        const byte* in_place = file.read_in_place(2 * sizeof(u32));
+        y_test_assert(in_place);
+        std::memcpy(&value, in_place + sizeof(u32), sizeof(u32));
+        y_test_assert(value == 102);
+        y_test_assert(file.tell() == 103 * sizeof(u32));
+
+        y_test_assert(!file.read_in_place(file.remaining() + 1));
+        y_test_assert(file.tell() == 103 * sizeof(u32));
+
+        core::Vector<byte> rest;
+        y_test_assert(file.read_all(rest).unwrap() == (1024 - 103) * sizeof(u32));
+        y_test_assert(file.at_end());
+        y_test_assert(!file.read_one(value));
+    }
+
+    y_test_assert(!io2::MappedFile::open("this_file_does_not_exist.bin"));
+    std::remove(test_file_name);
+}
+
+y_test_func("MappedFile serde3") {
+    const Mesh mesh = create_mesh(1024);
+    y_test_assert(write_test_file(mesh));
+
+    {
+        auto file = io2::MappedFile::open(test_file_name);
+        y_test_assert(file);
+        y_test_assert(load_and_compare(file.unwrap(), mesh));
+    }
+
+    std::remove(test_file_name);
+}
+
+y_test_func("MappedFile vs File deserialization") {
+    const Mesh mesh = create_mesh(1024 * 256);
+    y_test_assert(write_test_file(mesh));
+
+    double file_time = 0.0;
+    double mapped_time = 0.0;
+
+    {
+        core::Chrono chrono;
+        auto file = io2::File::open(test_file_name);
+        y_test_assert(file);
+        y_test_assert(load_and_compare(file.unwrap(), mesh));
+        file_time = chrono.elapsed().to_millis();
+    }
+
+    {
+        core::Chrono chrono;
+        auto file = io2::MappedFile::open(test_file_name);
+        y_test_assert(file);
+        y_test_assert(load_and_compare(file.unwrap(), mesh));
+        mapped_time = chrono.elapsed().to_millis();
+    }
+
+    log_msg(fmt("Deserializing % vertices: File %ms, MappedFile %ms", mesh.vertices.size(), file_time, mapped_time), Log::Perf);
+    std::remove(test_file_name);
+}
+
+}
+
@@ -0,0 +1,198 @@
+/*******************************
+Copyright (c) 2016-2023 Grégoire Angerand
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+**********************************/
+#include <y/concurrent/WorkStealingThreadPool.h>
+#include <y/concurrent/StaticThreadPool.h>
+#include <y/test/test.h>
+
+#include <y/core/Chrono.h>
+#include <y/utils/log.h>
+#include <y/utils/format.h>
+
+namespace {
+using namespace y;
+using namespace y::concurrent;
+
+template<typename Pool>
+usize schedule_from_producers(usize producers, usize tasks_per_producer, double& time_ms) {
+    std::atomic<usize> done = 0;
+
+    core::Chrono chrono;
+    {
+        Pool pool;
+
+        core::Vector<std::thread> threads;
+        for(usize i = 0; i != producers; ++i) {
+            threads.emplace_back([&] {
+                for(usize k = 0; k != tasks_per_producer; ++k) {
+                    pool.schedule([&] { ++done; });
+                }
+            });
+        }
+
+        for(auto& thread : threads) {
+            thread.join();
+        }
+    }
+
+    time_ms = chrono.elapsed().to_millis();
+    return done;
+}
+
+y_test_func("WorkStealingQueue push/pop/steal") {
+    WorkStealingQueue<usize*> queue(4);
+    usize values[64] = {};
+
+    for(usize i = 0; i != 64; ++i) {
+        queue.push(&values[i]);
+    }
+    y_test_assert(queue.size() == 64);
+
+    y_test_assert(queue.steal() == &values[0]);
+    y_test_assert(queue.pop() == &values[63]);
+    y_test_assert(queue.steal() == &values[1]);
+    y_test_assert(queue.size() == 61);
+
+    while(queue.pop()) {
+    }
+    y_test_assert(queue.is_empty());
+    y_test_assert(!queue.steal());
+}
+
+y_test_func("WorkStealingThreadPool schedule") {
+    std::atomic<usize> counter = 0;
+    {
+        WorkStealingThreadPool pool(4);
+        for(usize i = 0; i != 1000; ++i) {
+            pool.schedule([&] {
+                ++counter;
+            });
+        }
+    }
+    y_test_assert(counter == 1000);
+}
+
+y_test_func("WorkStealingThreadPool nested schedule") {
+    std::atomic<usize> counter = 0;
+    {
+        WorkStealingThreadPool pool(4);
+        for(usize i = 0; i != 64; ++i) {
+            pool.schedule([&] {
+                for(usize k = 0; k != 64; ++k) {
+                    pool.schedule([&] { ++counter; });
+                }
+            });
+        }
+    }
+    y_test_assert(counter == 64 * 64);
+}
+
+y_test_func("WorkStealingThreadPool dependencies") {
+    WorkStealingThreadPool pool(4);
+
+    std::atomic<usize> first = 0;
+    std::atomic<bool> ordered = true;
+
+    DependencyGroup group;
+    for(usize i = 0; i != 32; ++i) {
+        pool.schedule([&] { ++first; }, &group);
+    }
+
+    DependencyGroup second;
+    for(usize i = 0; i != 32; ++i) {
+        pool.schedule([&] {
+            if(first != 32) {
+                ordered = false;
+            }
+        }, &second, group);
+    }
+
+    pool.process_until_ready(second);
+
+    y_test_assert(group.is_ready());
+    y_test_assert(ordered);
+}
+
+y_test_func("WorkStealingThreadPool cancel") {
+    WorkStealingThreadPool pool(1);
+
+    std::atomic<bool> started = false;
+    std::atomic<bool> blocked = true;
+    pool.schedule([&] {
+        started = true;
+        while(blocked) {
+            std::this_thread::yield();
+        }
+    });
+
+    while(!started) {
+        std::this_thread::yield();
+    }
+
+    std::atomic<usize> counter = 0;
+
+    DependencyGroup group;
+    for(usize i = 0; i != 32; ++i) {
+        pool.schedule([&] { ++counter; }, &group);
+    }
+
+    DependencyGroup second;
+    pool.schedule([&] { ++counter; }, &second, group);
+
+    pool.cancel_pending_tasks();
+    blocked = false;
+
+    pool.process_until_ready(second);
+    while(!pool.is_empty()) {
+        std::this_thread::yield();
+    }
+
+    y_test_assert(group.is_ready());
+    y_test_assert(counter == 0);
+}
+
+y_test_func("WorkStealingThreadPool future") {
+    WorkStealingThreadPool pool(2);
+    auto future = pool.schedule_with_future([] { return 7; });
+    y_test_assert(future.get() == 7);
+}
+
+y_test_func("WorkStealingThreadPool no thread") {
+    usize counter = 0;
+    WorkStealingThreadPool pool(0);
+    pool.schedule([&] { ++counter; });
+    y_test_assert(counter == 1);
+    y_test_assert(pool.is_empty());
+}
+
+y_test_func("WorkStealingThreadPool vs StaticThreadPool") {
+    const usize total_tasks = 1024 * 16;
+    for(const usize producers : {1_uu, 4_uu, 16_uu}) {
+        double stat = 0.0;
+        double steal = 0.0;
+        y_test_assert(schedule_from_producers<StaticThreadPool>(producers, total_tasks / producers, stat) == total_tasks);
+        y_test_assert(schedule_from_producers<WorkStealingThreadPool>(producers, total_tasks / producers, steal) == total_tasks);
+        log_msg(fmt("% tasks from % producers: StaticThreadPool %ms, WorkStealingThreadPool %ms", total_tasks, producers, stat, steal), Log::Perf);
+    }
+}
+
+}
+
@@ -22,6 +22,7 @@ SOFTWARE.
 
 #include <y/utils.h>
 #include <y/utils/traits.h>
+#include <y/utils/hash.h>
 
 #include <y/test/test.h>
 
@@ -56,5 +57,42 @@ y_test_func("utils do_not_destroy") {
   }
   y_test_assert(i == 1);
 }
+
+y_test_func("utils ContentHash") {
+  const std::string_view text = "Nobody inspects the spammish repetition";
+
+  ContentHash empty;
+  y_test_assert(empty.hash() == UINT64_C(0xEF46DB3751D8E999));
+
+  ContentHash full;
+  full.add(text.data(), text.size());
+  y_test_assert(full.hash() == UINT64_C(0xFBCEA83C8A378BF1));
+
+  for (usize chunk = 1; chunk != text.size(); ++chunk) {
+    ContentHash chunked;
+    for (usize i = 0; i < text.size(); i += chunk) {
+      chunked.add(text.data() + i, std::min(chunk, text.size() - i));
+    }
+    y_test_assert(chunked.hash() == full.hash());
+  }
+}
+
+y_test_func("utils ContentHash128") {
+  const std::string_view text = "Nobody inspects the spammish repetition";
+
+  ContentHash128 full;
+  full.add(text.data(), text.size());
+  y_test_assert(full.hash().low == UINT64_C(0xFBCEA83C8A378BF1));
+  y_test_assert(full.hash().low != full.hash().high);
+
+  ContentHash128 chunked;
+  chunked.add(text.data(), 7);
+  chunked.add(text.data() + 7, text.size() - 7);
+  y_test_assert(chunked.hash() == full.hash());
+
+  ContentHash128 other;
+  other.add(text.data(), text.size() - 1);
+  y_test_assert(other.hash() != full.hash());
+}
 }
 
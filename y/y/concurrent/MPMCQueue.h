@@ -0,0 +1,304 @@
+/*******************************
+Copyright (c) 2016-2023 Grégoire Angerand
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+**********************************/
+#ifndef Y_CONCURRENT_MPMCQUEUE_H
+#define Y_CONCURRENT_MPMCQUEUE_H
+
+#include <y/utils.h>
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+
+namespace y {
+namespace concurrent {
+
+// Bounded multi-producer multi-consumer queue (see Dmitry Vyukov's "Bounded MPMC queue")
+// Every cell carries a sequence number that tells producers and consumers whether it is free, full or being written.
+// Push and pop are a single CAS on the enqueue/dequeue position in the uncontended case, and never allocate.
+template<typename T>
+class MPMCQueue : NonMovable {
+    struct Cell {
+        std::atomic<usize> sequence;
+        alignas(T) u8 storage[sizeof(T)];
+
+        T* value() {
+            return reinterpret_cast<T*>(storage);
+        }
+    };
+
+    public:
+        MPMCQueue(usize capacity = 1024) {
+            usize pow2_capacity = 2;
+            while(pow2_capacity < capacity) {
+                pow2_capacity *= 2;
+            }
+
+            _mask = pow2_capacity - 1;
+            _cells = std::make_unique<Cell[]>(pow2_capacity);
+            for(usize i = 0; i != pow2_capacity; ++i) {
+                _cells[i].sequence.store(i, std::memory_order_relaxed);
+            }
+        }
+
+        ~MPMCQueue() {
+            const usize end = _enqueue_pos.load(std::memory_order_acquire);
+            for(usize pos = _dequeue_pos.load(std::memory_order_acquire); pos != end; ++pos) {
+                _cells[pos & _mask].value()->~T();
+            }
+        }
+
+        usize capacity() const {
+            return _mask + 1;
+        }
+
+        // Only a snapshot: can be out of date as soon as it returns
+        usize size() const {
+            const usize enqueue = _enqueue_pos.load(std::memory_order_relaxed);
+            const usize dequeue = _dequeue_pos.load(std::memory_order_relaxed);
+            return enqueue > dequeue ? std::min(enqueue - dequeue, capacity()) : 0;
+        }
+
+        bool is_empty() const {
+            return size() == 0;
+        }
+
+        // Returns false if the queue is full
+        bool try_push(const T& t) {
+            return try_emplace(t);
+        }
+
+        // Returns false if the queue is full, t is only moved from on success
+        bool try_push(T&& t) {
+            return try_emplace(std::move(t));
+        }
+
+        // Returns false if the queue is empty
+        bool try_pop(T& t) {
+            usize pos = _dequeue_pos.load(std::memory_order_relaxed);
+            Cell* cell = nullptr;
+            for(;;) {
+                cell = &_cells[pos & _mask];
+                const usize seq = cell->sequence.load(std::memory_order_acquire);
+                const isize diff = isize(seq) - isize(pos + 1);
+                if(diff == 0) {
+                    if(_dequeue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                        break;
+                    }
+                } else if(diff < 0) {
+                    return false;
+                } else {
+                    pos = _dequeue_pos.load(std::memory_order_relaxed);
+                }
+            }
+
+            T* value = cell->value();
+            t = std::move(*value);
+            value->~T();
+            cell->sequence.store(pos + _mask + 1, std::memory_order_release);
+            return true;
+        }
+
+    private:
+        template<typename U>
+        bool try_emplace(U&& u) {
+            usize pos = _enqueue_pos.load(std::memory_order_relaxed);
+            Cell* cell = nullptr;
+            for(;;) {
+                cell = &_cells[pos & _mask];
+                const usize seq = cell->sequence.load(std::memory_order_acquire);
+                const isize diff = isize(seq) - isize(pos);
+                if(diff == 0) {
+                    if(_enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                        break;
+                    }
+                } else if(diff < 0) {
+                    return false;
+                } else {
+                    pos = _enqueue_pos.load(std::memory_order_relaxed);
+                }
+            }
+
+            new(cell->value()) T(y_fwd(u));
+            cell->sequence.store(pos + 1, std::memory_order_release);
+            return true;
+        }
+
+        std::unique_ptr<Cell[]> _cells;
+        usize _mask = 0;
+
+        alignas(64) std::atomic<usize> _enqueue_pos = 0;
+        alignas(64) std::atomic<usize> _dequeue_pos = 0;
+};
+
+
+// MPMCQueue with blocking push and pop.
+// The mutex is only taken when a thread actually has to wait (or has to wake a waiting thread),
+// so producers and consumers never contend on it while the queue is neither full nor empty.
+template<typename T>
+class BlockingMPMCQueue : NonMovable {
+    public:
+        BlockingMPMCQueue(usize capacity = 1024) : _queue(capacity) {
+        }
+
+        usize capacity() const {
+            return _queue.capacity();
+        }
+
+        usize size() const {
+            return _queue.size();
+        }
+
+        bool is_empty() const {
+            return _queue.is_empty();
+        }
+
+        bool is_closed() const {
+            return _closed;
+        }
+
+        // Returns false if the queue is full or closed, t is only moved from on success
+        bool try_push(T&& t) {
+            if(!_closed && _queue.try_push(std::move(t))) {
+                notify(_pop_waiters, _not_empty);
+                return true;
+            }
+            return false;
+        }
+
+        bool try_pop(T& t) {
+            if(_queue.try_pop(t)) {
+                notify(_push_waiters, _not_full);
+                return true;
+            }
+            return false;
+        }
+
+        // Blocks while the queue is full. Returns false (and leaves t untouched) if the queue has been closed
+        bool push(T&& t) {
+            for(usize i = 0; i != spin_count; ++i) {
+                if(try_push(std::move(t))) {
+                    return true;
+                }
+                std::this_thread::yield();
+            }
+
+            std::unique_lock lock(_lock);
+            ++_push_waiters;
+            y_defer(--_push_waiters);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            for(;;) {
+                if(_closed) {
+                    return false;
+                }
+                if(_queue.try_push(std::move(t))) {
+                    break;
+                }
+                _not_full.wait(lock);
+            }
+
+            lock.unlock();
+            notify(_pop_waiters, _not_empty);
+            return true;
+        }
+
+        // Blocks while the queue is empty. Returns false if the queue has been closed and is empty
+        bool pop(T& t) {
+            return pop(t, [] { return false; });
+        }
+
+        // Blocks while the queue is empty and stop returns false.
+        // stop is checked under the lock, so anything that changes its result followed by wake_all can not be missed.
+        template<typename F>
+        bool pop(T& t, F&& stop) {
+            for(usize i = 0; i != spin_count; ++i) {
+                if(try_pop(t)) {
+                    return true;
+                }
+                std::this_thread::yield();
+            }
+
+            std::unique_lock lock(_lock);
+            ++_pop_waiters;
+            y_defer(--_pop_waiters);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            for(;;) {
+                if(_queue.try_pop(t)) {
+                    break;
+                }
+                if(_closed || stop()) {
+                    return false;
+                }
+                _not_empty.wait(lock);
+            }
+
+            lock.unlock();
+            notify(_push_waiters, _not_full);
+            return true;
+        }
+
+        // Wakes up all threads blocked in pop so they can re-evaluate their stop condition
+        void wake_all() {
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if(_pop_waiters.load(std::memory_order_relaxed)) {
+                const std::unique_lock lock(_lock);
+                _not_empty.notify_all();
+            }
+        }
+
+        // Wakes up every waiting thread. push will fail from now on, pop keeps returning items until the queue is empty
+        void close() {
+            const std::unique_lock lock(_lock);
+            _closed = true;
+            _not_empty.notify_all();
+            _not_full.notify_all();
+        }
+
+    private:
+        // Number of attempts before going to sleep, waking a thread is much more expensive than a few failed pops
+        static constexpr usize spin_count = 16;
+
+        void notify(const std::atomic<u32>& waiters, std::condition_variable& cond) {
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if(waiters.load(std::memory_order_relaxed)) {
+                const std::unique_lock lock(_lock);
+                cond.notify_one();
+            }
+        }
+
+        MPMCQueue<T> _queue;
+
+        std::atomic<u32> _push_waiters = 0;
+        std::atomic<u32> _pop_waiters = 0;
+        std::atomic<bool> _closed = false;
+
+        std::mutex _lock;
+        std::condition_variable _not_empty;
+        std::condition_variable _not_full;
+};
+
+}
+}
+
+#endif // Y_CONCURRENT_MPMCQUEUE_H
+
@@ -50,6 +50,7 @@ class DependencyGroup {
 
     private:
         friend class StaticThreadPool;
+        friend class WorkStealingThreadPool;
 
         void add_dependency();
         void solve_dependency();
@@ -0,0 +1,162 @@
+/*******************************
+Copyright (c) 2016-2023 Grégoire Angerand
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+**********************************/
+#ifndef Y_CONCURRENT_WORKSTEALINGQUEUE_H
+#define Y_CONCURRENT_WORKSTEALINGQUEUE_H
+
+#include <y/core/Vector.h>
+
+#include <atomic>
+#include <memory>
+
+namespace y {
+namespace concurrent {
+
+// Chase-Lev deque (see "Correct and Efficient Work-Stealing for Weak Memory Models", Lê et al. 2013)
+// Only the owning thread can push and pop, any thread can steal.
+// Buffers are never freed before the queue is destroyed, so stealers can never read from a dead buffer.
+template<typename T>
+class WorkStealingQueue : NonMovable {
+    static_assert(std::is_pointer_v<T>, "WorkStealingQueue can only store pointers");
+
+    class Buffer : NonMovable {
+        public:
+            Buffer(usize capacity) : _mask(capacity - 1), _data(std::make_unique<std::atomic<T>[]>(capacity)) {
+                y_debug_assert((capacity & _mask) == 0);
+            }
+
+            usize capacity() const {
+                return _mask + 1;
+            }
+
+            void store(isize index, T t) {
+                _data[usize(index) & _mask].store(t, std::memory_order_relaxed);
+            }
+
+            T load(isize index) const {
+                return _data[usize(index) & _mask].load(std::memory_order_relaxed);
+            }
+
+            std::unique_ptr<Buffer> grow(isize top, isize bottom) const {
+                auto buffer = std::make_unique<Buffer>(capacity() * 2);
+                for(isize i = top; i != bottom; ++i) {
+                    buffer->store(i, load(i));
+                }
+                return buffer;
+            }
+
+        private:
+            const usize _mask;
+            std::unique_ptr<std::atomic<T>[]> _data;
+    };
+
+    public:
+        WorkStealingQueue(usize capacity = 1024) {
+            usize pow2_capacity = 2;
+            while(pow2_capacity < capacity) {
+                pow2_capacity *= 2;
+            }
+            _buffers.emplace_back(std::make_unique<Buffer>(pow2_capacity));
+            _buffer = _buffers.last().get();
+        }
+
+        usize size() const {
+            const isize bottom = _bottom.load(std::memory_order_relaxed);
+            const isize top = _top.load(std::memory_order_relaxed);
+            return usize(std::max(bottom - top, isize(0)));
+        }
+
+        bool is_empty() const {
+            return size() == 0;
+        }
+
+        // Owner only
+        void push(T t) {
+            const isize bottom = _bottom.load(std::memory_order_relaxed);
+            const isize top = _top.load(std::memory_order_acquire);
+            Buffer* buffer = _buffer.load(std::memory_order_relaxed);
+
+            if(bottom - top > isize(buffer->capacity()) - 1) {
+                _buffers.emplace_back(buffer->grow(top, bottom));
+                buffer = _buffers.last().get();
+                _buffer.store(buffer, std::memory_order_release);
+            }
+
+            buffer->store(bottom, t);
+            std::atomic_thread_fence(std::memory_order_release);
+            _bottom.store(bottom + 1, std::memory_order_relaxed);
+        }
+
+        // Owner only
+        T pop() {
+            const isize bottom = _bottom.load(std::memory_order_relaxed) - 1;
+            Buffer* buffer = _buffer.load(std::memory_order_relaxed);
+            _bottom.store(bottom, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            isize top = _top.load(std::memory_order_relaxed);
+
+            if(top > bottom) {
+                _bottom.store(bottom + 1, std::memory_order_relaxed);
+                return nullptr;
+            }
+
+            T t = buffer->load(bottom);
+            if(top == bottom) {
+                // Last element, race against stealers
+                if(!_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+                    t = nullptr;
+                }
+                _bottom.store(bottom + 1, std::memory_order_relaxed);
+            }
+            return t;
+        }
+
+        // Any thread
+        T steal() {
+            isize top = _top.load(std::memory_order_acquire);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            const isize bottom = _bottom.load(std::memory_order_acquire);
+
+            if(top >= bottom) {
+                return nullptr;
+            }
+
+            const Buffer* buffer = _buffer.load(std::memory_order_acquire);
+            T t = buffer->load(top);
+            if(!_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+                return nullptr;
+            }
+            return t;
+        }
+
+    private:
+        alignas(64) std::atomic<isize> _top = 0;
+        alignas(64) std::atomic<isize> _bottom = 0;
+        alignas(64) std::atomic<Buffer*> _buffer = nullptr;
+
+        core::Vector<std::unique_ptr<Buffer>> _buffers;
+};
+
+}
+}
+
+#endif // Y_CONCURRENT_WORKSTEALINGQUEUE_H
+
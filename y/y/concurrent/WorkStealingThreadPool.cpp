@@ -0,0 +1,325 @@
+/*******************************
+Copyright (c) 2016-2023 Grégoire Angerand
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+**********************************/
+
+#include "WorkStealingThreadPool.h"
+#include "concurrent.h"
+
+#include <y/utils/format.h>
+
+namespace y {
+namespace concurrent {
+
+static thread_local const WorkStealingThreadPool* this_thread_pool = nullptr;
+static thread_local usize this_thread_worker_index = 0;
+
+static usize steal_start_index(usize worker_count) {
+    static thread_local u32 state = thread_id() * 2654435761u + 1;
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return usize(state) % worker_count;
+}
+
+
+WorkStealingThreadPool::Task::Task(Func func, DependencyGroup wait, DependencyGroup done) :
+        function(std::move(func)),
+        wait_for(std::move(wait)),
+        on_done(std::move(done)) {
+}
+
+WorkStealingThreadPool::WorkStealingThreadPool(usize thread_count) {
+    for(usize i = 0; i != thread_count; ++i) {
+        _workers.emplace_back(std::make_unique<Worker>());
+    }
+
+    for(usize i = 0; i != thread_count; ++i) {
+        _workers[i]->thread = std::thread([this, i] {
+            concurrent::set_thread_name(fmt_c_str("Worker thread #%", i));
+            worker(i);
+        });
+    }
+}
+
+WorkStealingThreadPool::~WorkStealingThreadPool() {
+    process_until_empty();
+
+    {
+        _run = false;
+        const std::unique_lock lock(_sleep_lock);
+        _condition.notify_all();
+    }
+
+    for(auto& worker : _workers) {
+        worker->thread.join();
+    }
+
+    {
+        const std::unique_lock lock(_waiting_lock);
+        y_debug_assert(_waiting.is_empty());
+        for(Task* task : _waiting) {
+            delete task;
+        }
+        _waiting.clear();
+    }
+}
+
+usize WorkStealingThreadPool::concurency() const {
+    return _workers.size();
+}
+
+bool WorkStealingThreadPool::is_empty() const {
+    return !_scheduled;
+}
+
+usize WorkStealingThreadPool::pending_tasks() const {
+    return _scheduled;
+}
+
+void WorkStealingThreadPool::cancel_pending_tasks() {
+    auto drop = [this](Task* task) {
+        // Whoever waits on the group would never be woken up otherwise
+        task->on_done.solve_dependency();
+        delete task;
+        --_scheduled;
+    };
+
+    {
+        const std::unique_lock lock(_injector_lock);
+        for(Task* task : _injector) {
+            drop(task);
+        }
+        _ready -= isize(_injector.size());
+        _injector_size = 0;
+        _injector.clear();
+    }
+
+    for(auto& worker : _workers) {
+        while(!worker->queue.is_empty()) {
+            if(Task* task = worker->queue.steal()) {
+                --_ready;
+                drop(task);
+            }
+        }
+    }
+
+    {
+        const std::unique_lock lock(_waiting_lock);
+        for(Task* task : _waiting) {
+            drop(task);
+        }
+        _waiting_count = 0;
+        _waiting.clear();
+    }
+}
+
+void WorkStealingThreadPool::schedule(Func&& func, DependencyGroup* on_done, DependencyGroup wait_for) {
+    y_debug_assert(_run);
+
+    Task* task = nullptr;
+    if(on_done) {
+        on_done->add_dependency();
+        task = new Task(std::move(func), std::move(wait_for), *on_done);
+    } else {
+        task = new Task(std::move(func), std::move(wait_for));
+    }
+
+    ++_scheduled;
+
+    if(!task->wait_for.is_ready()) {
+        // Checking again under the lock so we can't miss the group being solved
+        const std::unique_lock lock(_waiting_lock);
+        if(!task->wait_for.is_ready()) {
+            _waiting << task;
+            ++_waiting_count;
+            return;
+        }
+    }
+
+    push_ready(task);
+
+    if(!concurency()) {
+        process_until_empty();
+    }
+}
+
+void WorkStealingThreadPool::process_until_ready(const DependencyGroup& group) {
+    while(!group.is_ready()) {
+        if(!process_one()) {
+            std::this_thread::yield();
+        }
+    }
+}
+
+void WorkStealingThreadPool::process_until_empty() {
+    for(;;) {
+        // _scheduled has to be read before _waiting_count, a finishing task releases its waiters before being marked as done
+        const usize scheduled = _scheduled;
+        const usize waiting = _waiting_count;
+        if(scheduled <= waiting) {
+            break;
+        }
+
+        if(!process_one()) {
+            std::this_thread::yield();
+        }
+    }
+}
+
+bool WorkStealingThreadPool::process_one() {
+    if(Task* task = find_task()) {
+        run_task(task);
+        return true;
+    }
+    return false;
+}
+
+void WorkStealingThreadPool::push_ready(Task* task) {
+    ++_ready;
+
+    if(this_thread_pool == this) {
+        _workers[this_thread_worker_index]->queue.push(task);
+    } else {
+        const std::unique_lock lock(_injector_lock);
+        _injector.push_back(task);
+        ++_injector_size;
+    }
+
+    if(_sleeping) {
+        const std::unique_lock lock(_sleep_lock);
+        _condition.notify_one();
+    }
+}
+
+void WorkStealingThreadPool::release_waiting_tasks() {
+    if(!_waiting_count) {
+        return;
+    }
+
+    core::Vector<Task*> ready;
+    {
+        const std::unique_lock lock(_waiting_lock);
+        for(usize i = 0; i < _waiting.size(); ++i) {
+            if(_waiting[i]->wait_for.is_ready()) {
+                ready << _waiting[i];
+                _waiting.erase_unordered(_waiting.begin() + i);
+                --i;
+            }
+        }
+        _waiting_count -= ready.size();
+    }
+
+    for(Task* task : ready) {
+        push_ready(task);
+    }
+}
+
+WorkStealingThreadPool::Task* WorkStealingThreadPool::find_task() {
+    Worker* self = this_thread_pool == this ? _workers[this_thread_worker_index].get() : nullptr;
+
+    Task* task = nullptr;
+    if(self) {
+        task = self->queue.pop();
+    }
+
+    if(!task && _injector_size) {
+        const std::unique_lock lock(_injector_lock);
+        if(!_injector.empty()) {
+            task = _injector.front();
+            _injector.pop_front();
+
+            // Workers grab a batch so they don't come back to the shared queue for every task
+            if(self) {
+                const usize batch = std::min(_injector.size() / (_workers.size() + 1), max_injector_batch);
+                for(usize i = 0; i != batch; ++i) {
+                    self->queue.push(_injector.front());
+                    _injector.pop_front();
+                }
+            }
+
+            _injector_size = _injector.size();
+        }
+    }
+
+    if(!task && !_workers.is_empty()) {
+        const usize worker_count = _workers.size();
+        const usize start = steal_start_index(worker_count);
+        for(usize i = 0; !task && i != worker_count; ++i) {
+            Worker* victim = _workers[(start + i) % worker_count].get();
+            if(victim != self) {
+                task = victim->queue.steal();
+            }
+        }
+    }
+
+    if(task) {
+        --_ready;
+    }
+
+    return task;
+}
+
+void WorkStealingThreadPool::run_task(Task* task) {
+    y_debug_assert(task->wait_for.is_ready());
+
+    const std::unique_ptr<Task> owned(task);
+    owned->function();
+
+    owned->on_done.solve_dependency();
+    if(!owned->on_done.is_empty() && owned->on_done.is_ready()) {
+        release_waiting_tasks();
+    }
+
+    --_scheduled;
+}
+
+void WorkStealingThreadPool::worker(usize index) {
+    this_thread_pool = this;
+    this_thread_worker_index = index;
+
+    while(_run) {
+        if(process_one()) {
+            continue;
+        }
+
+        const bool has_waiting = _waiting_count != 0;
+        {
+            std::unique_lock lock(_sleep_lock);
+            ++_sleeping;
+            const auto can_run = [this] { return _ready > 0 || !_run; };
+            if(has_waiting) {
+                // Dependencies might be solved by another pool, poll once in a while
+                _condition.wait_for(lock, std::chrono::milliseconds(1), can_run);
+            } else {
+                _condition.wait(lock, can_run);
+            }
+            --_sleeping;
+        }
+
+        if(has_waiting) {
+            release_waiting_tasks();
+        }
+    }
+}
+
+}
+}
+
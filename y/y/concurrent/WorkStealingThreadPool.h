@@ -0,0 +1,115 @@
+/*******************************
+Copyright (c) 2016-2023 Grégoire Angerand
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+**********************************/
+#ifndef Y_CONCURRENT_WORKSTEALINGTHREADPOOL_H
+#define Y_CONCURRENT_WORKSTEALINGTHREADPOOL_H
+
+#include "StaticThreadPool.h"
+#include "WorkStealingQueue.h"
+
+#include <deque>
+
+namespace y {
+namespace concurrent {
+
+// Drop-in replacement for StaticThreadPool:
+// Each worker owns a Chase-Lev deque, tasks scheduled from a worker go into its own deque,
+// tasks scheduled from other threads go into a shared injection queue.
+// Tasks waiting on a DependencyGroup are kept aside and only rescanned when a group gets solved.
+class WorkStealingThreadPool : NonMovable {
+    private:
+        using Func = std::function<void()>;
+
+        static constexpr usize max_injector_batch = 32;
+
+        struct Task : NonCopyable {
+            Task(Func func, DependencyGroup wait, DependencyGroup done = DependencyGroup());
+
+            Func function;
+            DependencyGroup wait_for;
+            DependencyGroup on_done;
+        };
+
+        struct Worker : NonMovable {
+            WorkStealingQueue<Task*> queue;
+            std::thread thread;
+        };
+
+    public:
+        WorkStealingThreadPool(usize thread_count = std::max(4u, std::thread::hardware_concurrency()));
+        ~WorkStealingThreadPool();
+
+        usize concurency() const;
+        bool is_empty() const;
+        usize pending_tasks() const;
+
+        void cancel_pending_tasks();
+
+        void schedule(Func&& func, DependencyGroup* on_done = nullptr, DependencyGroup wait_for = DependencyGroup());
+
+        template<typename F, typename R = decltype(std::declval<F>()())>
+        std::future<R> schedule_with_future(F&& func, DependencyGroup* on_done = nullptr, DependencyGroup wait_for = DependencyGroup()) {
+            auto promise = std::make_shared<std::promise<R>>();
+            auto future = promise->get_future();
+            schedule(std::move([p = std::move(promise), f = y_fwd(func)]() { p->set_value(f()); }), on_done, wait_for);
+            return future;
+        }
+
+        // Runs tasks on the calling thread until the group is ready
+        void process_until_ready(const DependencyGroup& group);
+
+    private:
+        // Empty means all tasks are done, except those waiting on unsolvable dependencies
+        void process_until_empty();
+        bool process_one();
+
+        void push_ready(Task* task);
+        void release_waiting_tasks();
+
+        Task* find_task();
+        void run_task(Task* task);
+
+        void worker(usize index);
+
+        core::Vector<std::unique_ptr<Worker>> _workers;
+
+        std::mutex _injector_lock;
+        std::deque<Task*> _injector;
+        std::atomic<usize> _injector_size = 0;
+
+        std::mutex _waiting_lock;
+        core::Vector<Task*> _waiting;
+        std::atomic<usize> _waiting_count = 0;
+
+        std::mutex _sleep_lock;
+        std::condition_variable _condition;
+        std::atomic<u32> _sleeping = 0;
+
+        std::atomic<isize> _ready = 0;
+        std::atomic<usize> _scheduled = 0;
+        std::atomic<bool> _run = true;
+};
+
+}
+}
+
+#endif // Y_CONCURRENT_WORKSTEALINGTHREADPOOL_H
+
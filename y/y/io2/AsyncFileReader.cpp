@@ -0,0 +1,562 @@
+/*******************************
+Copyright (c) 2016-2023 Grégoire Angerand
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+**********************************/
+#include "AsyncFileReader.h"
+#include "File.h"
+
+#include <y/concurrent/concurrent.h>
+
+#include <algorithm>
+
+#ifdef Y_OS_LINUX
+#include <sys/syscall.h>
+#if defined(__NR_io_uring_setup) && defined(__NR_io_uring_enter) && __has_include(<linux/io_uring.h>)
+#define Y_IO2_IO_URING
+#endif
+#endif
+
+#ifdef Y_IO2_IO_URING
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#endif
+
+namespace y {
+namespace io2 {
+
+struct AsyncFileReader::CompletedRead {
+    std::unique_ptr<Request> request;
+    core::Vector<byte> data;
+    bool failed = false;
+};
+
+void AsyncFileReader::complete_reads(core::Vector<CompletedRead>& completed, std::atomic<usize>& pending) {
+    for(CompletedRead& read : completed) {
+        if(read.failed) {
+            read.request->done(core::Err());
+        } else {
+            read.request->done(core::Ok(std::move(read.data)));
+        }
+        read.request = nullptr;
+        --pending;
+    }
+    completed.make_empty();
+}
+
+static core::Result<core::Vector<byte>> read_blocking(const AsyncFileReader::Request& request) {
+    auto file = File::open(request.file_name());
+    if(!file) {
+        return core::Err();
+    }
+
+    const u64 file_size = file.unwrap().size();
+    const u64 size = request.size() == AsyncFileReader::Request::until_end ? file_size - std::min(request.offset(), file_size) : request.size();
+    if(request.offset() + size > file_size) {
+        return core::Err();
+    }
+
+    core::Vector<byte> data;
+    if(size) {
+        data.set_min_size(usize(size));
+        file.unwrap().seek(usize(request.offset()));
+        if(!file.unwrap().read(data.data(), usize(size))) {
+            return core::Err();
+        }
+    }
+
+    return core::Ok(std::move(data));
+}
+
+
+
+
+#ifdef Y_IO2_IO_URING
+
+// Minimal io_uring wrapper over the raw syscalls: SQEs are pushed under the reader lock,
+// while a single thread waits for and reaps completions.
+class AsyncFileReader::Ring : NonMovable {
+    struct Slot {
+        std::unique_ptr<Request> request;
+        core::Vector<byte> data;
+        u64 offset = 0;
+        u64 read = 0;
+        int fd = -1;
+    };
+
+    static constexpr u64 wake_up_data = u64(-1);
+
+    // IORING_OP_READ takes a 32 bits length
+    static constexpr u64 max_read_size = 1u << 30;
+
+    public:
+        static std::unique_ptr<Ring> create(usize max_in_flight) {
+            auto ring = std::unique_ptr<Ring>(new Ring());
+            if(!ring->init(u32(max_in_flight))) {
+                return nullptr;
+            }
+            return ring;
+        }
+
+        ~Ring() {
+            y_debug_assert(is_idle());
+            if(_sqes) {
+                munmap(_sqes, _sqes_size);
+            }
+            if(_cq_ptr && _cq_ptr != _sq_ptr) {
+                munmap(_cq_ptr, _cq_size);
+            }
+            if(_sq_ptr) {
+                munmap(_sq_ptr, _sq_size);
+            }
+            if(_fd >= 0) {
+                ::close(_fd);
+            }
+        }
+
+        bool has_free_slot() const {
+            return !_free_slots.is_empty();
+        }
+
+        bool is_idle() const {
+            return _free_slots.size() == _slots.size();
+        }
+
+        // Opens the file and queues the first read, requests that can't be started end up in completed
+        void start(std::unique_ptr<Request> request, core::Vector<CompletedRead>& completed) {
+            y_debug_assert(has_free_slot());
+
+            const auto fail = [&] {
+                completed.emplace_back(CompletedRead{std::move(request), {}, true});
+            };
+
+            const int fd = ::open(request->file_name().data(), O_RDONLY | O_CLOEXEC);
+            if(fd < 0) {
+                fail();
+                return;
+            }
+
+            struct stat st = {};
+            if(fstat(fd, &st) != 0) {
+                ::close(fd);
+                fail();
+                return;
+            }
+
+            const u64 file_size = u64(st.st_size);
+            const u64 size = request->size() == Request::until_end ? file_size - std::min(request->offset(), file_size) : request->size();
+            if(request->offset() + size > file_size) {
+                ::close(fd);
+                fail();
+                return;
+            }
+
+            if(!size) {
+                ::close(fd);
+                completed.emplace_back(CompletedRead{std::move(request), {}, false});
+                return;
+            }
+
+            const u32 index = _free_slots.pop();
+            Slot& slot = _slots[index];
+            slot.fd = fd;
+            slot.offset = request->offset();
+            slot.read = 0;
+            slot.data.set_min_size(usize(size));
+            slot.request = std::move(request);
+
+            push_read(index);
+        }
+
+        void wake_up() {
+            io_uring_sqe* sqe = next_sqe();
+            sqe->opcode = IORING_OP_NOP;
+            sqe->user_data = wake_up_data;
+            push_sqe();
+        }
+
+        void submit() {
+            while(_to_submit) {
+                const int submitted = enter(_to_submit, 0, 0);
+                if(submitted < 0) {
+                    if(submitted == -EINTR || submitted == -EAGAIN || submitted == -EBUSY) {
+                        std::this_thread::yield();
+                        continue;
+                    }
+                    y_fatal("io_uring_enter failed");
+                }
+                _to_submit -= u32(submitted);
+            }
+        }
+
+        void wait() {
+            enter(0, 1, IORING_ENTER_GETEVENTS);
+        }
+
+        // Reaps every available completion, resubmitting short reads
+        void reap(core::Vector<CompletedRead>& completed) {
+            u32 head = *_cq_head;
+            const u32 tail = __atomic_load_n(_cq_tail, __ATOMIC_ACQUIRE);
+
+            for(; head != tail; ++head) {
+                const io_uring_cqe& cqe = _cqes[head & *_cq_mask];
+                if(cqe.user_data == wake_up_data) {
+                    continue;
+                }
+
+                const u32 index = u32(cqe.user_data);
+                Slot& slot = _slots[index];
+
+                if(cqe.res > 0) {
+                    slot.read += u64(cqe.res);
+                    if(slot.read < slot.data.size()) {
+                        push_read(index);
+                        continue;
+                    }
+                } else if(cqe.res == -EINTR || cqe.res == -EAGAIN) {
+                    push_read(index);
+                    continue;
+                }
+
+                // A read of 0 bytes means that the file got truncated
+                const bool failed = cqe.res <= 0;
+                completed.emplace_back(CompletedRead{std::move(slot.request), failed ? core::Vector<byte>() : std::move(slot.data), failed});
+
+                ::close(slot.fd);
+                slot.fd = -1;
+                slot.data = core::Vector<byte>();
+                _free_slots.push_back(index);
+            }
+
+            __atomic_store_n(_cq_head, head, __ATOMIC_RELEASE);
+        }
+
+    private:
+        Ring() = default;
+
+        bool init(u32 max_in_flight) {
+            // One extra entry for wake ups
+            io_uring_params params = {};
+            _fd = int(syscall(__NR_io_uring_setup, max_in_flight + 1, &params));
+            if(_fd < 0) {
+                return false;
+            }
+
+            _sq_size = params.sq_off.array + params.sq_entries * sizeof(u32);
+            _cq_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+
+            const bool single_mmap = params.features & IORING_FEAT_SINGLE_MMAP;
+            if(single_mmap) {
+                _sq_size = _cq_size = std::max(_sq_size, _cq_size);
+            }
+
+            _sq_ptr = mmap(nullptr, _sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _fd, IORING_OFF_SQ_RING);
+            if(_sq_ptr == MAP_FAILED) {
+                _sq_ptr = nullptr;
+                return false;
+            }
+
+            if(single_mmap) {
+                _cq_ptr = _sq_ptr;
+            } else {
+                _cq_ptr = mmap(nullptr, _cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _fd, IORING_OFF_CQ_RING);
+                if(_cq_ptr == MAP_FAILED) {
+                    _cq_ptr = nullptr;
+                    return false;
+                }
+            }
+
+            _sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+            void* sqes = mmap(nullptr, _sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _fd, IORING_OFF_SQES);
+            if(sqes == MAP_FAILED) {
+                return false;
+            }
+            _sqes = static_cast<io_uring_sqe*>(sqes);
+
+            byte* sq = static_cast<byte*>(_sq_ptr);
+            _sq_tail = reinterpret_cast<u32*>(sq + params.sq_off.tail);
+            _sq_mask = reinterpret_cast<u32*>(sq + params.sq_off.ring_mask);
+            _sq_array = reinterpret_cast<u32*>(sq + params.sq_off.array);
+
+            byte* cq = static_cast<byte*>(_cq_ptr);
+            _cq_head = reinterpret_cast<u32*>(cq + params.cq_off.head);
+            _cq_tail = reinterpret_cast<u32*>(cq + params.cq_off.tail);
+            _cq_mask = reinterpret_cast<u32*>(cq + params.cq_off.ring_mask);
+            _cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+
+            _slots.set_min_size(max_in_flight);
+            for(u32 i = 0; i != max_in_flight; ++i) {
+                _free_slots.push_back(max_in_flight - i - 1);
+            }
+
+            return true;
+        }
+
+        int enter(u32 to_submit, u32 min_complete, u32 flags) {
+            const int res = int(syscall(__NR_io_uring_enter, _fd, to_submit, min_complete, flags, nullptr, 0));
+            return res < 0 ? -errno : res;
+        }
+
+        io_uring_sqe* next_sqe() {
+            // The kernel consumes SQEs on submission, and we never have more in flight than the ring can hold
+            io_uring_sqe* sqe = &_sqes[*_sq_tail & *_sq_mask];
+            std::memset(sqe, 0, sizeof(io_uring_sqe));
+            return sqe;
+        }
+
+        void push_sqe() {
+            const u32 tail = *_sq_tail;
+            _sq_array[tail & *_sq_mask] = tail & *_sq_mask;
+            __atomic_store_n(_sq_tail, tail + 1, __ATOMIC_RELEASE);
+            ++_to_submit;
+        }
+
+        void push_read(u32 index) {
+            Slot& slot = _slots[index];
+            y_debug_assert(slot.read < slot.data.size());
+
+            io_uring_sqe* sqe = next_sqe();
+            sqe->opcode = IORING_OP_READ;
+            sqe->fd = slot.fd;
+            sqe->addr = u64(reinterpret_cast<uintptr_t>(slot.data.data() + slot.read));
+            sqe->len = u32(std::min(max_read_size, u64(slot.data.size()) - slot.read));
+            sqe->off = slot.offset + slot.read;
+            sqe->user_data = index;
+            push_sqe();
+        }
+
+        int _fd = -1;
+
+        void* _sq_ptr = nullptr;
+        void* _cq_ptr = nullptr;
+        usize _sq_size = 0;
+        usize _cq_size = 0;
+
+        io_uring_sqe* _sqes = nullptr;
+        usize _sqes_size = 0;
+
+        u32* _sq_tail = nullptr;
+        u32* _sq_mask = nullptr;
+        u32* _sq_array = nullptr;
+
+        u32* _cq_head = nullptr;
+        u32* _cq_tail = nullptr;
+        u32* _cq_mask = nullptr;
+        io_uring_cqe* _cqes = nullptr;
+
+        u32 _to_submit = 0;
+
+        core::Vector<Slot> _slots;
+        core::Vector<u32> _free_slots;
+};
+
+#else
+
+class AsyncFileReader::Ring : NonMovable {
+    public:
+        static std::unique_ptr<Ring> create(usize) {
+            return nullptr;
+        }
+
+        bool has_free_slot() const { return false; }
+        bool is_idle() const { return true; }
+        void start(std::unique_ptr<Request>, core::Vector<CompletedRead>&) {}
+        void wake_up() {}
+        void submit() {}
+        void wait() {}
+        void reap(core::Vector<CompletedRead>&) {}
+};
+
+#endif
+
+
+
+
+AsyncFileReader::Request::Request(core::String file_name, u64 offset, u64 size) : _file_name(std::move(file_name)), _offset(offset), _size(size) {
+}
+
+AsyncFileReader::Request::~Request() {
+}
+
+const core::String& AsyncFileReader::Request::file_name() const {
+    return _file_name;
+}
+
+u64 AsyncFileReader::Request::offset() const {
+    return _offset;
+}
+
+u64 AsyncFileReader::Request::size() const {
+    return _size;
+}
+
+
+
+AsyncFileReader::AsyncFileReader(usize max_in_flight, bool allow_io_uring) {
+    max_in_flight = std::max(max_in_flight, usize(1));
+
+    if(allow_io_uring) {
+        _ring = Ring::create(max_in_flight);
+    }
+
+    if(_ring) {
+        _threads.emplace_back([this] {
+            concurrent::set_thread_name("Async IO thread");
+            ring_worker();
+        });
+    } else {
+        // Blocking reads can't keep many requests in flight, a few threads is enough to hide most of the latency
+        const usize thread_count = std::clamp(max_in_flight / 16, usize(1), usize(4));
+        for(usize i = 0; i != thread_count; ++i) {
+            _threads.emplace_back([this] {
+                concurrent::set_thread_name("Async IO thread");
+                thread_worker();
+            });
+        }
+    }
+}
+
+AsyncFileReader::~AsyncFileReader() {
+    {
+        const std::unique_lock lock(_lock);
+        _run = false;
+        if(_ring) {
+            _ring->wake_up();
+            _ring->submit();
+        }
+    }
+
+    _condition.notify_all();
+
+    for(auto& thread : _threads) {
+        thread.join();
+    }
+
+    y_debug_assert(!_pending);
+}
+
+void AsyncFileReader::submit(std::unique_ptr<Request> request) {
+    core::Vector<std::unique_ptr<Request>> requests;
+    requests.emplace_back(std::move(request));
+    submit(std::move(requests));
+}
+
+void AsyncFileReader::submit(core::Vector<std::unique_ptr<Request>> requests) {
+    if(requests.is_empty()) {
+        return;
+    }
+
+    _pending += requests.size();
+
+    core::Vector<CompletedRead> completed;
+
+    {
+        const std::unique_lock lock(_lock);
+        for(auto& request : requests) {
+            _queued.emplace_back(std::move(request));
+        }
+        if(_ring) {
+            submit_queued(completed);
+        }
+    }
+
+    if(!_ring) {
+        if(requests.size() == 1) {
+            _condition.notify_one();
+        } else {
+            _condition.notify_all();
+        }
+    }
+
+    complete_reads(completed, _pending);
+}
+
+usize AsyncFileReader::pending() const {
+    return _pending;
+}
+
+bool AsyncFileReader::is_using_io_uring() const {
+    return _ring != nullptr;
+}
+
+void AsyncFileReader::submit_queued(core::Vector<CompletedRead>& completed) {
+    y_debug_assert(_ring);
+
+    while(!_queued.empty() && _ring->has_free_slot()) {
+        std::unique_ptr<Request> request = std::move(_queued.front());
+        _queued.pop_front();
+        _ring->start(std::move(request), completed);
+    }
+    _ring->submit();
+}
+
+void AsyncFileReader::ring_worker() {
+    core::Vector<CompletedRead> completed;
+    for(;;) {
+        _ring->wait();
+
+        bool stop = false;
+
+        {
+            const std::unique_lock lock(_lock);
+            _ring->reap(completed);
+            submit_queued(completed);
+            stop = !_run && _queued.empty() && _ring->is_idle();
+        }
+
+        complete_reads(completed, _pending);
+
+        if(stop) {
+            break;
+        }
+    }
+}
+
+void AsyncFileReader::thread_worker() {
+    core::Vector<CompletedRead> completed;
+    for(;;) {
+        {
+            std::unique_lock lock(_lock);
+            _condition.wait(lock, [this] { return !_queued.empty() || !_run; });
+            if(_queued.empty()) {
+                break;
+            }
+            completed.emplace_back(CompletedRead{std::move(_queued.front()), {}, false});
+            _queued.pop_front();
+        }
+
+        CompletedRead& read = completed.last();
+        if(auto data = read_blocking(*read.request)) {
+            read.data = std::move(data.unwrap());
+        } else {
+            read.failed = true;
+        }
+
+        complete_reads(completed, _pending);
+    }
+}
+
+}
+}
+
@@ -0,0 +1,106 @@
+/*******************************
+Copyright (c) 2016-2023 Grégoire Angerand
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+**********************************/
+#ifndef Y_IO2_ASYNCFILEREADER_H
+#define Y_IO2_ASYNCFILEREADER_H
+
+#include "io.h"
+
+#include <y/core/String.h>
+#include <y/core/Vector.h>
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <atomic>
+
+namespace y {
+namespace io2 {
+
+// Reads files in the background, with many reads in flight at once.
+// On Linux reads are batched through io_uring, everywhere else (or if io_uring is not available)
+// a few threads do blocking reads instead.
+class AsyncFileReader : NonMovable {
+    public:
+        class Request : NonMovable {
+            public:
+                static constexpr u64 until_end = u64(-1);
+
+                Request(core::String file_name, u64 offset = 0, u64 size = until_end);
+                virtual ~Request();
+
+                // Called on an IO thread as soon as the data is available, should not block
+                virtual void done(core::Result<core::Vector<byte>> data) = 0;
+
+                const core::String& file_name() const;
+                u64 offset() const;
+                u64 size() const;
+
+            private:
+                core::String _file_name;
+                u64 _offset = 0;
+                u64 _size = 0;
+        };
+
+        AsyncFileReader(usize max_in_flight = 64, bool allow_io_uring = true);
+
+        // Waits for all submitted requests to be done
+        ~AsyncFileReader();
+
+        // Never blocks, requests beyond max_in_flight are queued
+        void submit(std::unique_ptr<Request> request);
+
+        // Submits all the reads at once: with io_uring this is a single syscall, and completions tend to land together
+        void submit(core::Vector<std::unique_ptr<Request>> requests);
+
+        // Submitted requests that are not done yet
+        usize pending() const;
+
+        bool is_using_io_uring() const;
+
+    private:
+        class Ring;
+        struct CompletedRead;
+
+        static void complete_reads(core::Vector<CompletedRead>& completed, std::atomic<usize>& pending);
+
+        void submit_queued(core::Vector<CompletedRead>& completed);
+        void ring_worker();
+        void thread_worker();
+
+        std::unique_ptr<Ring> _ring;
+
+        std::deque<std::unique_ptr<Request>> _queued;
+        std::atomic<usize> _pending = 0;
+        bool _run = true;
+
+        mutable std::mutex _lock;
+        std::condition_variable _condition;
+
+        core::Vector<std::thread> _threads;
+};
+
+}
+}
+
+#endif // Y_IO2_ASYNCFILEREADER_H
+
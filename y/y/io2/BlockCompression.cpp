@@ -0,0 +1,553 @@
+/*******************************
+Copyright (c) 2016-2023 Grégoire Angerand
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+**********************************/
+#include "BlockCompression.h"
+
+#include <thread>
+#include <cstring>
+
+namespace y {
+namespace io2 {
+
+namespace lz {
+
+static constexpr usize min_match = 4;
+static constexpr usize max_offset = 0xFFFF;
+static constexpr usize hash_log = 14;
+
+// Matches are not searched in the last bytes, so the input always ends with literals
+static constexpr usize last_literals = 5;
+
+static u32 read_u32(const byte* ptr) {
+    u32 value = 0;
+    std::memcpy(&value, ptr, sizeof(value));
+    return value;
+}
+
+static usize hash(u32 value) {
+    return usize((value * 2654435761u) >> (32 - hash_log));
+}
+
+static byte* write_length(byte* dst, const byte* dst_end, usize length) {
+    while(length >= 0xFF) {
+        if(dst == dst_end) {
+            return nullptr;
+        }
+        *dst++ = byte(0xFF);
+        length -= 0xFF;
+    }
+    if(dst == dst_end) {
+        return nullptr;
+    }
+    *dst++ = byte(length);
+    return dst;
+}
+
+static bool read_length(const byte*& src, const byte* src_end, usize& length) {
+    for(;;) {
+        if(src == src_end) {
+            return false;
+        }
+        const usize b = usize(*src++);
+        length += b;
+        if(b != 0xFF) {
+            return true;
+        }
+    }
+}
+
+// Writes literals then a match, or only the literals if match_length is 0
+static byte* write_sequence(byte* dst, const byte* dst_end, const byte* literals, usize literal_count, usize offset, usize match_length) {
+    if(dst == dst_end) {
+        return nullptr;
+    }
+
+    byte* token = dst++;
+    const usize match_token = match_length ? match_length - min_match : 0;
+    *token = byte((std::min<usize>(literal_count, 15) << 4) | std::min<usize>(match_token, 15));
+
+    if(literal_count >= 15) {
+        if(!(dst = write_length(dst, dst_end, literal_count - 15))) {
+            return nullptr;
+        }
+    }
+
+    if(usize(dst_end - dst) < literal_count) {
+        return nullptr;
+    }
+    std::memcpy(dst, literals, literal_count);
+    dst += literal_count;
+
+    if(!match_length) {
+        return dst;
+    }
+
+    if(dst_end - dst < 2) {
+        return nullptr;
+    }
+    *dst++ = byte(offset & 0xFF);
+    *dst++ = byte(offset >> 8);
+
+    if(match_token >= 15) {
+        if(!(dst = write_length(dst, dst_end, match_token - 15))) {
+            return nullptr;
+        }
+    }
+
+    return dst;
+}
+
+usize max_compressed_size(usize size) {
+    return size + size / 255 + 16;
+}
+
+// A sequence outputs at most 255 bytes per byte it uses: the best case is a match whose length is extended by 0xFF bytes
+usize max_decompressed_size(usize size) {
+    return size * 255;
+}
+
+usize compress(const byte* src, usize size, byte* dst, usize dst_capacity) {
+    byte* out = dst;
+    const byte* out_end = dst + dst_capacity;
+
+    const byte* anchor = src;
+    const byte* end = src + size;
+
+    if(size > last_literals + min_match) {
+        const byte* match_limit = end - last_literals;
+
+        // Positions are relative to src, a stale or empty entry is caught by comparing the bytes
+        core::FixedArray<u32> table(usize(1) << hash_log);
+        std::fill(table.begin(), table.end(), 0);
+
+        const byte* ip = src + 1;
+        while(ip + min_match <= match_limit) {
+            const u32 sequence = read_u32(ip);
+            const usize h = hash(sequence);
+            const byte* candidate = src + table[h];
+            table[h] = u32(ip - src);
+
+            if(usize(ip - candidate) > max_offset || read_u32(candidate) != sequence) {
+                // Skip faster through data that does not compress
+                ip += 1 + (usize(ip - anchor) >> 6);
+                continue;
+            }
+
+            usize length = min_match;
+            while(ip + length < match_limit && ip[length] == candidate[length]) {
+                ++length;
+            }
+
+            if(!(out = write_sequence(out, out_end, anchor, usize(ip - anchor), usize(ip - candidate), length))) {
+                return 0;
+            }
+
+            ip += length;
+            anchor = ip;
+        }
+    }
+
+    if(!(out = write_sequence(out, out_end, anchor, usize(end - anchor), 0, 0))) {
+        return 0;
+    }
+
+    return usize(out - dst);
+}
+
+bool decompress(const byte* src, usize src_size, byte* dst, usize dst_size) {
+    const byte* ip = src;
+    const byte* src_end = src + src_size;
+    byte* op = dst;
+    const byte* dst_end = dst + dst_size;
+
+    for(;;) {
+        if(ip == src_end) {
+            return false;
+        }
+
+        const usize token = usize(*ip++);
+
+        usize literal_count = token >> 4;
+        if(literal_count == 15 && !read_length(ip, src_end, literal_count)) {
+            return false;
+        }
+
+        if(usize(src_end - ip) < literal_count || usize(dst_end - op) < literal_count) {
+            return false;
+        }
+        std::memcpy(op, ip, literal_count);
+        ip += literal_count;
+        op += literal_count;
+
+        // The last sequence only has literals
+        if(ip == src_end) {
+            return op == dst_end;
+        }
+
+        if(src_end - ip < 2) {
+            return false;
+        }
+        const usize offset = usize(ip[0]) | (usize(ip[1]) << 8);
+        ip += 2;
+
+        usize match_length = token & 0x0F;
+        if(match_length == 15 && !read_length(ip, src_end, match_length)) {
+            return false;
+        }
+        match_length += min_match;
+
+        if(!offset || offset > usize(op - dst) || usize(dst_end - op) < match_length) {
+            return false;
+        }
+
+        const byte* match = op - offset;
+        if(offset >= match_length) {
+            std::memcpy(op, match, match_length);
+            op += match_length;
+        } else {
+            // Overlapping match, repeats the last offset bytes
+            for(usize i = 0; i != match_length; ++i) {
+                *op++ = *match++;
+            }
+        }
+    }
+}
+
+}
+
+
+
+CompressedWriter::CompressedWriter(Writer& compressed, usize block_size) : _compressed(compressed), _block_size(block_size) {
+    y_always_assert(_block_size && _block_size <= max_block_size, "Invalid compression block size");
+}
+
+CompressedWriter::~CompressedWriter() {
+    y_debug_assert(_flushed || !_buffer.size());
+}
+
+void CompressedWriter::seek(usize byte) {
+    _buffer.seek(byte);
+}
+
+usize CompressedWriter::tell() const {
+    return _buffer.tell();
+}
+
+WriteResult CompressedWriter::write(const void* data, usize bytes) {
+    if(_flushed) {
+        return core::Err<usize>(0);
+    }
+    return _buffer.write(data, bytes);
+}
+
+FlushResult CompressedWriter::flush() {
+    if(_flushed) {
+        return core::Ok();
+    }
+
+    _flushed = true;
+
+    const usize size = _buffer.size();
+    const usize block_count = (size + _block_size - 1) / _block_size;
+
+    BlockCompressionHeader header;
+    header.block_size = u32(_block_size);
+    header.block_count = u32(block_count);
+    header.uncompressed_size = size;
+
+    core::FixedArray<u32> block_sizes(block_count);
+    core::Vector<byte> compressed = core::vector_with_capacity<byte>(size / 2);
+    core::FixedArray<byte> scratch(lz::max_compressed_size(_block_size));
+
+    for(usize i = 0; i != block_count; ++i) {
+        const byte* block = _buffer.data() + i * _block_size;
+        const usize block_size = std::min(_block_size, size - i * _block_size);
+
+        // Only keep the compressed block if it is actually smaller
+        const usize compressed_size = lz::compress(block, block_size, scratch.data(), block_size - 1);
+        if(compressed_size) {
+            compressed.push_back(scratch.data(), scratch.data() + compressed_size);
+            block_sizes[i] = u32(compressed_size);
+        } else {
+            compressed.push_back(block, block + block_size);
+            block_sizes[i] = u32(block_size) | BlockCompressionHeader::uncompressed_block_bit;
+        }
+    }
+
+    if(!_compressed.write_one(header) || !_compressed.write_array(block_sizes.data(), block_count) || !_compressed.write(compressed.data(), compressed.size())) {
+        return core::Err();
+    }
+
+    _compressed_size = sizeof(header) + sizeof(u32) * block_count + compressed.size();
+
+    return _compressed.flush();
+}
+
+bool CompressedWriter::is_flushed() const {
+    return _flushed;
+}
+
+usize CompressedWriter::compressed_size() const {
+    return _compressed_size;
+}
+
+
+
+CompressedReader::~CompressedReader() {
+}
+
+bool CompressedReader::is_compressed(Reader& reader) {
+    const usize pos = reader.tell();
+    u32 magic = 0;
+    const bool compressed = reader.read_one(magic) && magic == BlockCompressionHeader::magic;
+    reader.seek(pos);
+    return compressed;
+}
+
+core::Result<std::unique_ptr<CompressedReader>> CompressedReader::open(ReaderPtr compressed) {
+    BlockCompressionHeader header;
+    if(!compressed->read_one(header) || header.header_magic != BlockCompressionHeader::magic || header.header_version != BlockCompressionHeader::version) {
+        return core::Err();
+    }
+
+    // Empty data is the only data that can have a block size of 0
+    if(!header.block_size && header.uncompressed_size) {
+        return core::Err();
+    }
+
+    const u64 max_blocks = header.block_size ? (header.uncompressed_size + header.block_size - 1) / header.block_size : 0;
+    if(header.block_size > CompressedWriter::max_block_size || header.block_count != max_blocks) {
+        return core::Err();
+    }
+
+    y_debug_assert(header.uncompressed_size <= u64(header.block_count) * header.block_size);
+
+    // Checked before anything is allocated, so a corrupt header can't request more than the stream could hold
+    if(compressed->remaining() / sizeof(u32) < header.block_count) {
+        return core::Err();
+    }
+
+    std::unique_ptr<CompressedReader> reader(new CompressedReader());
+    reader->_block_size = header.block_size;
+    reader->_block_count = header.block_count;
+    reader->_block_sizes = core::FixedArray<u32>(header.block_count);
+    reader->_block_offsets = core::FixedArray<u64>(header.block_count + 1);
+
+    if(header.block_count && !compressed->read_array(reader->_block_sizes.data(), header.block_count)) {
+        return core::Err();
+    }
+
+    u64 offset = 0;
+    for(usize i = 0; i != header.block_count; ++i) {
+        const u32 block_size = reader->_block_sizes[i];
+        const u64 stored_size = block_size & ~BlockCompressionHeader::uncompressed_block_bit;
+        const u64 uncompressed_size = std::min<u64>(header.block_size, header.uncompressed_size - u64(i) * header.block_size);
+
+        // Blocks must be able to hold their part of the data
+        if(block_size & BlockCompressionHeader::uncompressed_block_bit ? stored_size != uncompressed_size : uncompressed_size > lz::max_decompressed_size(usize(stored_size))) {
+            return core::Err();
+        }
+
+        reader->_block_offsets[i] = offset;
+        offset += stored_size;
+    }
+    reader->_block_offsets[header.block_count] = offset;
+
+    if(compressed->remaining() < offset) {
+        return core::Err();
+    }
+
+    if(const byte* in_place = compressed->read_in_place(usize(offset))) {
+        reader->_compressed = in_place;
+    } else if(offset) {
+        reader->_compressed_storage = core::FixedArray<byte>(usize(offset));
+        if(!compressed->read(reader->_compressed_storage.data(), usize(offset))) {
+            return core::Err();
+        }
+        reader->_compressed = reader->_compressed_storage.data();
+    }
+
+    reader->_data = core::FixedArray<byte>(usize(header.uncompressed_size));
+    reader->_block_states = std::make_unique<std::atomic<u8>[]>(header.block_count);
+    for(usize i = 0; i != header.block_count; ++i) {
+        reader->_block_states[i] = Pending;
+    }
+
+    reader->_reader = std::move(compressed);
+    return core::Ok(std::move(reader));
+}
+
+core::Result<ReaderPtr> CompressedReader::open_if_compressed(ReaderPtr compressed) {
+    if(!is_compressed(*compressed)) {
+        return core::Ok(std::move(compressed));
+    }
+
+    auto reader = open(std::move(compressed));
+    if(!reader) {
+        return core::Err();
+    }
+
+    ReaderPtr ptr = std::move(reader.unwrap());
+    return core::Ok(std::move(ptr));
+}
+
+bool CompressedReader::at_end() const {
+    return _cursor == _data.size();
+}
+
+usize CompressedReader::remaining() const {
+    return _data.size() - _cursor;
+}
+
+void CompressedReader::seek(usize byte) {
+    _cursor = std::min(_data.size(), byte);
+}
+
+usize CompressedReader::tell() const {
+    return _cursor;
+}
+
+ReadResult CompressedReader::read(void* data, usize bytes) {
+    if(remaining() < bytes || !ensure_decompressed(_cursor, _cursor + bytes)) {
+        return core::Err<usize>(0);
+    }
+    std::memcpy(data, _data.data() + _cursor, bytes);
+    _cursor += bytes;
+    return core::Ok();
+}
+
+ReadUpToResult CompressedReader::read_up_to(void* data, usize max_bytes) {
+    const usize max = std::min(max_bytes, remaining());
+    if(!ensure_decompressed(_cursor, _cursor + max)) {
+        return core::Err<usize>(0);
+    }
+    std::memcpy(data, _data.data() + _cursor, max);
+    _cursor += max;
+    return core::Ok(max);
+}
+
+ReadUpToResult CompressedReader::read_all(core::Vector<byte>& data) {
+    const usize size = remaining();
+    if(!ensure_decompressed(_cursor, _data.size())) {
+        return core::Err<usize>(0);
+    }
+    data.push_back(_data.data() + _cursor, _data.data() + _data.size());
+    _cursor += size;
+    return core::Ok(size);
+}
+
+const byte* CompressedReader::read_in_place(usize bytes) {
+    if(remaining() < bytes || !ensure_decompressed(_cursor, _cursor + bytes)) {
+        return nullptr;
+    }
+    const byte* ptr = _data.data() + _cursor;
+    _cursor += bytes;
+    return ptr;
+}
+
+usize CompressedReader::size() const {
+    return _data.size();
+}
+
+usize CompressedReader::block_count() const {
+    return _block_count;
+}
+
+bool CompressedReader::has_pending_blocks() const {
+    return _next_block < _block_count;
+}
+
+void CompressedReader::decompress_blocks() {
+    for(;;) {
+        const usize index = _next_block++;
+        if(index >= _block_count) {
+            // Keep _next_block from growing without bound
+            _next_block = _block_count;
+            break;
+        }
+        decompress_block(index);
+    }
+}
+
+bool CompressedReader::decompress_all() {
+    decompress_blocks();
+    return ensure_decompressed(0, _data.size());
+}
+
+bool CompressedReader::decompress_block(usize index) {
+    u8 expected = Pending;
+    if(!_block_states[index].compare_exchange_strong(expected, Decompressing)) {
+        return false;
+    }
+
+    const u32 block_size = _block_sizes[index];
+    const byte* src = _compressed + _block_offsets[index];
+    const usize src_size = usize(_block_offsets[index + 1] - _block_offsets[index]);
+
+    byte* dst = _data.data() + index * _block_size;
+    const usize dst_size = std::min(_block_size, _data.size() - index * _block_size);
+
+    bool ok = false;
+    if(block_size & BlockCompressionHeader::uncompressed_block_bit) {
+        ok = src_size == dst_size;
+        if(ok) {
+            std::memcpy(dst, src, dst_size);
+        }
+    } else {
+        ok = lz::decompress(src, src_size, dst, dst_size);
+    }
+
+    _block_states[index] = ok ? Done : Failed;
+    return true;
+}
+
+bool CompressedReader::wait_for_block(usize index) {
+    for(;;) {
+        decompress_block(index);
+        switch(_block_states[index].load()) {
+            case Done:
+                return true;
+            case Failed:
+                return false;
+            default:
+                // Being decompressed by another thread
+                std::this_thread::yield();
+        }
+    }
+}
+
+bool CompressedReader::ensure_decompressed(usize begin, usize end) {
+    if(begin == end) {
+        return true;
+    }
+
+    const usize last = (end - 1) / _block_size;
+    for(usize i = begin / _block_size; i <= last; ++i) {
+        if(!wait_for_block(i)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+}
+}
+
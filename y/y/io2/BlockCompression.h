@@ -0,0 +1,177 @@
+/*******************************
+Copyright (c) 2016-2023 Grégoire Angerand
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+**********************************/
+#ifndef Y_IO2_BLOCKCOMPRESSION_H
+#define Y_IO2_BLOCKCOMPRESSION_H
+
+#include "Buffer.h"
+
+#include <y/core/FixedArray.h>
+
+#include <atomic>
+
+namespace y {
+namespace io2 {
+
+// Fast LZ77 codec (LZ4 like sequences of literals and 16 bit offset matches), working on single blocks.
+namespace lz {
+usize max_compressed_size(usize size);
+
+// Returns the compressed size, or 0 if the data does not fit in dst_capacity
+usize compress(const byte* src, usize size, byte* dst, usize dst_capacity);
+
+// Returns false if src is corrupt or does not decompress to exactly dst_size bytes
+bool decompress(const byte* src, usize src_size, byte* dst, usize dst_size);
+
+// Upper bound of the size of any data that compresses to size bytes
+usize max_decompressed_size(usize size);
+}
+
+
+// Data is split in independently compressed blocks, listed in a table after the header.
+// Blocks that do not compress are stored as is.
+struct BlockCompressionHeader {
+    static constexpr u32 magic = 0x425A4C59; // "YLZB"
+    static constexpr u32 version = 1;
+
+    // Blocks are stored with their size, the high bit is set for blocks that are not compressed
+    static constexpr u32 uncompressed_block_bit = 0x80000000;
+
+    u32 header_magic = magic;
+    u32 header_version = version;
+    u32 block_size = 0;
+    u32 block_count = 0;
+    u64 uncompressed_size = 0;
+};
+
+static_assert(sizeof(BlockCompressionHeader) == 24);
+
+
+// Everything is buffered and only compressed on flush, so the data can be patched (which serde3 archives do).
+// Nothing can be written after flush.
+class CompressedWriter final : public Writer {
+    public:
+        // Matches are limited to 16 bit offsets, so bigger blocks would not compress any better
+        static constexpr usize default_block_size = 64 * 1024;
+        static constexpr usize max_block_size = 64 * 1024;
+
+        CompressedWriter(Writer& compressed, usize block_size = default_block_size);
+        ~CompressedWriter() override;
+
+        void seek(usize byte) override;
+        usize tell() const override;
+
+        WriteResult write(const void* data, usize bytes) override;
+
+        // Compresses and writes everything to the underlying writer
+        FlushResult flush() override;
+
+        bool is_flushed() const;
+
+        // Size of the compressed data, valid after flush
+        usize compressed_size() const;
+
+    private:
+        Writer& _compressed;
+        Buffer _buffer;
+        usize _block_size = 0;
+        usize _compressed_size = 0;
+        bool _flushed = false;
+};
+
+
+// Blocks are decompressed on first access, into a buffer that holds the whole uncompressed data.
+// decompress_blocks can be called by several threads at once to decompress big data in parallel.
+class CompressedReader final : public Reader {
+    public:
+        ~CompressedReader() override;
+
+        // Checks the header at the current position, without moving
+        static bool is_compressed(Reader& reader);
+
+        // Reads from the current position of compressed, which must stay alive if the compressed data is read in place
+        static core::Result<std::unique_ptr<CompressedReader>> open(ReaderPtr compressed);
+
+        // Returns compressed unchanged if it does not start with a compression header
+        static core::Result<ReaderPtr> open_if_compressed(ReaderPtr compressed);
+
+        bool at_end() const override;
+        usize remaining() const override;
+
+        void seek(usize byte) override;
+        usize tell() const override;
+
+        ReadResult read(void* data, usize bytes) override;
+        ReadUpToResult read_up_to(void* data, usize max_bytes) override;
+        ReadUpToResult read_all(core::Vector<byte>& data) override;
+
+        const byte* read_in_place(usize bytes) override;
+
+        usize size() const;
+        usize block_count() const;
+
+        // Returns true if some blocks have not been claimed by a thread yet
+        bool has_pending_blocks() const;
+
+        // Decompresses blocks until every block has been claimed. Thread safe.
+        void decompress_blocks();
+
+        // Decompresses every block, waiting for the ones being decompressed by other threads
+        bool decompress_all();
+
+    private:
+        enum BlockState : u8 {
+            Pending,
+            Decompressing,
+            Done,
+            Failed
+        };
+
+        CompressedReader() = default;
+
+        bool decompress_block(usize index);
+        bool wait_for_block(usize index);
+        bool ensure_decompressed(usize begin, usize end);
+
+        ReaderPtr _reader;
+
+        // Either read in place from _reader or owned by _compressed_storage
+        const byte* _compressed = nullptr;
+        core::FixedArray<byte> _compressed_storage;
+
+        core::FixedArray<u64> _block_offsets;
+        core::FixedArray<u32> _block_sizes;
+        std::unique_ptr<std::atomic<u8>[]> _block_states;
+
+        // Blocks before this have all been claimed
+        std::atomic<usize> _next_block = 0;
+
+        core::FixedArray<byte> _data;
+        usize _block_size = 0;
+        usize _block_count = 0;
+        usize _cursor = 0;
+};
+
+}
+}
+
+#endif // Y_IO2_BLOCKCOMPRESSION_H
+
@@ -29,6 +29,9 @@ Buffer::Buffer(usize size) {
     _buffer.set_min_capacity(size);
 }
 
+Buffer::Buffer(core::Vector<byte> data) : _buffer(std::move(data)) {
+}
+
 Buffer::~Buffer() {
 }
 
@@ -92,6 +95,15 @@ ReadUpToResult Buffer::read_all(core::Vector<byte>& data) {
     return core::Ok(r);
 }
 
+const byte* Buffer::read_in_place(usize bytes) {
+    if(remaining() < bytes) {
+        return nullptr;
+    }
+    const byte* ptr = _buffer.data() + _cursor;
+    _cursor += bytes;
+    return ptr;
+}
+
 WriteResult Buffer::write(const void* data, usize bytes) {
     const byte* data_bytes = static_cast<const byte*>(data);
     if(at_end()) {
@@ -86,6 +86,16 @@ core::Result<File> File::open(const core::String &name) {
   return core::Err();
 }
 
+core::Result<File> File::open_append(const core::String &name) {
+  std::FILE *file = std::fopen(name.begin(), "ab");
+  if (file) {
+    File f(file);
+    f.seek_end();
+    return core::Ok(std::move(f));
+  }
+  return core::Err();
+}
+
 bool File::is_file_exists(const core::String &path) {
   struct stat buffer;
   return (stat(path.begin(), &buffer) == 0);
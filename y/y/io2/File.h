@@ -42,6 +42,7 @@ public:
 
   static core::Result<File> create(const core::String &name);
   static core::Result<File> open(const core::String &name);
+  static core::Result<File> open_append(const core::String &name);
   static bool is_file_exists(const core::String &path);
   static core::Result<core::String> read_text_file(const core::String &name);
 
@@ -0,0 +1,209 @@
+/*******************************
+Copyright (c) 2016-2023 Grégoire Angerand
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+**********************************/
+#include "MappedFile.h"
+
+#ifdef Y_OS_WIN
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include <cstring>
+
+namespace y {
+namespace io2 {
+
+MappedFile::~MappedFile() {
+#ifdef Y_OS_WIN
+    if(_data) {
+        UnmapViewOfFile(_data);
+    }
+    if(_mapping) {
+        CloseHandle(_mapping);
+    }
+    if(_file) {
+        CloseHandle(_file);
+    }
+#else
+    if(_data) {
+        munmap(const_cast<byte*>(_data), _size);
+    }
+#endif
+}
+
+MappedFile::MappedFile(MappedFile&& other) {
+    swap(other);
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) {
+    swap(other);
+    return *this;
+}
+
+void MappedFile::swap(MappedFile& other) {
+    std::swap(_data, other._data);
+    std::swap(_size, other._size);
+    std::swap(_cursor, other._cursor);
+    std::swap(_is_open, other._is_open);
+#ifdef Y_OS_WIN
+    std::swap(_file, other._file);
+    std::swap(_mapping, other._mapping);
+#endif
+}
+
+core::Result<MappedFile> MappedFile::open(const core::String& name) {
+    MappedFile file;
+
+#ifdef Y_OS_WIN
+    file._file = CreateFileA(name.data(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if(file._file == INVALID_HANDLE_VALUE) {
+        file._file = nullptr;
+        return core::Err();
+    }
+
+    LARGE_INTEGER size = {};
+    if(!GetFileSizeEx(file._file, &size)) {
+        return core::Err();
+    }
+
+    file._size = usize(size.QuadPart);
+    if(file._size) {
+        file._mapping = CreateFileMappingA(file._file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if(!file._mapping) {
+            return core::Err();
+        }
+
+        file._data = static_cast<const byte*>(MapViewOfFile(file._mapping, FILE_MAP_READ, 0, 0, 0));
+        if(!file._data) {
+            return core::Err();
+        }
+    }
+#else
+    const int fd = ::open(name.data(), O_RDONLY);
+    if(fd < 0) {
+        return core::Err();
+    }
+    y_defer(::close(fd));
+
+    struct stat st = {};
+    if(fstat(fd, &st) != 0) {
+        return core::Err();
+    }
+
+    // mmap fails on empty files
+    if(st.st_size) {
+        void* data = mmap(nullptr, usize(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        if(data == MAP_FAILED) {
+            return core::Err();
+        }
+
+        // Assets are almost always read front to back, in full
+        madvise(data, usize(st.st_size), MADV_SEQUENTIAL);
+        madvise(data, usize(st.st_size), MADV_WILLNEED);
+
+        file._data = static_cast<const byte*>(data);
+        file._size = usize(st.st_size);
+    }
+#endif
+
+    file._is_open = true;
+    return core::Ok(std::move(file));
+}
+
+bool MappedFile::is_open() const {
+    return _is_open;
+}
+
+bool MappedFile::at_end() const {
+    y_debug_assert(_cursor <= _size);
+    return _cursor == _size;
+}
+
+usize MappedFile::remaining() const {
+    y_debug_assert(_cursor <= _size);
+    return _size - _cursor;
+}
+
+void MappedFile::seek(usize byte) {
+    _cursor = std::min(_size, byte);
+}
+
+usize MappedFile::tell() const {
+    return _cursor;
+}
+
+void MappedFile::reset() {
+    _cursor = 0;
+}
+
+ReadResult MappedFile::read(void* data, usize bytes) {
+    if(remaining() < bytes) {
+        return core::Err<usize>(0);
+    }
+    std::memcpy(data, _data + _cursor, bytes);
+    _cursor += bytes;
+    return core::Ok();
+}
+
+ReadUpToResult MappedFile::read_up_to(void* data, usize max_bytes) {
+    const usize max = std::min(max_bytes, remaining());
+    if(max) {
+        std::memcpy(data, _data + _cursor, max);
+        _cursor += max;
+    }
+    return core::Ok(max);
+}
+
+ReadUpToResult MappedFile::read_all(core::Vector<byte>& data) {
+    const usize r = remaining();
+    data.push_back(_data + _cursor, _data + _size);
+    _cursor = _size;
+    return core::Ok(r);
+}
+
+const byte* MappedFile::read_in_place(usize bytes) {
+    if(remaining() < bytes) {
+        return nullptr;
+    }
+    const byte* ptr = _data + _cursor;
+    _cursor += bytes;
+    return ptr;
+}
+
+const byte* MappedFile::data() const {
+    return _data;
+}
+
+usize MappedFile::size() const {
+    return _size;
+}
+
+core::Span<byte> MappedFile::span() const {
+    return core::Span<byte>(_data, _size);
+}
+
+}
+}
+
@@ -53,6 +53,13 @@ class Reader : NonCopyable {
         virtual void seek(usize byte) = 0;
         virtual usize tell() const = 0;
 
+        // Returns a pointer to the next bytes and moves past them, if the reader holds its data in memory.
+        // Returns nullptr (without moving) otherwise, or if fewer than bytes are left.
+        virtual const byte* read_in_place(usize bytes) {
+            unused(bytes);
+            return nullptr;
+        }
+
         template<typename T>
         ReadResult read_one(T& t) {
             static_assert(std::is_trivially_copyable_v<T>);
@@ -642,6 +642,12 @@ class ReadableArchive final {
                 if constexpr(detail::use_collection_fast_path<T>) {
                     if(collection_size) {
                         y_try(check_header(y_create_named_object(*object.object.begin(), detail::collection_version_string)));
+
+                        // Readers backed by memory (mapped files, buffers) hand out the whole array at once,
+                        // so we copy straight out of their storage rather than going through read
+                        const usize byte_size = usize(collection_size) * sizeof(*object.object.begin());
+                        const byte* in_place = _file.read_in_place(byte_size);
+
                         if constexpr(!IsRange) {
                             if constexpr(has_resize_v<T>) {
                                 object.object.resize(collection_size);
@@ -654,7 +660,9 @@ class ReadableArchive final {
                                 }
                             }
                         }
-                        if(!_file.read_array(object.object.begin(), collection_size)) {
+                        if(in_place) {
+                            std::memcpy(static_cast<void*>(object.object.begin()), in_place, byte_size);
+                        } else if(!_file.read_array(object.object.begin(), collection_size)) {
                             return core::Err(Error(ErrorType::IOError, object.name.data()));
                         }
                     }
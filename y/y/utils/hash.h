@@ -28,6 +28,7 @@ SOFTWARE.
 #include "name.h"
 
 #include <functional>
+#include <cstring>
 
 namespace y {
 
@@ -111,8 +112,169 @@ inline constexpr u32 ct_str_hash(std::string_view str) {
 template<typename T>
 static constexpr u64 ct_type_hash_v = ct_type_hash<T>();
 
+
+
+// Streaming 64 bits hash for file contents (XXH64, see https://github.com/Cyan4973/xxHash)
+// Feeding the same bytes in any number of chunks gives the same hash.
+class ContentHash {
+    static constexpr u64 prime_1 = UINT64_C(0x9E3779B185EBCA87);
+    static constexpr u64 prime_2 = UINT64_C(0xC2B2AE3D27D4EB4F);
+    static constexpr u64 prime_3 = UINT64_C(0x165667B19E3779F9);
+    static constexpr u64 prime_4 = UINT64_C(0x85EBCA77C2B2AE63);
+    static constexpr u64 prime_5 = UINT64_C(0x27D4EB2F165667C5);
+
+    static constexpr usize stripe_size = 32;
+
+    public:
+        ContentHash(u64 seed = 0) : _seed(seed) {
+            _lanes[0] = seed + prime_1 + prime_2;
+            _lanes[1] = seed + prime_2;
+            _lanes[2] = seed;
+            _lanes[3] = seed - prime_1;
+        }
+
+        void add(const void* data, usize size) {
+            if(!size) {
+                return;
+            }
+
+            const u8* bytes = static_cast<const u8*>(data);
+            _total_size += size;
+
+            if(_buffered) {
+                const usize fill = std::min(stripe_size - _buffered, size);
+                std::memcpy(_buffer + _buffered, bytes, fill);
+                _buffered += fill;
+                bytes += fill;
+                size -= fill;
+
+                if(_buffered != stripe_size) {
+                    return;
+                }
+                consume_stripe(_buffer);
+                _buffered = 0;
+            }
+
+            for(; size >= stripe_size; size -= stripe_size, bytes += stripe_size) {
+                consume_stripe(bytes);
+            }
+
+            std::memcpy(_buffer, bytes, size);
+            _buffered = size;
+        }
+
+        u64 hash() const {
+            u64 h = 0;
+            if(_total_size >= stripe_size) {
+                h = rotl(_lanes[0], 1) + rotl(_lanes[1], 7) + rotl(_lanes[2], 12) + rotl(_lanes[3], 18);
+                for(const u64 lane : _lanes) {
+                    h = (h ^ round(0, lane)) * prime_1 + prime_4;
+                }
+            } else {
+                h = _seed + prime_5;
+            }
+
+            h += _total_size;
+
+            const u8* bytes = _buffer;
+            usize size = _buffered;
+            for(; size >= 8; size -= 8, bytes += 8) {
+                h ^= round(0, read<u64>(bytes));
+                h = rotl(h, 27) * prime_1 + prime_4;
+            }
+            if(size >= 4) {
+                h ^= u64(read<u32>(bytes)) * prime_1;
+                h = rotl(h, 23) * prime_2 + prime_3;
+                size -= 4;
+                bytes += 4;
+            }
+            for(; size; --size, ++bytes) {
+                h ^= u64(*bytes) * prime_5;
+                h = rotl(h, 11) * prime_1;
+            }
+
+            h ^= h >> 33;
+            h *= prime_2;
+            h ^= h >> 29;
+            h *= prime_3;
+            h ^= h >> 32;
+            return h;
+        }
+
+    private:
+        template<typename T>
+        static T read(const u8* bytes) {
+            T t = {};
+            std::memcpy(&t, bytes, sizeof(T));
+            return t;
+        }
+
+        static constexpr u64 rotl(u64 x, u32 r) {
+            return (x << r) | (x >> (64 - r));
+        }
+
+        static constexpr u64 round(u64 acc, u64 input) {
+            acc += input * prime_2;
+            acc = rotl(acc, 31);
+            return acc * prime_1;
+        }
+
+        void consume_stripe(const u8* bytes) {
+            for(usize i = 0; i != 4; ++i) {
+                _lanes[i] = round(_lanes[i], read<u64>(bytes + i * 8));
+            }
+        }
+
+        u64 _lanes[4] = {};
+        u64 _seed = 0;
+        u64 _total_size = 0;
+
+        u8 _buffer[stripe_size] = {};
+        usize _buffered = 0;
+};
+
+struct Hash128 {
+    u64 low = 0;
+    u64 high = 0;
+
+    bool operator==(const Hash128& other) const {
+        return low == other.low && high == other.high;
+    }
+
+    bool operator!=(const Hash128& other) const {
+        return !operator==(other);
+    }
+};
+
+// 128 bits content hash, made of two differently seeded ContentHash.
+// Use this to identify content without comparing bytes.
+class ContentHash128 {
+    public:
+        using Value = Hash128;
+
+        void add(const void* data, usize size) {
+            _low.add(data, size);
+            _high.add(data, size);
+        }
+
+        Value hash() const {
+            return Value{_low.hash(), _high.hash()};
+        }
+
+    private:
+        ContentHash _low = ContentHash(0);
+        ContentHash _high = ContentHash(UINT64_C(0x9E3779B97F4A7C15));
+};
+
 }
 
+template<>
+struct std::hash<y::Hash128> {
+    auto operator()(const y::Hash128& h) const {
+        return y::usize(h.low);
+    }
+};
+
 template<typename A, typename B>
 struct std::hash<std::pair<A, B>> : std::hash<A>, std::hash<B> {
     auto operator()(const std::pair<A, B>& p) const {
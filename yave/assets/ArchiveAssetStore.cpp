@@ -0,0 +1,1120 @@
+/*******************************
+Copyright (c) 2016-2023 Grégoire Angerand
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+**********************************/
+#include "ArchiveAssetStore.h"
+#include "AssetIndex.h"
+#include "asset_paths.h"
+
+#include <y/io2/MappedFile.h>
+#include <y/core/FixedArray.h>
+#include <y/utils/hash.h>
+#include <y/utils/log.h>
+#include <y/utils/format.h>
+
+#include <charconv>
+
+namespace yave {
+
+using namespace detail;
+
+namespace {
+
+static constexpr u32 index_magic = 0x58444E49; // "INDX"
+static constexpr u32 journal_magic = 0x4E524A41; // "AJRN"
+static constexpr u32 index_version = 1;
+
+struct IndexHeader {
+    u32 magic = index_magic;
+    u32 version = index_version;
+    u64 next_id = 0;
+    u32 next_archive = 0;
+    u32 asset_count = 0;
+    u32 folder_count = 0;
+    u32 string_size = 0;
+    u64 body_hash = 0;
+};
+
+struct IndexEntry {
+    u64 id = 0;
+    u64 offset = 0;
+    u64 size = 0;
+    u64 content_hash = 0;
+    u32 type = 0;
+    u32 archive = 0;
+    u32 name_offset = 0;
+    u32 name_size = 0;
+};
+
+// The journal is only replayed on top of the checkpoint whose header hash it was started from
+struct JournalRecord {
+    u32 op = 0;
+    u32 type = 0;
+    u64 id = 0;
+    u64 offset = 0;
+    u64 size = 0;
+    u64 content_hash = 0;
+    u32 archive = 0;
+    u32 name_size = 0;
+    u32 other_name_size = 0;
+    u32 padding = 0;
+    u64 checksum = 0;
+};
+
+static_assert(sizeof(IndexHeader) == 40);
+static_assert(sizeof(IndexEntry) == 48);
+static_assert(sizeof(JournalRecord) == 64);
+
+static u64 checkpoint_hash(const IndexHeader& header) {
+    ContentHash hash;
+    hash.add(&header, sizeof(header));
+    return hash.hash();
+}
+
+// Reads one asset out of a mapped archive, keeping the mapping alive
+class ArchiveReader final : public io2::Reader {
+    public:
+        ArchiveReader(std::shared_ptr<io2::MappedFile> archive, u64 offset, u64 size) :
+                _archive(std::move(archive)),
+                _data(_archive->data() + offset),
+                _size(usize(size)) {
+        }
+
+        bool at_end() const override {
+            return _cursor == _size;
+        }
+
+        usize remaining() const override {
+            return _size - _cursor;
+        }
+
+        void seek(usize byte) override {
+            _cursor = std::min(byte, _size);
+        }
+
+        usize tell() const override {
+            return _cursor;
+        }
+
+        io2::ReadResult read(void* data, usize bytes) override {
+            if(remaining() < bytes) {
+                return core::Err<usize>(0);
+            }
+            std::memcpy(data, _data + _cursor, bytes);
+            _cursor += bytes;
+            return core::Ok();
+        }
+
+        io2::ReadUpToResult read_up_to(void* data, usize max_bytes) override {
+            const usize max = std::min(max_bytes, remaining());
+            if(max) {
+                std::memcpy(data, _data + _cursor, max);
+                _cursor += max;
+            }
+            return core::Ok(max);
+        }
+
+        io2::ReadUpToResult read_all(core::Vector<byte>& data) override {
+            const usize r = remaining();
+            data.push_back(_data + _cursor, _data + _size);
+            _cursor = _size;
+            return core::Ok(r);
+        }
+
+        const byte* read_in_place(usize bytes) override {
+            if(remaining() < bytes) {
+                return nullptr;
+            }
+            const byte* ptr = _data + _cursor;
+            _cursor += bytes;
+            return ptr;
+        }
+
+    private:
+        std::shared_ptr<io2::MappedFile> _archive;
+        const byte* _data = nullptr;
+        usize _size = 0;
+        usize _cursor = 0;
+};
+
+}
+
+
+
+
+ArchiveAssetStore::ArchiveFileSystemModel::ArchiveFileSystemModel(ArchiveAssetStore* parent) : _parent(parent) {
+}
+
+core::String ArchiveAssetStore::ArchiveFileSystemModel::join(std::string_view path, std::string_view name) const {
+    if(!path.size()) {
+        return name;
+    }
+    core::String result;
+    result.set_min_capacity(path.size() + name.size() + 1);
+    result += path;
+    if(!is_delimiter(path.back())) {
+        result.push_back('/');
+    }
+    result += name;
+    return result;
+}
+
+core::String ArchiveAssetStore::ArchiveFileSystemModel::filename(std::string_view path) const {
+    for(usize i = path.size(); i > 0; --i) {
+        if(is_delimiter(path[i - 1])) {
+            return path.substr(i);
+        }
+    }
+    return path;
+}
+
+FileSystemModel::Result<core::String> ArchiveAssetStore::ArchiveFileSystemModel::current_path() const {
+    return core::Ok(core::String());
+}
+
+FileSystemModel::Result<core::String> ArchiveAssetStore::ArchiveFileSystemModel::parent_path(std::string_view path) const {
+    return core::Ok(core::String(strict_parent_path(path)));
+}
+
+FileSystemModel::Result<bool> ArchiveAssetStore::ArchiveFileSystemModel::exists(std::string_view path) const {
+    if(path.empty()) {
+        return core::Ok(true);
+    }
+
+    const bool has_delim = is_delimiter(path.back());
+    const std::string_view no_delim = strict_path(path);
+
+    const auto lock = y_profile_unique_lock(_parent->_lock);
+    return core::Ok(_parent->_folders.find(no_delim) != _parent->_folders.end() || (!has_delim && _parent->_assets.find(no_delim) != _parent->_assets.end()));
+}
+
+FileSystemModel::Result<FileSystemModel::EntryType> ArchiveAssetStore::ArchiveFileSystemModel::entry_type(std::string_view path) const {
+    if(path.empty()) {
+        return core::Ok(EntryType::Directory);
+    }
+
+    const auto lock = y_profile_unique_lock(_parent->_lock);
+    const bool is_dir = _parent->_folders.find(strict_path(path)) != _parent->_folders.end();
+    return core::Ok(is_dir ? EntryType::Directory : EntryType::File);
+}
+
+FileSystemModel::Result<core::String> ArchiveAssetStore::ArchiveFileSystemModel::absolute(std::string_view path) const {
+    return core::Ok(core::String(path));
+}
+
+FileSystemModel::Result<> ArchiveAssetStore::ArchiveFileSystemModel::for_each(std::string_view path, const for_each_f& func) const {
+    y_profile();
+
+    path = strict_path(path);
+
+    const bool is_root = path.empty();
+
+    const auto lock = y_profile_unique_lock(_parent->_lock);
+
+    for(auto it = _parent->_folders.lower_bound(path); it != _parent->_folders.end(); ++it) {
+        if(is_strict_direct_parent(path, *it)) {
+            func(EntryInfo{EntryType::Directory, it->sub_str(path.size() + !is_root), 0});
+        } else if(!it->starts_with(path)) {
+            break;
+        }
+    }
+
+    for(auto it = _parent->_assets.lower_bound(path); it != _parent->_assets.end(); ++it) {
+        if(is_strict_direct_parent(path, it->first)) {
+            func(EntryInfo{EntryType::File, it->first.sub_str(path.size() + !is_root), usize(it->second.size)});
+        } else if(!it->first.starts_with(path)) {
+            break;
+        }
+    }
+
+    return core::Ok();
+}
+
+FileSystemModel::Result<> ArchiveAssetStore::ArchiveFileSystemModel::create_directory(std::string_view path) const {
+    y_profile();
+
+    path = strict_path(path);
+
+    if(path.empty()) {
+        return core::Ok();
+    }
+
+    const auto lock = y_profile_unique_lock(_parent->_lock);
+
+    if(_parent->apply_create_folder(path)) {
+        return _parent->journal_or_restore(JournalOp::CreateFolder, AssetData{}, path);
+    }
+
+    return core::Ok();
+}
+
+FileSystemModel::Result<> ArchiveAssetStore::ArchiveFileSystemModel::remove(std::string_view path) const {
+    y_profile();
+
+    path = strict_path(path);
+
+    const auto lock = y_profile_unique_lock(_parent->_lock);
+
+    const usize removed = _parent->apply_remove(path);
+    log_msg(fmt("Removed % assets", removed));
+
+    return _parent->journal_or_restore(JournalOp::Remove, AssetData{}, path);
+}
+
+FileSystemModel::Result<> ArchiveAssetStore::ArchiveFileSystemModel::rename(std::string_view from, std::string_view to) const {
+    y_profile();
+
+    from = strict_path(from);
+    to = strict_path(to);
+
+    if(!is_valid_path(to) || to.empty() || from.empty()) {
+        return core::Err();
+    }
+
+    const auto lock = y_profile_unique_lock(_parent->_lock);
+
+    if(!_parent->apply_rename(from, to)) {
+        return core::Err();
+    }
+
+    return _parent->journal_or_restore(JournalOp::Rename, AssetData{}, from, to);
+}
+
+
+
+
+
+
+
+
+ArchiveAssetStore::ArchiveAssetStore(const core::String& root) :
+        _root(FileSystemModel::local_filesystem()->absolute(root).unwrap_or(root)),
+        _journal(journal_magic, index_version),
+        _filesystem(this) {
+    y_profile();
+
+    FileSystemModel::local_filesystem()->create_directory(_root).unwrap();
+
+    load_index().unwrap();
+    remove_unused_archives();
+
+    // Only compact when it's worth it: more than half the archives is dead, and by a significant amount
+    const u64 dead = dead_bytes();
+    if(dead > 64 * 1024 * 1024 && dead > _live_bytes) {
+        log_msg(fmt("Compacting asset archives: %MB are unused", dead / (1024 * 1024)));
+        if(!compact()) {
+            log_msg("Asset archive compaction failed", Log::Error);
+        }
+    }
+}
+
+ArchiveAssetStore::~ArchiveAssetStore() {
+}
+
+core::String ArchiveAssetStore::index_file_name() const {
+    return _filesystem.join(_root, ".index");
+}
+
+core::String ArchiveAssetStore::journal_file_name() const {
+    return _filesystem.join(_root, ".journal");
+}
+
+core::String ArchiveAssetStore::archive_file_name(u32 archive) const {
+    return _filesystem.join(_root, fmt("%.archive", archive));
+}
+
+const FileSystemModel* ArchiveAssetStore::filesystem() const {
+    return &_filesystem;
+}
+
+void ArchiveAssetStore::rebuild_id_map() const {
+    const auto lock = y_profile_unique_lock(_lock);
+
+    if(!_ids) {
+        y_profile();
+
+        auto& assets = const_cast<std::map<core::String, AssetData>&>(_assets);
+
+        _ids = std::make_unique<std::remove_reference_t<decltype(*_ids)>>();
+        _ids->reserve(assets.size());
+
+        for(auto it = assets.begin(); it != assets.end(); ++it) {
+            (*_ids)[it->second.id] = it;
+        }
+    }
+}
+
+AssetId ArchiveAssetStore::next_id() {
+    const auto lock = y_profile_unique_lock(_lock);
+
+    return AssetId::from_id(_next_id++);
+}
+
+u64 ArchiveAssetStore::archived_bytes() const {
+    const auto lock = y_profile_unique_lock(_lock);
+
+    u64 total = 0;
+    for(const u64 size : _archive_sizes) {
+        total += size;
+    }
+    return total;
+}
+
+u64 ArchiveAssetStore::dead_bytes() const {
+    const auto lock = y_profile_unique_lock(_lock);
+
+    return archived_bytes() - _live_bytes;
+}
+
+AssetStore::Result<ArchiveAssetStore::AssetData> ArchiveAssetStore::append_data(io2::Reader& data) {
+    y_profile();
+
+    const auto lock = y_profile_unique_lock(_lock);
+
+    const u32 current = _next_archive - 1;
+    if(!_next_archive || _archive_sizes[current] >= max_archive_size) {
+        _current_archive = io2::File();
+        ++_next_archive;
+        _archive_sizes.set_min_size(_next_archive);
+    }
+
+    const u32 archive = _next_archive - 1;
+    if(!_current_archive.is_open()) {
+        if(auto file = io2::File::open_append(archive_file_name(archive))) {
+            _current_archive = std::move(file.unwrap());
+        } else {
+            return core::Err(ErrorType::FilesytemError);
+        }
+    }
+
+    y_debug_assert(_current_archive.tell() == _archive_sizes[archive]);
+
+    AssetData asset_data;
+    asset_data.archive = archive;
+    asset_data.offset = _archive_sizes[archive];
+
+    ContentHash hash;
+    bool success = true;
+
+    {
+        y_profile_zone("writing");
+
+        core::FixedArray<u8> buffer(64 * 1024);
+        while(!data.at_end()) {
+            const auto r = data.read_up_to(buffer.data(), buffer.size());
+            if(!r || !r.unwrap()) {
+                success = r.is_ok();
+                break;
+            }
+
+            const usize read = r.unwrap();
+            if(!_current_archive.write(buffer.data(), read)) {
+                success = false;
+                break;
+            }
+
+            hash.add(buffer.data(), read);
+            asset_data.size += read;
+        }
+
+        success &= _current_archive.flush().is_ok();
+    }
+
+    // Whatever happened, the archive now ends here
+    _archive_sizes[archive] = _current_archive.tell();
+
+    if(!success) {
+        return core::Err(ErrorType::FilesytemError);
+    }
+
+    asset_data.content_hash = hash.hash();
+
+    return core::Ok(asset_data);
+}
+
+AssetStore::Result<std::shared_ptr<io2::MappedFile>> ArchiveAssetStore::map_archive(u32 archive, u64 end) const {
+    const auto lock = y_profile_unique_lock(_lock);
+
+    _mapped_archives.set_min_size(archive + 1);
+
+    // Archives are append only: an older mapping is still valid for everything it covers
+    auto& mapped = _mapped_archives[archive];
+    if(!mapped || mapped->size() < end) {
+        y_profile_zone("mapping archive");
+        auto file = io2::MappedFile::open(archive_file_name(archive));
+        if(!file || file.unwrap().size() < end) {
+            return core::Err(ErrorType::FilesytemError);
+        }
+        mapped = std::make_shared<io2::MappedFile>(std::move(file.unwrap()));
+    }
+
+    return core::Ok(mapped);
+}
+
+AssetStore::Result<AssetId> ArchiveAssetStore::import(io2::Reader& data, std::string_view dst_name, AssetType type) {
+    y_profile();
+
+    dst_name = strict_path(dst_name);
+
+    if(!is_valid_path(dst_name)) {
+        return core::Err(ErrorType::InvalidName);
+    }
+
+    const auto lock = y_profile_unique_lock(_lock);
+
+    if(!_filesystem.create_directory(strict_parent_path(dst_name))) {
+        return core::Err(ErrorType::FilesytemError);
+    }
+
+    if(_assets.find(dst_name) != _assets.end()) {
+        return core::Err(ErrorType::NameAlreadyExists);
+    }
+
+    auto appended = append_data(data);
+    y_try(appended);
+
+    AssetData asset_data = appended.unwrap();
+    asset_data.id = next_id();
+    asset_data.type = type;
+
+    apply_import(dst_name, asset_data);
+    y_try(journal_or_restore(JournalOp::Import, asset_data, dst_name));
+
+    return core::Ok(asset_data.id);
+}
+
+AssetStore::Result<> ArchiveAssetStore::write(AssetId id, io2::Reader& data) {
+    y_profile();
+
+    if(id == AssetId::invalid_id()) {
+        return core::Err(ErrorType::UnknownID);
+    }
+
+    const auto lock = y_profile_unique_lock(_lock);
+
+    rebuild_id_map();
+    if(!_ids->contains(id)) {
+        return core::Err(ErrorType::UnknownID);
+    }
+
+    auto appended = append_data(data);
+    y_try(appended);
+
+    AssetData written = appended.unwrap();
+    written.id = id;
+
+    apply_write(id, written);
+    return journal_or_restore(JournalOp::Write, written, {});
+}
+
+AssetStore::Result<io2::ReaderPtr> ArchiveAssetStore::data(AssetId id) const {
+    y_profile();
+
+    if(id == AssetId::invalid_id()) {
+        return core::Err(ErrorType::UnknownID);
+    }
+
+    const auto lock = y_profile_unique_lock(_lock);
+
+    rebuild_id_map();
+    const auto it = _ids->find(id);
+    if(it == _ids->end()) {
+        return core::Err(ErrorType::UnknownID);
+    }
+
+    const AssetData& asset_data = it->second->second;
+
+    auto mapped = map_archive(asset_data.archive, asset_data.offset + asset_data.size);
+    y_try(mapped);
+
+    io2::ReaderPtr ptr = std::make_unique<ArchiveReader>(std::move(mapped.unwrap()), asset_data.offset, asset_data.size);
+    return core::Ok(std::move(ptr));
+}
+
+AssetStore::Result<AssetId> ArchiveAssetStore::id(std::string_view name) const {
+    y_profile();
+
+    const auto lock = y_profile_unique_lock(_lock);
+
+    if(const auto it = _assets.find(name); it != _assets.end()) {
+        return core::Ok(it->second.id);
+    }
+
+    return core::Err(ErrorType::UnknownID);
+}
+
+AssetStore::Result<core::String> ArchiveAssetStore::name(AssetId id) const {
+    y_profile();
+
+    if(id == AssetId::invalid_id()) {
+        return core::Err(ErrorType::UnknownID);
+    }
+
+    const auto lock = y_profile_unique_lock(_lock);
+
+    rebuild_id_map();
+    if(const auto it = _ids->find(id); it != _ids->end()) {
+        return core::Ok(core::String(it->second->first));
+    }
+
+    return core::Err(ErrorType::UnknownID);
+}
+
+AssetStore::Result<> ArchiveAssetStore::remove(AssetId id) {
+    y_profile();
+
+    const auto lock = y_profile_unique_lock(_lock);
+
+    auto na = name(id);
+    y_try(na);
+
+    return remove(na.unwrap());
+}
+
+AssetStore::Result<> ArchiveAssetStore::rename(AssetId id, std::string_view new_name) {
+    y_profile();
+
+    const auto lock = y_profile_unique_lock(_lock);
+
+    auto na = name(id);
+    y_try(na);
+
+    return rename(na.unwrap(), new_name);
+}
+
+AssetStore::Result<> ArchiveAssetStore::remove(std::string_view name) {
+    y_profile();
+
+    if(!_filesystem.remove(name)) {
+        return core::Err(ErrorType::FilesytemError);
+    }
+
+    return core::Ok();
+}
+
+AssetStore::Result<> ArchiveAssetStore::rename(std::string_view from, std::string_view to) {
+    y_profile();
+
+    if(!_filesystem.rename(from, to)) {
+        return core::Err(ErrorType::FilesytemError);
+    }
+
+    return core::Ok();
+}
+
+AssetStore::Result<AssetType> ArchiveAssetStore::asset_type(AssetId id) const {
+    y_profile();
+
+    if(id == AssetId::invalid_id()) {
+        return core::Err(ErrorType::UnknownID);
+    }
+
+    const auto lock = y_profile_unique_lock(_lock);
+
+    rebuild_id_map();
+    if(const auto it = _ids->find(id); it != _ids->end()) {
+        return core::Ok(it->second->second.type);
+    }
+
+    return core::Err(ErrorType::UnknownID);
+}
+
+AssetStore::Result<u64> ArchiveAssetStore::content_hash(AssetId id) const {
+    if(id == AssetId::invalid_id()) {
+        return core::Err(ErrorType::UnknownID);
+    }
+
+    const auto lock = y_profile_unique_lock(_lock);
+
+    rebuild_id_map();
+    if(const auto it = _ids->find(id); it != _ids->end()) {
+        return core::Ok(it->second->second.content_hash);
+    }
+
+    return core::Err(ErrorType::UnknownID);
+}
+
+AssetStore::Result<> ArchiveAssetStore::compact() {
+    y_profile();
+
+    const auto lock = y_profile_unique_lock(_lock);
+
+    const u32 first_new_archive = _next_archive;
+
+    // Copy assets in archive order, so we read the old archives front to back
+    core::Vector<AssetData*> assets = core::vector_with_capacity<AssetData*>(_assets.size());
+    for(auto& [name, asset_data] : _assets) {
+        assets << &asset_data;
+    }
+    std::sort(assets.begin(), assets.end(), [](const AssetData* a, const AssetData* b) {
+        return std::tie(a->archive, a->offset) < std::tie(b->archive, b->offset);
+    });
+
+    const std::map<core::String, AssetData> old_assets = _assets;
+    const core::Vector<u64> old_sizes = _archive_sizes;
+
+    auto restore = [&] {
+        _current_archive = io2::File();
+        for(u32 i = first_new_archive; i != _next_archive; ++i) {
+            FileSystemModel::local_filesystem()->remove(archive_file_name(i)).ignore();
+        }
+        _assets = old_assets;
+        _archive_sizes = old_sizes;
+        _next_archive = first_new_archive;
+        _ids = nullptr;
+        // The new archives are gone, their indices will be reused
+        _mapped_archives.shrink_to(first_new_archive);
+    };
+
+    // Appending to the last archive would mix live and compacted data
+    _current_archive = io2::File();
+    _archive_sizes.set_min_size(_next_archive + 1);
+    _archive_sizes[_next_archive++] = max_archive_size;
+
+    for(AssetData* asset_data : assets) {
+        auto mapped = map_archive(asset_data->archive, asset_data->offset + asset_data->size);
+        if(!mapped) {
+            restore();
+            return core::Err(ErrorType::FilesytemError);
+        }
+
+        ArchiveReader reader(std::move(mapped.unwrap()), asset_data->offset, asset_data->size);
+        auto appended = append_data(reader);
+        if(!appended || appended.unwrap().content_hash != asset_data->content_hash) {
+            restore();
+            return core::Err(ErrorType::FilesytemError);
+        }
+
+        const AssetData& written = appended.unwrap();
+        asset_data->archive = written.archive;
+        asset_data->offset = written.offset;
+    }
+
+    // The placeholder archive was never created
+    _archive_sizes[first_new_archive] = 0;
+
+    if(!save_index()) {
+        restore();
+        return core::Err(ErrorType::FilesytemError);
+    }
+
+    for(u32 i = 0; i != first_new_archive; ++i) {
+        _archive_sizes[i] = 0;
+    }
+    _mapped_archives.make_empty();
+
+    remove_unused_archives();
+
+    return core::Ok();
+}
+
+void ArchiveAssetStore::remove_unused_archives() {
+    y_profile();
+
+    const auto lock = y_profile_unique_lock(_lock);
+
+    core::Vector<bool> used(_next_archive, false);
+    for(const auto& [name, asset_data] : _assets) {
+        used[asset_data.archive] = true;
+    }
+
+    // Keep the archive we are appending to
+    if(_current_archive.is_open()) {
+        used[_next_archive - 1] = true;
+    }
+
+    const FileSystemModel* fs = FileSystemModel::local_filesystem();
+
+    core::Vector<core::String> to_remove;
+    fs->for_each(_root, [&](const FileSystemModel::EntryInfo& info) {
+        if(info.type != FileSystemModel::EntryType::File || !info.name.ends_with(".archive")) {
+            return;
+        }
+
+        u32 archive = 0;
+        const std::string_view number = info.name.sub_str(0, info.name.size() - 8);
+        if(std::from_chars(number.data(), number.data() + number.size(), archive).ec != std::errc()) {
+            return;
+        }
+
+        if(archive >= _next_archive || !used[archive]) {
+            to_remove << info.name;
+        }
+    }).ignore();
+
+    for(const core::String& name : to_remove) {
+        if(!fs->remove(fs->join(_root, name))) {
+            log_msg(fmt("Unable to remove unused archive %", name), Log::Warning);
+        }
+    }
+
+    for(u32 i = 0; i != _next_archive; ++i) {
+        if(!used[i]) {
+            _archive_sizes[i] = 0;
+        }
+    }
+}
+
+AssetStore::Result<> ArchiveAssetStore::load_index() {
+    y_profile();
+
+    const auto lock = y_profile_unique_lock(_lock);
+
+    _ids = nullptr;
+    _assets.clear();
+    _folders.clear();
+    _archive_sizes.make_empty();
+    _mapped_archives.make_empty();
+    _current_archive = io2::File();
+    _journal.close();
+    _checkpoint = 0;
+    _live_bytes = 0;
+    _next_archive = 0;
+    _next_id = u64(std::time(nullptr));
+
+    y_try(read_index());
+
+    // A clean journal can be appended to, otherwise we checkpoint to start a new one
+    const bool clean = replay_journal() && _journal.reopen(journal_file_name());
+
+    load_archive_sizes();
+    rebuild_id_map();
+
+    if(!clean && !save_index()) {
+        log_msg("Failed to save asset index", Log::Error);
+    }
+
+    return core::Ok();
+}
+
+AssetStore::Result<> ArchiveAssetStore::read_index() {
+    y_profile();
+
+    const auto lock = y_profile_unique_lock(_lock);
+
+    const core::String file_name = index_file_name();
+    if(!io2::File::is_file_exists(file_name)) {
+        return core::Ok();
+    }
+
+    auto file = io2::MappedFile::open(file_name);
+    if(!file) {
+        log_msg("Unable to open asset index", Log::Error);
+        return core::Err(ErrorType::FilesytemError);
+    }
+
+    auto parsed = AssetIndexReader<IndexHeader, IndexEntry>::parse(file.unwrap().span());
+    if(!parsed) {
+        return core::Err(parsed.error());
+    }
+
+    const auto& index = parsed.unwrap();
+    const IndexHeader& header = index.header();
+
+    _checkpoint = checkpoint_hash(header);
+    _next_id = std::max(_next_id, header.next_id);
+    _next_archive = header.next_archive;
+
+    {
+        y_profile_zone("Reading assets");
+        for(u32 i = 0; i != header.asset_count; ++i) {
+            const IndexEntry entry = index.entry(i);
+
+            const std::string_view name = index.name(entry);
+            if(name.empty() || entry.archive >= _next_archive) {
+                log_msg("Invalid asset index entry", Log::Error);
+                continue;
+            }
+
+            AssetData asset_data;
+            asset_data.id = AssetId::from_id(entry.id);
+            asset_data.type = AssetType(entry.type);
+            asset_data.archive = entry.archive;
+            asset_data.offset = entry.offset;
+            asset_data.size = entry.size;
+            asset_data.content_hash = entry.content_hash;
+
+            // Entries are saved in order
+            _assets.emplace_hint(_assets.end(), name, asset_data);
+            _live_bytes += entry.size;
+        }
+    }
+
+    {
+        y_profile_zone("Reading folders");
+        for(u32 i = 0; i != header.folder_count; ++i) {
+            const std::string_view name = index.name(index.folder(i));
+            if(!name.empty()) {
+                _folders.emplace_hint(_folders.end(), name);
+            }
+        }
+    }
+
+    return core::Ok();
+}
+
+void ArchiveAssetStore::load_archive_sizes() {
+    y_profile();
+
+    const auto lock = y_profile_unique_lock(_lock);
+
+    _archive_sizes.make_empty();
+    _archive_sizes.set_min_size(_next_archive);
+
+    const FileSystemModel* fs = FileSystemModel::local_filesystem();
+    fs->for_each(_root, [&](const FileSystemModel::EntryInfo& info) {
+        if(info.type != FileSystemModel::EntryType::File || !info.name.ends_with(".archive")) {
+            return;
+        }
+
+        u32 archive = 0;
+        const std::string_view number = info.name.sub_str(0, info.name.size() - 8);
+        if(std::from_chars(number.data(), number.data() + number.size(), archive).ec == std::errc() && archive < _next_archive) {
+            _archive_sizes[archive] = info.file_size;
+        }
+    }).ignore();
+}
+
+AssetStore::Result<> ArchiveAssetStore::save_index() {
+    y_profile();
+
+    const auto lock = y_profile_unique_lock(_lock);
+
+    AssetIndexWriter<IndexHeader, IndexEntry> index(_assets.size(), _folders.size());
+
+    for(const auto& [name, asset_data] : _assets) {
+        IndexEntry entry;
+        entry.id = asset_data.id.id();
+        entry.offset = asset_data.offset;
+        entry.size = asset_data.size;
+        entry.content_hash = asset_data.content_hash;
+        entry.type = u32(asset_data.type);
+        entry.archive = asset_data.archive;
+        index.add_entry(entry, name);
+    }
+
+    for(const core::String& folder : _folders) {
+        index.add_folder(folder);
+    }
+
+    IndexHeader header;
+    header.next_id = _next_id;
+    header.next_archive = _next_archive;
+
+    y_try(index.write(index_file_name(), header));
+
+    // The previous journal is now obsolete: it was started from another checkpoint
+    _checkpoint = checkpoint_hash(header);
+    if(!_journal.create(journal_file_name(), _checkpoint)) {
+        // The index itself is valid: the next mutation will fail to be journaled and reload the store, which checkpoints again
+        log_msg("Unable to create asset journal", Log::Error);
+    }
+
+    return core::Ok();
+}
+
+bool ArchiveAssetStore::apply_import(std::string_view name, const AssetData& asset_data) {
+    const auto lock = y_profile_unique_lock(_lock);
+
+    const auto [it, inserted] = _assets.emplace(name, asset_data);
+    if(!inserted) {
+        return false;
+    }
+
+    if(_ids) {
+        (*_ids)[asset_data.id] = it;
+    }
+
+    _live_bytes += asset_data.size;
+    _next_id = std::max(_next_id, asset_data.id.id() + 1);
+    _next_archive = std::max(_next_archive, asset_data.archive + 1);
+
+    return true;
+}
+
+bool ArchiveAssetStore::apply_write(AssetId id, const AssetData& written) {
+    const auto lock = y_profile_unique_lock(_lock);
+
+    rebuild_id_map();
+    const auto it = _ids->find(id);
+    if(it == _ids->end()) {
+        return false;
+    }
+
+    AssetData& asset_data = it->second->second;
+    _live_bytes -= asset_data.size;
+    _live_bytes += written.size;
+
+    asset_data.archive = written.archive;
+    asset_data.offset = written.offset;
+    asset_data.size = written.size;
+    asset_data.content_hash = written.content_hash;
+
+    _next_archive = std::max(_next_archive, written.archive + 1);
+
+    return true;
+}
+
+bool ArchiveAssetStore::apply_create_folder(std::string_view path) {
+    const auto lock = y_profile_unique_lock(_lock);
+
+    // Parents of existing folders always exist
+    bool created = false;
+    for(; !path.empty() && _folders.emplace(path).second; path = strict_parent_path(path)) {
+        created = true;
+    }
+
+    return created;
+}
+
+usize ArchiveAssetStore::apply_remove(std::string_view path) {
+    const auto lock = y_profile_unique_lock(_lock);
+
+    for(auto it = _folders.begin(); it != _folders.end();) {
+        if(is_strict_indirect_parent(path, *it) || *it == path) {
+            it = _folders.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    usize removed = 0;
+    for(auto it = _assets.begin(); it != _assets.end();) {
+        if(is_strict_indirect_parent(path, it->first) || it->first == path) {
+            if(_ids) {
+                _ids->erase(it->second.id);
+            }
+            _live_bytes -= it->second.size;
+            it = _assets.erase(it);
+            ++removed;
+        } else {
+            ++it;
+        }
+    }
+
+    return removed;
+}
+
+bool ArchiveAssetStore::apply_rename(std::string_view from, std::string_view to) {
+    const auto lock = y_profile_unique_lock(_lock);
+
+    std::map<core::String, AssetData> new_assets;
+    for(const auto& [name, data] : _assets) {
+        core::String new_name = name;
+        if(is_strict_indirect_parent(from, name) || from == name) {
+            const std::string_view end = name.sub_str(from.size() + (from == name ? 0 : 1));
+            new_name = end.empty() ? core::String(to) : _filesystem.join(to, end);
+            if(_assets.find(new_name) != _assets.end()) {
+                return false;
+            }
+        }
+        if(!new_assets.emplace(std::move(new_name), data).second) {
+            return false;
+        }
+    }
+
+    std::set<core::String> new_folders;
+    for(const core::String& folder : _folders) {
+        if(is_strict_indirect_parent(from, folder)) {
+            new_folders.insert(_filesystem.join(to, folder.sub_str(from.size() + 1)));
+        } else if(from == folder) {
+            new_folders.insert(to);
+        } else {
+            new_folders.insert(folder);
+        }
+    }
+
+    _ids = nullptr;
+    std::swap(new_folders, _folders);
+    std::swap(new_assets, _assets);
+
+    return true;
+}
+
+AssetStore::Result<> ArchiveAssetStore::journal_or_restore(JournalOp op, const AssetData& asset_data, std::string_view name, std::string_view other_name) {
+    y_profile();
+
+    const auto lock = y_profile_unique_lock(_lock);
+
+    JournalRecord record;
+    record.op = u32(op);
+    record.type = u32(asset_data.type);
+    record.id = asset_data.id.id();
+    record.offset = asset_data.offset;
+    record.size = asset_data.size;
+    record.content_hash = asset_data.content_hash;
+    record.archive = asset_data.archive;
+
+    if(!_journal.append(record, name, other_name)) {
+        log_msg("Failed to write asset journal", Log::Error);
+        load_index().ignore();
+        return core::Err(ErrorType::FilesytemError);
+    }
+
+    if(_journal.record_count() >= checkpoint_interval && !save_index()) {
+        log_msg("Failed to checkpoint asset index", Log::Warning);
+    }
+
+    return core::Ok();
+}
+
+AssetStore::Result<> ArchiveAssetStore::replay_journal() {
+    y_profile();
+
+    const auto lock = y_profile_unique_lock(_lock);
+
+    return _journal.replay<JournalRecord>(journal_file_name(), _checkpoint, [&](const JournalRecord& record, std::string_view name, std::string_view other_name) {
+        AssetData asset_data;
+        asset_data.id = AssetId::from_id(record.id);
+        asset_data.type = AssetType(record.type);
+        asset_data.archive = record.archive;
+        asset_data.offset = record.offset;
+        asset_data.size = record.size;
+        asset_data.content_hash = record.content_hash;
+
+        switch(JournalOp(record.op)) {
+            case JournalOp::Import:
+                apply_import(name, asset_data);
+            break;
+
+            case JournalOp::Write:
+                apply_write(asset_data.id, asset_data);
+            break;
+
+            case JournalOp::CreateFolder:
+                apply_create_folder(name);
+            break;
+
+            case JournalOp::Remove:
+                apply_remove(name);
+            break;
+
+            case JournalOp::Rename:
+                apply_rename(name, other_name);
+            break;
+
+            default:
+                log_msg(fmt("Unknown journal operation: %", record.op), Log::Error);
+        }
+    });
+}
+
+}
+
@@ -0,0 +1,182 @@
+/*******************************
+Copyright (c) 2016-2023 Grégoire Angerand
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+**********************************/
+#ifndef YAVE_ASSETS_ARCHIVEASSETSTORE_H
+#define YAVE_ASSETS_ARCHIVEASSETSTORE_H
+
+#include <yave/utils/FileSystemModel.h>
+
+#include "AssetStore.h"
+#include "AssetIndex.h"
+
+#include <y/core/String.h>
+#include <y/core/HashMap.h>
+#include <y/io2/File.h>
+
+#include <mutex>
+#include <set>
+#include <map>
+
+namespace y::io2 {
+class MappedFile;
+}
+
+namespace yave {
+
+// Stores asset data packed in large append-only archive files, described by a single binary index.
+// The whole index is loaded with one mapping, no matter how many assets the store contains.
+// Mutations are appended to a journal, the index is only rewritten every checkpoint_interval mutations and when the store is opened.
+// Overwritten and removed assets leave dead space in the archives, which compact() reclaims.
+class ArchiveAssetStore final : NonMovable, public AssetStore {
+
+    class ArchiveFileSystemModel final : public FileSystemModel {
+        public:
+            core::String filename(std::string_view path) const override;
+            core::String  join(std::string_view path, std::string_view name) const override;
+
+            Result<core::String> current_path() const override;
+            Result<core::String> parent_path(std::string_view path) const override;
+
+            Result<bool> exists(std::string_view path) const override;
+            Result<EntryType> entry_type(std::string_view path) const override;
+
+            Result<core::String> absolute(std::string_view path) const override;
+            Result<> for_each(std::string_view path, const for_each_f& func) const override;
+            Result<> create_directory(std::string_view path) const override;
+            Result<> remove(std::string_view path) const override;
+            Result<> rename(std::string_view from, std::string_view to) const override;
+
+        private:
+            friend class ArchiveAssetStore;
+
+            ArchiveFileSystemModel(ArchiveAssetStore* parent);
+
+            ArchiveAssetStore* _parent = nullptr;
+    };
+
+    struct AssetData {
+        AssetId id;
+        AssetType type = AssetType::Unknown;
+        u32 archive = 0;
+        u64 offset = 0;
+        u64 size = 0;
+        u64 content_hash = 0;
+    };
+
+    enum class JournalOp : u32 {
+        Import = 1,
+        Write = 2,
+        CreateFolder = 3,
+        Remove = 4,
+        Rename = 5,
+    };
+
+    public:
+        static constexpr u64 max_archive_size = 1024 * 1024 * 1024;
+
+        // Number of journaled mutations between checkpoints
+        static constexpr usize checkpoint_interval = 4096;
+
+        ArchiveAssetStore(const core::String& root = "./store.archive");
+        ~ArchiveAssetStore() override;
+
+        const FileSystemModel* filesystem() const override;
+
+        Result<AssetId> import(io2::Reader& data, std::string_view dst_name, AssetType type) override;
+        Result<> write(AssetId id, io2::Reader& data) override;
+
+        Result<AssetId> id(std::string_view name) const override;
+        Result<core::String> name(AssetId id) const override;
+
+        Result<io2::ReaderPtr> data(AssetId id) const override;
+
+        Result<> remove(AssetId id) override;
+        Result<> rename(AssetId id, std::string_view new_name) override;
+        Result<> remove(std::string_view name) override;
+        Result<> rename(std::string_view from, std::string_view to) override;
+
+        Result<AssetType> asset_type(AssetId id) const override;
+
+        Result<u64> content_hash(AssetId id) const;
+
+        // Rewrites every live asset into new archives and deletes the old ones
+        Result<> compact();
+
+        u64 archived_bytes() const;
+        u64 dead_bytes() const;
+
+    private:
+        AssetId next_id();
+        void rebuild_id_map() const;
+
+        core::String index_file_name() const;
+        core::String journal_file_name() const;
+        core::String archive_file_name(u32 archive) const;
+
+        Result<AssetData> append_data(io2::Reader& data);
+        Result<std::shared_ptr<io2::MappedFile>> map_archive(u32 archive, u64 end) const;
+
+        // Used both by live mutations and when replaying the journal
+        bool apply_import(std::string_view name, const AssetData& asset_data);
+        bool apply_write(AssetId id, const AssetData& written);
+        bool apply_create_folder(std::string_view path);
+        usize apply_remove(std::string_view path);
+        bool apply_rename(std::string_view from, std::string_view to);
+
+        // Reloads the last persisted state if the record could not be written
+        Result<> journal_or_restore(JournalOp op, const AssetData& asset_data, std::string_view name, std::string_view other_name = {});
+        Result<> replay_journal();
+
+        Result<> load_index();
+        Result<> read_index();
+        Result<> save_index();
+        void load_archive_sizes();
+
+        void remove_unused_archives();
+
+        core::String _root;
+
+        u64 _next_id = 0;
+        u32 _next_archive = 0;
+
+        std::set<core::String> _folders;
+        std::map<core::String, AssetData> _assets;
+
+        core::Vector<u64> _archive_sizes;
+        u64 _live_bytes = 0;
+
+        io2::File _current_archive;
+
+        detail::AssetJournal _journal;
+        u64 _checkpoint = 0;
+
+        mutable core::Vector<std::shared_ptr<io2::MappedFile>> _mapped_archives;
+        mutable std::unique_ptr<core::FlatHashMap<AssetId, std::map<core::String, AssetData>::iterator>> _ids;
+
+        mutable std::recursive_mutex _lock;
+
+        ArchiveFileSystemModel _filesystem;
+};
+
+}
+
+#endif // YAVE_ASSETS_ARCHIVEASSETSTORE_H
+
@@ -60,6 +60,24 @@ AssetLoadingState AssetDependencies::state() const {
     return AssetLoadingState::Loaded;
 }
 
+const detail::AssetPtrDataBase* AssetDependencies::pending_dependency() const {
+    for(const auto& d : _deps) {
+        if(d.is_loading()) {
+            return d._data.get();
+        }
+    }
+    return nullptr;
+}
+
+void AssetDependencies::raise_priority(AssetLoadingPriority priority, core::Vector<const detail::AssetPtrDataBase*>& raised) const {
+    for(const auto& d : _deps) {
+        if(d.is_loading() && d._data->priority() < priority) {
+            d._data->set_priority(priority);
+            raised.emplace_back(d._data.get());
+        }
+    }
+}
+
 AssetLoadingErrorType AssetDependencies::error() const {
     for(const auto& d : _deps) {
         if(!d.is_failed()) {
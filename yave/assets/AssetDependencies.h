@@ -41,6 +41,12 @@ class AssetDependencies {
         AssetLoadingState state() const;
         AssetLoadingErrorType error() const;
 
+        // Returns the first dependency that is still loading, if any
+        const detail::AssetPtrDataBase* pending_dependency() const;
+
+        // Raises the priority of the dependencies that are still loading, and appends the raised ones to raised
+        void raise_priority(AssetLoadingPriority priority, core::Vector<const detail::AssetPtrDataBase*>& raised) const;
+
 
     private:
         core::Vector<GenericAssetPtr> _deps;
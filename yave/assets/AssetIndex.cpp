@@ -0,0 +1,175 @@
+/*******************************
+Copyright (c) 2016-2023 Grégoire Angerand
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+**********************************/
+
+#include "AssetIndex.h"
+
+#include <yave/utils/FileSystemModel.h>
+
+#include <y/io2/File.h>
+#include <y/utils/hash.h>
+#include <y/utils/log.h>
+
+namespace yave {
+namespace detail {
+
+AssetStore::Result<core::Span<byte>> check_asset_index_body(core::Span<byte> data, usize header_size, usize body_size, u64 body_hash) {
+    if(data.size() != header_size + body_size) {
+        log_msg("Asset index is corrupted", Log::Error);
+        return core::Err(AssetStore::ErrorType::Unknown);
+    }
+
+    const core::Span<byte> body(data.data() + header_size, body_size);
+
+    ContentHash hash;
+    hash.add(body.data(), body.size());
+    if(hash.hash() != body_hash) {
+        log_msg("Asset index is corrupted", Log::Error);
+        return core::Err(AssetStore::ErrorType::Unknown);
+    }
+
+    return core::Ok(body);
+}
+
+AssetStore::Result<> write_asset_index(const core::String& file_name, core::Span<byte> header, core::Span<byte> entries, core::Span<byte> folders, std::string_view strings) {
+    y_profile();
+
+    const core::String tmp_file = file_name + "_";
+
+    {
+        auto file = io2::File::create(tmp_file);
+        if(!file) {
+            return core::Err(AssetStore::ErrorType::FilesytemError);
+        }
+
+        io2::File& index = file.unwrap();
+        if(!index.write(header.data(), header.size()) ||
+           !index.write(entries.data(), entries.size()) ||
+           !index.write(folders.data(), folders.size()) ||
+           !index.write(strings.data(), strings.size()) ||
+           !index.flush()) {
+            return core::Err(AssetStore::ErrorType::FilesytemError);
+        }
+    }
+
+    if(!FileSystemModel::local_filesystem()->rename(tmp_file, file_name)) {
+        return core::Err(AssetStore::ErrorType::FilesytemError);
+    }
+
+    return core::Ok();
+}
+
+u64 asset_index_body_hash(core::Span<byte> entries, core::Span<byte> folders, std::string_view strings) {
+    ContentHash hash;
+    hash.add(entries.data(), entries.size());
+    hash.add(folders.data(), folders.size());
+    hash.add(strings.data(), strings.size());
+    return hash.hash();
+}
+
+u64 asset_journal_checksum(const void* record, usize record_size, std::string_view name, std::string_view other_name) {
+    ContentHash hash;
+    hash.add(record, record_size);
+    hash.add(name.data(), name.size());
+    hash.add(other_name.data(), other_name.size());
+    return hash.hash();
+}
+
+
+
+void AssetJournal::close() {
+    _file = io2::File();
+    _records = 0;
+}
+
+AssetStore::Result<> AssetJournal::create(const core::String& file_name, u64 checkpoint) {
+    y_profile();
+
+    close();
+
+    auto file = io2::File::create(file_name);
+    if(!file) {
+        return core::Err(AssetStore::ErrorType::FilesytemError);
+    }
+
+    AssetJournalHeader header;
+    header.magic = _magic;
+    header.version = _version;
+    header.checkpoint = checkpoint;
+    if(!file.unwrap().write_one(header) || !file.unwrap().flush()) {
+        return core::Err(AssetStore::ErrorType::FilesytemError);
+    }
+
+    _file = std::move(file.unwrap());
+    return core::Ok();
+}
+
+AssetStore::Result<> AssetJournal::reopen(const core::String& file_name) {
+    auto file = io2::File::open_append(file_name);
+    if(!file) {
+        return core::Err(AssetStore::ErrorType::FilesytemError);
+    }
+
+    _file = std::move(file.unwrap());
+    return core::Ok();
+}
+
+AssetStore::Result<> AssetJournal::append_data(const void* record, usize record_size, std::string_view name, std::string_view other_name) {
+    if(!_file.is_open()) {
+        return core::Err(AssetStore::ErrorType::FilesytemError);
+    }
+
+    if(!_file.write(record, record_size) ||
+       !_file.write(name.data(), name.size()) ||
+       !_file.write(other_name.data(), other_name.size()) ||
+       !_file.flush()) {
+        return core::Err(AssetStore::ErrorType::FilesytemError);
+    }
+
+    ++_records;
+    return core::Ok();
+}
+
+AssetStore::Result<core::Vector<byte>> AssetJournal::read(const core::String& file_name, u64 checkpoint) const {
+    y_profile();
+
+    core::Vector<byte> journal;
+    if(auto file = io2::File::open(file_name); file.is_error() || file.unwrap().read_all(journal).is_error()) {
+        return core::Err(AssetStore::ErrorType::FilesytemError);
+    }
+
+    AssetJournalHeader header;
+    if(journal.size() < sizeof(header)) {
+        return core::Err(AssetStore::ErrorType::Unknown);
+    }
+    std::memcpy(&header, journal.data(), sizeof(header));
+
+    if(header.magic != _magic || header.version != _version || header.checkpoint != checkpoint) {
+        // Written before the last checkpoint
+        return core::Err(AssetStore::ErrorType::Unknown);
+    }
+
+    return core::Ok(std::move(journal));
+}
+
+}
+}
+
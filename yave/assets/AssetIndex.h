@@ -0,0 +1,281 @@
+/*******************************
+Copyright (c) 2016-2023 Grégoire Angerand
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+**********************************/
+#ifndef YAVE_ASSETS_ASSETINDEX_H
+#define YAVE_ASSETS_ASSETINDEX_H
+
+#include "AssetStore.h"
+
+#include <y/core/Vector.h>
+#include <y/core/Span.h>
+#include <y/io2/File.h>
+#include <y/utils/log.h>
+#include <y/utils/format.h>
+
+#include <cstring>
+
+namespace yave {
+namespace detail {
+
+// Binary asset index shared by the asset stores: a Header followed by asset_count Entry,
+// folder_count AssetIndexFolder and string_size bytes of names.
+// Header must have magic, version, asset_count, folder_count, string_size and body_hash members
+// and default its magic and version to those of its layout. Each layout must use its own magic.
+// Entry must have name_offset and name_size members.
+
+struct AssetIndexFolder {
+    u32 name_offset = 0;
+    u32 name_size = 0;
+};
+
+static_assert(sizeof(AssetIndexFolder) == 8);
+
+// Returns the body of the index, or an error if its size or body hash don't match the header
+AssetStore::Result<core::Span<byte>> check_asset_index_body(core::Span<byte> data, usize header_size, usize body_size, u64 body_hash);
+
+// Writes the index to a temporary file before moving it over file_name
+AssetStore::Result<> write_asset_index(const core::String& file_name, core::Span<byte> header, core::Span<byte> entries, core::Span<byte> folders, std::string_view strings);
+
+u64 asset_index_body_hash(core::Span<byte> entries, core::Span<byte> folders, std::string_view strings);
+
+u64 asset_journal_checksum(const void* record, usize record_size, std::string_view name, std::string_view other_name);
+
+
+template<typename Header, typename Entry>
+class AssetIndexReader {
+    public:
+        static AssetStore::Result<AssetIndexReader> parse(core::Span<byte> data) {
+            AssetIndexReader reader;
+            if(data.size() < sizeof(Header)) {
+                log_msg("Asset index is corrupted", Log::Error);
+                return core::Err(AssetStore::ErrorType::Unknown);
+            }
+            std::memcpy(&reader._header, data.data(), sizeof(Header));
+
+            const Header expected;
+            if(reader._header.magic != expected.magic || reader._header.version != expected.version) {
+                log_msg("Asset index has an unsupported version", Log::Error);
+                return core::Err(AssetStore::ErrorType::Unknown);
+            }
+
+            const usize entries_size = usize(reader._header.asset_count) * sizeof(Entry);
+            const usize folders_size = usize(reader._header.folder_count) * sizeof(AssetIndexFolder);
+            const usize body_size = entries_size + folders_size + reader._header.string_size;
+
+            auto body = check_asset_index_body(data, sizeof(Header), body_size, reader._header.body_hash);
+            if(!body) {
+                return core::Err(body.error());
+            }
+
+            reader._entries = body.unwrap().data();
+            reader._folders = reader._entries + entries_size;
+            reader._strings = reinterpret_cast<const char*>(reader._folders + folders_size);
+
+            return core::Ok(reader);
+        }
+
+        const Header& header() const {
+            return _header;
+        }
+
+        Entry entry(usize index) const {
+            y_debug_assert(index < _header.asset_count);
+            Entry entry;
+            std::memcpy(&entry, _entries + index * sizeof(Entry), sizeof(Entry));
+            return entry;
+        }
+
+        AssetIndexFolder folder(usize index) const {
+            y_debug_assert(index < _header.folder_count);
+            AssetIndexFolder folder;
+            std::memcpy(&folder, _folders + index * sizeof(AssetIndexFolder), sizeof(AssetIndexFolder));
+            return folder;
+        }
+
+        // Returns an empty name if the entry points outside of the string table
+        template<typename T>
+        std::string_view name(const T& entry) const {
+            if(usize(entry.name_offset) + entry.name_size > _header.string_size) {
+                return {};
+            }
+            return std::string_view(_strings + entry.name_offset, entry.name_size);
+        }
+
+    private:
+        AssetIndexReader() = default;
+
+        Header _header;
+        const byte* _entries = nullptr;
+        const byte* _folders = nullptr;
+        const char* _strings = nullptr;
+};
+
+template<typename Header, typename Entry>
+class AssetIndexWriter {
+    public:
+        AssetIndexWriter(usize entry_count, usize folder_count) :
+                _entries(core::vector_with_capacity<Entry>(entry_count)),
+                _folders(core::vector_with_capacity<AssetIndexFolder>(folder_count)) {
+        }
+
+        void add_entry(Entry entry, std::string_view name) {
+            entry.name_offset = push_name(name);
+            entry.name_size = u32(name.size());
+            _entries << entry;
+        }
+
+        void add_folder(std::string_view name) {
+            _folders << AssetIndexFolder{push_name(name), u32(name.size())};
+        }
+
+        // Fills the counts and body hash of header
+        AssetStore::Result<> write(const core::String& file_name, Header& header) const {
+            const core::Span<byte> entries(reinterpret_cast<const byte*>(_entries.data()), _entries.size() * sizeof(Entry));
+            const core::Span<byte> folders(reinterpret_cast<const byte*>(_folders.data()), _folders.size() * sizeof(AssetIndexFolder));
+
+            header.asset_count = u32(_entries.size());
+            header.folder_count = u32(_folders.size());
+            header.string_size = u32(_strings.size());
+            header.body_hash = asset_index_body_hash(entries, folders, _strings);
+
+            return write_asset_index(file_name, core::Span<byte>(reinterpret_cast<const byte*>(&header), sizeof(header)), entries, folders, _strings);
+        }
+
+    private:
+        u32 push_name(std::string_view name) {
+            const u32 offset = u32(_strings.size());
+            _strings += name;
+            return offset;
+        }
+
+        core::Vector<Entry> _entries;
+        core::Vector<AssetIndexFolder> _folders;
+        core::String _strings;
+};
+
+
+struct AssetJournalHeader {
+    u32 magic = 0;
+    u32 version = 0;
+    u64 checkpoint = 0;
+};
+
+static_assert(sizeof(AssetJournalHeader) == 16);
+
+// Append-only log of the mutations made since the last index checkpoint, so that small changes don't rewrite the whole index.
+// Records must have name_size, other_name_size and checksum members, and are followed by their names.
+// A journal is only replayed on top of the checkpoint it was started from.
+class AssetJournal {
+    public:
+        AssetJournal(u32 magic, u32 version) : _magic(magic), _version(version) {
+        }
+
+        bool is_open() const {
+            return _file.is_open();
+        }
+
+        usize record_count() const {
+            return _records;
+        }
+
+        void close();
+
+        // Starts an empty journal on top of checkpoint
+        AssetStore::Result<> create(const core::String& file_name, u64 checkpoint);
+
+        // Keeps appending to a journal that has been fully replayed
+        AssetStore::Result<> reopen(const core::String& file_name);
+
+        template<typename Record>
+        AssetStore::Result<> append(Record record, std::string_view name, std::string_view other_name = {}) {
+            record.name_size = u32(name.size());
+            record.other_name_size = u32(other_name.size());
+            record.checksum = checksum(record, name, other_name);
+            return append_data(&record, sizeof(record), name, other_name);
+        }
+
+        // Calls func(record, name, other_name) for every record, in order.
+        // Fails if the journal wasn't started from checkpoint, or if it is damaged (in which case the records before the damage are still replayed).
+        template<typename Record, typename F>
+        AssetStore::Result<> replay(const core::String& file_name, u64 checkpoint, F&& func) {
+            close();
+
+            auto data = read(file_name, checkpoint);
+            y_try(data);
+
+            const core::Vector<byte>& journal = data.unwrap();
+
+            usize offset = sizeof(AssetJournalHeader);
+            while(offset != journal.size()) {
+                Record record;
+                if(journal.size() - offset < sizeof(record)) {
+                    break;
+                }
+                std::memcpy(&record, journal.data() + offset, sizeof(record));
+
+                const usize names_size = usize(record.name_size) + record.other_name_size;
+                if(journal.size() - offset - sizeof(record) < names_size) {
+                    break;
+                }
+
+                const std::string_view names(reinterpret_cast<const char*>(journal.data() + offset + sizeof(record)), names_size);
+                const std::string_view name = names.substr(0, record.name_size);
+                const std::string_view other_name = names.substr(record.name_size);
+                if(checksum(record, name, other_name) != record.checksum) {
+                    break;
+                }
+
+                func(record, name, other_name);
+
+                offset += sizeof(record) + names_size;
+                ++_records;
+            }
+
+            if(offset != journal.size()) {
+                log_msg(fmt("Asset journal is truncated, % operations recovered", _records), Log::Warning);
+                return core::Err(AssetStore::ErrorType::Unknown);
+            }
+
+            return core::Ok();
+        }
+
+    private:
+        template<typename Record>
+        static u64 checksum(Record record, std::string_view name, std::string_view other_name) {
+            record.checksum = 0;
+            return asset_journal_checksum(&record, sizeof(record), name, other_name);
+        }
+
+        AssetStore::Result<> append_data(const void* record, usize record_size, std::string_view name, std::string_view other_name);
+        AssetStore::Result<core::Vector<byte>> read(const core::String& file_name, u64 checkpoint) const;
+
+        io2::File _file;
+        usize _records = 0;
+
+        u32 _magic = 0;
+        u32 _version = 0;
+};
+
+}
+}
+
+#endif // YAVE_ASSETS_ASSETINDEX_H
+
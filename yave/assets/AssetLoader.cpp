@@ -48,6 +48,8 @@ AssetLoader::AssetLoader(const std::shared_ptr<AssetStore>& store, AssetLoadingF
 }
 
 AssetLoader::~AssetLoader() {
+    // Cached assets might hold on to assets of other types
+    clear_cache();
 }
 
 AssetStore& AssetLoader::store() {
@@ -67,6 +69,8 @@ AssetLoadingFlags AssetLoader::loading_flags() const {
 }
 
 void AssetLoader::wait_until_loaded(const GenericAssetPtr& ptr) {
+    // Someone is blocked on it now
+    set_loading_priority(ptr, AssetLoadingPriority::Immediate);
     _thread_pool.wait_until_loaded(ptr);
     y_debug_assert(!ptr.is_loading());
 }
@@ -75,6 +79,59 @@ bool AssetLoader::is_loading() const {
     return _thread_pool.is_processing();
 }
 
+void AssetLoader::set_loading_priority(const GenericAssetPtr& ptr, AssetLoadingPriority priority) {
+    if(ptr.is_loading()) {
+        ptr._data->set_priority(priority);
+        _thread_pool.priorities_changed(ptr._data.get());
+    }
+}
+
+usize AssetLoader::cancelled_jobs() const {
+    return _thread_pool.cancelled_jobs();
+}
+
+AssetLoader::LoadingStats AssetLoader::loading_stats() const {
+    return _thread_pool.stats();
+}
+
+void AssetLoader::set_cache_budget(AssetType type, u64 bytes) {
+    const auto lock = y_profile_unique_lock(_lock);
+    _cache_budgets[type] = bytes;
+    for(const auto& [index, loader] : _loaders) {
+        if(loader->type() == type) {
+            loader->set_cache_budget(bytes);
+        }
+    }
+}
+
+u64 AssetLoader::cache_budget(AssetType type) const {
+    const auto lock = y_profile_unique_lock(_lock);
+    if(const auto it = _cache_budgets.find(type); it != _cache_budgets.end()) {
+        return it->second;
+    }
+    return default_cache_budget;
+}
+
+AssetLoader::CacheStats AssetLoader::cache_stats(AssetType type) const {
+    const auto lock = y_profile_unique_lock(_lock);
+    for(const auto& [index, loader] : _loaders) {
+        if(loader->type() == type) {
+            return loader->cache_stats();
+        }
+    }
+
+    CacheStats stats;
+    stats.budget = cache_budget(type);
+    return stats;
+}
+
+void AssetLoader::clear_cache() {
+    const auto lock = y_profile_unique_lock(_lock);
+    for(const auto& [index, loader] : _loaders) {
+        loader->clear_cache();
+    }
+}
+
 core::Result<AssetId> AssetLoader::load_or_import(std::string_view name, std::string_view import_from, AssetType type) {
     if(auto id = _store->id(name)) {
         return id;
@@ -32,6 +32,7 @@ SOFTWARE.
 
 #include <typeindex>
 #include <future>
+#include <list>
 
 namespace yave {
 
@@ -40,10 +41,23 @@ class AssetLoadingContext;
 class AssetLoader : NonMovable {
     public:
          using ErrorType = AssetLoadingErrorType;
+         using LoadingStats = AssetLoadingThreadPool::Stats;
 
          template<typename T>
          using Result = core::Result<AssetPtr<T>, ErrorType>;
 
+         struct CacheStats {
+             // Loads served by the cache after every other owner had released the asset
+             u64 hits = 0;
+             // Loads that had to go through the store
+             u64 misses = 0;
+             u64 evictions = 0;
+
+             usize cached_assets = 0;
+             u64 cached_bytes = 0;
+             u64 budget = 0;
+         };
+
     private:
         using LoadingJob = AssetLoadingThreadPool::LoadingJob;
 
@@ -55,6 +69,10 @@ class AssetLoader : NonMovable {
 
                 virtual AssetType type() const = 0;
 
+                virtual void set_cache_budget(u64 bytes) = 0;
+                virtual CacheStats cache_stats() const = 0;
+                virtual void clear_cache() = 0;
+
             protected:
                 LoaderBase(AssetLoader* parent);
 
@@ -76,30 +94,64 @@ class AssetLoader : NonMovable {
             using LoadFrom = typename traits::load_from;
 
             public:
+                using ReadFunc = std::function<core::Result<LoadFrom>(io2::Reader&)>;
+
                 Loader(AssetLoader* parent);
                 ~Loader();
 
                 inline AssetPtr<T> load(AssetId id);
-                inline AssetPtr<T> load_async(AssetId id);
+                inline AssetPtr<T> load_async(AssetId id, AssetLoadingPriority priority);
 
                 inline AssetPtr<T> reload(const AssetPtr<T>& ptr);
+                inline AssetPtr<T> replace(const AssetPtr<T>& ptr, T asset);
+                inline AssetPtr<T> replace_async(const AssetPtr<T>& ptr, ReadFunc read, AssetLoadingPriority priority);
 
-                AssetType type() const {
+                AssetType type() const override {
                     return traits::type;
                 }
 
+                inline void set_cache_budget(u64 bytes) override;
+                inline CacheStats cache_stats() const override;
+                inline void clear_cache() override;
+
             private:
+                struct CachedAsset {
+                    std::shared_ptr<Data> data;
+                    u64 byte_size = 0;
+                };
+
+                using CacheList = std::list<CachedAsset>;
+
                 [[nodiscard]] inline bool find_ptr(AssetPtr<T>& ptr);
                 inline std::unique_ptr<LoadingJob> create_loading_job(AssetPtr<T> ptr);
+                inline std::unique_ptr<LoadingJob> create_replacing_job(AssetPtr<T> ptr, ReadFunc read);
+
+                inline void swap_in(const std::shared_ptr<Data>& data);
+
+                [[nodiscard]] inline bool try_cancel(const std::shared_ptr<Data>& data);
+
+                inline void add_to_cache(const std::shared_ptr<Data>& data, u64 byte_size);
+                inline void evict(u64 budget, core::Vector<std::shared_ptr<Data>>& evicted);
 
                 core::FlatHashMap<AssetId, WeakAssetPtr> _loaded;
-                std::recursive_mutex _lock;
+
+                // Most recently used first
+                CacheList _cache;
+                core::FlatHashMap<AssetId, typename CacheList::iterator> _cache_index;
+                u64 _cache_bytes = 0;
+                u64 _cache_budget = 0;
+                CacheStats _cache_stats;
+
+                mutable std::recursive_mutex _lock;
         };
 
    public:
         Y_TODO(make configurable)
         static constexpr bool fail_on_partial_deser = false;
 
+        // Per asset type, in serialized bytes
+        static constexpr u64 default_cache_budget = 64 * 1024 * 1024;
+
         AssetLoader(const std::shared_ptr<AssetStore>& store, AssetLoadingFlags flags = AssetLoadingFlags::None, usize concurency = 1);
         ~AssetLoader();
 
@@ -114,6 +166,22 @@ class AssetLoader : NonMovable {
 
         bool is_loading() const;
 
+        // Only affects assets that are still loading
+        void set_loading_priority(const GenericAssetPtr& ptr, AssetLoadingPriority priority);
+
+        // Number of loads dropped because nothing referenced the asset anymore
+        usize cancelled_jobs() const;
+
+        // Totals since the loader was created, diff two snapshots to measure a set of loads
+        LoadingStats loading_stats() const;
+
+        // Released assets are kept alive until their type goes over budget.
+        // Assets are accounted for by the size of their serialized data.
+        void set_cache_budget(AssetType type, u64 bytes);
+        u64 cache_budget(AssetType type) const;
+        CacheStats cache_stats(AssetType type) const;
+        void clear_cache();
+
         template<typename T>
         inline Result<T> load_res(AssetId id);
         template<typename T>
@@ -122,11 +190,21 @@ class AssetLoader : NonMovable {
         template<typename T>
         inline AssetPtr<T> load(AssetId id);
         template<typename T>
-        inline AssetPtr<T> load_async(AssetId id);
+        inline AssetPtr<T> load_async(AssetId id, AssetLoadingPriority priority = AssetLoadingPriority::Normal);
 
         template<typename T>
         inline AssetPtr<T> reload(const AssetPtr<T>& ptr);
 
+        // Swaps a loaded asset with another version of it (a higher resolution texture for example),
+        // existing AssetPtrs will pick it up on flush_reload
+        template<typename T>
+        inline AssetPtr<T> replace(const AssetPtr<T>& ptr, T asset);
+
+        // Like replace, but the new version is built on the loading threads by calling read on the asset's data.
+        // It is swapped in once loaded. The job is dropped if the returned AssetPtr is released before it completes.
+        template<typename T, typename F>
+        inline AssetPtr<T> replace_async(const AssetPtr<T>& ptr, F&& read, AssetLoadingPriority priority = AssetLoadingPriority::Low);
+
         template<typename T>
         inline Result<T> import(std::string_view name, std::string_view import_from);
 
@@ -147,7 +225,9 @@ class AssetLoader : NonMovable {
         core::FlatHashMap<std::type_index, std::unique_ptr<LoaderBase>> _loaders;
         std::shared_ptr<AssetStore> _store;
 
-        std::recursive_mutex _lock;
+        core::FlatHashMap<AssetType, u64> _cache_budgets;
+
+        mutable std::recursive_mutex _lock;
         AssetLoadingThreadPool _thread_pool;
 
         std::atomic<AssetLoadingFlags> _loading_flags = AssetLoadingFlags::None;
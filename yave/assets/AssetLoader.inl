@@ -93,11 +93,13 @@ core::Result<core::String> AssetPtr<T>::name() const {
 template<typename T>
 AssetLoader::Loader<T>::Loader(AssetLoader* parent) : LoaderBase(parent) {
     y_always_assert(parent, "Parent should not be null.");
+    _cache_budget = parent->cache_budget(traits::type);
 }
 
 template<typename T>
 AssetLoader::Loader<T>::~Loader<T>() {
     y_profile();
+    clear_cache();
     const auto lock = y_profile_unique_lock(_lock);
     for(auto&& [id, ptr] : _loaded) {
         if(!ptr.expired()) {
@@ -117,17 +119,115 @@ bool AssetLoader::Loader<T>::find_ptr(AssetPtr<T>& ptr) {
     auto& weak = _loaded[id];
     ptr = weak.lock();
     if(ptr._data) {
+        if(const auto it = _cache_index.find(id); it != _cache_index.end()) {
+            // Only owned by the cache and by ptr: we would have reloaded it without the cache
+            if(ptr._data.use_count() == 2) {
+                ++_cache_stats.hits;
+            }
+            _cache.splice(_cache.begin(), _cache, it->second);
+        }
         return true;
     }
+    ++_cache_stats.misses;
     weak = (ptr = std::make_shared<Data>(id, parent()))._data;
     return false;
 }
 
+template<typename T>
+bool AssetLoader::Loader<T>::try_cancel(const std::shared_ptr<Data>& data) {
+    const auto lock = y_profile_unique_lock(_lock);
+
+    // New references can only come from _loaded, which we guard:
+    // if the job holds the only one, no one can be waiting on the asset.
+    if(data.use_count() != 1) {
+        return false;
+    }
+
+    if(const auto it = _loaded.find(data->id); it != _loaded.end()) {
+        const WeakAssetPtr& weak = it->second;
+        if(!weak.owner_before(data) && !data.owner_before(weak)) {
+            _loaded.erase(data->id);
+        }
+    }
+
+    return true;
+}
+
+template<typename T>
+void AssetLoader::Loader<T>::add_to_cache(const std::shared_ptr<Data>& data, u64 byte_size) {
+    // Declared before the lock so evicted assets are destroyed after it is released
+    core::Vector<std::shared_ptr<Data>> evicted;
+
+    const auto lock = y_profile_unique_lock(_lock);
+
+    if(const auto it = _cache_index.find(data->id); it != _cache_index.end()) {
+        _cache_bytes -= it->second->byte_size;
+        evicted.emplace_back(std::move(it->second->data));
+        _cache.erase(it->second);
+        _cache_index.erase(data->id);
+    }
+
+    if(byte_size > _cache_budget) {
+        return;
+    }
+
+    _cache.push_front(CachedAsset{data, byte_size});
+    _cache_index[data->id] = _cache.begin();
+    _cache_bytes += byte_size;
+
+    evict(_cache_budget, evicted);
+}
+
+template<typename T>
+void AssetLoader::Loader<T>::evict(u64 budget, core::Vector<std::shared_ptr<Data>>& evicted) {
+    while(_cache_bytes > budget) {
+        y_debug_assert(!_cache.empty());
+
+        CachedAsset& last = _cache.back();
+        _cache_bytes -= last.byte_size;
+        _cache_index.erase(last.data->id);
+        evicted.emplace_back(std::move(last.data));
+        _cache.pop_back();
+
+        ++_cache_stats.evictions;
+    }
+}
+
+template<typename T>
+void AssetLoader::Loader<T>::set_cache_budget(u64 bytes) {
+    core::Vector<std::shared_ptr<Data>> evicted;
+
+    const auto lock = y_profile_unique_lock(_lock);
+    _cache_budget = bytes;
+    evict(_cache_budget, evicted);
+}
+
+template<typename T>
+AssetLoader::CacheStats AssetLoader::Loader<T>::cache_stats() const {
+    const auto lock = y_profile_unique_lock(_lock);
+
+    CacheStats stats = _cache_stats;
+    stats.cached_assets = _cache.size();
+    stats.cached_bytes = _cache_bytes;
+    stats.budget = _cache_budget;
+    return stats;
+}
+
+template<typename T>
+void AssetLoader::Loader<T>::clear_cache() {
+    CacheList cache;
+
+    const auto lock = y_profile_unique_lock(_lock);
+    std::swap(cache, _cache);
+    _cache_index.make_empty();
+    _cache_bytes = 0;
+}
+
 
 template<typename T>
 AssetPtr<T> AssetLoader::Loader<T>::load(AssetId id) {
     y_profile();
-    auto ptr = load_async(id);
+    auto ptr = load_async(id, AssetLoadingPriority::Immediate);
     parent()->wait_until_loaded(ptr);
     y_debug_assert(!ptr.is_loading());
     return ptr;
@@ -135,11 +235,14 @@ AssetPtr<T> AssetLoader::Loader<T>::load(AssetId id) {
 }
 
 template<typename T>
-AssetPtr<T> AssetLoader::Loader<T>::load_async(AssetId id) {
+AssetPtr<T> AssetLoader::Loader<T>::load_async(AssetId id, AssetLoadingPriority priority) {
     y_profile();
     AssetPtr<T> ptr(id);
     if(!find_ptr(ptr)) {
+        ptr._data->set_priority(priority);
         parent()->_thread_pool.add_loading_job(create_loading_job(ptr));
+    } else if(ptr.is_loading() && ptr._data->priority() < priority) {
+        parent()->set_loading_priority(ptr, priority);
     }
     return ptr;
 }
@@ -173,11 +276,48 @@ AssetPtr<T> AssetLoader::Loader<T>::reload(const AssetPtr<T>& ptr) {
     return reloaded;
 }
 
+template<typename T>
+AssetPtr<T> AssetLoader::Loader<T>::replace(const AssetPtr<T>& ptr, T asset) {
+    y_profile();
+
+    const AssetId id = ptr.id();
+    y_always_assert(id != AssetId::invalid_id(), "Can not replace asset without ID");
+
+    AssetPtr<T> replaced(id, parent(), std::move(asset));
+    swap_in(replaced._data);
+    return replaced;
+}
+
+template<typename T>
+AssetPtr<T> AssetLoader::Loader<T>::replace_async(const AssetPtr<T>& ptr, ReadFunc read, AssetLoadingPriority priority) {
+    y_profile();
+
+    const AssetId id = ptr.id();
+    y_always_assert(id != AssetId::invalid_id(), "Can not replace asset without ID");
+
+    AssetPtr<T> replaced(id, parent());
+    replaced._data->set_priority(priority);
+    parent()->_thread_pool.add_loading_job(create_replacing_job(replaced, std::move(read)));
+    return replaced;
+}
+
+template<typename T>
+void AssetLoader::Loader<T>::swap_in(const std::shared_ptr<Data>& data) {
+    y_debug_assert(data->is_loaded());
+
+    const auto lock = y_profile_unique_lock(_lock);
+    auto& weak = _loaded[data->id];
+    if(auto orig = weak.lock()) {
+        orig->set_reloaded(data);
+    }
+    weak = data;
+}
+
 template<typename T>
 std::unique_ptr<AssetLoader::LoadingJob> AssetLoader::Loader<T>::create_loading_job(AssetPtr<T> ptr) {
     class Job : public LoadingJob {
         public:
-            Job(AssetLoader* loader, std::shared_ptr<Data> data) : LoadingJob(loader), _data(std::move(data)) {
+            Job(Loader<T>* loader, std::shared_ptr<Data> data) : LoadingJob(loader->parent()), _loader(loader), _data(std::move(data)) {
                 y_always_assert(_data, "Invalid asset");
                 y_profile_msg(fmt_c_str("Adding loading request for %", asset_name()));
             }
@@ -191,9 +331,11 @@ std::unique_ptr<AssetLoader::LoadingJob> AssetLoader::Loader<T>::create_loading_
                 y_always_assert(_data->loader() == parent(), "Mismatched AssetLoaders");
                 y_always_assert(id != AssetId::invalid_id(), "Invalid asset ID");
 
-                if(auto reader = parent()->store().data(id)) {
+                if(auto reader = read_data(id)) {
                     y_profile_zone("deserializing");
 
+                    _byte_size = reader.unwrap()->remaining();
+
                     const serde3::Result res = serde3::ReadableArchive(*reader.unwrap()).deserialize(_load_from);
 
                     if(res.is_error() || (fail_on_partial_deser && res.unwrap() == serde3::Success::Partial)) {
@@ -227,6 +369,7 @@ std::unique_ptr<AssetLoader::LoadingJob> AssetLoader::Loader<T>::create_loading_
                 y_profile_zone_arg("finalizing", fmt_c_str("%", asset_name()));
                 y_debug_assert(_data->is_loading());
                 _data->finalize_loading(std::move(_load_from));
+                _loader->add_to_cache(_data, _byte_size);
                 y_profile_msg(fmt_c_str("finished loading %", asset_name()));
             }
 
@@ -239,9 +382,23 @@ std::unique_ptr<AssetLoader::LoadingJob> AssetLoader::Loader<T>::create_loading_
                 log_msg(fmt("Unable to load %: failed to load dependency", asset_name()), Log::Error);
             }
 
+            const detail::AssetPtrDataBase* asset() const override {
+                return _data.get();
+            }
+
+            bool try_cancel() override {
+                return _loader->try_cancel(_data);
+            }
+
+            bool reads_whole_data() const override {
+                return !reads_partial_data_v<LoadFrom>;
+            }
+
         private:
+            Loader<T>* _loader = nullptr;
             std::shared_ptr<Data> _data;
             LoadFrom _load_from;
+            u64 _byte_size = 0;
 
             core::String asset_name() const {
                 return stringify_id(AssetPtr<T>(_data).id());
@@ -253,7 +410,83 @@ std::unique_ptr<AssetLoader::LoadingJob> AssetLoader::Loader<T>::create_loading_
             }
     };
 
-    return std::make_unique<Job>(parent(), std::move(ptr._data));
+    return std::make_unique<Job>(this, std::move(ptr._data));
+}
+
+template<typename T>
+std::unique_ptr<AssetLoader::LoadingJob> AssetLoader::Loader<T>::create_replacing_job(AssetPtr<T> ptr, ReadFunc read) {
+    class Job : public LoadingJob {
+        public:
+            Job(Loader<T>* loader, std::shared_ptr<Data> data, ReadFunc read) : LoadingJob(loader->parent()), _loader(loader), _data(std::move(data)), _read(std::move(read)) {
+                y_always_assert(_data, "Invalid asset");
+                y_always_assert(_read, "Invalid read function");
+            }
+
+            core::Result<void> read() override {
+                y_profile_zone_arg("replacing", fmt_c_str("%", stringify_id(_data->id)));
+
+                y_always_assert(_data->is_loading(), "Asset is not in a loading state");
+
+                auto reader = read_data(_data->id);
+                if(!reader) {
+                    _data->set_failed(ErrorType::InvalidID);
+                    log_msg(fmt("Unable to replace %: invalid ID", stringify_id(_data->id)), Log::Error);
+                    return core::Err();
+                }
+
+                _byte_size = reader.unwrap()->remaining();
+
+                auto loaded = _read(*reader.unwrap());
+                if(!loaded) {
+                    _data->set_failed(ErrorType::InvalidData);
+                    log_msg(fmt("Unable to replace %: invalid data", stringify_id(_data->id)), Log::Error);
+                    return core::Err();
+                }
+
+                _load_from = std::move(loaded.unwrap());
+                return core::Ok();
+            }
+
+            void finalize() override {
+                if(_data->is_failed()) {
+                    return;
+                }
+
+                y_profile_zone_arg("finalizing replacement", fmt_c_str("%", stringify_id(_data->id)));
+                _data->finalize_loading(std::move(_load_from));
+
+                // The cache should hold the latest version, or it would keep the replaced one alive
+                _loader->add_to_cache(_data, _byte_size);
+                _loader->swap_in(_data);
+            }
+
+            void set_dependencies_failed() override {
+                if(!_data->is_failed()) {
+                    _data->set_failed(AssetLoadingErrorType::FailedDependency);
+                }
+            }
+
+            const detail::AssetPtrDataBase* asset() const override {
+                return _data.get();
+            }
+
+            bool try_cancel() override {
+                return _loader->try_cancel(_data);
+            }
+
+            bool reads_whole_data() const override {
+                return false;
+            }
+
+        private:
+            Loader<T>* _loader = nullptr;
+            std::shared_ptr<Data> _data;
+            ReadFunc _read;
+            LoadFrom _load_from;
+            u64 _byte_size = 0;
+    };
+
+    return std::make_unique<Job>(this, std::move(ptr._data), std::move(read));
 }
 
 
@@ -286,8 +519,8 @@ AssetPtr<T> AssetLoader::load(AssetId id) {
 }
 
 template<typename T>
-AssetPtr<T> AssetLoader::load_async(AssetId id) {
-    return loader_for_type<T>().load_async(id);
+AssetPtr<T> AssetLoader::load_async(AssetId id, AssetLoadingPriority priority) {
+    return loader_for_type<T>().load_async(id, priority);
 }
 
 
@@ -296,6 +529,16 @@ AssetPtr<T> AssetLoader::reload(const AssetPtr<T>& ptr) {
     return loader_for_type<T>().reload(ptr);
 }
 
+template<typename T>
+AssetPtr<T> AssetLoader::replace(const AssetPtr<T>& ptr, T asset) {
+    return loader_for_type<T>().replace(ptr, std::move(asset));
+}
+
+template<typename T, typename F>
+AssetPtr<T> AssetLoader::replace_async(const AssetPtr<T>& ptr, F&& read, AssetLoadingPriority priority) {
+    return loader_for_type<T>().replace_async(ptr, y_fwd(read), priority);
+}
+
 template<typename T>
 AssetLoader::Result<T> AssetLoader::import(std::string_view name, std::string_view import_from) {
     return load<T>(load_or_import(name, import_from, AssetTraits<T>::type));
@@ -337,7 +580,7 @@ AssetPtr<T> AssetLoadingContext::load(AssetId id) {
 
 template<typename T>
 AssetPtr<T> AssetLoadingContext::load_async(AssetId id) {
-    auto ptr = _parent->load_async<T>(id);
+    auto ptr = _parent->load_async<T>(id, _priority);
     _dependencies.add_dependency(ptr);
     return ptr;
 }
@@ -41,5 +41,13 @@ AssetLoader* AssetLoadingContext::parent() const {
     return _parent;
 }
 
+AssetLoadingPriority AssetLoadingContext::priority() const {
+    return _priority;
+}
+
+void AssetLoadingContext::set_priority(AssetLoadingPriority priority) {
+    _priority = priority;
+}
+
 }
 
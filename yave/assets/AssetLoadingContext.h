@@ -40,6 +40,10 @@ class AssetLoadingContext {
         const AssetDependencies& dependencies() const;
         AssetLoader* parent() const;
 
+        // Dependencies are loaded with the priority of the asset that needs them
+        AssetLoadingPriority priority() const;
+        void set_priority(AssetLoadingPriority priority);
+
     private:
         template<typename T>
         friend class Loader;
@@ -48,6 +52,7 @@ class AssetLoadingContext {
 
         AssetLoader* _parent = nullptr;
         AssetDependencies _dependencies;
+        AssetLoadingPriority _priority = AssetLoadingPriority::Normal;
 };
 
 }
@@ -25,10 +25,13 @@ SOFTWARE.
 #include "AssetLoader.h"
 
 #include <y/concurrent/concurrent.h>
+#include <y/io2/Buffer.h>
 
 #include <y/utils/log.h>
 #include <y/utils/format.h>
 
+#include <algorithm>
+
 namespace yave {
 
 AssetLoadingThreadPool::LoadingJob::~LoadingJob() {
@@ -49,7 +52,69 @@ AssetLoadingContext& AssetLoadingThreadPool::LoadingJob::loading_context() {
     return _ctx;
 }
 
-AssetLoadingThreadPool::AssetLoadingThreadPool(AssetLoader* parent, usize concurency) : _parent(parent) {
+AssetStore::Result<io2::ReaderPtr> AssetLoadingThreadPool::LoadingJob::read_data(AssetId id) {
+    if(_fetched_data) {
+        return core::Ok(std::move(_fetched_data));
+    }
+
+    core::Chrono chrono;
+    auto data = parent()->store().data(id);
+
+    _read_io_ns = chrono.elapsed().to_nanos();
+    _io_ns = _read_io_ns;
+    if(data) {
+        _read_bytes = data.unwrap()->remaining();
+    }
+
+    return data;
+}
+
+
+
+class AssetLoadingThreadPool::FetchRequest final : public io2::AsyncFileReader::Request {
+    static_assert(AssetStore::DataLocation::until_end == Request::until_end);
+
+    public:
+        FetchRequest(AssetLoadingThreadPool* pool, std::unique_ptr<LoadingJob> job, const AssetStore::DataLocation& location) :
+                Request(location.file_name, location.offset, location.size),
+                _pool(pool),
+                _job(std::move(job)) {
+        }
+
+        void done(core::Result<core::Vector<byte>> data) override {
+            _job->_io_ns = _chrono.elapsed().to_nanos();
+
+            // On failure the job reads from the store, which will report the error
+            io2::ReaderPtr reader;
+            if(data) {
+                _job->_read_bytes = data.unwrap().size();
+                reader = std::make_unique<io2::Buffer>(std::move(data.unwrap()));
+
+                if(io2::CompressedReader::is_compressed(*reader)) {
+                    if(auto compressed = io2::CompressedReader::open(std::move(reader))) {
+                        _job->_compressed_data = compressed.unwrap().get();
+                        reader = std::move(compressed.unwrap());
+                    }
+                }
+            }
+            _pool->push_fetched_job(std::move(_job), std::move(reader));
+        }
+
+    private:
+        AssetLoadingThreadPool* _pool = nullptr;
+        std::unique_ptr<LoadingJob> _job;
+        core::Chrono _chrono;
+};
+
+
+
+AssetLoadingThreadPool::AssetLoadingThreadPool(AssetLoader* parent, usize concurency) :
+        _loading_jobs(job_queue_capacity),
+        _finalize_jobs(job_queue_capacity),
+        _fetched_jobs(max_fetching_jobs),
+        _async_reader(std::make_unique<io2::AsyncFileReader>(max_fetching_jobs)),
+        _parent(parent) {
+
     _threads = core::vector_with_capacity<std::thread>(concurency);
     for(usize i = 0; i != concurency; ++i) {
         _threads.emplace_back([this] {
@@ -60,96 +125,541 @@ AssetLoadingThreadPool::AssetLoadingThreadPool(AssetLoader* parent, usize concur
 }
 
 AssetLoadingThreadPool::~AssetLoadingThreadPool() {
-    {
-        _run = false;
-        const auto lock = y_profile_unique_lock(_lock);
-        _condition.notify_all();
-    }
+    _run = false;
+    _loading_jobs.close();
 
     for(auto& thread : _threads) {
         thread.join();
     }
+
+    // Waits for in flight reads, which push into _fetched_jobs
+    _async_reader = nullptr;
 }
 
 void AssetLoadingThreadPool::wait_until_loaded(const GenericAssetPtr& ptr) {
     y_profile();
     while(ptr.is_loading()) {
-        process_one(y_profile_unique_lock(_lock));
+        if(!process_one()) {
+            std::this_thread::yield();
+        }
     }
 }
 
 void AssetLoadingThreadPool::add_loading_job(std::unique_ptr<LoadingJob> job) {
+    job->_sequence = _next_sequence++;
+    if(!_loading_jobs.try_push(std::move(job))) {
+        // Queue is full: read the job on this thread rather than blocking on the loading threads
+        y_profile_zone("loading queue full");
+        ++_processing;
+        y_defer(--_processing);
+        read_one(std::move(job));
+    }
+}
+
+void AssetLoadingThreadPool::priorities_changed(const detail::AssetPtrDataBase* asset) {
     {
-        const auto lock = y_profile_unique_lock(_lock);
-        _loading_jobs.emplace_back(std::move(job));
+        // Dependencies still queued are re-sorted by the loading threads, but jobs parked on a dependency
+        // only get picked up again once it is loaded: raise what they wait on as well
+        const auto lock = y_profile_unique_lock(_waiting_lock);
+        core::Vector<const detail::AssetPtrDataBase*> assets;
+        assets.emplace_back(asset);
+        raise_waiting_priorities(assets);
     }
-    _condition.notify_one();
+
+    _priorities_changed = true;
 }
 
 bool AssetLoadingThreadPool::is_processing() const {
-    return _processing != 0;
+    return _processing != 0 || _fetching != 0;
+}
+
+usize AssetLoadingThreadPool::cancelled_jobs() const {
+    return _cancelled;
+}
+
+static core::Duration duration_from_nanos(u64 ns) {
+    return core::Duration(ns / 1'000'000'000, u32(ns % 1'000'000'000));
 }
 
-void AssetLoadingThreadPool::process_one(std::unique_lock<std::mutex> lock) {
+AssetLoadingThreadPool::Stats AssetLoadingThreadPool::stats() const {
+    Stats stats;
+    stats.loaded_assets = _loaded_assets;
+    stats.failed_assets = _failed_assets;
+    stats.bytes = _read_bytes;
+    stats.io_time = duration_from_nanos(_io_ns);
+    stats.deserialize_time = duration_from_nanos(_deserialize_ns);
+    stats.finalize_time = duration_from_nanos(_finalize_ns);
+    return stats;
+}
+
+static void finalize_job(AssetLoadingThreadPool::LoadingJob& job, AssetLoadingState state) {
+    y_debug_assert(state != AssetLoadingState::NotLoaded);
+    if(state == AssetLoadingState::Loaded) {
+        job.finalize();
+    } else if(state == AssetLoadingState::Failed) {
+        job.set_dependencies_failed();
+    }
+}
+
+bool AssetLoadingThreadPool::process_one() {
     y_profile();
-    y_debug_assert(lock.owns_lock());
 
     ++_processing;
     y_defer(--_processing);
 
-    {
-        y_profile_zone("finalizing loop");
-        for(auto it = _finalize_jobs.begin(); it != _finalize_jobs.end(); ++it) {
-            const AssetLoadingState state = (*it)->dependencies().state();
-            if(state != AssetLoadingState::NotLoaded) {
-                auto job = std::move(*it);
-                _finalize_jobs.erase(it);
-                lock.unlock();
-
-                if(state == AssetLoadingState::Loaded) {
-                    job->finalize();
-                } else if(state == AssetLoadingState::Failed) {
-                    job->set_dependencies_failed();
+    if(finalize_one()) {
+        return true;
+    }
+
+    if(help_decompress()) {
+        return true;
+    }
+
+    if(read_fetched_one()) {
+        return true;
+    }
+
+    return can_start_loading() && start_loading();
+}
+
+bool AssetLoadingThreadPool::finalize_one() {
+    y_profile_zone("finalizing loop");
+
+    // Jobs only get here once all their dependencies are done
+    std::unique_ptr<LoadingJob> job;
+    if(!_finalize_jobs.try_pop(job) && _finalize_overflow_size) {
+        const auto lock = y_profile_unique_lock(_overflow_lock);
+        if(!_finalize_overflow.empty()) {
+            job = std::move(_finalize_overflow.front());
+            _finalize_overflow.pop_front();
+            --_finalize_overflow_size;
+        }
+    }
+
+    if(!job) {
+        return false;
+    }
+
+    if(job->try_cancel()) {
+        ++_cancelled;
+        return true;
+    }
+
+    const AssetLoadingState state = job->dependencies().state();
+    y_debug_assert(state != AssetLoadingState::NotLoaded);
+    finalize_and_notify(std::move(job), state);
+
+    return true;
+}
+
+bool AssetLoadingThreadPool::read_fetched_one() {
+    std::unique_ptr<LoadingJob> job;
+    if(!_fetched_jobs.try_pop(job)) {
+        return false;
+    }
+
+    --_fetching;
+
+    // Keep the disk busy while this one is deserialized
+    if(can_start_loading()) {
+        start_loading();
+    }
+
+    read_one(std::move(job));
+    return true;
+}
+
+bool AssetLoadingThreadPool::start_loading() {
+    y_profile_zone("start loading");
+
+    const auto reserve_fetch = [this] {
+        if(_fetch_unsupported) {
+            return false;
+        }
+        if(_fetching++ < max_fetching_jobs) {
+            return true;
+        }
+        --_fetching;
+        return false;
+    };
+
+    core::Vector<std::unique_ptr<io2::AsyncFileReader::Request>> requests;
+    std::unique_ptr<LoadingJob> read_here;
+    bool started = false;
+
+    while(!read_here) {
+        const bool fetch = reserve_fetch();
+        if(!fetch && started) {
+            break;
+        }
+
+        std::unique_ptr<LoadingJob> job = next_loading_job();
+        if(!job) {
+            if(fetch) {
+                --_fetching;
+            }
+            break;
+        }
+
+        started = true;
+
+        if(job->try_cancel()) {
+            ++_cancelled;
+            if(fetch) {
+                --_fetching;
+            }
+            continue;
+        }
+
+        if(fetch) {
+            if(job->reads_whole_data()) {
+                auto location = _parent->store().data_location(job->asset()->id);
+                if(location) {
+                    requests.emplace_back(std::make_unique<FetchRequest>(this, std::move(job), location.unwrap()));
+                    continue;
+                }
+
+                if(location.error() == AssetStore::ErrorType::UnsupportedOperation) {
+                    _fetch_unsupported = true;
                 }
-                _condition.notify_all();
-                return;
+            }
+            --_fetching;
+        }
+
+        // The store can't tell where the data is, the job reads its data partially, or all fetch slots are taken: read it on this thread
+        read_here = std::move(job);
+    }
+
+    _async_reader->submit(std::move(requests));
+
+    if(read_here) {
+        read_one(std::move(read_here));
+    }
+
+    return started;
+}
+
+void AssetLoadingThreadPool::push_fetched_job(std::unique_ptr<LoadingJob> job, io2::ReaderPtr data) {
+    job->_fetched_data = std::move(data);
+
+    // _fetching bounds the number of jobs in the queue
+    const bool pushed = _fetched_jobs.try_push(std::move(job));
+    y_always_assert(pushed, "Fetched job queue is full");
+
+    _loading_jobs.wake_all();
+}
+
+void AssetLoadingThreadPool::decompress(io2::CompressedReader& reader) {
+    y_profile();
+
+    if(reader.block_count() <= 1) {
+        return;
+    }
+
+    {
+        const auto lock = y_profile_unique_lock(_decompression_lock);
+        _decompressions.emplace_back(SharedDecompression{&reader, 0});
+        ++_decompression_count;
+    }
+
+    _loading_jobs.wake_all();
+
+    reader.decompress_blocks();
+
+    {
+        std::unique_lock lock(_decompression_lock);
+        const auto entry = [&] {
+            return std::find_if(_decompressions.begin(), _decompressions.end(), [&](const SharedDecompression& d) { return d.reader == &reader; });
+        };
+
+        _decompression_done.wait(lock, [&] { return entry()->helpers == 0; });
+        _decompressions.erase_unordered(entry());
+        --_decompression_count;
+    }
+
+    // Blocks that failed will fail the read
+}
+
+bool AssetLoadingThreadPool::help_decompress() {
+    if(!has_decompression_blocks()) {
+        return false;
+    }
+
+    y_profile();
+
+    io2::CompressedReader* reader = nullptr;
+
+    {
+        const auto lock = y_profile_unique_lock(_decompression_lock);
+        for(SharedDecompression& decompression : _decompressions) {
+            if(decompression.reader->has_pending_blocks()) {
+                reader = decompression.reader;
+                ++decompression.helpers;
+                break;
+            }
+        }
+    }
+
+    if(!reader) {
+        return false;
+    }
+
+    reader->decompress_blocks();
+
+    {
+        const auto lock = y_profile_unique_lock(_decompression_lock);
+        for(SharedDecompression& decompression : _decompressions) {
+            if(decompression.reader == reader) {
+                --decompression.helpers;
+                break;
             }
         }
     }
 
-    y_debug_assert(lock.owns_lock());
+    _decompression_done.notify_all();
+
+    return true;
+}
+
+void AssetLoadingThreadPool::read_one(std::unique_ptr<LoadingJob> job) {
+    y_profile_zone("load one");
+
+    if(job->try_cancel()) {
+        ++_cancelled;
+        return;
+    }
+
+    // Dependencies requested while reading inherit the priority of the asset
+    job->_ctx.set_priority(job->asset()->priority());
 
-    if(!_loading_jobs.empty()) {
-        y_profile_zone("load one");
-        auto job = std::move(_loading_jobs.front());
-        _loading_jobs.pop_front();
-        lock.unlock();
+    core::Chrono chrono;
+
+    if(job->_compressed_data) {
+        decompress(*job->_compressed_data);
+        job->_compressed_data = nullptr;
+    }
 
-        if(job->read()) {
-            y_profile_zone("post read");
-            const AssetLoadingState state = job->dependencies().state();
-            if(state != AssetLoadingState::NotLoaded) {
-                if(state == AssetLoadingState::Loaded) {
-                    job->finalize();
-                } else if(state == AssetLoadingState::Failed) {
-                    job->set_dependencies_failed();
+    const bool read = job->read().is_ok();
+
+    {
+        const u64 read_ns = chrono.elapsed().to_nanos();
+        _deserialize_ns += read_ns - std::min(read_ns, job->_read_io_ns);
+        _io_ns += job->_io_ns;
+        _read_bytes += job->_read_bytes;
+    }
+
+    if(read) {
+        y_profile_zone("post read");
+        const AssetLoadingState state = job->dependencies().state();
+        if(state != AssetLoadingState::NotLoaded) {
+            finalize_and_notify(std::move(job), state);
+        } else {
+            wait_for_dependencies(std::move(job));
+        }
+    } else {
+        // The asset has been set as failed
+        ++_failed_assets;
+        notify_done(job->asset());
+    }
+}
+
+void AssetLoadingThreadPool::finalize_and_notify(std::unique_ptr<LoadingJob> job, AssetLoadingState state) {
+    {
+        core::Chrono chrono;
+        finalize_job(*job, state);
+        _finalize_ns += chrono.elapsed().to_nanos();
+    }
+
+    if(job->asset()->is_failed()) {
+        ++_failed_assets;
+    } else {
+        ++_loaded_assets;
+    }
+
+    notify_done(job->asset());
+}
+
+bool AssetLoadingThreadPool::is_less_urgent(const std::unique_ptr<LoadingJob>& a, const std::unique_ptr<LoadingJob>& b) {
+    if(a->_queued_priority == b->_queued_priority) {
+        return a->_sequence > b->_sequence;
+    }
+    return a->_queued_priority < b->_queued_priority;
+}
+
+void AssetLoadingThreadPool::push_pending_job(std::unique_ptr<LoadingJob> job) {
+    job->_queued_priority = job->asset()->priority();
+    _pending_jobs.emplace_back(std::move(job));
+    std::push_heap(_pending_jobs.begin(), _pending_jobs.end(), is_less_urgent);
+}
+
+void AssetLoadingThreadPool::add_pending_job(std::unique_ptr<LoadingJob> job) {
+    const auto lock = y_profile_unique_lock(_pending_lock);
+    push_pending_job(std::move(job));
+    _pending_count = _pending_jobs.size();
+}
+
+std::unique_ptr<AssetLoadingThreadPool::LoadingJob> AssetLoadingThreadPool::next_loading_job() {
+    if(!has_loading_jobs()) {
+        return nullptr;
+    }
+
+    y_profile();
+
+    std::unique_ptr<LoadingJob> job;
+
+    {
+        const auto lock = y_profile_unique_lock(_pending_lock);
+
+        while(_loading_jobs.try_pop(job)) {
+            push_pending_job(std::move(job));
+        }
+
+        if(_priorities_changed.exchange(false)) {
+            y_profile_zone("sorting");
+            for(auto& pending : _pending_jobs) {
+                pending->_queued_priority = pending->asset()->priority();
+            }
+            std::make_heap(_pending_jobs.begin(), _pending_jobs.end(), is_less_urgent);
+        }
+
+        if(_pending_jobs.is_empty()) {
+            _pending_count = 0;
+            return nullptr;
+        }
+
+        std::pop_heap(_pending_jobs.begin(), _pending_jobs.end(), is_less_urgent);
+        job = _pending_jobs.pop();
+        _pending_count = _pending_jobs.size();
+    }
+
+    // Other threads might be sleeping while jobs we took from the queue are pending
+    if(_pending_count && can_start_loading()) {
+        _loading_jobs.wake_all();
+    }
+
+    return job;
+}
+
+void AssetLoadingThreadPool::wait_for_dependencies(std::unique_ptr<LoadingJob> job) {
+    for(;;) {
+        const detail::AssetPtrDataBase* dependency = job->dependencies().pending_dependency();
+        if(!dependency) {
+            push_finalize_job(std::move(job));
+            return;
+        }
+
+        const auto lock = y_profile_unique_lock(_waiting_lock);
+
+        // notify_done is called after the state changes, under the same lock:
+        // if the dependency is still loading here, it will wake this job up
+        if(dependency->is_loading()) {
+            // The priority of the asset might have been raised while it was being read
+            core::Vector<const detail::AssetPtrDataBase*> raised;
+            job->dependencies().raise_priority(job->asset()->priority(), raised);
+
+            _waiting_jobs[dependency].emplace_back(std::move(job));
+
+            if(!raised.is_empty()) {
+                raise_waiting_priorities(raised);
+                _priorities_changed = true;
+            }
+            return;
+        }
+    }
+}
+
+void AssetLoadingThreadPool::notify_done(const detail::AssetPtrDataBase* asset) {
+    y_debug_assert(!asset->is_loading());
+
+    core::Vector<std::unique_ptr<LoadingJob>> waiting;
+
+    {
+        const auto lock = y_profile_unique_lock(_waiting_lock);
+        if(const auto it = _waiting_jobs.find(asset); it != _waiting_jobs.end()) {
+            waiting = std::move(it->second);
+            _waiting_jobs.erase(asset);
+        }
+    }
+
+    for(auto& job : waiting) {
+        wait_for_dependencies(std::move(job));
+    }
+}
+
+void AssetLoadingThreadPool::raise_waiting_priorities(core::Vector<const detail::AssetPtrDataBase*>& assets) {
+    y_profile();
+
+    while(!assets.is_empty()) {
+        const detail::AssetPtrDataBase* asset = assets.pop();
+        const AssetLoadingPriority priority = asset->priority();
+        for(const auto& [dependency, jobs] : _waiting_jobs) {
+            for(const auto& job : jobs) {
+                if(job->asset() == asset) {
+                    job->dependencies().raise_priority(priority, assets);
                 }
-                _condition.notify_all();
-            } else {
-                auto inner_lock = y_profile_unique_lock(_lock);
-                _finalize_jobs.emplace_back(std::move(job));
             }
         }
     }
 }
 
+void AssetLoadingThreadPool::push_finalize_job(std::unique_ptr<LoadingJob> job) {
+    if(!_finalize_jobs.try_push(std::move(job))) {
+        const auto lock = y_profile_unique_lock(_overflow_lock);
+        _finalize_overflow.emplace_back(std::move(job));
+        ++_finalize_overflow_size;
+    }
+
+    // Idle threads only sleep while there is nothing to finalize
+    _loading_jobs.wake_all();
+}
+
+bool AssetLoadingThreadPool::has_decompression_blocks() {
+    if(!_decompression_count) {
+        return false;
+    }
+
+    // Readers whose blocks have all been claimed are only waiting on other threads, there is nothing left to help with
+    const auto lock = y_profile_unique_lock(_decompression_lock);
+    return std::any_of(_decompressions.begin(), _decompressions.end(), [](const SharedDecompression& d) { return d.reader->has_pending_blocks(); });
+}
+
+bool AssetLoadingThreadPool::has_finalize_jobs() const {
+    return !_finalize_jobs.is_empty() || _finalize_overflow_size;
+}
+
+bool AssetLoadingThreadPool::has_loading_jobs() const {
+    return !_loading_jobs.is_empty() || _pending_count;
+}
+
+bool AssetLoadingThreadPool::has_fetched_jobs() const {
+    return !_fetched_jobs.is_empty();
+}
+
+bool AssetLoadingThreadPool::can_start_loading() const {
+    // Fetches are refilled in batches: reads are submitted together and their completions tend to land together.
+    // While enough reads are in flight, loading threads wait for data instead of reading on their own.
+    return _fetch_unsupported || _fetching <= max_fetching_jobs / 2;
+}
+
 void AssetLoadingThreadPool::worker() {
+    // Only true if process_one can make progress. Everything that can change it wakes the loading queue:
+    // fetch completions, finalize jobs, new decompressions and jobs taken from the queue while threads can start loading.
+    const auto has_work = [this] {
+        return has_finalize_jobs() || has_fetched_jobs() || has_decompression_blocks() || (_pending_count && can_start_loading());
+    };
+
     while(_run) {
-        auto lock = y_profile_unique_lock(_lock);
-        _condition.wait(lock, [this] {
-            return !_loading_jobs.empty() || !_finalize_jobs.empty() ||  !_run;
-        });
-        process_one(std::move(lock));
+        if(process_one()) {
+            continue;
+        }
+
+        // Sleeps until there is something to do rather than spinning on work other threads are busy with
+        std::unique_ptr<LoadingJob> job;
+        if(_loading_jobs.pop(job, [&] { return has_work() || !_run; })) {
+            ++_processing;
+            y_defer(--_processing);
+            add_pending_job(std::move(job));
+        }
     }
 }
 
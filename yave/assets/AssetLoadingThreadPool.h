@@ -23,14 +23,19 @@ SOFTWARE.
 #define YAVE_ASSETS_ASSETLOADINGTHREADPOOL_H
 
 #include "AssetLoadingContext.h"
+#include "AssetStore.h"
 
 #include <y/core/Vector.h>
+#include <y/core/HashMap.h>
+#include <y/concurrent/MPMCQueue.h>
+#include <y/io2/AsyncFileReader.h>
+#include <y/io2/BlockCompression.h>
+#include <y/core/Chrono.h>
 
 #include <thread>
 #include <mutex>
 #include <condition_variable>
 #include <deque>
-#include <list>
 #include <functional>
 
 namespace yave {
@@ -40,6 +45,24 @@ class AssetLoadingThreadPool : NonMovable {
         using CreateFunc = std::function<void()>;
         using ReadFunc = std::function<CreateFunc(AssetLoadingContext&)>;
 
+        // Times are summed over all loading threads, so they can exceed the wall time
+        struct Stats {
+            u64 loaded_assets = 0;
+            u64 failed_assets = 0;
+
+            // Size of the data handed to loading jobs
+            u64 bytes = 0;
+
+            // Waiting for data: read latency for fetched data, opening for data read on loading threads
+            core::Duration io_time;
+
+            // Includes decompression
+            core::Duration deserialize_time;
+
+            // Includes uploads for graphic assets
+            core::Duration finalize_time;
+        };
+
         class LoadingJob : NonMovable {
             public:
                 virtual ~LoadingJob();
@@ -48,6 +71,14 @@ class AssetLoadingThreadPool : NonMovable {
                 virtual void finalize() = 0;
                 virtual void set_dependencies_failed() = 0;
 
+                virtual const detail::AssetPtrDataBase* asset() const = 0;
+
+                // Returns true if nothing references the asset anymore, in which case the job should be dropped
+                virtual bool try_cancel() = 0;
+
+                // Returns false if the job only reads part of its data, which should then be read lazily from the store
+                virtual bool reads_whole_data() const = 0;
+
                 const AssetDependencies& dependencies() const;
                 AssetLoader* parent() const;
 
@@ -56,8 +87,26 @@ class AssetLoadingThreadPool : NonMovable {
 
                 AssetLoadingContext& loading_context();
 
+                // Returns the data fetched by the thread pool if any, reads it from the store otherwise
+                AssetStore::Result<io2::ReaderPtr> read_data(AssetId id);
+
             private:
+                friend class AssetLoadingThreadPool;
+
                 AssetLoadingContext _ctx;
+                io2::ReaderPtr _fetched_data;
+
+                // Set if _fetched_data is compressed
+                io2::CompressedReader* _compressed_data = nullptr;
+
+                // Filled by read_data and fetches, in nanoseconds
+                u64 _io_ns = 0;
+                u64 _read_io_ns = 0;
+                u64 _read_bytes = 0;
+
+                // Priority at the time the job was last sorted
+                AssetLoadingPriority _queued_priority = AssetLoadingPriority::Normal;
+                u64 _sequence = 0;
         };
 
 
@@ -68,23 +117,110 @@ class AssetLoadingThreadPool : NonMovable {
 
         void add_loading_job(std::unique_ptr<LoadingJob> job);
 
+        // Call after changing the priority of a loading asset, pending dependencies of the asset are raised to match
+        void priorities_changed(const detail::AssetPtrDataBase* asset);
+
         bool is_processing() const;
 
+        usize cancelled_jobs() const;
+
+        Stats stats() const;
+
     private:
-        void process_one(std::unique_lock<std::mutex> lock);
+        class FetchRequest;
+
+        struct SharedDecompression {
+            io2::CompressedReader* reader = nullptr;
+            usize helpers = 0;
+        };
+
+        static constexpr usize job_queue_capacity = 1024 * 16;
+
+        // Reads kept in flight by the async reader, loading threads only deserialize
+        static constexpr usize max_fetching_jobs = 64;
+
+        bool process_one();
+        bool finalize_one();
+        bool read_fetched_one();
+        bool start_loading();
+        void read_one(std::unique_ptr<LoadingJob> job);
+        void push_fetched_job(std::unique_ptr<LoadingJob> job, io2::ReaderPtr data);
+        void decompress(io2::CompressedReader& reader);
+        bool help_decompress();
+        bool has_decompression_blocks();
+        void finalize_and_notify(std::unique_ptr<LoadingJob> job, AssetLoadingState state);
+        void push_finalize_job(std::unique_ptr<LoadingJob> job);
+        bool has_finalize_jobs() const;
+        bool has_loading_jobs() const;
+        bool has_fetched_jobs() const;
+        bool can_start_loading() const;
         void worker();
 
-        std::deque<std::unique_ptr<LoadingJob>> _loading_jobs;
-        std::list<std::unique_ptr<LoadingJob>> _finalize_jobs;
+        std::unique_ptr<LoadingJob> next_loading_job();
+        void add_pending_job(std::unique_ptr<LoadingJob> job);
+        void push_pending_job(std::unique_ptr<LoadingJob> job);
+
+        static bool is_less_urgent(const std::unique_ptr<LoadingJob>& a, const std::unique_ptr<LoadingJob>& b);
+
+        void wait_for_dependencies(std::unique_ptr<LoadingJob> job);
+        void notify_done(const detail::AssetPtrDataBase* asset);
+
+        // Raises the dependencies of the waiting jobs of assets to the priority of the asset, recursively.
+        // Must be called with _waiting_lock held, which keeps the dependencies of waiting jobs alive.
+        void raise_waiting_priorities(core::Vector<const detail::AssetPtrDataBase*>& assets);
+
+        // New jobs land here first, and are sorted by priority into _pending_jobs by the loading threads
+        concurrent::BlockingMPMCQueue<std::unique_ptr<LoadingJob>> _loading_jobs;
+
+        // Heap ordered by priority, then submission order
+        core::Vector<std::unique_ptr<LoadingJob>> _pending_jobs;
+        std::atomic<usize> _pending_count = 0;
+        std::atomic<bool> _priorities_changed = false;
+        std::atomic<u64> _next_sequence = 0;
+        std::mutex _pending_lock;
+
+        // Jobs whose dependencies are all done
+        concurrent::MPMCQueue<std::unique_ptr<LoadingJob>> _finalize_jobs;
+
+        // Jobs waiting on a dependency, indexed by the dependency they wait on
+        core::FlatHashMap<const detail::AssetPtrDataBase*, core::Vector<std::unique_ptr<LoadingJob>>> _waiting_jobs;
+        std::mutex _waiting_lock;
+
+        // Jobs whose data has been fetched, ready to be deserialized
+        concurrent::MPMCQueue<std::unique_ptr<LoadingJob>> _fetched_jobs;
+
+        // Jobs being fetched or in _fetched_jobs
+        std::atomic<usize> _fetching = 0;
+        std::atomic<bool> _fetch_unsupported = false;
+
+        std::unique_ptr<io2::AsyncFileReader> _async_reader;
+
+        // Compressed data being decompressed by a loading thread, which idle threads help with.
+        // Entries are only removed by their owner once they have no helpers left.
+        core::Vector<SharedDecompression> _decompressions;
+        std::atomic<usize> _decompression_count = 0;
+        std::mutex _decompression_lock;
+        std::condition_variable _decompression_done;
+
+        std::atomic<usize> _cancelled = 0;
+
+        std::atomic<u64> _loaded_assets = 0;
+        std::atomic<u64> _failed_assets = 0;
+        std::atomic<u64> _read_bytes = 0;
+        std::atomic<u64> _io_ns = 0;
+        std::atomic<u64> _deserialize_ns = 0;
+        std::atomic<u64> _finalize_ns = 0;
 
-        mutable std::mutex _lock;
-        std::condition_variable _condition;
+        // Only used if _finalize_jobs is full
+        std::deque<std::unique_ptr<LoadingJob>> _finalize_overflow;
+        std::atomic<usize> _finalize_overflow_size = 0;
+        std::mutex _overflow_lock;
 
         core::Vector<std::thread> _threads;
         std::atomic<bool> _run = true;
         std::atomic<u32> _processing = 0;
 
-        [[maybe_unused]] AssetLoader* _parent = nullptr;
+        AssetLoader* _parent = nullptr;
 };
 
 }
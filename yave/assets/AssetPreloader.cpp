@@ -0,0 +1,174 @@
+/*******************************
+Copyright (c) 2016-2023 Grégoire Angerand
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+**********************************/
+#include "AssetPreloader.h"
+
+#include <y/utils/log.h>
+#include <y/utils/format.h>
+
+#include <algorithm>
+
+namespace yave {
+
+static core::Duration duration_diff(const core::Duration& end, const core::Duration& start) {
+    const u64 ns = end.to_nanos() - std::min(end.to_nanos(), start.to_nanos());
+    return core::Duration(ns / 1'000'000'000, u32(ns % 1'000'000'000));
+}
+
+static AssetLoader::LoadingStats stats_diff(const AssetLoader::LoadingStats& end, const AssetLoader::LoadingStats& start) {
+    AssetLoader::LoadingStats stats;
+    stats.loaded_assets = end.loaded_assets - start.loaded_assets;
+    stats.failed_assets = end.failed_assets - start.failed_assets;
+    stats.bytes = end.bytes - start.bytes;
+    stats.io_time = duration_diff(end.io_time, start.io_time);
+    stats.deserialize_time = duration_diff(end.deserialize_time, start.deserialize_time);
+    stats.finalize_time = duration_diff(end.finalize_time, start.finalize_time);
+    return stats;
+}
+
+double AssetPreloader::Report::bytes_per_second() const {
+    const double secs = total_time.to_secs();
+    return secs > 0.0 ? double(loading.bytes) / secs : 0.0;
+}
+
+core::String AssetPreloader::Report::to_string() const {
+    core::String str;
+    fmt_into(str, "% assets (% loaded with dependencies, % failed), %MB in %ms (%MB/s): io %ms, deserialize %ms, finalize %ms",
+        requested_assets,
+        loading.loaded_assets,
+        failed_assets,
+        loading.bytes / (1024.0 * 1024.0),
+        total_time.to_millis(),
+        bytes_per_second() / (1024.0 * 1024.0),
+        loading.io_time.to_millis(),
+        loading.deserialize_time.to_millis(),
+        loading.finalize_time.to_millis()
+    );
+    return str;
+}
+
+
+AssetPreloader::AssetPreloader(AssetLoader& loader, AssetLoadingPriority priority) : _loader(&loader), _priority(priority) {
+}
+
+usize AssetPreloader::request_count() const {
+    return _requests.size();
+}
+
+bool AssetPreloader::is_started() const {
+    return _started;
+}
+
+void AssetPreloader::start() {
+    y_profile();
+
+    y_always_assert(!_started, "Preload has already been started");
+    _started = true;
+
+    struct Request {
+        AssetId id;
+        LoadFunc load = nullptr;
+        AssetStore::DataLocation location;
+    };
+
+    core::Vector<Request> requests = core::vector_with_capacity<Request>(_requests.size());
+    {
+        y_profile_zone("locating data");
+        const AssetStore& store = _loader->store();
+        for(const auto& [id, load] : _requests) {
+            requests.emplace_back(Request{id, load, store.data_location(id).unwrap_or(AssetStore::DataLocation{})});
+        }
+    }
+
+    // Requests with the same priority are read in order: issue them in the order their data is laid out in
+    std::sort(requests.begin(), requests.end(), [](const Request& a, const Request& b) {
+        if(a.location.file_name != b.location.file_name) {
+            return a.location.file_name < b.location.file_name;
+        }
+        if(a.location.offset != b.location.offset) {
+            return a.location.offset < b.location.offset;
+        }
+        return a.id.id() < b.id.id();
+    });
+
+    _start_stats = _loader->loading_stats();
+    _chrono.start();
+
+    {
+        y_profile_zone("requesting");
+        _assets.set_min_capacity(requests.size());
+        for(const Request& request : requests) {
+            _assets << request.load(*_loader, request.id, _priority);
+        }
+    }
+
+    _report.requested_assets = _assets.size();
+}
+
+bool AssetPreloader::poll() {
+    if(!_started) {
+        return false;
+    }
+
+    if(_done) {
+        return true;
+    }
+
+    while(_first_loading != _assets.size() && !_assets[_first_loading].is_loading()) {
+        ++_first_loading;
+    }
+
+    if(_first_loading != _assets.size()) {
+        return false;
+    }
+
+    _report = report();
+    _done = true;
+    _report.failed_assets = std::count_if(_assets.begin(), _assets.end(), [](const GenericAssetPtr& asset) { return asset.is_failed(); });
+
+    return true;
+}
+
+void AssetPreloader::wait() {
+    y_profile();
+
+    y_always_assert(_started, "Preload has not been started");
+
+    for(const GenericAssetPtr& asset : _assets) {
+        _loader->wait_until_loaded(asset);
+    }
+
+    poll();
+}
+
+AssetPreloader::Report AssetPreloader::report() const {
+    if(_done || !_started) {
+        return _report;
+    }
+
+    Report report = _report;
+    report.loading = stats_diff(_loader->loading_stats(), _start_stats);
+    report.total_time = _chrono.elapsed();
+    return report;
+}
+
+}
+
@@ -0,0 +1,118 @@
+/*******************************
+Copyright (c) 2016-2023 Grégoire Angerand
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+**********************************/
+#ifndef YAVE_ASSETS_ASSETPRELOADER_H
+#define YAVE_ASSETS_ASSETPRELOADER_H
+
+#include "AssetLoader.h"
+
+#include <y/core/Chrono.h>
+
+namespace yave {
+
+// Gathers every asset needed by something (a scene for example) and requests them as one batch,
+// instead of each asset being requested when whatever uses it gets around to it.
+class AssetPreloader : NonMovable {
+    public:
+        struct Report {
+            // Unique assets requested, their dependencies are not counted
+            usize requested_assets = 0;
+            usize failed_assets = 0;
+
+            // Loader stats over the duration of the preload, other loads running at the same time are included
+            AssetLoader::LoadingStats loading;
+
+            core::Duration total_time;
+
+            double bytes_per_second() const;
+            core::String to_string() const;
+        };
+
+        AssetPreloader(AssetLoader& loader, AssetLoadingPriority priority = AssetLoadingPriority::High);
+
+        template<typename T>
+        void add(AssetId id) {
+            y_debug_assert(!_started);
+            if(id != AssetId::invalid_id() && !_requests.contains(id)) {
+                _requests.emplace(id, &load_async<T>);
+            }
+        }
+
+        template<typename T>
+        void add(const AssetPtr<T>& ptr) {
+            add<T>(ptr.id());
+        }
+
+        // Adds every AssetPtr found in object
+        template<typename T>
+        void add_recursive(const T& object) {
+            reflect::explore_recursive(object, [this](const auto& member) {
+                if constexpr(is_asset_ptr_v<remove_cvref_t<decltype(member)>>) {
+                    add(member);
+                }
+            });
+        }
+
+        usize request_count() const;
+
+        // Issues every request at once
+        void start();
+
+        // Returns true once every requested asset is done loading, which means their dependencies are too
+        bool poll();
+
+        // This is dangerous: Do not call in loading threads!
+        void wait();
+
+        bool is_started() const;
+
+        // Only final once poll has returned true
+        Report report() const;
+
+    private:
+        using LoadFunc = GenericAssetPtr (*)(AssetLoader&, AssetId, AssetLoadingPriority);
+
+        template<typename T>
+        static GenericAssetPtr load_async(AssetLoader& loader, AssetId id, AssetLoadingPriority priority) {
+            return loader.load_async<T>(id, priority);
+        }
+
+        AssetLoader* _loader = nullptr;
+        AssetLoadingPriority _priority = AssetLoadingPriority::High;
+
+        core::FlatHashMap<AssetId, LoadFunc> _requests;
+
+        // Keeps the assets alive until whatever needs them picks them up
+        core::Vector<GenericAssetPtr> _assets;
+        usize _first_loading = 0;
+
+        core::Chrono _chrono;
+        AssetLoader::LoadingStats _start_stats;
+        Report _report;
+
+        bool _started = false;
+        bool _done = false;
+};
+
+}
+
+#endif // YAVE_ASSETS_ASSETPRELOADER_H
+
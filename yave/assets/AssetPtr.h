@@ -66,6 +66,13 @@ inline constexpr AssetLoadingFlags operator&(AssetLoadingFlags l, AssetLoadingFl
     return AssetLoadingFlags(u32(l) & u32(r));
 }
 
+enum class AssetLoadingPriority : u32 {
+    Low = 0,
+    Normal = 1,
+    High = 2,
+    Immediate = 3
+};
+
 
 template<typename T, typename... Args>
 AssetPtr<T> make_asset(Args&&... args);
@@ -89,10 +96,14 @@ class AssetPtrDataBase : NonMovable {
 
         inline AssetLoader* loader() const;
 
+        inline AssetLoadingPriority priority() const;
+        inline void set_priority(AssetLoadingPriority priority);
+
     protected:
         inline AssetPtrDataBase(AssetId i, AssetLoader* loader, AssetLoadingState s = AssetLoadingState::NotLoaded);
 
         std::atomic<AssetLoadingState> _state = AssetLoadingState::NotLoaded;
+        std::atomic<AssetLoadingPriority> _priority = AssetLoadingPriority::Normal;
         AssetLoader* _loader = nullptr;
 };
 
@@ -213,6 +224,7 @@ class GenericAssetPtr {
     private:
         friend class AssetLoader;
         friend class AssetLoadingThreadPool;
+        friend class AssetDependencies;
 
         std::shared_ptr<detail::AssetPtrDataBase> _data;
 };
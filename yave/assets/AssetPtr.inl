@@ -76,6 +76,14 @@ AssetLoader* AssetPtrDataBase::loader() const {
     return _loader;
 }
 
+AssetLoadingPriority AssetPtrDataBase::priority() const {
+    return _priority.load(std::memory_order_relaxed);
+}
+
+void AssetPtrDataBase::set_priority(AssetLoadingPriority priority) {
+    _priority.store(priority, std::memory_order_relaxed);
+}
+
 
 template<typename T>
 AssetPtrData<T>::AssetPtrData(AssetId id, AssetLoader* loader) : AssetPtrDataBase(id, loader, AssetLoadingState::NotLoaded) {
@@ -65,6 +65,11 @@ AssetStore::Result<> AssetStore::write(AssetId id, io2::Reader& data) {
     return core::Err(ErrorType::UnsupportedOperation);
 }
 
+AssetStore::Result<AssetStore::DataLocation> AssetStore::data_location(AssetId id) const {
+    unused(id);
+    return core::Err(ErrorType::UnsupportedOperation);
+}
+
 AssetStore::Result<AssetType> AssetStore::asset_type(AssetId id) const {
     unused(id);
     return core::Err(ErrorType::UnsupportedOperation);
@@ -26,6 +26,7 @@ SOFTWARE.
 #include "AssetType.h"
 
 #include <y/io2/io.h>
+#include <y/core/String.h>
 
 namespace yave {
 
@@ -49,6 +50,14 @@ class AssetStore : NonCopyable {
         template<typename T = void>
         using Result = core::Result<T, ErrorType>;
 
+        // A range of bytes in a file, by default the whole file. The bytes might be block compressed (see io2::CompressedReader)
+        struct DataLocation {
+            static constexpr u64 until_end = u64(-1);
+
+            core::String file_name;
+            u64 offset = 0;
+            u64 size = until_end;
+        };
 
 
         AssetStore();
@@ -64,6 +73,10 @@ class AssetStore : NonCopyable {
 
         virtual Result<io2::ReaderPtr> data(AssetId id) const = 0;
 
+        // Where the data returned by data() lives on disk, so it can be read asynchronously.
+        // Stores that don't keep assets as plain file ranges return UnsupportedOperation.
+        virtual Result<DataLocation> data_location(AssetId id) const;
+
         virtual Result<> remove(AssetId id);
         virtual Result<> rename(AssetId id, std::string_view new_name);
 
@@ -35,6 +35,15 @@ struct AssetTraits {
     static constexpr bool is_asset = false;
 };
 
+namespace detail {
+template<typename T>
+using reads_partial_data_t = decltype(T::reads_partial_data);
+}
+
+// Types whose deserialization might only read the start of their data, which should not be fetched whole
+template<typename T>
+static constexpr bool reads_partial_data_v = is_detected_v<detail::reads_partial_data_t, T>;
+
 Y_TODO(Merge these two)
 
 #define YAVE_DECLARE_GRAPHIC_ASSET_TRAITS(Type, LoadFrom, TypeEnum)                         \
@@ -21,84 +21,99 @@ SOFTWARE.
 **********************************/
 
 #include "FolderAssetStore.h"
+#include "AssetIndex.h"
+#include "asset_paths.h"
+
+#include <yave/utils/filesystem.h>
 
 #include <y/io2/File.h>
-#include <y/concurrent/StaticThreadPool.h>
+#include <y/io2/MappedFile.h>
+#include <y/io2/BlockCompression.h>
+#include <y/core/FixedArray.h>
+#include <y/concurrent/WorkStealingThreadPool.h>
 
 #include <y/utils/log.h>
 #include <y/serde3/archives.h>
 
 #include <charconv>
+#include <cinttypes>
+#include <cstring>
 
 namespace yave {
 
-static bool is_delimiter(char c) {
-    return c == '/';
-}
+using namespace detail;
+
+namespace {
+
+static constexpr u32 index_magic = 0x58444946; // "FIDX"
+static constexpr u32 journal_magic = 0x4E524A4C; // "LJRN"
+static constexpr u32 index_version = 1;
+
+struct IndexHeader {
+    u32 magic = index_magic;
+    u32 version = index_version;
+    u64 generation = 0;
+    u64 next_id = 0;
+    u32 asset_count = 0;
+    u32 folder_count = 0;
+    u32 string_size = 0;
+    u32 padding = 0;
+    u64 body_hash = 0;
+};
+
+struct IndexEntry {
+    u64 id = 0;
+    ContentHash128::Value content_hash;
+    u64 file_size = 0;
+    u32 type = 0;
+    u32 name_offset = 0;
+    u32 name_size = 0;
+    u32 padding = 0;
+};
+
+// The journal is only replayed on top of the checkpoint with the same generation
+struct JournalRecord {
+    u32 op = 0;
+    u32 type = 0;
+    u64 id = 0;
+    ContentHash128::Value content_hash;
+    u64 file_size = 0;
+    u32 name_size = 0;
+    u32 other_name_size = 0;
+    u64 checksum = 0;
+};
+
+static_assert(sizeof(IndexHeader) == 48);
+static_assert(sizeof(IndexEntry) == 48);
+static_assert(sizeof(JournalRecord) == 56);
 
-static std::string_view strict_path(std::string_view path) {
-    const bool has_delim = !path.empty() && is_delimiter(path.back());
-    const std::string_view no_delim(path.data(), path.size() - has_delim);
-    return no_delim;
 }
 
-static std::string_view strict_parent_path(std::string_view path) {
-    for(usize i = path.size(); i > 0; --i) {
-        if(is_delimiter(path[i - 1])) {
-            return path.substr(0, i - 1);
-        }
-    }
-    return std::string_view();
-}
-
-static bool is_strict_direct_parent(std::string_view parent, std::string_view path) {
-    return strict_parent_path(path) == parent;
+static core::String stringify_content_hash(const ContentHash128::Value& hash) {
+    std::array<char, 64> buffer = {0};
+    std::snprintf(buffer.data(), buffer.size(), "%016" PRIx64 "%016" PRIx64, hash.low, hash.high);
+    return core::String(buffer.data());
 }
 
-static bool is_strict_indirect_parent(std::string_view parent, std::string_view path) {
-    parent = strict_path(parent);
-    if(parent.size() >= path.size()) {
+static bool parse_content_hash(std::string_view str, ContentHash128::Value& hash) {
+    if(str.size() != 32) {
         return false;
     }
-    if(!is_delimiter(path[parent.size()])) {
-        return false;
-    }
-    return path.substr(0, parent.size()) == parent;
-}
-
-static bool is_valid_name_char(char c) {
-    return std::isprint(static_cast<unsigned char>(c)) && c != '\\';
-}
-
-static bool is_valid_path_char(char c) {
-    return is_valid_name_char(c) || is_delimiter(c);
-}
-
-[[maybe_unused]]
-static bool is_valid_name(std::string_view name) {
-    for(char c : name) {
-        if(!is_valid_name_char(c)) {
-            return false;
-        }
-    }
-    return !name.empty();
+    const char* begin = str.data();
+    return std::from_chars(begin, begin + 16, hash.low, 16).ec == std::errc() &&
+           std::from_chars(begin + 16, begin + 32, hash.high, 16).ec == std::errc();
 }
 
-static bool is_valid_path(std::string_view name) {
-    for(char c : name) {
-        if(!is_valid_path_char(c)) {
-            return false;
-        }
-    }
-    return true;
+static core::String replace_prefix(std::string_view name, std::string_view from, std::string_view to) {
+    y_debug_assert(name.substr(0, from.size()) == from);
+    core::String result;
+    result.set_min_capacity(to.size() + name.size() - from.size());
+    result += to;
+    result += name.substr(from.size());
+    return result;
 }
 
-
-
-
 FolderAssetStore::FolderFileSystemModel::FolderFileSystemModel(FolderAssetStore* parent) : _parent(parent) {
-    y_debug_assert(core::String("a") < core::String("ab"));
-    y_debug_assert(std::string_view("a") < std::string_view("ab"));
 }
 
 core::String FolderAssetStore::FolderFileSystemModel::join(std::string_view path, std::string_view name) const {
@@ -144,7 +159,7 @@ FileSystemModel::Result<bool> FolderAssetStore::FolderFileSystemModel::exists(st
     const std::string_view no_delim(path.data(), path.size() - has_delim);
 
     const auto lock = y_profile_unique_lock(_parent->_lock);
-    return core::Ok(_parent->_folders.find(no_delim) != _parent->_folders.end() || (!has_delim && _parent->_assets.find(no_delim) != _parent->_assets.end()));
+    return core::Ok(_parent->_folders.contains(no_delim) || (!has_delim && _parent->_names.contains(no_delim)));
 }
 
 FileSystemModel::Result<FileSystemModel::EntryType> FolderAssetStore::FolderFileSystemModel::entry_type(std::string_view path) const {
@@ -155,7 +170,7 @@ FileSystemModel::Result<FileSystemModel::EntryType> FolderAssetStore::FolderFile
     }
 
     const auto lock = y_profile_unique_lock(_parent->_lock);
-    const bool is_dir = _parent->_folders.find(strict_path(path)) != _parent->_folders.end();
+    const bool is_dir = _parent->_folders.contains(strict_path(path));
     return core::Ok(is_dir ? EntryType::Directory : EntryType::File);
 }
 
@@ -172,34 +187,33 @@ FileSystemModel::Result<> FolderAssetStore::FolderFileSystemModel::for_each(std:
 
     const auto lock = y_profile_unique_lock(_parent->_lock);
 
-    for(auto it = _parent->_folders.lower_bound(path); it != _parent->_folders.end(); ++it) {
-        if(is_strict_direct_parent(path, *it)) {
-            const EntryInfo info = {
-                EntryType::Directory,
-                it->sub_str(path.size() + !is_root),
-                0
-            };
-            func(info);
-        } else if(!it->starts_with(path)) {
-            break;
-        }
+    const auto it = _parent->_folders.find(path);
+    if(it == _parent->_folders.end()) {
+        return core::Ok();
     }
 
-    for(auto it = _parent->_assets.lower_bound(path); it != _parent->_assets.end(); ++it) {
-        if(is_strict_direct_parent(path, it->first)) {
-            const EntryInfo info = {
-                EntryType::File,
-                it->first.sub_str(path.size() + !is_root),
-                it->second.file_size
-            };
-            func(info);
-        } else if(!it->first.starts_with(path)) {
-            break;
-        }
+    const FolderData& folder = it->second;
+
+    for(const core::String& sub_folder : folder.folders) {
+        const EntryInfo info = {
+            EntryType::Directory,
+            sub_folder.sub_str(path.size() + !is_root),
+            0
+        };
+        func(info);
     }
 
-    return core::Ok();
+    for(const AssetId id : folder.assets) {
+        const AssetData& asset = _parent->_assets.find(id)->second;
+        const EntryInfo info = {
+            EntryType::File,
+            asset.name.sub_str(path.size() + !is_root),
+            usize(asset.file_size)
+        };
+        func(info);
+    }
 
+    return core::Ok();
 }
 
 FileSystemModel::Result<> FolderAssetStore::FolderFileSystemModel::create_directory(std::string_view path) const {
@@ -213,17 +227,20 @@ FileSystemModel::Result<> FolderAssetStore::FolderFileSystemModel::create_direct
 
     const auto lock = y_profile_unique_lock(_parent->_lock);
 
-    const auto parent = strict_parent_path(path);
-    if(!is_directory(parent).unwrap_or(false)) {
-        y_try(create_directory(parent));
+    if(_parent->_folders.contains(path)) {
+        return core::Ok();
     }
 
-    if(_parent->_folders.emplace(path).second) {
-        log_msg(fmt("Folder created: %", path));
-        return _parent->save_or_restore_tree();
+    if(_parent->_names.contains(path)) {
+        return core::Err();
     }
 
-    return core::Ok();
+    y_try(create_directory(strict_parent_path(path)));
+
+    _parent->apply_create_folder(path);
+    log_msg(fmt("Folder created: %", path));
+
+    return _parent->journal_or_restore(JournalOp::CreateFolder, AssetData{}, path);
 }
 
 FileSystemModel::Result<> FolderAssetStore::FolderFileSystemModel::remove(std::string_view path) const {
@@ -233,55 +250,29 @@ FileSystemModel::Result<> FolderAssetStore::FolderFileSystemModel::remove(std::s
 
     const auto lock = y_profile_unique_lock(_parent->_lock);
 
-    core::Vector<core::String> files_to_delete;
-
-    std::set<core::String> new_folders;
-    {
-        y_profile_zone("folders");
-        for(const core::String& folder : _parent->_folders) {
-            if(is_strict_indirect_parent(path, folder) || folder == path) {
-                // Remove
-            } else {
-                y_debug_assert(!is_strict_direct_parent(path, folder));
-                new_folders.insert(folder);
-            }
-        }
+    core::Vector<AssetId> removed;
+    if(!_parent->apply_remove(path, &removed)) {
+        return core::Ok();
     }
 
-    std::map<core::String, AssetData> new_assets;
-    {
-        y_profile_zone("assets");
-        for(const auto &[name, data] : _parent->_assets) {
-            if(is_strict_indirect_parent(path, name) || name == path) {
-                const AssetId id = data.id;
-                const core::String filename = _parent->asset_desc_file_name(id);
-                if(auto r = FileSystemModel::local_filesystem()->remove(filename); !r) {
-                    log_msg(fmt("Unable to remove %", filename), Log::Error);
-                    _parent->reload_all().ignore();
-                    return r;
-                }
-                files_to_delete << _parent->asset_data_file_name(id);
-            } else {
-                y_debug_assert(!is_strict_direct_parent(path, name));
-                new_assets[name] = data;
-            }
-        }
+    if(!_parent->journal_or_restore(JournalOp::Remove, AssetData{}, path)) {
+        return core::Err();
     }
 
-    if(!files_to_delete.is_empty()) {
+    {
         y_profile_zone("cleaning files");
-        for(const core::String& file : files_to_delete) {
-            FileSystemModel::local_filesystem()->remove(file).ignore();
+        const FileSystemModel* fs = FileSystemModel::local_filesystem();
+        for(const AssetId id : removed) {
+            if(!fs->remove(_parent->asset_desc_file_name(id))) {
+                log_msg(fmt("Unable to remove %", _parent->asset_desc_file_name(id)), Log::Error);
+            }
+            fs->remove(_parent->asset_data_file_name(id)).ignore();
         }
     }
 
-    log_msg(fmt("Removed % assets", _parent->_assets.size() - new_assets.size()));
-
-    _parent->_ids = nullptr;
-    std::swap(new_folders, _parent->_folders);
-    std::swap(new_assets, _parent->_assets);
+    log_msg(fmt("Removed % assets", removed.size()));
 
-    return _parent->save_or_restore_tree();
+    return core::Ok();
 }
 
 FileSystemModel::Result<> FolderAssetStore::FolderFileSystemModel::rename(std::string_view from, std::string_view to) const {
@@ -296,55 +287,24 @@ FileSystemModel::Result<> FolderAssetStore::FolderFileSystemModel::rename(std::s
 
     const auto lock = y_profile_unique_lock(_parent->_lock);
 
-    std::map<core::String, AssetData> new_assets;
-    {
-        for(const auto &[name, data] : _parent->_assets) {
-            if(is_strict_indirect_parent(from, name) || from == name) {
-                const std::string_view end = name.sub_str(from.size() + 1);
-                const core::String new_name = end.empty() ? core::String(to) : join(to, end);
-
-                if(_parent->_assets.emplace(new_name, data).second) {
-                    if(auto r = _parent->load_desc(data.id)) {
-                        AssetDesc desc = std::move(r.unwrap());
-                        desc.name = new_name;
-                        if(_parent->save_desc(data.id, desc)) {
-                            new_assets[new_name] = data;
-                            continue;
-                        }
-                    }
-                }
-
-                _parent->reload_all().ignore();
-                return core::Err();
-            } else {
-                y_debug_assert(!is_strict_direct_parent(from, name));
-                new_assets[name] = data;
-            }
-        }
+    core::Vector<AssetId> renamed;
+    if(!_parent->apply_rename(from, to, &renamed)) {
+        return core::Err();
     }
 
-    std::set<core::String> new_folders;
-    {
-        for(const core::String& folder : _parent->_folders) {
-            core::String new_name = folder;
-
-            if(is_strict_indirect_parent(from, folder)) {
-                const std::string_view end = folder.sub_str(from.size() + 1);
-                new_name = join(to, end);
-                y_debug_assert(!end.empty());
-            } else if(from == folder) {
-                new_name = to;
-            }
+    if(!_parent->journal_or_restore(JournalOp::Rename, AssetData{}, from, to)) {
+        return core::Err();
+    }
 
-            new_folders.insert(new_name);
+    // Descs are only read to rebuild the index, failing to update them isn't fatal
+    for(const AssetId id : renamed) {
+        const AssetData& asset = _parent->_assets.find(id)->second;
+        if(!_parent->save_desc(id, AssetDesc{asset.name, asset.type, asset.content_hash})) {
+            log_msg(fmt("Unable to update desc of \"%\"", asset.name), Log::Warning);
         }
     }
 
-    _parent->_ids = nullptr;
-    std::swap(new_folders, _parent->_folders);
-    std::swap(new_assets, _parent->_assets);
-
-    return _parent->save_or_restore_tree();
+    return core::Ok();
 }
 
 
@@ -354,7 +314,11 @@ FileSystemModel::Result<> FolderAssetStore::FolderFileSystemModel::rename(std::s
 
 
 
-FolderAssetStore::FolderAssetStore(const core::String& root) : _root(FileSystemModel::local_filesystem()->absolute(root).unwrap_or(root)), _filesystem(this) {
+FolderAssetStore::FolderAssetStore(const core::String& root, bool compress_data) :
+        _root(FileSystemModel::local_filesystem()->absolute(root).unwrap_or(root)),
+        _compress_data(compress_data),
+        _journal(journal_magic, index_version),
+        _filesystem(this) {
     y_profile();
 
     FileSystemModel::local_filesystem()->create_directory(_root).unwrap();
@@ -373,15 +337,19 @@ core::String FolderAssetStore::asset_desc_file_name(AssetId id) const {
     return _filesystem.join(_root, fmt("%.desc", stringify_id(id)));
 }
 
-
 core::String FolderAssetStore::tree_file_name() const {
     const auto* fs = FileSystemModel::local_filesystem();
     return fs->join(_root, ".tree");
 }
 
-core::String FolderAssetStore::next_id_file_name() const {
+core::String FolderAssetStore::index_file_name() const {
     const auto* fs = FileSystemModel::local_filesystem();
-    return fs->join(_root, ".next_id");
+    return fs->join(_root, ".index");
+}
+
+core::String FolderAssetStore::journal_file_name() const {
+    const auto* fs = FileSystemModel::local_filesystem();
+    return fs->join(_root, ".journal");
 }
 
 AssetStore::Result<FolderAssetStore::AssetDesc> FolderAssetStore::load_desc(AssetId id) const {
@@ -396,6 +364,7 @@ AssetStore::Result<FolderAssetStore::AssetDesc> FolderAssetStore::load_desc(Asse
 
     AssetDesc desc;
 
+    // name, type and content hash, one per line. Older descs don't have a content hash.
     const char* data = reinterpret_cast<const char*>(buffer.data());
     for(usize i = 0; i != buffer.size(); ++i) {
         const char c = data[i];
@@ -406,8 +375,15 @@ AssetStore::Result<FolderAssetStore::AssetDesc> FolderAssetStore::load_desc(Asse
             const std::string_view trimmed = core::trim(leftover);
 
             u32 type = 0;
-            if(std::from_chars(trimmed.data(), trimmed.data() + trimmed.size(), type).ec == std::errc()) {
+            const auto [type_end, ec] = std::from_chars(trimmed.data(), trimmed.data() + trimmed.size(), type);
+            if(ec == std::errc()) {
                 desc.type = AssetType(type);
+
+                const std::string_view hash = core::trim(std::string_view(type_end, trimmed.data() + trimmed.size() - type_end));
+                if(!hash.empty() && !parse_content_hash(hash, desc.content_hash)) {
+                    log_msg(fmt("Invalid content hash for \"%\"", desc.name), Log::Warning);
+                }
+
                 return core::Ok(std::move(desc));
             }
 
@@ -421,7 +397,9 @@ AssetStore::Result<FolderAssetStore::AssetDesc> FolderAssetStore::load_desc(Asse
 AssetStore::Result<> FolderAssetStore::save_desc(AssetId id, const AssetDesc& desc) const {
     y_profile();
 
-    const std::string_view data = fmt("%\n%\n", desc.name, desc.type);
+    const std::string_view data = desc.content_hash == ContentHashValue()
+        ? fmt("%\n%\n", desc.name, desc.type)
+        : fmt("%\n%\n%\n", desc.name, desc.type, stringify_content_hash(desc.content_hash));
 
     const core::String file_name = asset_desc_file_name(id);
     const core::String tmp_file = file_name + "_";
@@ -437,21 +415,6 @@ AssetStore::Result<> FolderAssetStore::save_desc(AssetId id, const AssetDesc& de
     return core::Ok();
 }
 
-void FolderAssetStore::rebuild_id_map() const {
-    y_profile();
-
-    const auto lock = y_profile_unique_lock(_lock);
-
-    if(!_ids) {
-        _ids = std::make_unique<std::remove_reference_t<decltype(*_ids)>>();
-        _ids->reserve(_assets.size());
-
-        for(auto it = _assets.begin(); it != _assets.end(); ++it) {
-            (*_ids)[it->second.id] = it;
-        }
-    }
-}
-
 const FileSystemModel* FolderAssetStore::filesystem() const {
     return &_filesystem;
 }
@@ -471,26 +434,25 @@ AssetStore::Result<AssetId> FolderAssetStore::import(io2::Reader& data, std::str
         return core::Err(ErrorType::FilesytemError);
     }
 
-    if(_assets.find(dst_name) != _assets.end()) {
+    if(_names.contains(dst_name)) {
         return core::Err(ErrorType::NameAlreadyExists);
     }
 
     const AssetId id = next_id();
-    const core::String data_file_name = asset_data_file_name(id);
 
-    {
-        y_profile_zone("writing");
-        if(!io2::File::copy(data, data_file_name)) {
-            return core::Err(ErrorType::FilesytemError);
-        }
-    }
+    auto written = write_data(id, data);
+    y_try(written);
+
+    const AssetData asset = { id, type, written.unwrap().file_size, written.unwrap().content_hash, dst_name };
+    y_try(save_desc(id, AssetDesc{asset.name, type, asset.content_hash}));
 
-    const AssetDesc desc = { dst_name, type };
-    y_try(save_desc(id, desc));
+    apply_import(asset);
 
-    const auto it = _assets.emplace(dst_name, AssetData{id, type}).first;
-    if(_ids) {
-        (*_ids)[id] = it;
+    if(auto r = journal_or_restore(JournalOp::Import, asset, asset.name); !r) {
+        const FileSystemModel* fs = FileSystemModel::local_filesystem();
+        fs->remove(asset_desc_file_name(id)).ignore();
+        fs->remove(asset_data_file_name(id)).ignore();
+        return core::Err(r.error());
     }
 
     return core::Ok(id);
@@ -505,16 +467,153 @@ AssetStore::Result<> FolderAssetStore::write(AssetId id, io2::Reader& data) {
 
     const auto lock = y_profile_unique_lock(_lock);
 
-    const core::String data_file_name = asset_data_file_name(id);
-    if(!io2::File::open(data_file_name)) {
+    if(!_assets.contains(id)) {
         return core::Err(ErrorType::UnknownID);
     }
 
-    if(!io2::File::copy(data, data_file_name)) {
+    auto written = write_data(id, data);
+    y_try(written);
+
+    apply_write(id, written.unwrap());
+
+    const AssetData& asset = _assets.find(id)->second;
+    y_try(save_desc(id, AssetDesc{asset.name, asset.type, asset.content_hash}));
+
+    return journal_or_restore(JournalOp::Write, asset, asset.name);
+}
+
+AssetStore::Result<FolderAssetStore::WrittenData> FolderAssetStore::write_data(AssetId id, io2::Reader& data) {
+    y_profile();
+
+    const auto lock = y_profile_unique_lock(_lock);
+
+    const core::String data_file_name = asset_data_file_name(id);
+    const core::String tmp_file = data_file_name + "_";
+
+    ContentHash128 hash;
+    u64 file_size = 0;
+
+    {
+        y_profile_zone("writing");
+
+        auto file = io2::File::create(tmp_file);
+        if(!file) {
+            return core::Err(ErrorType::FilesytemError);
+        }
+
+        // The content hash is computed on the uncompressed data, so compressed and uncompressed copies can be shared
+        std::unique_ptr<io2::CompressedWriter> compressed;
+        if(_compress_data) {
+            compressed = std::make_unique<io2::CompressedWriter>(file.unwrap());
+        }
+        io2::Writer& writer = compressed ? *compressed : static_cast<io2::Writer&>(file.unwrap());
+
+        core::FixedArray<u8> buffer(64 * 1024);
+        while(!data.at_end()) {
+            const auto read = data.read_up_to(buffer.data(), buffer.size());
+            if(!read) {
+                return core::Err(ErrorType::FilesytemError);
+            }
+
+            if(!read.unwrap()) {
+                break;
+            }
+
+            hash.add(buffer.data(), read.unwrap());
+            if(!writer.write(buffer.data(), read.unwrap())) {
+                return core::Err(ErrorType::FilesytemError);
+            }
+
+            file_size += read.unwrap();
+        }
+
+        if(!writer.flush()) {
+            return core::Err(ErrorType::FilesytemError);
+        }
+    }
+
+    const WrittenData written = { hash.hash(), file_size };
+    const FileSystemModel* fs = FileSystemModel::local_filesystem();
+
+    // Data files are never modified in place, only replaced, so they can be shared between assets
+    if(const AssetId original = find_content(written.content_hash, id); original != AssetId::invalid_id()) {
+        y_profile_zone("linking");
+
+        const core::String link_file = data_file_name + "_link";
+
+        std::error_code ec;
+        fs::remove(fs::path(link_file.data()), ec);
+        fs::create_hard_link(fs::path(asset_data_file_name(original).data()), fs::path(link_file.data()), ec);
+
+        if(!ec) {
+            if(fs->rename(link_file, data_file_name)) {
+                fs->remove(tmp_file).ignore();
+                return core::Ok(written);
+            }
+            fs->remove(link_file).ignore();
+        }
+
+        log_msg(fmt("Unable to share data between % and %", stringify_id(id), stringify_id(original)), Log::Warning);
+    }
+
+    if(!fs->rename(tmp_file, data_file_name)) {
         return core::Err(ErrorType::FilesytemError);
     }
 
-    return core::Ok();
+    return core::Ok(written);
+}
+
+void FolderAssetStore::register_content(AssetId id, const ContentHashValue& content_hash) {
+    const auto lock = y_profile_unique_lock(_lock);
+
+    if(content_hash == ContentHashValue()) {
+        return;
+    }
+
+    auto& ids = _content_ids[content_hash];
+    if(std::find(ids.begin(), ids.end(), id) == ids.end()) {
+        ids << id;
+    }
+}
+
+AssetId FolderAssetStore::find_content(const ContentHashValue& content_hash, AssetId except) {
+    const auto lock = y_profile_unique_lock(_lock);
+
+    const auto it = _content_ids.find(content_hash);
+    if(it == _content_ids.end()) {
+        return AssetId::invalid_id();
+    }
+
+    auto& ids = it->second;
+    for(usize i = 0; i != ids.size();) {
+        const auto asset_it = _assets.find(ids[i]);
+        if(asset_it == _assets.end() || asset_it->second.content_hash != content_hash) {
+            // Removed or rewritten since
+            ids.erase_unordered(ids.begin() + i);
+            continue;
+        }
+
+        if(ids[i] != except) {
+            return ids[i];
+        }
+        ++i;
+    }
+
+    return AssetId::invalid_id();
+}
+
+AssetStore::Result<FolderAssetStore::ContentHashValue> FolderAssetStore::content_hash(AssetId id) const {
+    if(id == AssetId::invalid_id()) {
+        return core::Err(ErrorType::UnknownID);
+    }
+
+    const auto lock = y_profile_unique_lock(_lock);
+
+    if(const auto it = _assets.find(id); it != _assets.end()) {
+        return core::Ok(it->second.content_hash);
+    }
+
+    return core::Err(ErrorType::UnknownID);
 }
 
 AssetStore::Result<io2::ReaderPtr> FolderAssetStore::data(AssetId id) const {
@@ -524,21 +623,46 @@ AssetStore::Result<io2::ReaderPtr> FolderAssetStore::data(AssetId id) const {
         return core::Err(ErrorType::UnknownID);
     }
 
-    if(auto file = io2::File::open(asset_data_file_name(id))) {
-        io2::ReaderPtr ptr = std::make_unique<io2::File>(std::move(file.unwrap()));
-        return core::Ok(std::move(ptr));
+    const core::String file_name = asset_data_file_name(id);
+
+    // Data files might be compressed regardless of _compress_data, if it has been changed since they were written
+    const auto decompress = [](io2::ReaderPtr ptr) -> Result<io2::ReaderPtr> {
+        auto reader = io2::CompressedReader::open_if_compressed(std::move(ptr));
+        if(!reader) {
+            return core::Err(ErrorType::FilesytemError);
+        }
+        return core::Ok(std::move(reader.unwrap()));
+    };
+
+    // Mapped files are much cheaper to deserialize from: no stdio and collections are copied in bulk
+    if(auto file = io2::MappedFile::open(file_name)) {
+        return decompress(std::make_unique<io2::MappedFile>(std::move(file.unwrap())));
+    }
+
+    if(auto file = io2::File::open(file_name)) {
+        return decompress(std::make_unique<io2::File>(std::move(file.unwrap())));
     }
 
     return core::Err(ErrorType::UnknownID);
 }
 
+AssetStore::Result<AssetStore::DataLocation> FolderAssetStore::data_location(AssetId id) const {
+    if(id == AssetId::invalid_id()) {
+        return core::Err(ErrorType::UnknownID);
+    }
+
+    DataLocation location;
+    location.file_name = asset_data_file_name(id);
+    return core::Ok(std::move(location));
+}
+
 AssetStore::Result<AssetId> FolderAssetStore::id(std::string_view name) const {
     y_profile();
 
     const auto lock = y_profile_unique_lock(_lock);
 
-    if(const auto it = _assets.find(name); it != _assets.end()) {
-        return core::Ok(it->second.id);
+    if(const auto it = _names.find(name); it != _names.end()) {
+        return core::Ok(it->second);
     }
 
     return core::Err(ErrorType::UnknownID);
@@ -553,9 +677,8 @@ AssetStore::Result<core::String> FolderAssetStore::name(AssetId id) const {
 
     const auto lock = y_profile_unique_lock(_lock);
 
-    rebuild_id_map();
-    if(const auto it = _ids->find(id); it != _ids->end()) {
-        return core::Ok(core::String(it->second->first));
+    if(const auto it = _assets.find(id); it != _assets.end()) {
+        return core::Ok(core::String(it->second.name));
     }
 
     return core::Err(ErrorType::UnknownID);
@@ -624,9 +747,8 @@ AssetStore::Result<AssetType> FolderAssetStore::asset_type(AssetId id) const {
 
     const auto lock = y_profile_unique_lock(_lock);
 
-    rebuild_id_map();
-    if(const auto it = _ids->find(id); it != _ids->end()) {
-        return core::Ok(it->second->second.type);
+    if(const auto it = _assets.find(id); it != _assets.end()) {
+        return core::Ok(it->second.type);
     }
 
     return core::Err(ErrorType::UnknownID);
@@ -642,20 +764,394 @@ AssetId FolderAssetStore::next_id() {
 
 
 
+bool FolderAssetStore::apply_import(const AssetData& asset) {
+    if(_names.contains(asset.name) || _assets.contains(asset.id)) {
+        return false;
+    }
+
+    apply_create_folder(strict_parent_path(asset.name));
 
+    AssetData& asset_data = _assets.emplace(asset.id, asset).first->second;
+    _names.emplace(asset_data.name, asset_data.id);
+    add_asset_to_folder(asset_data);
 
+    register_content(asset.id, asset.content_hash);
+
+    // Ids are time based, make sure we never reuse one if the store is reopened quickly
+    _next_id = std::max(_next_id, asset.id.id() + 1);
+
+    return true;
+}
+
+bool FolderAssetStore::apply_write(AssetId id, const WrittenData& data) {
+    const auto it = _assets.find(id);
+    if(it == _assets.end()) {
+        return false;
+    }
+
+    it->second.content_hash = data.content_hash;
+    it->second.file_size = data.file_size;
+
+    register_content(id, data.content_hash);
+
+    return true;
+}
+
+bool FolderAssetStore::apply_create_folder(std::string_view path) {
+    if(path.empty() || _folders.contains(path)) {
+        return false;
+    }
+
+    apply_create_folder(strict_parent_path(path));
+
+    _folders.emplace(path);
+    add_subfolder(path);
+    _tree_changed = true;
+
+    return true;
+}
+
+bool FolderAssetStore::apply_remove(std::string_view path, core::Vector<AssetId>* removed) {
+    if(path.empty()) {
+        return false;
+    }
+
+    if(const auto it = _names.find(path); it != _names.end()) {
+        const AssetId id = it->second;
+        remove_asset_from_folder(_assets.find(id)->second);
+        _names.erase(it);
+        _assets.erase(id);
+
+        if(removed) {
+            removed->push_back(id);
+        }
+        return true;
+    }
+
+    if(!_folders.contains(path)) {
+        return false;
+    }
+
+    core::Vector<core::String> folders;
+    core::Vector<AssetId> assets;
+    collect_subtree(path, folders, assets);
+
+    // Folder asset lists are dropped along with the folders, no need to maintain them
+    for(const AssetId id : assets) {
+        const auto it = _assets.find(id);
+        _names.erase(it->second.name);
+        _assets.erase(it);
+    }
+
+    remove_subfolder(path);
+    for(const core::String& folder : folders) {
+        _folders.erase(folder);
+    }
+    _tree_changed = true;
+
+    if(removed) {
+        removed->push_back(assets.begin(), assets.end());
+    }
+    return true;
+}
+
+bool FolderAssetStore::apply_rename(std::string_view from, std::string_view to, core::Vector<AssetId>* renamed) {
+    if(from.empty() || to.empty() || from == to) {
+        return false;
+    }
+
+    if(_names.contains(to) || _folders.contains(to) || is_strict_indirect_parent(from, to)) {
+        return false;
+    }
+
+    if(const auto it = _names.find(from); it != _names.end()) {
+        const AssetId id = it->second;
+        _names.erase(it);
+
+        AssetData& asset = _assets.find(id)->second;
+        remove_asset_from_folder(asset);
+
+        apply_create_folder(strict_parent_path(to));
+
+        asset.name = to;
+        _names.emplace(asset.name, id);
+        add_asset_to_folder(asset);
+
+        if(renamed) {
+            renamed->push_back(id);
+        }
+        return true;
+    }
+
+    if(!_folders.contains(from)) {
+        return false;
+    }
+
+    core::Vector<core::String> folders;
+    core::Vector<AssetId> assets;
+    collect_subtree(from, folders, assets);
+
+    apply_create_folder(strict_parent_path(to));
+    remove_subfolder(from);
+
+    {
+        // Take everything out first: re-inserting might rehash
+        core::Vector<std::pair<core::String, FolderData>> moved = core::vector_with_capacity<std::pair<core::String, FolderData>>(folders.size());
+        for(const core::String& folder : folders) {
+            const auto it = _folders.find(folder);
+            moved.emplace_back(replace_prefix(folder, from, to), std::move(it->second));
+            _folders.erase(it);
+        }
+
+        for(auto& [folder, data] : moved) {
+            // Replacing a common prefix keeps subfolders sorted
+            for(core::String& sub_folder : data.folders) {
+                sub_folder = replace_prefix(sub_folder, from, to);
+            }
+            _folders.emplace(folder, std::move(data));
+        }
+    }
+
+    add_subfolder(to);
+    _tree_changed = true;
+
+    // Assets keep their position in their (moved) folder
+    for(const AssetId id : assets) {
+        AssetData& asset = _assets.find(id)->second;
+        _names.erase(asset.name);
+        asset.name = replace_prefix(asset.name, from, to);
+        _names.emplace(asset.name, id);
+    }
+
+    if(renamed) {
+        renamed->push_back(assets.begin(), assets.end());
+    }
+    return true;
+}
+
+void FolderAssetStore::add_asset_to_folder(AssetData& asset) {
+    FolderData& folder = _folders.find(strict_parent_path(asset.name))->second;
+    asset.folder_index = folder.assets.size();
+    folder.assets << asset.id;
+}
+
+void FolderAssetStore::remove_asset_from_folder(const AssetData& asset) {
+    FolderData& folder = _folders.find(strict_parent_path(asset.name))->second;
+    y_debug_assert(folder.assets[asset.folder_index] == asset.id);
+
+    const AssetId last = folder.assets.last();
+    folder.assets[asset.folder_index] = last;
+    _assets.find(last)->second.folder_index = asset.folder_index;
+    folder.assets.pop();
+}
+
+void FolderAssetStore::add_subfolder(std::string_view path) {
+    core::Vector<core::String>& sub_folders = _folders.find(strict_parent_path(path))->second.folders;
+    const auto it = std::lower_bound(sub_folders.begin(), sub_folders.end(), path, [](const core::String& a, std::string_view b) { return std::string_view(a) < b; });
+    if(it == sub_folders.end() || std::string_view(*it) != path) {
+        sub_folders.insert(it, core::String(path));
+    }
+}
+
+void FolderAssetStore::remove_subfolder(std::string_view path) {
+    core::Vector<core::String>& sub_folders = _folders.find(strict_parent_path(path))->second.folders;
+    const auto it = std::lower_bound(sub_folders.begin(), sub_folders.end(), path, [](const core::String& a, std::string_view b) { return std::string_view(a) < b; });
+    if(it != sub_folders.end() && std::string_view(*it) == path) {
+        sub_folders.erase(it);
+    }
+}
+
+void FolderAssetStore::collect_subtree(std::string_view path, core::Vector<core::String>& folders, core::Vector<AssetId>& assets) const {
+    const auto it = _folders.find(path);
+    if(it == _folders.end()) {
+        return;
+    }
+
+    folders.emplace_back(path);
+    assets.push_back(it->second.assets.begin(), it->second.assets.end());
+
+    for(const core::String& sub_folder : it->second.folders) {
+        collect_subtree(sub_folder, folders, assets);
+    }
+}
+
+
+
+
+
+FolderAssetStore::Result<> FolderAssetStore::journal_or_restore(JournalOp op, const AssetData& asset, std::string_view name, std::string_view other_name) {
+    y_profile();
+
+    const auto lock = y_profile_unique_lock(_lock);
+
+    if(!append_journal(op, asset, name, other_name)) {
+        log_msg("Failed to write asset journal", Log::Error);
+        reload_all().ignore();
+        return core::Err(ErrorType::FilesytemError);
+    }
+
+    // Empty folders can't be recovered from the descs if the index is lost
+    if(_tree_changed && !save_tree()) {
+        log_msg("Failed to save folder tree", Log::Warning);
+    }
+
+    return core::Ok();
+}
+
+FolderAssetStore::Result<> FolderAssetStore::append_journal(JournalOp op, const AssetData& asset, std::string_view name, std::string_view other_name) {
+    y_profile();
+
+    const auto lock = y_profile_unique_lock(_lock);
+
+    JournalRecord record;
+    record.op = u32(op);
+    record.type = u32(asset.type);
+    record.id = asset.id.id();
+    record.content_hash = asset.content_hash;
+    record.file_size = asset.file_size;
+
+    y_try(_journal.append(record, name, other_name));
+
+    if(_journal.record_count() >= checkpoint_interval) {
+        if(!save_index()) {
+            log_msg("Failed to checkpoint asset index", Log::Warning);
+        }
+    }
+
+    return core::Ok();
+}
+
+FolderAssetStore::Result<> FolderAssetStore::replay_journal() {
+    y_profile();
+
+    const auto lock = y_profile_unique_lock(_lock);
+
+    return _journal.replay<JournalRecord>(journal_file_name(), _generation, [&](const JournalRecord& record, std::string_view name, std::string_view other_name) {
+        switch(JournalOp(record.op)) {
+            case JournalOp::Import:
+                apply_import(AssetData{AssetId::from_id(record.id), AssetType(record.type), record.file_size, record.content_hash, name});
+            break;
+
+            case JournalOp::Write:
+                apply_write(AssetId::from_id(record.id), WrittenData{record.content_hash, record.file_size});
+            break;
+
+            case JournalOp::CreateFolder:
+                apply_create_folder(name);
+            break;
+
+            case JournalOp::Remove:
+                apply_remove(name);
+            break;
+
+            case JournalOp::Rename:
+                apply_rename(name, other_name);
+            break;
+
+            default:
+                log_msg(fmt("Unknown journal operation: %", record.op), Log::Error);
+        }
+    });
+}
+
+FolderAssetStore::Result<> FolderAssetStore::load_index() {
+    y_profile();
+
+    const auto lock = y_profile_unique_lock(_lock);
+
+    core::Vector<byte> data;
+    if(auto file = io2::File::open(index_file_name()); file.is_error() || file.unwrap().read_all(data).is_error()) {
+        return core::Err(ErrorType::FilesytemError);
+    }
+
+    auto parsed = AssetIndexReader<IndexHeader, IndexEntry>::parse(data);
+    if(!parsed) {
+        return core::Err(parsed.error());
+    }
+
+    const auto& index = parsed.unwrap();
+    const IndexHeader& header = index.header();
+
+    _generation = header.generation;
+    _next_id = std::max(_next_id, header.next_id);
+
+    {
+        y_profile_zone("Reading folders");
+        _folders.reserve(header.folder_count + 1);
+        for(u32 i = 0; i != header.folder_count; ++i) {
+            apply_create_folder(index.name(index.folder(i)));
+        }
+    }
+
+    {
+        y_profile_zone("Reading assets");
+        _assets.reserve(header.asset_count);
+        _names.reserve(header.asset_count);
+        for(u32 i = 0; i != header.asset_count; ++i) {
+            const IndexEntry entry = index.entry(i);
+
+            const std::string_view name = index.name(entry);
+            if(name.empty() || !apply_import(AssetData{AssetId::from_id(entry.id), AssetType(entry.type), entry.file_size, entry.content_hash, name})) {
+                log_msg("Invalid asset index entry", Log::Error);
+            }
+        }
+    }
+
+    return core::Ok();
+}
+
+FolderAssetStore::Result<> FolderAssetStore::save_index() {
+    y_profile();
+
+    const auto lock = y_profile_unique_lock(_lock);
+
+    AssetIndexWriter<IndexHeader, IndexEntry> index(_assets.size(), _folders.size());
+
+    for(const AssetData& asset : _assets.values()) {
+        IndexEntry entry;
+        entry.id = asset.id.id();
+        entry.content_hash = asset.content_hash;
+        entry.file_size = asset.file_size;
+        entry.type = u32(asset.type);
+        index.add_entry(entry, asset.name);
+    }
+
+    for(const auto& [folder, data] : _folders) {
+        // Only empty folders need to be saved, but they are cheap
+        if(!folder.is_empty()) {
+            index.add_folder(folder);
+        }
+    }
+
+    IndexHeader header;
+    header.generation = _generation + 1;
+    header.next_id = _next_id;
+
+    y_try(index.write(index_file_name(), header));
+
+    if(!save_tree()) {
+        log_msg("Failed to save folder tree", Log::Warning);
+    }
+
+    // The previous journal is now obsolete: its generation doesn't match the index anymore
+    _generation = header.generation;
+    return _journal.create(journal_file_name(), _generation);
+}
 
 FolderAssetStore::Result<> FolderAssetStore::load_tree() {
     y_profile();
 
     const auto lock = y_profile_unique_lock(_lock);
 
-    _folders.clear();
+    const core::String file_name = tree_file_name();
+    if(!FileSystemModel::local_filesystem()->exists(file_name).unwrap_or(false)) {
+        // New store
+        return core::Ok();
+    }
 
     core::Vector<byte> tree_data;
-    if(auto file = io2::File::open(tree_file_name()); file.is_error() || file.unwrap().read_all(tree_data).is_error()) {
-        log_msg("Unable to open folder index", Log::Error);
-        return core::Ok(); // ????
+    if(auto file = io2::File::open(file_name); file.is_error() || file.unwrap().read_all(tree_data).is_error()) {
+        return core::Err(ErrorType::FilesytemError);
     }
 
     // Folders
@@ -664,7 +1160,7 @@ FolderAssetStore::Result<> FolderAssetStore::load_tree() {
         auto push_folder = [&] {
             if(!line.is_empty()) {
                 y_debug_assert(is_valid_path(line));
-                _folders.insert(std::move(line));
+                apply_create_folder(line);
                 line.make_empty();
             }
         };
@@ -682,50 +1178,32 @@ FolderAssetStore::Result<> FolderAssetStore::load_tree() {
     return core::Ok();
 }
 
-FolderAssetStore::Result<> FolderAssetStore::save_tree() const {
+FolderAssetStore::Result<> FolderAssetStore::save_tree() {
     y_profile();
 
     const auto lock = y_profile_unique_lock(_lock);
 
     core::String tree_data;
-    {
-        for(const core::String& folder : _folders) {
-            y_debug_assert(is_valid_path(folder));
-            y_debug_assert(std::string_view(folder) == strict_path(folder));
-            y_debug_assert(_filesystem.is_directory(strict_parent_path(folder)).unwrap_or(false));
-
+    for(const auto& [folder, data] : _folders) {
+        // Folders with assets are recreated from the descs, but they are cheap
+        if(!folder.is_empty()) {
             tree_data += folder;
             tree_data += "\n";
         }
     }
 
-    {
-        const core::String file_name = tree_file_name();
-        const core::String tmp_file = file_name + "_";
-
-        Y_TODO(Openning file is slow, maybe we should cache it)
-        if(auto file = io2::File::create(tmp_file); file.is_error() || file.unwrap().write_array(tree_data.data(), tree_data.size()).is_error()) {
-            return core::Err(ErrorType::FilesytemError);
-        }
+    const core::String file_name = tree_file_name();
+    const core::String tmp_file = file_name + "_";
 
-        if(!FileSystemModel::local_filesystem()->rename(tmp_file, file_name)) {
-            return core::Err(ErrorType::FilesytemError);
-        }
+    if(auto file = io2::File::create(tmp_file); file.is_error() || file.unwrap().write_array(tree_data.data(), tree_data.size()).is_error()) {
+        return core::Err(ErrorType::FilesytemError);
     }
 
-    return core::Ok();
-}
-
-FolderAssetStore::Result<> FolderAssetStore::save_or_restore_tree() {
-    y_profile();
-
-    const auto lock = y_profile_unique_lock(_lock);
-
-    if(!save_tree()) {
-        load_tree().unwrap();
-        log_msg("Failed to save tree", Log::Error);
+    if(!FileSystemModel::local_filesystem()->rename(tmp_file, file_name)) {
         return core::Err(ErrorType::FilesytemError);
     }
+
+    _tree_changed = false;
     return core::Ok();
 }
 
@@ -734,9 +1212,6 @@ FolderAssetStore::Result<> FolderAssetStore::load_asset_descs() {
 
     const auto lock = y_profile_unique_lock(_lock);
 
-    _ids = nullptr;
-    _assets.clear();
-
     core::Vector<u64> desc_ids;
     core::FlatHashMap<u64, usize> asset_sizes;
 
@@ -778,7 +1253,7 @@ FolderAssetStore::Result<> FolderAssetStore::load_asset_descs() {
     core::Vector<core::Vector<std::pair<AssetDesc, AssetData>>> assets;
     {
         y_profile_zone("Reading descs");
-        concurrent::StaticThreadPool thread_pool;
+        concurrent::WorkStealingThreadPool thread_pool;
 
         const usize tasks = thread_pool.concurency() * 8 + 1;
         assets.set_min_size(tasks);
@@ -795,7 +1270,11 @@ FolderAssetStore::Result<> FolderAssetStore::load_asset_descs() {
                     const AssetId id = AssetId::from_id(uid);
                     if(auto r = load_desc(id)) {
                         AssetDesc desc = r.unwrap();
-                        AssetData data = { id, desc.type, 0 };
+                        // The name is set once the descs are merged
+                        AssetData data;
+                        data.id = id;
+                        data.type = desc.type;
+                        data.content_hash = desc.content_hash;
 
                         if(const auto it = asset_sizes.find(uid); it != asset_sizes.end()) {
                             data.file_size = it->second;
@@ -820,21 +1299,23 @@ FolderAssetStore::Result<> FolderAssetStore::load_asset_descs() {
         usize emergency_id = 1;
         for(auto& a : assets) {
             for(auto& [desc, data] : a) {
-                if(!_assets.emplace(desc.name, data).second) {
+                data.name = desc.name;
+
+                const std::string_view parent = strict_parent_path(desc.name);
+                if(!parent.empty() && !_folders.contains(parent)) {
+                    log_msg(fmt("\"%\" was not found in folder database", parent), Log::Warning);
+                }
+
+                if(!apply_import(data)) {
                     log_msg(fmt("\"%\" already exists in asset database", desc.name), Log::Error);
 
                     {
                         fmt_into(desc.name, "_(%)", emergency_id++);
-                        _assets.emplace(desc.name, data);
+                        data.name = desc.name;
+                        apply_import(data);
                         save_desc(data.id, desc).ignore();
                     }
                 }
-
-                if(auto parent = _filesystem.parent_path(desc.name); parent && !parent.unwrap().is_empty()) {
-                    if(_folders.insert(parent.unwrap()).second) {
-                        log_msg(fmt("\"%\" was not found in folder database", parent.unwrap()), Log::Warning);
-                    }
-                }
             }
         }
     }
@@ -842,16 +1323,53 @@ FolderAssetStore::Result<> FolderAssetStore::load_asset_descs() {
     return core::Ok();
 }
 
+void FolderAssetStore::clear_index() {
+    const auto lock = y_profile_unique_lock(_lock);
+
+    _assets.make_empty();
+    _names.make_empty();
+    _folders.make_empty();
+    _content_ids.make_empty();
+
+    // Root
+    _folders.emplace(std::string_view());
+
+    _journal.close();
+    _generation = 0;
+}
+
 FolderAssetStore::Result<> FolderAssetStore::reload_all() {
     y_profile();
 
     const auto lock = y_profile_unique_lock(_lock);
 
+    clear_index();
     _next_id = u64(std::time(nullptr));
-    load_tree().unwrap();
-    load_asset_descs().unwrap();
 
-    rebuild_id_map();
+    bool checkpoint = true;
+    if(load_index()) {
+        // A clean journal can be appended to, otherwise we checkpoint to start a new one
+        if(replay_journal() && _journal.reopen(journal_file_name())) {
+            checkpoint = false;
+        }
+    } else {
+        log_msg("Rebuilding asset index");
+
+        clear_index();
+        _next_id = u64(std::time(nullptr));
+
+        if(!load_tree()) {
+            log_msg("Unable to read folder tree, empty folders have been lost", Log::Error);
+        }
+        load_asset_descs().unwrap();
+    }
+
+    if(checkpoint && !save_index()) {
+        log_msg("Failed to save asset index", Log::Error);
+    }
+
+    // Loading recreates every folder, but the tree was saved along with the journal records
+    _tree_changed = false;
 
     return core::Ok();
 }
@@ -25,16 +25,21 @@ SOFTWARE.
 #include <yave/utils/FileSystemModel.h>
 
 #include "AssetStore.h"
+#include "AssetIndex.h"
 
 #include <y/core/String.h>
 #include <y/core/HashMap.h>
+#include <y/utils/hash.h>
+#include <y/io2/File.h>
 
 #include <mutex>
-#include <set>
-#include <map>
 
 namespace yave {
 
+// Asset names and folders are kept in hashed indices, persisted as a binary checkpoint plus an append-only journal of mutations.
+// The checkpoint is rewritten (and the journal cleared) every checkpoint_interval mutations and when the store is opened.
+// Each asset also has a desc file, and folders are listed in a tree file, used to rebuild the index if it goes missing.
+// Asset data can be block compressed, compressed and uncompressed data files can coexist in the same store.
 class FolderAssetStore final : NonMovable, public AssetStore {
 
     class FolderFileSystemModel final : public FileSystemModel {
@@ -65,19 +70,65 @@ class FolderAssetStore final : NonMovable, public AssetStore {
             FolderAssetStore* _parent = nullptr;
     };
 
+    using ContentHashValue = ContentHash128::Value;
+
     struct AssetData {
         AssetId id;
         AssetType type;
-        usize file_size;
+        u64 file_size = 0;
+        ContentHashValue content_hash = {};
+        core::String name;
+
+        // Position in the parent folder's asset list
+        usize folder_index = 0;
+    };
+
+    struct FolderData {
+        // Full names, sorted
+        core::Vector<core::String> folders;
+        core::Vector<AssetId> assets;
     };
 
     struct AssetDesc {
         core::String name;
         AssetType type;
+        ContentHashValue content_hash = {};
+    };
+
+    struct WrittenData {
+        ContentHashValue content_hash = {};
+        u64 file_size = 0;
+    };
+
+    enum class JournalOp : u32 {
+        Import = 1,
+        Write = 2,
+        CreateFolder = 3,
+        Remove = 4,
+        Rename = 5,
+    };
+
+    struct NameHash {
+        usize operator()(std::string_view name) const {
+            return std::hash<std::string_view>()(name);
+        }
+    };
+
+    struct NameEqual {
+        bool operator()(std::string_view a, std::string_view b) const {
+            return a == b;
+        }
     };
 
+    template<typename T>
+    using NameMap = core::FlatHashMap<core::String, T, NameHash, NameEqual>;
+
     public:
-        FolderAssetStore(const core::String& root = "./store");
+        // Number of journaled mutations between checkpoints
+        static constexpr usize checkpoint_interval = 4096;
+
+        // Only affects data written from now on
+        FolderAssetStore(const core::String& root = "./store", bool compress_data = false);
         ~FolderAssetStore() override;
 
         const FileSystemModel* filesystem() const override;
@@ -89,6 +140,7 @@ class FolderAssetStore final : NonMovable, public AssetStore {
         Result<core::String> name(AssetId id) const override;
 
         Result<io2::ReaderPtr> data(AssetId id) const override;
+        Result<DataLocation> data_location(AssetId id) const override;
 
         Result<> remove(AssetId id) override;
         Result<> rename(AssetId id, std::string_view new_name) override;
@@ -97,34 +149,71 @@ class FolderAssetStore final : NonMovable, public AssetStore {
 
         Result<AssetType> asset_type(AssetId id) const override;
 
+        // Assets with the same content share the same file.
+        // The loader does not alias them: each id is still loaded, and its GPU resources created, on its own.
+        Result<ContentHashValue> content_hash(AssetId id) const;
+
     private:
         AssetId next_id();
-        void rebuild_id_map() const;
 
         core::String tree_file_name() const;
-        core::String next_id_file_name() const;
+        core::String index_file_name() const;
+        core::String journal_file_name() const;
         core::String asset_data_file_name(AssetId id) const;
         core::String asset_desc_file_name(AssetId id) const;
 
         Result<AssetDesc> load_desc(AssetId id) const;
         Result<> save_desc(AssetId id, const AssetDesc& desc) const;
 
-        Result<> save_or_restore_tree();
+        Result<WrittenData> write_data(AssetId id, io2::Reader& data);
+        void register_content(AssetId id, const ContentHashValue& content_hash);
+        AssetId find_content(const ContentHashValue& content_hash, AssetId except);
 
-        Result<> load_tree();
-        Result<> save_tree() const;
+        // In memory mutations, shared by live operations and journal replay
+        bool apply_import(const AssetData& asset);
+        bool apply_write(AssetId id, const WrittenData& data);
+        bool apply_create_folder(std::string_view path);
+        bool apply_remove(std::string_view path, core::Vector<AssetId>* removed = nullptr);
+        bool apply_rename(std::string_view from, std::string_view to, core::Vector<AssetId>* renamed = nullptr);
+
+        void add_asset_to_folder(AssetData& asset);
+        void remove_asset_from_folder(const AssetData& asset);
+        void add_subfolder(std::string_view path);
+        void remove_subfolder(std::string_view path);
+        void collect_subtree(std::string_view path, core::Vector<core::String>& folders, core::Vector<AssetId>& assets) const;
 
+        // Restores the last persisted state if the record could not be written
+        Result<> journal_or_restore(JournalOp op, const AssetData& asset, std::string_view name, std::string_view other_name = {});
+        Result<> append_journal(JournalOp op, const AssetData& asset, std::string_view name, std::string_view other_name);
+        Result<> replay_journal();
+
+        Result<> load_index();
+        Result<> save_index();
+
+        Result<> load_tree();
+        Result<> save_tree();
         Result<> load_asset_descs();
 
+        void clear_index();
         Result<> reload_all();
 
         core::String _root;
+        bool _compress_data = false;
 
         u64 _next_id = 0;
-        std::set<core::String> _folders;
-        std::map<core::String, AssetData> _assets;
 
-        mutable std::unique_ptr<core::FlatHashMap<AssetId, std::map<core::String, AssetData>::const_iterator>> _ids;
+        core::FlatHashMap<AssetId, AssetData> _assets;
+        NameMap<AssetId> _names;
+        NameMap<FolderData> _folders;
+
+        // Set when folders have been created, removed or renamed since the tree was last saved
+        bool _tree_changed = false;
+
+        // Might contain removed assets or assets whose content changed, use find_content
+        core::FlatHashMap<ContentHashValue, core::Vector<AssetId>> _content_ids;
+
+        detail::AssetJournal _journal;
+        u64 _generation = 0;
 
         mutable std::recursive_mutex _lock;
 
@@ -23,8 +23,47 @@ SOFTWARE.
 #include "Frustum.h"
 #include "Camera.h"
 
+#if __has_include(<immintrin.h>)
+#include <immintrin.h>
+#if defined(__AVX__)
+#define YAVE_FRUSTUM_AVX
+#elif defined(__SSE2__) || defined(_M_X64)
+#define YAVE_FRUSTUM_SSE
+#endif
+#endif
+
 namespace yave {
 
+namespace simd {
+#if defined(YAVE_FRUSTUM_AVX)
+using f32x = __m256;
+static constexpr usize lanes = 8;
+
+static f32x load(const float* ptr) { return _mm256_loadu_ps(ptr); }
+static f32x splat(float f) { return _mm256_set1_ps(f); }
+static f32x add(f32x a, f32x b) { return _mm256_add_ps(a, b); }
+static f32x sub(f32x a, f32x b) { return _mm256_sub_ps(a, b); }
+static f32x mul(f32x a, f32x b) { return _mm256_mul_ps(a, b); }
+static u32 greater_equal_mask(f32x a, f32x b) { return u32(_mm256_movemask_ps(_mm256_cmp_ps(a, b, _CMP_GE_OQ))); }
+static u32 less_equal_mask(f32x a, f32x b) { return u32(_mm256_movemask_ps(_mm256_cmp_ps(a, b, _CMP_LE_OQ))); }
+#elif defined(YAVE_FRUSTUM_SSE)
+using f32x = __m128;
+static constexpr usize lanes = 4;
+
+static f32x load(const float* ptr) { return _mm_loadu_ps(ptr); }
+static f32x splat(float f) { return _mm_set1_ps(f); }
+static f32x add(f32x a, f32x b) { return _mm_add_ps(a, b); }
+static f32x sub(f32x a, f32x b) { return _mm_sub_ps(a, b); }
+static f32x mul(f32x a, f32x b) { return _mm_mul_ps(a, b); }
+static u32 greater_equal_mask(f32x a, f32x b) { return u32(_mm_movemask_ps(_mm_cmpge_ps(a, b))); }
+static u32 less_equal_mask(f32x a, f32x b) { return u32(_mm_movemask_ps(_mm_cmple_ps(a, b))); }
+#endif
+
+#if defined(YAVE_FRUSTUM_AVX) || defined(YAVE_FRUSTUM_SSE)
+static_assert(AABBBatch::size % lanes == 0);
+#endif
+}
+
 Frustum Frustum::from_view_proj(const math::Matrix4<>& view, const math::Matrix4<>& proj) {
     y_debug_assert(!Camera::is_proj_orthographic(proj));
 
@@ -166,6 +205,64 @@ Intersection Frustum::intersection(const AABB &aabb) const {
     return inter;
 }
 
+u32 Frustum::visible_mask(const AABBBatch& batch, float far_dist) const {
+    static constexpr u32 full_mask = (1u << AABBBatch::size) - 1;
+
+#if defined(YAVE_FRUSTUM_AVX) || defined(YAVE_FRUSTUM_SSE)
+    using namespace simd;
+
+    static constexpr u32 lane_mask = (1u << lanes) - 1;
+
+    u32 mask = 0;
+    for(usize first = 0; first != AABBBatch::size; first += lanes) {
+        // Same operations as intersection, one box per lane
+        const f32x bbox_min[3] = {
+            sub(load(batch.min_x.data() + first), splat(_pos.x())),
+            sub(load(batch.min_y.data() + first), splat(_pos.y())),
+            sub(load(batch.min_z.data() + first), splat(_pos.z())),
+        };
+        const f32x bbox_max[3] = {
+            sub(load(batch.max_x.data() + first), splat(_pos.x())),
+            sub(load(batch.max_y.data() + first), splat(_pos.y())),
+            sub(load(batch.max_z.data() + first), splat(_pos.z())),
+        };
+
+        const auto dot = [&](const math::Vec3& normal, bool max_if_positive) {
+            f32x sum = splat(0.0f);
+            for(usize c = 0; c != 3; ++c) {
+                const f32x p = (normal[c] > 0.0f) == max_if_positive ? bbox_max[c] : bbox_min[c];
+                sum = add(sum, mul(splat(normal[c]), p));
+            }
+            return sum;
+        };
+
+        u32 group_mask = lane_mask;
+        for(const Plane& plane : _planes) {
+            group_mask &= greater_equal_mask(dot(plane.normal, true), splat(plane.offset));
+            if(!group_mask) {
+                break;
+            }
+        }
+
+        if(group_mask && far_dist > 0.0f) {
+            group_mask &= less_equal_mask(dot(_planes[0].normal, false), splat(-far_dist));
+        }
+
+        mask |= group_mask << first;
+    }
+
+    return mask & full_mask;
+#else
+    u32 mask = 0;
+    for(usize i = 0; i != AABBBatch::size; ++i) {
+        if(intersection(batch.get(i), far_dist) != Intersection::Outside) {
+            mask |= 1u << i;
+        }
+    }
+    return mask & full_mask;
+#endif
+}
+
 Intersection Frustum::intersection(const AABB &aabb, float far_dist) const {
     const Intersection inter = intersection(aabb);
 
@@ -64,6 +64,10 @@ class Frustum {
 
         Intersection intersection(const AABB& aabb) const;
         Intersection intersection(const AABB& aabb, float far_dist) const;
+
+        // Returns a bit mask of the AABBs of the batch that are not outside the frustum (same test as intersection)
+        u32 visible_mask(const AABBBatch& batch, float far_dist = -1.0f) const;
+
     private:
         std::array<Plane, 5> _planes;
         math::Vec3 _pos;
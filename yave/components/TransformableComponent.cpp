@@ -22,8 +22,6 @@ SOFTWARE.
 
 #include "TransformableComponent.h"
 
-#include <yave/scene/OctreeNode.h>
-
 namespace yave {
 
 TransformableComponent::TransformableComponent(const math::Transform<>& transform) : _transform(transform) {
@@ -50,7 +48,6 @@ TransformableComponent& TransformableComponent::operator=(const TransformableCom
 void TransformableComponent::swap(TransformableComponent& other) {
     std::swap(_transform, other._transform);
     std::swap(_aabb, other._aabb);
-    std::swap(_node, other._node);
 }
 
 void TransformableComponent::set_transform(const math::Transform<>& tr) {
@@ -106,9 +103,5 @@ AABB TransformableComponent::global_aabb() const {
     return to_global(_aabb);
 }
 
-const OctreeNode* TransformableComponent::octree_node() const {
-    return _node;
-}
-
 }
 
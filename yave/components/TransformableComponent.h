@@ -24,7 +24,6 @@ SOFTWARE.
 
 #include <yave/systems/AABBUpdateSystem.h>
 
-#include <yave/scene/OctreeData.h>
 #include <yave/meshes/AABB.h>
 
 
@@ -60,20 +59,13 @@ class TransformableComponent final {
         const AABB& local_aabb() const;
         AABB global_aabb() const;
 
-        const OctreeNode* octree_node() const;
-
         y_reflect(TransformableComponent, _transform)
 
     private:
-        friend class Octree;
-        friend class OctreeSystem;
-
         void swap(TransformableComponent& other);
 
         math::Transform<> _transform;
         AABB _aabb;
-
-        mutable OctreeNode* _node = nullptr;
 };
 
 }
@@ -0,0 +1,232 @@
+/*******************************
+Copyright (c) 2016-2023 Grégoire Angerand
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+**********************************/
+#include "ArchetypeStorage.h"
+#include "ComponentContainer.h"
+
+#include <y/utils/log.h>
+#include <y/utils/format.h>
+
+namespace yave {
+namespace ecs {
+
+static constexpr u32 invalid_archetype = u32(-1);
+
+bool ArchetypeStorage::ArchetypeTable::contains(ComponentTypeIndex type) const {
+    return std::binary_search(types.begin(), types.end(), type);
+}
+
+u32 ArchetypeStorage::ArchetypeTable::offset(ComponentTypeIndex type) const {
+    const auto it = std::lower_bound(types.begin(), types.end(), type);
+    y_debug_assert(it != types.end() && *it == type);
+    return offsets[it - types.begin()];
+}
+
+bool ArchetypeStorage::is_dirty() const {
+    return _dirty;
+}
+
+bool ArchetypeStorage::is_dirty(core::Span<QueryCache::ComponentRule> rules) const {
+    if(!_dirty) {
+        return false;
+    }
+
+    // Sets that didn't change still have the layout of the last rebuild: entities that moved to another archetype
+    // because of changes in other sets are still in the range of their previous archetype, which matches the same rules.
+    return std::any_of(rules.begin(), rules.end(), [&](const auto& rule) {
+        return rule.type >= _dirty_types.size() || _dirty_types[rule.type];
+    });
+}
+
+bool ArchetypeStorage::should_rebuild() const {
+    return _dirty && (_changes * rebuild_ratio >= _entity_count || _dirty_ticks >= max_dirty_ticks);
+}
+
+void ArchetypeStorage::set_dirty(ComponentTypeIndex type, usize changes) {
+    _dirty = true;
+    _changes += changes;
+    _dirty_types.set_min_size(usize(type) + 1, false);
+    _dirty_types[type] = true;
+}
+
+void ArchetypeStorage::end_tick(core::Span<std::unique_ptr<ComponentContainerBase>> containers) {
+    if(!_dirty) {
+        return;
+    }
+
+    ++_dirty_ticks;
+    if(should_rebuild()) {
+        rebuild(containers);
+    }
+}
+
+core::Span<ArchetypeStorage::ArchetypeTable> ArchetypeStorage::tables() const {
+    return _tables;
+}
+
+void ArchetypeStorage::rebuild(core::Span<std::unique_ptr<ComponentContainerBase>> containers) {
+    y_profile();
+
+    u32 max_index = 0;
+    for(const auto& container : containers) {
+        if(container) {
+            for(const EntityId id : container->ids()) {
+                max_index = std::max(max_index, id.index());
+            }
+        }
+    }
+
+    // Every container splits the archetypes of its entities in two, archetype 0 has no components.
+    // Containers are indexed by type so signatures end up sorted.
+    core::Vector<u32> archetype_of(usize(max_index) + 1, 0);
+    core::Vector<core::Vector<ComponentTypeIndex>> signatures;
+    signatures.emplace_back();
+
+    {
+        y_profile_zone("computing signatures");
+        core::Vector<u32> split;
+        for(const auto& container : containers) {
+            if(!container || container->ids().is_empty()) {
+                continue;
+            }
+
+            split.make_empty();
+            split.set_min_size(signatures.size(), invalid_archetype);
+
+            for(const EntityId id : container->ids()) {
+                u32& archetype = archetype_of[id.index()];
+                if(split[archetype] == invalid_archetype) {
+                    split[archetype] = u32(signatures.size());
+                    core::Vector<ComponentTypeIndex> signature = signatures[archetype];
+                    signature << container->type_id();
+                    signatures.emplace_back(std::move(signature));
+                }
+                archetype = split[archetype];
+            }
+        }
+    }
+
+    // Entities are sorted by index inside their archetype
+    core::Vector<u32> rank(archetype_of.size(), 0);
+    core::Vector<u32> archetype_sizes(signatures.size(), 0);
+    for(usize i = 0; i != archetype_of.size(); ++i) {
+        rank[i] = archetype_sizes[archetype_of[i]]++;
+    }
+
+    _tables.make_empty();
+    _entity_count = 0;
+
+    core::Vector<u32> table_of(signatures.size(), invalid_archetype);
+    core::Vector<u32> next_offset(containers.size(), 0);
+    for(usize i = 1; i < signatures.size(); ++i) {
+        if(!archetype_sizes[i]) {
+            continue;
+        }
+
+        table_of[i] = u32(_tables.size());
+
+        ArchetypeTable& table = _tables.emplace_back();
+        table.types = std::move(signatures[i]);
+        table.size = archetype_sizes[i];
+        _entity_count += table.size;
+        for(const ComponentTypeIndex type : table.types) {
+            table.offsets << next_offset[type];
+            next_offset[type] += table.size;
+        }
+    }
+
+    {
+        y_profile_zone("reordering component sets");
+        core::Vector<u32> destinations;
+        core::Vector<u32> archetype_offsets;
+        for(const auto& container : containers) {
+            if(!container || container->ids().is_empty()) {
+                continue;
+            }
+
+            const ComponentTypeIndex type = container->type_id();
+            const core::Span<EntityId> ids = container->ids();
+
+            archetype_offsets.make_empty();
+            archetype_offsets.set_min_size(signatures.size(), invalid_archetype);
+            for(usize i = 0; i != signatures.size(); ++i) {
+                if(table_of[i] != invalid_archetype && _tables[table_of[i]].contains(type)) {
+                    archetype_offsets[i] = _tables[table_of[i]].offset(type);
+                }
+            }
+
+            destinations.make_empty();
+            destinations.set_min_capacity(ids.size());
+            for(const EntityId id : ids) {
+                const u32 index = id.index();
+                y_debug_assert(archetype_offsets[archetype_of[index]] != invalid_archetype);
+                destinations << archetype_offsets[archetype_of[index]] + rank[index];
+            }
+
+            container->permute(destinations);
+        }
+    }
+
+    _dirty = false;
+    _changes = 0;
+    _dirty_ticks = 0;
+    _dirty_types.make_empty();
+    _dirty_types.set_min_size(containers.size(), false);
+
+    y_profile_msg(fmt_c_str("% archetypes", _tables.size()));
+}
+
+core::Vector<EntityId> ArchetypeStorage::matching(core::Span<std::unique_ptr<ComponentContainerBase>> containers, core::Span<QueryCache::ComponentRule> rules) const {
+    y_debug_assert(!is_dirty(rules));
+
+    const auto first_included = std::find_if(rules.begin(), rules.end(), [](const auto& rule) { return rule.include; });
+    y_always_assert(first_included != rules.end(), "Query needs at least one inclusive matching rule");
+
+    const ComponentContainerBase* container = containers[first_included->type].get();
+    if(!container) {
+        return {};
+    }
+
+    const core::Span<EntityId> ids = container->ids();
+
+    usize total = 0;
+    core::Vector<std::pair<u32, u32>> ranges;
+    for(const ArchetypeTable& table : _tables) {
+        const bool matched = std::all_of(rules.begin(), rules.end(), [&](const auto& rule) {
+            return table.contains(rule.type) == rule.include;
+        });
+
+        if(matched) {
+            ranges.emplace_back(table.offset(first_included->type), table.size);
+            total += table.size;
+        }
+    }
+
+    auto result = core::vector_with_capacity<EntityId>(total);
+    for(const auto& [offset, size] : ranges) {
+        result.push_back(ids.begin() + offset, ids.begin() + offset + size);
+    }
+    return result;
+}
+
+}
+}
+
@@ -0,0 +1,79 @@
+/*******************************
+Copyright (c) 2016-2023 Grégoire Angerand
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+**********************************/
+#ifndef YAVE_ECS_ARCHETYPESTORAGE_H
+#define YAVE_ECS_ARCHETYPESTORAGE_H
+
+#include "Query.h"
+
+namespace yave {
+namespace ecs {
+
+// Optional storage layout for EntityWorld:
+// Component sets are reordered so that entities with the same component signature form a contiguous range,
+// in the same order, in every component set of the signature. Each archetype is then a SoA table spread over the sets.
+// Structural changes make the sets of the changed component types dirty, queries over dirty sets fall back to regular matching.
+// Rebuilding is O(n), so it only happens once enough changes have accumulated, or once the layout has been dirty for a while.
+class ArchetypeStorage : NonCopyable {
+    public:
+        static constexpr usize rebuild_ratio = 16;
+
+        // Keeps a trickle of changes from disabling the layout indefinitely
+        static constexpr usize max_dirty_ticks = 64;
+
+        struct ArchetypeTable {
+            core::Vector<ComponentTypeIndex> types;
+            core::Vector<u32> offsets;
+            u32 size = 0;
+
+            bool contains(ComponentTypeIndex type) const;
+            u32 offset(ComponentTypeIndex type) const;
+        };
+
+        bool is_dirty() const;
+        bool is_dirty(core::Span<QueryCache::ComponentRule> rules) const;
+        bool should_rebuild() const;
+        void set_dirty(ComponentTypeIndex type, usize changes = 1);
+
+        // Call once per tick
+        void end_tick(core::Span<std::unique_ptr<ComponentContainerBase>> containers);
+
+        core::Span<ArchetypeTable> tables() const;
+
+        void rebuild(core::Span<std::unique_ptr<ComponentContainerBase>> containers);
+
+        // Only valid if none of the component types of the rules are dirty
+        core::Vector<EntityId> matching(core::Span<std::unique_ptr<ComponentContainerBase>> containers, core::Span<QueryCache::ComponentRule> rules) const;
+
+    private:
+        core::Vector<ArchetypeTable> _tables;
+        usize _entity_count = 0;
+        usize _changes = 0;
+        usize _dirty_ticks = 0;
+        core::Vector<bool> _dirty_types;
+        bool _dirty = true;
+};
+
+}
+}
+
+#endif // YAVE_ECS_ARCHETYPESTORAGE_H
+
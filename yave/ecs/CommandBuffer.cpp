@@ -0,0 +1,242 @@
+/*******************************
+Copyright (c) 2016-2023 Grégoire Angerand
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+**********************************/
+#include "CommandBuffer.h"
+#include "EntityWorld.h"
+
+#include <y/utils/memory.h>
+
+namespace yave {
+namespace ecs {
+
+CommandBuffer::~CommandBuffer() {
+    clear();
+}
+
+CommandBuffer::CommandBuffer(CommandBuffer&& other) {
+    swap(other);
+}
+
+CommandBuffer& CommandBuffer::operator=(CommandBuffer&& other) {
+    swap(other);
+    return *this;
+}
+
+void CommandBuffer::swap(CommandBuffer& other) {
+    if(this != &other) {
+        std::swap(_commands, other._commands);
+        std::swap(_components, other._components);
+        std::swap(_tags, other._tags);
+        std::swap(_blocks, other._blocks);
+        std::swap(_block, other._block);
+        std::swap(_block_offset, other._block_offset);
+        std::swap(_pending_entities, other._pending_entities);
+    }
+}
+
+bool CommandBuffer::is_empty() const {
+    return _commands.is_empty();
+}
+
+usize CommandBuffer::size() const {
+    return _commands.size();
+}
+
+CommandBuffer::Entity CommandBuffer::create_entity() {
+    Entity entity{EntityId()};
+    entity._pending = _pending_entities++;
+    record(CommandType::CreateEntity, entity);
+    return entity;
+}
+
+void CommandBuffer::remove_entity(EntityId id) {
+    record(CommandType::RemoveEntity, id);
+}
+
+void CommandBuffer::add_tag(Entity entity, core::String tag) {
+    const u32 index = u32(_tags.size());
+    _tags.emplace_back(std::move(tag));
+    record(CommandType::AddTag, entity, index);
+}
+
+void CommandBuffer::remove_tag(Entity entity, core::String tag) {
+    const u32 index = u32(_tags.size());
+    _tags.emplace_back(std::move(tag));
+    record(CommandType::RemoveTag, entity, index);
+}
+
+void CommandBuffer::append(CommandBuffer&& other) {
+    if(is_empty()) {
+        clear();
+        swap(other);
+        return;
+    }
+
+    const u32 component_offset = u32(_components.size());
+    const u32 tag_offset = u32(_tags.size());
+
+    _commands.set_min_capacity(_commands.size() + other._commands.size());
+    for(Command cmd : other._commands) {
+        if(cmd.entity.is_pending()) {
+            cmd.entity._pending += _pending_entities;
+        }
+        switch(cmd.type) {
+            case CommandType::AddComponent:
+                cmd.payload += component_offset;
+            break;
+
+            case CommandType::AddTag:
+            case CommandType::RemoveTag:
+                cmd.payload += tag_offset;
+            break;
+
+            default:
+            break;
+        }
+        _commands.emplace_back(cmd);
+    }
+
+    _components.push_back(other._components.begin(), other._components.end());
+    for(core::String& tag : other._tags) {
+        _tags.emplace_back(std::move(tag));
+    }
+
+    // Keep filling our own block, other's blocks are only kept alive
+    for(auto& block : other._blocks) {
+        _blocks.emplace_back(std::move(block));
+    }
+
+    _pending_entities += other._pending_entities;
+
+    other._commands.make_empty();
+    other._components.make_empty();
+    other._tags.make_empty();
+    other._blocks.make_empty();
+    other._block = nullptr;
+    other._block_offset = block_size;
+    other._pending_entities = 0;
+}
+
+void CommandBuffer::play(EntityWorld& world) {
+    y_profile();
+
+    auto created = core::vector_with_capacity<EntityId>(_pending_entities);
+
+    const auto resolve = [&](const Entity& entity) {
+        return entity.is_pending() ? created[entity._pending] : entity._id;
+    };
+
+    for(const Command& cmd : _commands) {
+        if(cmd.type == CommandType::CreateEntity) {
+            y_debug_assert(created.size() == cmd.entity._pending);
+            created << world.create_entity();
+            continue;
+        }
+
+        const EntityId id = resolve(cmd.entity);
+        const bool exists = world.exists(id);
+
+        switch(cmd.type) {
+            case CommandType::AddComponent: {
+                ComponentData& component = _components[cmd.payload];
+                if(exists) {
+                    component.add(world, id, component.data);
+                }
+                component.destroy(component.data);
+                component.data = nullptr;
+            } break;
+
+            case CommandType::RemoveEntity:
+                if(exists) {
+                    world.remove_entity(id);
+                }
+            break;
+
+            case CommandType::AddTag:
+                if(exists) {
+                    world.add_tag(id, _tags[cmd.payload]);
+                }
+            break;
+
+            case CommandType::RemoveTag:
+                if(exists) {
+                    world.remove_tag(id, _tags[cmd.payload]);
+                }
+            break;
+
+            default:
+                y_fatal("Unknown command type");
+        }
+    }
+
+    clear();
+}
+
+void CommandBuffer::clear() {
+    for(const ComponentData& component : _components) {
+        if(component.data) {
+            component.destroy(component.data);
+        }
+    }
+
+    _commands.make_empty();
+    _components.make_empty();
+    _tags.make_empty();
+    _pending_entities = 0;
+
+    // Keep the current block around for the next frame
+    for(auto& block : _blocks) {
+        if(block.get() == _block) {
+            std::swap(block, _blocks.first());
+            break;
+        }
+    }
+    while(_blocks.size() > (_block ? 1 : 0)) {
+        _blocks.pop();
+    }
+    _block_offset = 0;
+}
+
+void CommandBuffer::record(CommandType type, Entity entity, u32 payload) {
+    _commands.emplace_back(Command{type, entity, payload});
+}
+
+void* CommandBuffer::allocate(usize size, usize alignment) {
+    y_debug_assert(alignment <= alignof(std::max_align_t));
+
+    if(size > block_size) {
+        return _blocks.emplace_back(std::make_unique<u8[]>(size)).get();
+    }
+
+    _block_offset = align_up_to(_block_offset, alignment);
+    if(!_block || _block_offset + size > block_size) {
+        _block = _blocks.emplace_back(std::make_unique<u8[]>(block_size)).get();
+        _block_offset = 0;
+    }
+
+    void* ptr = _block + _block_offset;
+    _block_offset += size;
+    return ptr;
+}
+
+}
+}
+
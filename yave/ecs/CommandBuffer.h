@@ -0,0 +1,154 @@
+/*******************************
+Copyright (c) 2016-2023 Grégoire Angerand
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+**********************************/
+#ifndef YAVE_ECS_COMMANDBUFFER_H
+#define YAVE_ECS_COMMANDBUFFER_H
+
+#include "ecs.h"
+
+#include <y/core/Vector.h>
+#include <y/core/String.h>
+
+#include <memory>
+
+namespace yave {
+namespace ecs {
+
+namespace detail {
+template<typename T>
+void add_command_component(EntityWorld& world, EntityId id, void* component);
+}
+
+// Records world mutations to be applied later, at a sync point.
+// A buffer is not thread safe but doesn't lock either: use one per thread (or per task)
+// and append them in a fixed order for playback to stay deterministic.
+class CommandBuffer : NonCopyable {
+    public:
+        // Either an existing entity or one created by the buffer, resolved during playback
+        class Entity {
+            public:
+                Entity(EntityId id) : _id(id) {
+                }
+
+                bool is_pending() const {
+                    return _pending != not_pending;
+                }
+
+            private:
+                friend class CommandBuffer;
+
+                static constexpr u32 not_pending = u32(-1);
+
+                EntityId _id;
+                u32 _pending = not_pending;
+        };
+
+        CommandBuffer() = default;
+        ~CommandBuffer();
+
+        CommandBuffer(CommandBuffer&& other);
+        CommandBuffer& operator=(CommandBuffer&& other);
+
+        void swap(CommandBuffer& other);
+
+        bool is_empty() const;
+        usize size() const;
+
+        Entity create_entity();
+
+        template<typename... Args>
+        Entity create_entity(StaticArchetype<Args...>) {
+            const Entity entity = create_entity();
+            (add_component<Args>(entity), ...);
+            return entity;
+        }
+
+        template<typename T, typename... Args>
+        void add_component(Entity entity, Args&&... args) {
+            void* data = allocate(sizeof(T), alignof(T));
+            new(data) T{y_fwd(args)...};
+
+            const u32 index = u32(_components.size());
+            _components.emplace_back(ComponentData{
+                data,
+                &detail::add_command_component<T>,
+                [](void* ptr) { static_cast<T*>(ptr)->~T(); },
+            });
+            record(CommandType::AddComponent, entity, index);
+        }
+
+        void remove_entity(EntityId id);
+
+        void add_tag(Entity entity, core::String tag);
+        void remove_tag(Entity entity, core::String tag);
+
+        // Moves every command of other after the ones already recorded
+        void append(CommandBuffer&& other);
+
+        // Applies the commands in recording order and empties the buffer.
+        // Commands targeting entities that no longer exist are dropped.
+        void play(EntityWorld& world);
+
+        void clear();
+
+    private:
+        enum class CommandType : u32 {
+            CreateEntity,
+            AddComponent,
+            RemoveEntity,
+            AddTag,
+            RemoveTag,
+        };
+
+        struct Command {
+            CommandType type;
+            Entity entity;
+            u32 payload = 0;
+        };
+
+        struct ComponentData {
+            void* data = nullptr;
+            void (*add)(EntityWorld&, EntityId, void*) = nullptr;
+            void (*destroy)(void*) = nullptr;
+        };
+
+        static constexpr usize block_size = 16 * 1024;
+
+        void record(CommandType type, Entity entity, u32 payload = 0);
+        void* allocate(usize size, usize alignment);
+
+        core::Vector<Command> _commands;
+        core::Vector<ComponentData> _components;
+        core::Vector<core::String> _tags;
+
+        // Components are never moved once recorded, so they live in fixed blocks
+        core::Vector<std::unique_ptr<u8[]>> _blocks;
+        u8* _block = nullptr;
+        usize _block_offset = block_size;
+
+        u32 _pending_entities = 0;
+};
+
+}
+}
+
+#endif // YAVE_ECS_COMMANDBUFFER_H
+
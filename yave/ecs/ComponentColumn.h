@@ -0,0 +1,140 @@
+/*******************************
+Copyright (c) 2016-2023 Grégoire Angerand
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+**********************************/
+#ifndef YAVE_ECS_COMPONENTCOLUMN_H
+#define YAVE_ECS_COMPONENTCOLUMN_H
+
+#include "ComponentContainer.h"
+
+#include <y/serde3/headers.h>
+
+#include <cstring>
+
+namespace yave {
+namespace ecs {
+
+namespace detail {
+template<typename T>
+constexpr bool is_raw_component();
+
+template<typename T, typename M>
+constexpr usize raw_member_size(const reflect::NamedMember<T, M>&) {
+    return is_raw_component<M>() ? sizeof(M) : 0;
+}
+
+// Raw components can be stored as bytes without losing anything:
+// they are trivially copyable and every byte belongs to a serialized member
+template<typename T>
+constexpr bool is_raw_component() {
+    if constexpr(!std::is_trivially_copyable_v<T> || std::is_pointer_v<T> || std::is_member_pointer_v<T>) {
+        return false;
+    } else if constexpr(!reflect::has_reflect_v<T>) {
+        return true;
+    } else {
+        return std::apply([](const auto&... members) {
+            return (raw_member_size(members) + ... + usize(0)) == sizeof(T);
+        }, reflect::list_members<T>());
+    }
+}
+
+template<typename T>
+u64 component_layout_hash() {
+    u64 hash = ct_type_hash_v<T>;
+    hash_combine(hash, u64(sizeof(T)));
+    hash_combine(hash, u64(serde3::detail::build_members_header<T>().member_hash));
+    return hash;
+}
+}
+
+
+// All the components of one type in an EntityScene, with the index of the entity they belong to
+class ComponentColumnBase : NonMovable {
+    public:
+        virtual ~ComponentColumnBase();
+
+        virtual ComponentRuntimeInfo runtime_info() const = 0;
+        virtual usize size() const = 0;
+
+        virtual void push(u32 entity_index, const ComponentBoxBase& box) = 0;
+
+        // ids maps scene entity indices to world entities
+        virtual void add_to(EntityWorld& world, core::Span<EntityId> ids) const = 0;
+
+        y_serde3_poly_abstract_base(ComponentColumnBase)
+};
+
+template<typename T>
+class ComponentColumn final : public ComponentColumnBase {
+    public:
+        static constexpr bool is_raw = detail::is_raw_component<T>();
+
+        ComponentColumn() = default;
+
+        ComponentRuntimeInfo runtime_info() const override {
+            return ComponentRuntimeInfo::create<T>();
+        }
+
+        usize size() const override {
+            return _entities.size();
+        }
+
+        void push(u32 entity_index, const ComponentBoxBase& box) override {
+            y_debug_assert(box.runtime_info().type_id == type_index<T>());
+            const T& component = static_cast<const ComponentBox<T>&>(box).component();
+
+            _entities << entity_index;
+            if constexpr(is_raw) {
+                _layout = detail::component_layout_hash<T>();
+                const u8* bytes = reinterpret_cast<const u8*>(&component);
+                _raw.push_back(bytes, bytes + sizeof(T));
+            } else {
+                _components.emplace_back(component);
+            }
+        }
+
+        void add_to(EntityWorld& world, core::Span<EntityId> ids) const override;
+
+        // Always empty for raw components, which are stored as bytes
+        core::Span<T> components() const {
+            return _components;
+        }
+
+        y_no_serde3_expr(serde3::has_no_serde3_v<T>)
+
+        y_reflect(ComponentColumn, _entities, _layout, _raw, _components)
+        y_serde3_poly(ComponentColumn)
+
+    private:
+        core::Vector<u32> _entities;
+
+        // Raw components are stored as one block of bytes, which serde3 reads and writes in bulk.
+        // _layout is checked on load so we never reinterpret bytes written for a different layout.
+        u64 _layout = 0;
+        core::Vector<u8> _raw;
+
+        core::Vector<T> _components;
+};
+
+}
+}
+
+#endif // YAVE_ECS_COMPONENTCOLUMN_H
+
@@ -21,6 +21,8 @@ SOFTWARE.
 **********************************/
 
 #include "ComponentContainer.h"
+#include "ComponentColumn.h"
+#include "EntityWorld.h"
 
 namespace yave {
 namespace ecs {
@@ -31,19 +33,24 @@ ComponentBoxBase::~ComponentBoxBase() {
 ComponentContainerBase::~ComponentContainerBase() {
 }
 
+ComponentColumnBase::~ComponentColumnBase() {
+}
+
 
 void ComponentContainerBase::clean_after_tick() {
-    _mutated.make_empty();
+    _mutated.clear();
     _to_remove.clear();
 }
 
+void ComponentContainerBase::on_component_added(EntityWorld& world, EntityId id) const {
+    world.on_component_added(_type_id, id);
+}
+
 void ComponentContainerBase::prepare_for_tick() {
     y_profile();
 
     for(const EntityId id : _to_remove) {
-        if(_mutated.contains(id)) {
-            _mutated.erase(id);
-        }
+        _mutated.reset(id.index());
     }
 }
 
@@ -25,6 +25,7 @@ SOFTWARE.
 #include "ecs.h"
 #include "traits.h"
 #include "SparseComponentSet.h"
+#include "DirtyBitSet.h"
 #include "ComponentRuntimeInfo.h"
 
 Y_TODO(try replacing this?)
@@ -41,6 +42,8 @@ using has_register_component_type_t = decltype(std::declval<T>().register_compon
 }
 
 
+class ComponentColumnBase;
+
 
 class ComponentBoxBase : NonMovable {
     public:
@@ -48,6 +51,7 @@ class ComponentBoxBase : NonMovable {
 
         virtual ComponentRuntimeInfo runtime_info() const = 0;
         virtual void add_to(EntityWorld& world, EntityId id) const = 0;
+        virtual std::unique_ptr<ComponentColumnBase> create_column() const = 0;
         // virtual void add_or_replace_to(EntityWorld& world, EntityId id) const = 0;
 
         y_serde3_poly_abstract_base(ComponentBoxBase)
@@ -61,6 +65,7 @@ class ComponentBox final : public ComponentBoxBase {
 
         ComponentRuntimeInfo runtime_info() const override;
         void add_to(EntityWorld& world, EntityId id) const override;
+        std::unique_ptr<ComponentColumnBase> create_column() const override;
         // void add_or_replace_to(EntityWorld& world, EntityId id) const override;
 
         const T& component() const {
@@ -85,9 +90,16 @@ class ComponentContainerBase : NonMovable {
         virtual ComponentRuntimeInfo runtime_info() const = 0;
 
         virtual void add(EntityWorld& world, EntityId id) = 0;
+        virtual void add_batch(EntityWorld& world, core::Span<EntityId> ids) = 0;
+
+        // boxes contains either a single box, copied for every id, or one box per id
+        virtual void add_boxes(EntityWorld& world, core::Span<EntityId> ids, core::Span<const ComponentBoxBase*> boxes) = 0;
 
         virtual std::unique_ptr<ComponentBoxBase> create_box(EntityId id) const = 0;
 
+        // Used by ArchetypeStorage, see SparseComponentSet::permute
+        virtual void permute(core::MutableSpan<u32> destinations) = 0;
+
 
         inline bool contains(EntityId id) const {
             return id_set().contains(id);
@@ -105,10 +117,22 @@ class ComponentContainerBase : NonMovable {
             return *reinterpret_cast<const SparseIdSetBase*>(this + 1);
         }
 
-        inline const SparseIdSet& recently_mutated() const {
+        inline const DirtyBitSet& recently_mutated() const {
             return _mutated;
         }
 
+        template<typename F>
+        inline void for_each_mutated(F&& func) const {
+            const SparseIdSetBase& set = id_set();
+            const core::Span<EntityId> ids = set.ids();
+            _mutated.for_each([&](u32 index) {
+                const u32 dense_index = set.dense_index_of(index);
+                if(dense_index != SparseIdSetBase::invalid_index) {
+                    func(ids[dense_index]);
+                }
+            });
+        }
+
         inline const SparseIdSet& to_be_removed() const {
             return _to_remove;
         }
@@ -124,12 +148,14 @@ class ComponentContainerBase : NonMovable {
         inline T& add(EntityWorld& world, EntityId id, Args&&... args) {
             y_debug_assert(id.is_valid());
 
-            _mutated.insert(id);
+            _mutated.set(id.index());
 
             auto& set = component_set<T>();
             if(!set.contains_index(id.index())) {
                 add_required_components<T>(world, id);
-                return set.insert(id, y_fwd(args)...);
+                T& component = set.insert(id, y_fwd(args)...);
+                on_component_added(world, id);
+                return component;
             } else {
                 if constexpr(sizeof...(Args) != 0) {
                     return set[id] = T{y_fwd(args)...};
@@ -139,13 +165,35 @@ class ComponentContainerBase : NonMovable {
             }
         }
 
+        // get_component(i) returns the component of ids[i]
+        template<typename T, typename F>
+        inline void add_batch(EntityWorld& world, core::Span<EntityId> ids, F&& get_component) {
+            auto& set = component_set<T>();
+            set.reserve(ids);
+
+            for(usize i = 0; i != ids.size(); ++i) {
+                const EntityId id = ids[i];
+                y_debug_assert(id.is_valid());
+
+                _mutated.set(id.index());
+
+                if(!set.contains_index(id.index())) {
+                    add_required_components<T>(world, id);
+                    set.insert(id, get_component(i));
+                    on_component_added(world, id);
+                } else {
+                    set[id] = get_component(i);
+                }
+            }
+        }
+
 
         template<typename T>
         inline auto* component_ptr(EntityId id) {
             if constexpr(traits::is_component_mutable_v<T>) {
                 auto* ptr = component_set<T>().try_get(id);
                 if(ptr) {
-                    _mutated.insert(id);
+                    _mutated.set(id.index());
                 }
                 return ptr;
             } else {
@@ -171,7 +219,7 @@ class ComponentContainerBase : NonMovable {
         friend class EntityWorld;
 
         const ComponentTypeIndex _type_id;
-        SparseIdSet _mutated;
+        DirtyBitSet _mutated;
         SparseIdSet _to_remove;
 
     protected:
@@ -184,6 +232,8 @@ class ComponentContainerBase : NonMovable {
         template<typename T>
         void add_required_components(EntityWorld& world, EntityId id);
 
+        void on_component_added(EntityWorld& world, EntityId id) const;
+
 
     private:
         template<typename T>
@@ -241,6 +291,29 @@ class ComponentContainer final : public ComponentContainerBase {
             ComponentContainerBase::add<T>(world, id);
         }
 
+        void add_batch(EntityWorld& world, core::Span<EntityId> ids) override {
+            ComponentContainerBase::add_batch<T>(world, ids, [](usize) { return T(); });
+        }
+
+        void add_boxes(EntityWorld& world, core::Span<EntityId> ids, core::Span<const ComponentBoxBase*> boxes) override {
+            y_debug_assert(boxes.size() == 1 || boxes.size() == ids.size());
+            if constexpr(std::is_copy_constructible_v<T>) {
+                const auto component = [&](usize i) -> const T& {
+                    const ComponentBoxBase* box = boxes[boxes.size() == 1 ? 0 : i];
+                    y_debug_assert(box->runtime_info().type_id == type_id());
+                    return static_cast<const ComponentBox<T>*>(box)->component();
+                };
+                ComponentContainerBase::add_batch<T>(world, ids, component);
+            } else {
+                unused(world, ids, boxes);
+                y_fatal("Component is not copyable");
+            }
+        }
+
+        void permute(core::MutableSpan<u32> destinations) override {
+            _components.permute(destinations);
+        }
+
         std::unique_ptr<ComponentBoxBase> create_box(EntityId id) const override {
             unused(id);
             if constexpr(std::is_copy_constructible_v<T>) {
@@ -0,0 +1,142 @@
+/*******************************
+Copyright (c) 2016-2023 Grégoire Angerand
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+**********************************/
+#ifndef YAVE_ECS_DIRTYBITSET_H
+#define YAVE_ECS_DIRTYBITSET_H
+
+#include "ecs.h"
+
+#include <y/core/Vector.h>
+
+#ifdef Y_MSVC
+#include <intrin.h>
+#endif
+
+namespace yave {
+namespace ecs {
+
+namespace detail {
+inline u32 count_trailing_zeros(u64 word) {
+    y_debug_assert(word);
+#ifdef Y_MSVC
+    unsigned long index = 0;
+    _BitScanForward64(&index, word);
+    return u32(index);
+#else
+    return u32(__builtin_ctzll(word));
+#endif
+}
+}
+
+
+// Entity index bitset with O(1) clear.
+// Every word is stamped with the generation it was last written in, words with an older stamp read as zero.
+// Written words are recorded so iteration only touches words that actually changed.
+class DirtyBitSet : NonCopyable {
+    public:
+        using index_type = u32;
+
+        static constexpr usize word_bits = 64;
+
+        inline void set(index_type index) {
+            const usize w = index / word_bits;
+            const u64 bit = u64(1) << (index % word_bits);
+
+            if(w >= _words.size()) {
+                _words.set_min_size(w + 1, u64(0));
+                _stamps.set_min_size(w + 1, u32(0));
+            }
+
+            if(_stamps[w] != _generation) {
+                _stamps[w] = _generation;
+                _words[w] = 0;
+                _dirty_words.emplace_back(index_type(w));
+            }
+
+            u64& word = _words[w];
+            _count += (word & bit) ? 0 : 1;
+            word |= bit;
+        }
+
+        inline void reset(index_type index) {
+            const usize w = index / word_bits;
+            const u64 bit = u64(1) << (index % word_bits);
+
+            if(w < _words.size() && _stamps[w] == _generation && (_words[w] & bit)) {
+                _words[w] &= ~bit;
+                --_count;
+            }
+        }
+
+        inline bool test(index_type index) const {
+            const usize w = index / word_bits;
+            if(w >= _words.size() || _stamps[w] != _generation) {
+                return false;
+            }
+            return (_words[w] >> (index % word_bits)) & 1;
+        }
+
+        inline usize size() const {
+            return _count;
+        }
+
+        inline bool is_empty() const {
+            return !_count;
+        }
+
+        // Calls func(index) for every set bit, in word order of first write
+        template<typename F>
+        inline void for_each(F&& func) const {
+            for(const index_type w : _dirty_words) {
+                u64 word = _words[w];
+                while(word) {
+                    const u32 bit = detail::count_trailing_zeros(word);
+                    func(index_type(w * word_bits + bit));
+                    word &= word - 1;
+                }
+            }
+        }
+
+        void clear() {
+            _dirty_words.make_empty();
+            _count = 0;
+
+            if(++_generation == 0) {
+                // Stamps wrapped around, old stamps might alias the new generation
+                std::fill(_stamps.begin(), _stamps.end(), u32(0));
+                _generation = 1;
+            }
+        }
+
+    private:
+        core::Vector<u64> _words;
+        core::Vector<u32> _stamps;
+        core::Vector<index_type> _dirty_words;
+
+        usize _count = 0;
+        u32 _generation = 1;
+};
+
+}
+}
+
+#endif // YAVE_ECS_DIRTYBITSET_H
+
@@ -0,0 +1,55 @@
+/*******************************
+Copyright (c) 2016-2023 Grégoire Angerand
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+**********************************/
+#include "EntityScene.h"
+
+#include <y/core/HashMap.h>
+
+#include <y/utils/log.h>
+
+namespace yave {
+namespace ecs {
+
+EntityScene::EntityScene(core::Vector<EntityPrefab> prefabs) : _entity_count(u32(prefabs.size())) {
+    y_profile();
+
+    core::FlatHashMap<ComponentTypeIndex, ComponentColumnBase*> columns;
+    for(usize i = 0; i != prefabs.size(); ++i) {
+        for(const auto& box : prefabs[i].components()) {
+            if(!box) {
+                log_msg("Unable to add null component", Log::Error);
+                continue;
+            }
+
+            const ComponentTypeIndex type_id = box->runtime_info().type_id;
+            auto it = columns.find(type_id);
+            if(it == columns.end()) {
+                ComponentColumnBase* column = _columns.emplace_back(box->create_column()).get();
+                it = columns.insert({type_id, column}).first;
+            }
+            it->second->push(u32(i), *box);
+        }
+    }
+}
+
+}
+}
+
@@ -23,26 +23,39 @@ SOFTWARE.
 #define YAVE_ECS_ENTITYSCENE_H
 
 #include "EntityPrefab.h"
+#include "ComponentColumn.h"
 
 #include <yave/assets/AssetPtr.h>
 
 namespace yave {
 namespace ecs {
 
+// Scenes are stored by column: one block per component type rather than one prefab per entity
 class EntityScene {
     public:
         EntityScene() = default;
-        EntityScene(core::Vector<EntityPrefab> prefabs) : _prefabs(std::move(prefabs)) {
+        EntityScene(core::Vector<EntityPrefab> prefabs);
+
+        usize entity_count() const {
+            return _prefabs.is_empty() ? _entity_count : _prefabs.size();
+        }
+
+        core::Span<std::unique_ptr<ComponentColumnBase>> columns() const {
+            return _columns;
         }
 
+        // Only used by scenes saved before columns
         core::Span<EntityPrefab> prefabs() const {
             return _prefabs;
         }
 
-        y_reflect(EntityScene, _prefabs);
+        y_reflect(EntityScene, _prefabs, _entity_count, _columns);
 
     private:
         core::Vector<EntityPrefab> _prefabs;
+
+        u32 _entity_count = 0;
+        core::Vector<std::unique_ptr<ComponentColumnBase>> _columns;
 };
 
 }
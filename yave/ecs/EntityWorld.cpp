@@ -21,6 +21,7 @@ SOFTWARE.
 **********************************/
 
 #include "EntityWorld.h"
+#include "EntityScene.h"
 
 #include <y/utils/log.h>
 #include <y/utils/format.h>
@@ -28,6 +29,8 @@ SOFTWARE.
 
 #include <yave/assets/AssetLoadingContext.h>
 
+#include <y/concurrent/WorkStealingThreadPool.h>
+
 #include <numeric>
 
 
@@ -51,6 +54,85 @@ static auto create_component_containers() {
     return containers;
 }
 
+// None of the systems should be exclusive.
+// Systems running here must not change the world's structure directly, they record it in their command buffer instead.
+// Each system waits for every previous system it conflicts with, so conflicting systems still run in registration order.
+template<typename F>
+static void run_systems_concurrently(core::Span<std::unique_ptr<System>> systems, const F& run_system) {
+    y_profile();
+
+    struct SystemNode {
+        core::Vector<usize> successors;
+        std::atomic<u32> dependencies = 0;
+    };
+
+    const usize system_count = systems.size();
+    auto nodes = std::make_unique<SystemNode[]>(system_count);
+    for(usize i = 0; i != system_count; ++i) {
+        for(usize j = 0; j != i; ++j) {
+            if(systems[i]->conflicts_with(*systems[j])) {
+                nodes[j].successors << i;
+                ++nodes[i].dependencies;
+            }
+        }
+    }
+
+    auto& pool = thread_pool();
+    concurrent::DependencyGroup done;
+
+    // Successors are scheduled from within their last dependency so done can not be reached early
+    std::function<void(usize)> schedule_system = [&](usize index) {
+        pool.schedule([&, index] {
+            run_system(*systems[index]);
+            for(const usize next : nodes[index].successors) {
+                if(--nodes[next].dependencies == 0) {
+                    schedule_system(next);
+                }
+            }
+        }, &done);
+    };
+
+    core::Vector<usize> roots;
+    for(usize i = 0; i != system_count; ++i) {
+        if(!nodes[i].dependencies) {
+            roots << i;
+        }
+    }
+
+    for(const usize root : roots) {
+        schedule_system(root);
+    }
+
+    pool.process_until_ready(done);
+}
+
+// Exclusive systems act as barriers and are run on the calling thread
+template<typename F>
+static void run_systems(core::Span<std::unique_ptr<System>> systems, bool& running_concurrently, const F& run_system) {
+    usize begin = 0;
+    const auto run_range = [&](usize end) {
+        if(end - begin > 1) {
+            running_concurrently = true;
+            run_systems_concurrently(core::Span<std::unique_ptr<System>>(systems.data() + begin, end - begin), run_system);
+            running_concurrently = false;
+        } else if(end != begin) {
+            run_system(*systems[begin]);
+        }
+    };
+
+    for(usize i = 0; i != systems.size(); ++i) {
+        if(systems[i]->is_exclusive()) {
+            run_range(i);
+            run_system(*systems[i]);
+            begin = i + 1;
+        }
+    }
+
+    run_range(systems.size());
+}
+
+
+
 EntityWorld::EntityWorld() : _containers(create_component_containers()) {
 }
 
@@ -78,6 +160,8 @@ void EntityWorld::swap(EntityWorld& other) {
         std::swap(_required_components, other._required_components);
         std::swap(_systems, other._systems);
         std::swap(_world_components, other._world_components);
+        std::swap(_query_caches, other._query_caches);
+        std::swap(_archetypes, other._archetypes);
     }
     for(const ComponentTypeIndex c : _required_components) {
         unused(c);
@@ -99,28 +183,60 @@ void EntityWorld::tick() {
 
     {
         y_profile_zone("tick");
-        for(auto& system : _systems) {
-            y_profile_dyn_zone(system->name().data());
-            system->tick(*this);
-        }
+        run_systems(_systems, _running_concurrent_systems, [this](System& system) {
+            y_profile_dyn_zone(system.name().data());
+            system.tick(*this);
+        });
     }
 
+    play_command_buffers();
+
     {
         y_profile_zone("clean after tick");
+
+        core::Vector<EntityId> removed;
+        for(auto& container : _containers) {
+            if(container) {
+                const SparseIdSet& to_be_removed = container->to_be_removed();
+                if(_archetypes && !to_be_removed.is_empty()) {
+                    _archetypes->set_dirty(container->type_id(), to_be_removed.size());
+                }
+                removed.push_back(to_be_removed.begin(), to_be_removed.end());
+            }
+        }
+
         for(auto& container : _containers) {
             if(container) {
                 container->clean_after_tick();
             }
         }
+
+        update_query_caches(removed);
+
+        if(_archetypes) {
+            _archetypes->end_tick(_containers);
+        }
     }
 }
 
 void EntityWorld::update(float dt) {
+    y_profile();
+    run_systems(_systems, _running_concurrent_systems, [this, dt](System& system) {
+        y_profile_dyn_zone(system.name().data());
+        system.update(*this, dt);
+        system.schedule_fixed_update(*this, dt);
+    });
+
+    play_command_buffers();
+}
+
+void EntityWorld::play_command_buffers() {
     y_profile();
     for(auto& system : _systems) {
-        y_profile_dyn_zone(system->name().data());
-        system->update(*this, dt);
-        system->schedule_fixed_update(*this, dt);
+        CommandBuffer& commands = system->command_buffer();
+        if(!commands.is_empty()) {
+            commands.play(*this);
+        }
     }
 }
 
@@ -133,6 +249,7 @@ bool EntityWorld::exists(EntityId id) const {
 }
 
 EntityId EntityWorld::create_entity() {
+    check_structural_change();
     const EntityId id = _entities.create();
     for(const ComponentTypeIndex c : _required_components) {
         ComponentContainerBase* container = find_container(c);
@@ -164,8 +281,69 @@ EntityId EntityWorld::create_entity(const EntityPrefab& prefab) {
     return id;
 }
 
+core::Vector<EntityId> EntityWorld::create_entities(usize count) {
+    y_profile();
+
+    check_structural_change();
+
+    auto ids = core::vector_with_capacity<EntityId>(count);
+    for(usize i = 0; i != count; ++i) {
+        ids << _entities.create();
+    }
+
+    for(const ComponentTypeIndex c : _required_components) {
+        ComponentContainerBase* container = find_container(c);
+        y_debug_assert(container && container->type_id() == c);
+        container->add_batch(*this, ids);
+    }
+
+    return ids;
+}
+
+core::Vector<EntityId> EntityWorld::create_entities(const EntityPrefab& prefab, usize count) {
+    y_profile();
+
+    auto ids = create_entities(count);
+    for(const auto& comp : prefab.components()) {
+        if(!comp) {
+            log_msg("Unable to add null component", Log::Error);
+        } else {
+            const ComponentBoxBase* box = comp.get();
+            find_container(box->runtime_info().type_id)->add_boxes(*this, ids, core::Span<const ComponentBoxBase*>(&box, 1));
+        }
+    }
+    return ids;
+}
+
+core::Vector<EntityId> EntityWorld::create_entities(const EntityScene& scene) {
+    y_profile();
+
+    auto ids = create_entities(scene.entity_count());
+
+    for(const auto& column : scene.columns()) {
+        column->add_to(*this, ids);
+    }
+
+    const core::Span<EntityPrefab> prefabs = scene.prefabs();
+
+    // Every prefab is different: grouping boxes by type means walking all of them twice,
+    // which costs more than it saves, so components are still added per entity.
+    for(usize i = 0; i != prefabs.size(); ++i) {
+        for(const auto& comp : prefabs[i].components()) {
+            if(!comp) {
+                log_msg("Unable to add null component", Log::Error);
+            } else {
+                comp->add_to(*this, ids[i]);
+            }
+        }
+    }
+
+    return ids;
+}
+
 void EntityWorld::remove_entity(EntityId id) {
     check_exists(id);
+    check_structural_change();
     for(auto& container : _containers) {
         if(container) {
             container->remove(id);
@@ -178,6 +356,7 @@ void EntityWorld::remove_entity(EntityId id) {
         }
     }
     _entities.recycle(id);
+    update_query_caches(core::Span<EntityId>(&id, 1));
 }
 
 EntityId EntityWorld::id_from_index(u32 index) const {
@@ -206,10 +385,6 @@ core::Span<EntityId> EntityWorld::component_ids(ComponentTypeIndex type_id) cons
     return find_container(type_id)->ids();
 }
 
-core::Span<EntityId> EntityWorld::recently_mutated(ComponentTypeIndex type_id) const {
-    return find_container(type_id)->recently_mutated().ids();
-}
-
 core::Span<EntityId> EntityWorld::to_be_removed(ComponentTypeIndex type_id) const {
     return find_container(type_id)->to_be_removed().ids();
 }
@@ -250,21 +425,30 @@ const SparseIdSetBase* EntityWorld::tag_set(const core::String& tag) const {
 void EntityWorld::add_tag(EntityId id, const core::String& tag) {
     check_exists(id);
     y_always_assert(!is_tag_implicit(tag), "Implicit tags can't be added directly");
+    check_structural_change();
     _tags[tag].insert(id);
+    update_query_caches_for_tag(tag, core::Span<EntityId>(&id, 1));
 }
 
 void EntityWorld::remove_tag(EntityId id, const core::String& tag) {
     check_exists(id);
     y_always_assert(!is_tag_implicit(tag), "Implicit tags can't be removed directly");
+    check_structural_change();
     auto& tag_set = _tags[tag];
     if(tag_set.contains(id)) {
         tag_set.erase(id);
+        update_query_caches_for_tag(tag, core::Span<EntityId>(&id, 1));
     }
 }
 
 void EntityWorld::clear_tag(const core::String& tag) {
     y_always_assert(!is_tag_implicit(tag), "Implicit tags can't be removed directly");
-    _tags.erase(tag);
+    check_structural_change();
+    if(const auto it = _tags.find(tag); it != _tags.end()) {
+        const core::Vector<EntityId> ids(it->second.ids());
+        _tags.erase(it);
+        update_query_caches_for_tag(tag, ids);
+    }
 }
 
 bool EntityWorld::has_tag(EntityId id, const core::String& tag) const {
@@ -285,11 +469,63 @@ std::string_view EntityWorld::component_type_name(ComponentTypeIndex type_id) co
     return find_container(type_id)->runtime_info().clean_component_name();
 }
 
+void EntityWorld::set_archetype_storage(bool enabled) {
+    if(enabled == has_archetype_storage()) {
+        return;
+    }
+
+    if(enabled) {
+        _archetypes = std::make_unique<ArchetypeStorage>();
+        _archetypes->rebuild(_containers);
+    } else {
+        _archetypes = nullptr;
+    }
+}
+
+bool EntityWorld::has_archetype_storage() const {
+    return _archetypes != nullptr;
+}
+
+void EntityWorld::rebuild_archetypes() {
+    if(_archetypes) {
+        _archetypes->rebuild(_containers);
+    }
+}
+
+core::Vector<EntityId> EntityWorld::archetype_matching(core::Span<QueryCache::ComponentRule> components, core::Span<core::String> tags) const {
+    y_profile();
+
+    y_debug_assert(_archetypes && !_archetypes->is_dirty(components));
+    core::Vector<EntityId> ids = _archetypes->matching(_containers, components);
+
+    if(tags.is_empty()) {
+        return ids;
+    }
+
+    core::ScratchPad<QueryUtils::SetMatch> matches(tags.size());
+    for(usize i = 0; i != tags.size(); ++i) {
+        const bool is_neg = tags[i].starts_with("!");
+        matches[i] = {
+            tag_set(is_neg ? core::String(tags[i].sub_str(1)) : tags[i]),
+            !is_neg
+        };
+    }
+    return QueryUtils::matching(matches, ids);
+}
+
+void EntityWorld::on_component_added(ComponentTypeIndex type_id, EntityId id) {
+    check_structural_change();
+    if(_archetypes) {
+        _archetypes->set_dirty(type_id);
+    }
+    update_query_caches_for_component(type_id, id);
+}
+
 void EntityWorld::make_mutated(ComponentTypeIndex type_id, core::Span<EntityId> ids) {
     y_profile();
     auto& mutated = find_container(type_id)->_mutated;
     for(const EntityId id : ids) {
-        mutated.insert(id);
+        mutated.set(id.index());
     }
 }
 
@@ -303,6 +539,130 @@ ComponentContainerBase* EntityWorld::find_container(ComponentTypeIndex type_id)
     return _containers[type_id].get();
 }
 
+const QueryCache* EntityWorld::find_query_cache(core::Span<QueryCache::ComponentRule> components, core::Span<core::String> tags) const {
+    for(const auto& cache : _query_caches) {
+        if(cache->_components.size() != components.size() || cache->_tags.size() != tags.size()) {
+            continue;
+        }
+
+        bool same_rules = std::equal(components.begin(), components.end(), cache->_components.begin());
+        for(usize i = 0; same_rules && i != tags.size(); ++i) {
+            const bool is_neg = tags[i].starts_with("!");
+            same_rules = cache->_tags[i] == QueryCache::TagRule{is_neg ? core::String(tags[i].sub_str(1)) : tags[i], !is_neg};
+        }
+
+        if(same_rules) {
+            return cache.get();
+        }
+    }
+    return nullptr;
+}
+
+const QueryCache& EntityWorld::find_or_create_query_cache(core::Span<QueryCache::ComponentRule> components, core::Span<core::String> tags) {
+    if(const QueryCache* cache = find_query_cache(components, tags)) {
+        return *cache;
+    }
+
+    y_profile();
+
+    check_structural_change();
+
+    auto cache = std::make_unique<QueryCache>();
+    cache->_components = core::Vector<QueryCache::ComponentRule>(components);
+    for(const core::String& tag : tags) {
+        const bool is_neg = tag.starts_with("!");
+        cache->_tags.emplace_back(QueryCache::TagRule{is_neg ? core::String(tag.sub_str(1)) : tag, !is_neg});
+    }
+
+    rebuild_query_cache(*cache);
+
+    return *_query_caches.emplace_back(std::move(cache));
+}
+
+bool EntityWorld::matches_query_cache(const QueryCache& cache, EntityId id) const {
+    for(const QueryCache::ComponentRule& rule : cache._components) {
+        const ComponentContainerBase* container = find_container(rule.type);
+        if((container && container->contains(id)) != rule.include) {
+            return false;
+        }
+    }
+    for(const QueryCache::TagRule& rule : cache._tags) {
+        const SparseIdSetBase* set = tag_set(rule.tag);
+        if((set && set->contains(id)) != rule.include) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void EntityWorld::update_query_cache(QueryCache& cache, EntityId id) const {
+    if(matches_query_cache(cache, id)) {
+        cache._ids.insert(id);
+    } else if(cache._ids.contains(id)) {
+        cache._ids.erase(id);
+    }
+}
+
+void EntityWorld::rebuild_query_cache(QueryCache& cache) const {
+    y_profile();
+
+    // Same candidates as a regular query: ids of the first inclusive rule
+    core::Span<EntityId> candidates;
+    if(const auto it = std::find_if(cache._components.begin(), cache._components.end(), [](const auto& rule) { return rule.include; }); it != cache._components.end()) {
+        const ComponentContainerBase* container = find_container(it->type);
+        candidates = container ? container->ids() : core::Span<EntityId>();
+    } else if(const auto tag_it = std::find_if(cache._tags.begin(), cache._tags.end(), [](const auto& rule) { return rule.include; }); tag_it != cache._tags.end()) {
+        candidates = with_tag(tag_it->tag);
+    } else {
+        y_fatal("Query needs at least one inclusive matching rule");
+    }
+
+    cache._ids.make_empty();
+    for(const EntityId id : candidates) {
+        if(matches_query_cache(cache, id)) {
+            cache._ids.insert(id);
+        }
+    }
+}
+
+void EntityWorld::update_query_caches_for_component(ComponentTypeIndex type_id, EntityId id) {
+    for(auto& cache : _query_caches) {
+        const auto& rules = cache->_components;
+        const auto& tags = cache->_tags;
+        const bool affected =
+            std::any_of(rules.begin(), rules.end(), [&](const auto& rule) { return rule.type == type_id; }) ||
+            std::any_of(tags.begin(), tags.end(), [](const auto& rule) { return rule.tag.starts_with("@"); });
+
+        if(affected) {
+            update_query_cache(*cache, id);
+        }
+    }
+}
+
+void EntityWorld::update_query_caches_for_tag(std::string_view tag, core::Span<EntityId> ids) {
+    for(auto& cache : _query_caches) {
+        const auto& rules = cache->_tags;
+        if(std::any_of(rules.begin(), rules.end(), [&](const auto& rule) { return rule.tag == tag; })) {
+            for(const EntityId id : ids) {
+                update_query_cache(*cache, id);
+            }
+        }
+    }
+}
+
+void EntityWorld::update_query_caches(core::Span<EntityId> ids) {
+    if(ids.is_empty()) {
+        return;
+    }
+
+    y_profile();
+    for(auto& cache : _query_caches) {
+        for(const EntityId id : ids) {
+            update_query_cache(*cache, id);
+        }
+    }
+}
+
 void EntityWorld::register_component_types(System* system) const {
     for(auto& container : _containers) {
         if(container) {
@@ -315,6 +675,10 @@ void EntityWorld::check_exists(EntityId id) const {
     y_always_assert(exists(id), "Entity doesn't exists");
 }
 
+void EntityWorld::check_structural_change() const {
+    y_always_assert(!_running_concurrent_systems, "Concurrent systems must use their command buffer to change the world's structure");
+}
+
 
 void EntityWorld::post_deserialize() {
     auto patched = create_component_containers();
@@ -327,6 +691,14 @@ void EntityWorld::post_deserialize() {
     }
     _containers = std::move(patched);
 
+    for(auto& cache : _query_caches) {
+        rebuild_query_cache(*cache);
+    }
+
+    if(_archetypes) {
+        _archetypes->rebuild(_containers);
+    }
+
     for(auto& system : _systems) {
         y_debug_assert(system);
         system->reset(*this);
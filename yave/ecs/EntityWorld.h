@@ -25,7 +25,9 @@ SOFTWARE.
 #include "EntityIdPool.h"
 #include "Query.h"
 #include "Archetype.h"
+#include "ArchetypeStorage.h"
 #include "EntityPrefab.h"
+#include "ComponentColumn.h"
 #include "System.h"
 #include "tags.h"
 
@@ -57,6 +59,11 @@ class EntityWorld {
         EntityId create_entity(const Archetype& archetype);
         EntityId create_entity(const EntityPrefab& prefab);
 
+        // Batched versions: entities are allocated all at once and required/prefab components are inserted one type at a time
+        core::Vector<EntityId> create_entities(usize count);
+        core::Vector<EntityId> create_entities(const EntityPrefab& prefab, usize count);
+        core::Vector<EntityId> create_entities(const EntityScene& scene);
+
         void remove_entity(EntityId id);
 
         EntityId id_from_index(u32 index) const;
@@ -64,9 +71,14 @@ class EntityWorld {
         EntityPrefab create_prefab(EntityId id) const;
 
         core::Span<EntityId> component_ids(ComponentTypeIndex type_id) const;
-        core::Span<EntityId> recently_mutated(ComponentTypeIndex type_id) const;
         core::Span<EntityId> to_be_removed(ComponentTypeIndex type_id) const;
 
+        // Calls func(id) for every entity whose component has been mutated since the last tick
+        template<typename F>
+        void for_each_mutated(ComponentTypeIndex type_id, F&& func) const {
+            find_container(type_id)->for_each_mutated(y_fwd(func));
+        }
+
         core::Span<EntityId> with_tag(const core::String& tag) const;
 
         const SparseIdSetBase* tag_set(const core::String& tag) const;
@@ -78,6 +90,12 @@ class EntityWorld {
         void make_mutated(ComponentTypeIndex type_id, core::Span<EntityId> ids);
 
 
+        // Opt-in, see ArchetypeStorage
+        void set_archetype_storage(bool enabled);
+        bool has_archetype_storage() const;
+        void rebuild_archetypes();
+
+
 
         // ---------------------------------------- Systems ----------------------------------------
 
@@ -132,6 +150,15 @@ class EntityWorld {
             return &find_container<T>()->template add<T>(*this, id, y_fwd(args)...);
         }
 
+        // get_component(i) returns the component to add to ids[i]
+        template<typename T, typename F>
+        void add_component_batch(core::Span<EntityId> ids, F&& get_component) {
+            for(const EntityId id : ids) {
+                check_exists(id);
+            }
+            find_container<T>()->template add_batch<T>(*this, ids, y_fwd(get_component));
+        }
+
         template<typename First, typename... Args>
         void add_components(EntityId id) {
             y_debug_assert(exists(id));
@@ -260,9 +287,9 @@ class EntityWorld {
             return component_ids(type_index<T>());
         }
 
-        template<typename T>
-        core::Span<EntityId> recently_mutated() const {
-            return recently_mutated(type_index<T>());
+        template<typename T, typename F>
+        void for_each_mutated(F&& func) const {
+            find_container<T>()->for_each_mutated(y_fwd(func));
         }
 
         template<typename T>
@@ -276,7 +303,7 @@ class EntityWorld {
 
         template<typename... Args>
         auto query(core::Span<core::String> tags = {}) {
-            auto q = Query<Args...>(typed_component_sets_or_none<Args...>(), build_matches_for_query<Args...>(tags));
+            auto q = create_query<Args...>(tags);
             dirty_mutated_containers<Args...>(q.ids());
             return q;
         }
@@ -284,7 +311,7 @@ class EntityWorld {
         template<typename... Args>
         auto query(core::Span<core::String> tags = {}) const {
             static_assert((traits::is_component_const_v<Args> && ...));
-            auto q = Query<Args...>(typed_component_sets_or_none<Args...>(), build_matches_for_query<Args...>(tags));
+            auto q = create_query<Args...>(tags);
 
             return q;
         }
@@ -316,6 +343,36 @@ class EntityWorld {
 
 
 
+        // ---------------------------------------- Registered queries ----------------------------------------
+
+        // Registered queries keep their matching ids up to date as components and tags are added or removed,
+        // running them doesn't allocate or match anything. Changed<T> and Removed<T> are not supported.
+        template<typename... Args>
+        const QueryCache& register_query(core::Span<core::String> tags = {}) {
+            const auto rules = query_cache_rules<Args...>();
+            return find_or_create_query_cache(rules, tags);
+        }
+
+        template<typename... Args>
+        auto cached_query(core::Span<core::String> tags = {}) {
+            auto q = Query<Args...>(typed_component_sets_or_none<Args...>(), register_query<Args...>(tags));
+            dirty_mutated_containers<Args...>(q.ids());
+            return q;
+        }
+
+        // Falls back to a regular query if the query hasn't been registered
+        template<typename... Args>
+        auto cached_query(core::Span<core::String> tags = {}) const {
+            static_assert((traits::is_component_const_v<Args> && ...));
+            const auto rules = query_cache_rules<Args...>();
+            if(const QueryCache* cache = find_query_cache(rules, tags)) {
+                return Query<Args...>(typed_component_sets_or_none<Args...>(), *cache);
+            }
+            return query<Args...>(tags);
+        }
+
+
+
         // ---------------------------------------- Misc ----------------------------------------
 
         template<typename T>
@@ -339,11 +396,49 @@ class EntityWorld {
 
         void post_deserialize();
 
+        // Sync point for deferred mutations, called after systems are run
+        void play_command_buffers();
+
         y_reflect(EntityWorld, _entities, _containers, _tags, _world_components)
 
     private:
         template<typename T>
         friend class ComponentContainer;
+        friend class ComponentContainerBase;
+
+        template<typename... Args>
+        static auto query_cache_rules() {
+            static_assert(((!traits::component_changed_v<Args> && !traits::component_removed_v<Args>) && ...), "Changed<T> and Removed<T> can not be cached");
+            return std::array<QueryCache::ComponentRule, sizeof...(Args)>{
+                QueryCache::ComponentRule{type_index<traits::component_raw_type_t<Args>>(), traits::component_required_v<Args>}...
+            };
+        }
+
+        template<typename... Args>
+        auto create_query(core::Span<core::String> tags) const {
+            if constexpr(sizeof...(Args) != 0 && ((!traits::component_changed_v<Args> && !traits::component_removed_v<Args>) && ...)) {
+                const auto rules = query_cache_rules<Args...>();
+                if(_archetypes && !_archetypes->is_dirty(rules)) {
+                    return Query<Args...>(typed_component_sets_or_none<Args...>(), archetype_matching(rules, tags));
+                }
+            }
+            return Query<Args...>(typed_component_sets_or_none<Args...>(), build_matches_for_query<Args...>(tags));
+        }
+
+        core::Vector<EntityId> archetype_matching(core::Span<QueryCache::ComponentRule> components, core::Span<core::String> tags) const;
+
+        void on_component_added(ComponentTypeIndex type_id, EntityId id);
+
+        const QueryCache* find_query_cache(core::Span<QueryCache::ComponentRule> components, core::Span<core::String> tags) const;
+        const QueryCache& find_or_create_query_cache(core::Span<QueryCache::ComponentRule> components, core::Span<core::String> tags);
+
+        bool matches_query_cache(const QueryCache& cache, EntityId id) const;
+        void update_query_cache(QueryCache& cache, EntityId id) const;
+        void rebuild_query_cache(QueryCache& cache) const;
+
+        void update_query_caches_for_component(ComponentTypeIndex type_id, EntityId id);
+        void update_query_caches_for_tag(std::string_view tag, core::Span<EntityId> ids);
+        void update_query_caches(core::Span<EntityId> ids);
 
 
         template<typename T>
@@ -445,6 +540,7 @@ class EntityWorld {
         void register_component_types(System* system) const;
 
         void check_exists(EntityId id) const;
+        void check_structural_change() const;
 
 
         core::Vector<std::unique_ptr<ComponentContainerBase>> _containers;
@@ -455,6 +551,11 @@ class EntityWorld {
 
         core::Vector<std::unique_ptr<System>> _systems;
         core::Vector<std::unique_ptr<WorldComponentContainerBase>> _world_components;
+
+        core::Vector<std::unique_ptr<QueryCache>> _query_caches;
+        std::unique_ptr<ArchetypeStorage> _archetypes;
+
+        bool _running_concurrent_systems = false;
 };
 
 }
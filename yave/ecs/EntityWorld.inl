@@ -93,6 +93,45 @@ void ComponentBox<T>::add_to(EntityWorld& world, EntityId id) const {
     world.add_component<T>(id, _component);
 }
 
+
+
+template<typename T>
+std::unique_ptr<ComponentColumnBase> ComponentBox<T>::create_column() const {
+    return std::make_unique<ComponentColumn<T>>();
+}
+
+template<typename T>
+void ComponentColumn<T>::add_to(EntityWorld& world, core::Span<EntityId> ids) const {
+    auto column_ids = core::vector_with_capacity<EntityId>(_entities.size());
+    for(const u32 index : _entities) {
+        y_debug_assert(index < ids.size());
+        column_ids << ids[index];
+    }
+
+    if constexpr(is_raw) {
+        if(_layout != detail::component_layout_hash<T>() || _raw.size() != _entities.size() * sizeof(T)) {
+            log_msg(fmt("Layout of % changed since the scene was saved, components have been skipped", runtime_info().clean_component_name()), Log::Error);
+            return;
+        }
+
+        world.add_component_batch<T>(column_ids, [&](usize i) {
+            T component;
+            std::memcpy(&component, _raw.data() + i * sizeof(T), sizeof(T));
+            return component;
+        });
+    } else {
+        y_debug_assert(_components.size() == _entities.size());
+        world.add_component_batch<T>(column_ids, [&](usize i) -> const T& {
+            return _components[i];
+        });
+    }
+}
+
+template<typename T>
+void detail::add_command_component(EntityWorld& world, EntityId id, void* component) {
+    world.add_component<T>(id, std::move(*static_cast<T*>(component)));
+}
+
 }
 }
 
@@ -48,6 +48,44 @@ core::Vector<EntityId> QueryUtils::matching(core::Span<SetMatch> matches, core::
     return match;
 }
 
+core::Vector<EntityId> QueryUtils::matching(core::Span<SetMatch> matches, const SetMatch& candidates) {
+    y_debug_assert(candidates.include);
+
+    if(!candidates.set) {
+        return {};
+    }
+
+    if(!candidates.mutated) {
+        return matching(matches, candidates.set->ids());
+    }
+
+    y_profile();
+
+    // Scan the dirty words directly rather than going through every id of the set
+    const core::Span<EntityId> set_ids = candidates.set->ids();
+    auto match = core::vector_with_capacity<EntityId>(candidates.mutated->size());
+    candidates.mutated->for_each([&](u32 index) {
+        const u32 dense_index = candidates.set->dense_index_of(index);
+        if(dense_index == SparseIdSetBase::invalid_index) {
+            return;
+        }
+
+        const EntityId id = set_ids[dense_index];
+        bool matched = true;
+        for(usize i = 0; matched && i != matches.size(); ++i) {
+            matched &= matches[i].contains(id);
+        }
+
+        if(matched) {
+            match.push_back(id);
+        }
+    });
+
+    y_profile_msg(fmt_c_str("% id matched", match.size()));
+
+    return match;
+}
+
 }
 }
 
@@ -25,6 +25,8 @@ SOFTWARE.
 #include "traits.h"
 #include "ComponentContainer.h"
 
+#include <y/core/String.h>
+
 #include <y/utils/iter.h>
 
 #include <y/utils/log.h>
@@ -52,11 +54,13 @@ struct QueryUtils {
         const SparseIdSetBase* set = nullptr;
         bool include = true;
 
-        inline core::Span<EntityId> ids() const {
-            return set ? set->ids() : core::Span<EntityId>{};
-        }
+        // Only ids with their bit set match, used by Changed<T>
+        const DirtyBitSet* mutated = nullptr;
 
         inline isize signed_size() const {
+            if(mutated) {
+                return mutated->size();
+            }
             return set ? set->size() : 0;
         }
 
@@ -68,16 +72,23 @@ struct QueryUtils {
             if(!include) {
                 return false;
             }
+            if(mutated && mutated->is_empty()) {
+                return true;
+            }
             return set ? set->is_empty() : true;
         }
 
         inline bool contains(EntityId id) const {
-            return (set ? set->contains(id) : false) == include;
+            const bool in_set = set && set->contains(id) && (!mutated || mutated->test(id.index()));
+            return in_set == include;
         }
     };
 
     static core::Vector<EntityId> matching(core::Span<SetMatch> matches, core::Span<EntityId> ids);
 
+    // Matches the ids of candidates against the other rules, candidates must be inclusive
+    static core::Vector<EntityId> matching(core::Span<SetMatch> matches, const SetMatch& candidates);
+
     template<usize I = 0, typename... Args>
     static void fill_match_array(core::MutableSpan<SetMatch> matches, const std::array<const ComponentContainerBase*, sizeof...(Args)>& containers, bool only_changed = true) {
         if constexpr(I < sizeof...(Args)) {
@@ -87,29 +98,76 @@ struct QueryUtils {
             static constexpr bool removed = traits::component_removed_v<component_type>;
 
             const SparseIdSetBase* set = nullptr;
+            const DirtyBitSet* mutated = nullptr;
             if(const ComponentContainerBase* container = containers[I]) {
 
                 y_debug_assert(type_index<traits::component_raw_type_t<component_type>>() == container->type_id());
 
                 if constexpr(removed) {
                     set = &container->to_be_removed();
-                } else if constexpr(changed && only_changed) {
-                    set = &container->recently_mutated();
                 } else {
                     set = &container->id_set();
+                    if(changed && only_changed) {
+                        mutated = &container->recently_mutated();
+                    }
                 }
             }
 
             matches[I] = {
                 set,
                 required,
+                mutated,
             };
-            fill_match_array<I + 1, Args...>(matches, containers);
+            fill_match_array<I + 1, Args...>(matches, containers, only_changed);
         }
     }
 };
 
 
+// Persistent match list of a registered query.
+// EntityWorld keeps it up to date as components and tags are added or removed.
+class QueryCache : NonMovable {
+    public:
+        struct ComponentRule {
+            ComponentTypeIndex type;
+            bool include = true;
+
+            inline bool operator==(const ComponentRule& other) const {
+                return type == other.type && include == other.include;
+            }
+        };
+
+        struct TagRule {
+            core::String tag;
+            bool include = true;
+
+            inline bool operator==(const TagRule& other) const {
+                return tag == other.tag && include == other.include;
+            }
+        };
+
+        inline core::Span<EntityId> ids() const {
+            return _ids.ids();
+        }
+
+        inline core::Span<ComponentRule> component_rules() const {
+            return _components;
+        }
+
+        inline core::Span<TagRule> tag_rules() const {
+            return _tags;
+        }
+
+    private:
+        friend class EntityWorld;
+
+        core::Vector<ComponentRule> _components;
+        core::Vector<TagRule> _tags;
+
+        SparseIdSet _ids;
+};
+
+
 template<typename... Args>
 class Query : NonCopyable {
 
@@ -119,6 +177,10 @@ class Query : NonCopyable {
     static constexpr bool is_empty = sizeof...(Args) == 0;
     static constexpr std::array component_included = {traits::component_required_v<Args>..., false};
 
+    // Aim for chunks that fit in L1
+    static constexpr usize chunk_byte_size = 16 * 1024;
+    static constexpr usize components_byte_size = (sizeof(traits::component_raw_type_t<Args>) + ... + sizeof(EntityId));
+
     template<usize I = 0>
     static auto make_component_tuple(const set_tuple& sets, EntityId id) {
         if constexpr(I < std::tuple_size_v<set_tuple>) {
@@ -298,6 +360,30 @@ class Query : NonCopyable {
             return _ids.size();
         }
 
+        static constexpr usize default_chunk_size = std::max(usize(64), chunk_byte_size / components_byte_size);
+
+        // Calls func with consecutive ranges of at most chunk_size elements, concurrently on the ECS thread pool.
+        // Mutate<T> components have already been marked as mutated when the query was created,
+        // so chunks never touch the mutation sets and can safely write to their own components.
+        template<typename F>
+        void for_each_chunk(F&& func, usize chunk_size = default_chunk_size) const {
+            y_profile();
+
+            parallel_for_chunks(_ids.size(), chunk_size, [&](usize chunk_begin, usize chunk_end) {
+                func(core::Range<const_iterator>(iterator_at(chunk_begin), iterator_at(chunk_end)));
+            });
+        }
+
+        // Calls func(id, components...) for every element, concurrently on the ECS thread pool
+        template<typename F>
+        void par_for_each(F&& func, usize chunk_size = default_chunk_size) const {
+            for_each_chunk([&](const core::Range<const_iterator>& chunk) {
+                for(auto&& id_comp : chunk) {
+                    std::apply([&](auto&... comps) { func(id_comp.id, comps...); }, id_comp.components);
+                }
+            }, chunk_size);
+        }
+
         // These have lifetime problems when writing:
         // for(auto id : world.query<A>().ids()) { /* ... */ }
         // "world.query<A>().ids()" is what gets bound, so the Query gets destroyed before the loop is even entered...
@@ -316,7 +402,10 @@ class Query : NonCopyable {
         }
 
         core::Vector<EntityId> ids() && {
-            return std::move(_ids);
+            if(_ids.data() == _owned_ids.data()) {
+                return std::move(_owned_ids);
+            }
+            return core::Vector<EntityId>(_ids);
         }
 
     private:
@@ -326,23 +415,44 @@ class Query : NonCopyable {
             if(!matches.is_empty() && std::all_of(matches.begin(), matches.end(), [](auto match) { return !match.is_empty(); })) {
                 std::sort(matches.begin(), matches.end(), [](const auto& a, const auto& b) { return a.sorting_key() < b.sorting_key(); });
                 y_always_assert(matches[0].include, "Query needs at least one inclusive matching rule");
-                _ids = QueryUtils::matching(core::Span<QueryUtils::SetMatch>(matches.begin() + 1, matches.size() - 1), matches[0].ids());
+                _owned_ids = QueryUtils::matching(core::Span<QueryUtils::SetMatch>(matches.begin() + 1, matches.size() - 1), matches[0]);
             }
+            _ids = _owned_ids;
             fill_components_array();
         }
 
         Query(const set_tuple& sets, core::MutableSpan<QueryUtils::SetMatch> matches, core::Span<EntityId> range)  : _sets(sets) {
             if(std::all_of(matches.begin(), matches.end(), [](auto match) { return !match.is_empty(); })) {
                 std::sort(matches.begin(), matches.end(), [](const auto& a, const auto& b) { return a.sorting_key() < b.sorting_key(); });
-                _ids = QueryUtils::matching(matches, range);
+                _owned_ids = QueryUtils::matching(matches, range);
             }
+            _ids = _owned_ids;
+            fill_components_array();
+        }
+
+        Query(const set_tuple& sets, core::Vector<EntityId> ids) : _sets(sets), _owned_ids(std::move(ids)) {
+            _ids = _owned_ids;
+            fill_components_array();
+        }
+
+        // Iterates directly over the ids of a registered query, nothing is matched or copied.
+        // Components should not be added or removed while the query is alive.
+        Query(const set_tuple& sets, const QueryCache& cache) : _sets(sets), _ids(cache.ids()) {
             fill_components_array();
         }
 
     private:
 #if defined(USE_LAZY_QUERY)
         void fill_components_array() {}
+
+        const_iterator iterator_at(usize index) const {
+            return const_iterator(_ids.begin() + index, _sets);
+        }
 #else
+        const_iterator iterator_at(usize index) const {
+            return const_iterator(index, _ids.data(), _components.data());
+        }
+
         void fill_components_array() {
             y_profile();
             _components.set_min_capacity(_ids.size());
@@ -359,7 +469,8 @@ class Query : NonCopyable {
 
         set_tuple _sets;
 
-        core::Vector<EntityId> _ids;
+        core::Vector<EntityId> _owned_ids;
+        core::Span<EntityId> _ids;
 
 
 };
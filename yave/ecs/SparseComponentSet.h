@@ -326,6 +326,46 @@ class SparseComponentSetBase : public SparseIdSetBase {
             _dense.set_min_capacity(cap);
         }
 
+        // Makes room for all of ids at once so batched insertions don't reallocate
+        void reserve(core::Span<EntityId> ids) {
+            if(ids.is_empty()) {
+                return;
+            }
+
+            index_type max_index = 0;
+            for(const EntityId id : ids) {
+                max_index = std::max(max_index, id.index());
+            }
+
+            grow_sparse(max_index);
+            set_min_capacity(size() + ids.size());
+        }
+
+        // Moves the element at dense index i to destinations[i], destinations is used as scratch space
+        void permute(core::MutableSpan<index_type> destinations) {
+            y_debug_assert(destinations.size() == _dense.size());
+
+            // Invert the permutation in place so we can move elements in order
+            for(usize i = 0; i != destinations.size(); ++i) {
+                _sparse[_dense[i].index()] = destinations[i];
+            }
+            for(usize i = 0; i != destinations.size(); ++i) {
+                destinations[_sparse[_dense[i].index()]] = index_type(i);
+            }
+
+            auto dense = core::vector_with_capacity<EntityId>(_dense.size());
+            auto values = core::vector_with_capacity<element_type>(_values.size());
+            for(const index_type src : destinations) {
+                dense.emplace_back(_dense[src]);
+                values.emplace_back(std::move(_values[src]));
+            }
+
+            _dense.swap(dense);
+            _values.swap(values);
+
+            audit();
+        }
+
         void clear() {
             _values.clear();
             _dense.clear();
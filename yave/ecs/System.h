@@ -23,8 +23,11 @@ SOFTWARE.
 #define YAVE_ECS_SYSTEM_H
 
 #include <yave/ecs/ecs.h>
+#include <yave/ecs/traits.h>
+#include <yave/ecs/CommandBuffer.h>
 
 #include <y/core/String.h>
+#include <y/core/Vector.h>
 
 namespace yave {
 namespace ecs {
@@ -71,6 +74,40 @@ class System : NonCopyable {
             return _fixed_update_time;
         }
 
+        // Systems that don't declare their component accesses might touch anything in the world,
+        // they are run on the calling thread and never alongside another system.
+        bool is_exclusive() const {
+            return !_has_declared_access;
+        }
+
+        core::Span<ComponentTypeIndex> read_components() const {
+            return _reads;
+        }
+
+        core::Span<ComponentTypeIndex> written_components() const {
+            return _writes;
+        }
+
+        bool conflicts_with(const System& other) const {
+            if(is_exclusive() || other.is_exclusive()) {
+                return true;
+            }
+            const auto contains = [](core::Span<ComponentTypeIndex> types, ComponentTypeIndex type) {
+                return std::find(types.begin(), types.end(), type) != types.end();
+            };
+            for(const ComponentTypeIndex type : _writes) {
+                if(contains(other._writes, type) || contains(other._reads, type)) {
+                    return true;
+                }
+            }
+            for(const ComponentTypeIndex type : other._writes) {
+                if(contains(_reads, type)) {
+                    return true;
+                }
+            }
+            return false;
+        }
+
         void schedule_fixed_update(EntityWorld& world, float dt) {
             if(_fixed_update_time <= 0.0f) {
                 if(_fixed_update_time > -1.0f) {
@@ -86,10 +123,39 @@ class System : NonCopyable {
             }
         }
 
+        // Played back by the world after every tick and update, in system order.
+        // Systems that declare their accesses may run concurrently: they must create, remove or add components to entities through it.
+        CommandBuffer& command_buffer() {
+            return _commands;
+        }
+
+    protected:
+        // Uses the same syntax as queries: declare_access<A, Mutate<B>>() reads A and writes B
+        template<typename... Args>
+        void declare_access() {
+            _has_declared_access = true;
+            (declare_component_access<Args>(), ...);
+        }
+
     private:
+        template<typename T>
+        void declare_component_access() {
+            const ComponentTypeIndex type = type_index<traits::component_raw_type_t<T>>();
+            auto& accesses = traits::is_component_mutable_v<T> ? _writes : _reads;
+            if(std::find(accesses.begin(), accesses.end(), type) == accesses.end()) {
+                accesses << type;
+            }
+        }
+
         core::String _name;
         float _fixed_update_time = 0.0f;
         float _fixed_update_acc = 0.0f;
+
+        core::Vector<ComponentTypeIndex> _reads;
+        core::Vector<ComponentTypeIndex> _writes;
+        bool _has_declared_access = false;
+
+        CommandBuffer _commands;
 };
 
 }
@@ -22,10 +22,43 @@ SOFTWARE.
 
 #include "ecs.h"
 
+#include <y/concurrent/WorkStealingThreadPool.h>
+
 #include <atomic>
 
 namespace yave {
 namespace ecs {
+
+concurrent::WorkStealingThreadPool& thread_pool() {
+    static concurrent::WorkStealingThreadPool pool;
+    return pool;
+}
+
+void parallel_for_chunks(usize size, usize chunk_size, const std::function<void(usize, usize)>& func) {
+    y_debug_assert(chunk_size);
+
+    if(size <= chunk_size) {
+        if(size) {
+            func(0, size);
+        }
+        return;
+    }
+
+    auto& pool = thread_pool();
+    concurrent::DependencyGroup done;
+    for(usize i = chunk_size; i < size; i += chunk_size) {
+        const usize end = std::min(i + chunk_size, size);
+        pool.schedule([&, i, end] {
+            func(i, end);
+        }, &done);
+    }
+
+    // The calling thread takes the first chunk instead of idling
+    func(0, chunk_size);
+
+    pool.process_until_ready(done);
+}
+
 namespace detail {
 
 u32 next_type_index() {
@@ -24,6 +24,12 @@ SOFTWARE.
 
 #include <yave/yave.h>
 
+#include <functional>
+
+namespace y::concurrent {
+class WorkStealingThreadPool;
+}
+
 namespace yave {
 namespace ecs {
 
@@ -31,6 +37,13 @@ class EntityWorld;
 class ComponentContainerBase;
 
 
+// Shared by system scheduling and parallel queries
+concurrent::WorkStealingThreadPool& thread_pool();
+
+// Calls func(begin, end) with consecutive ranges of at most chunk_size elements of [0, size), concurrently on thread_pool()
+void parallel_for_chunks(usize size, usize chunk_size, const std::function<void(usize, usize)>& func);
+
+
 
 
 namespace detail {
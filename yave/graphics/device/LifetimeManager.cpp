@@ -40,7 +40,7 @@ static bool compare_cmd_buffers(const CmdBufferData* a, const CmdBufferData* b)
     return a->resource_fence() < b->resource_fence();
 }
 
-LifetimeManager::LifetimeManager() {
+LifetimeManager::LifetimeManager() : _destroy_queue(destroy_queue_capacity) {
 #ifdef YAVE_MT_LIFETIME_MANAGER
     _collector_thread = std::thread([this] {
         concurrent::set_thread_name("LifetimeManager collector thread");
@@ -82,6 +82,7 @@ LifetimeManager::~LifetimeManager() {
     y_debug_assert(_create_counter == _next);
     y_always_assert(_in_flight.empty(), "CmdBuffer still in flight");
 
+    collect_destroy_queue();
     for(auto& res : _to_destroy) {
         y_always_assert(res.first == _next, "Resourse is still waiting on unsignaled fence.");
         destroy_resource(res.second);
@@ -156,6 +157,8 @@ void LifetimeManager::clear_resources(u64 up_to) {
         y_profile_zone("collection");
         const auto lock = y_profile_unique_lock(_resources_lock);
 
+        collect_destroy_queue();
+
         y_debug_assert(std::is_sorted(_to_destroy.begin(), _to_destroy.end(), [](const auto& a, const auto& b) { return a.first < b.first; }));
         while(!_to_destroy.empty() && _to_destroy.front().first <= up_to) {
             to_delete.push_back(std::move(_to_destroy.front().second));
@@ -169,6 +172,26 @@ void LifetimeManager::clear_resources(u64 up_to) {
     }
 }
 
+void LifetimeManager::push_to_destroy(ManagedResource resource) {
+    std::pair<u64, ManagedResource> res(_create_counter, std::move(resource));
+    if(!_destroy_queue.try_push(std::move(res))) {
+        y_profile_zone("destroy queue full");
+        const auto lock = y_profile_unique_lock(_resources_lock);
+        collect_destroy_queue();
+        _to_destroy.emplace_back(std::move(res));
+    }
+}
+
+// _resources_lock must be held
+void LifetimeManager::collect_destroy_queue() {
+    // Resources can be pushed slightly out of order by concurrent producers, so keep _to_destroy sorted
+    std::pair<u64, ManagedResource> res(0, EmptyResource{});
+    while(_destroy_queue.try_pop(res)) {
+        const auto it = std::upper_bound(_to_destroy.begin(), _to_destroy.end(), res.first, [](u64 a, const auto& b) { return a < b.first; });
+        _to_destroy.insert(it, std::move(res));
+    }
+}
+
 void LifetimeManager::destroy_resource(ManagedResource& resource) const {
     std::visit(
         [](auto& res) {
@@ -238,7 +261,7 @@ usize LifetimeManager::pending_cmd_buffers() const {
 
 usize LifetimeManager::pending_deletions() const {
     const auto lock = y_profile_unique_lock(_resources_lock);
-    return _to_destroy.size();
+    return _to_destroy.size() + _destroy_queue.size();
 }
 
 }
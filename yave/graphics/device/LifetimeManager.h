@@ -27,6 +27,8 @@ SOFTWARE.
 #include <yave/graphics/memory/DeviceMemory.h>
 #include <yave/meshes/MeshDrawData.h>
 
+#include <y/concurrent/MPMCQueue.h>
+
 #include <variant>
 #include <deque>
 #include <mutex>
@@ -40,6 +42,8 @@ class LifetimeManager : NonMovable {
 
     struct EmptyResource {};
 
+    static constexpr usize destroy_queue_capacity = 1024 * 4;
+
     using ManagedResource = std::variant<
 #define YAVE_GENERATE_RT_VARIANT(T) T,
 YAVE_GRAPHIC_HANDLE_TYPES(YAVE_GENERATE_RT_VARIANT)
@@ -65,17 +69,20 @@ YAVE_GRAPHIC_HANDLE_TYPES(YAVE_GENERATE_RT_VARIANT)
 
 #define YAVE_GENERATE_DESTROY(T)                                                    \
         void destroy_later(T&& t) {                                                 \
-            const auto lock = y_profile_unique_lock(_resources_lock);               \
-            _to_destroy.emplace_back(_create_counter, ManagedResource(y_fwd(t)));   \
+            push_to_destroy(ManagedResource(y_fwd(t)));                             \
         }
 YAVE_GRAPHIC_HANDLE_TYPES(YAVE_GENERATE_DESTROY)
 #undef YAVE_GENERATE_DESTROY
 
     private:
+        void push_to_destroy(ManagedResource resource);
+        void collect_destroy_queue();
+
         void clear_resources(u64 up_to);
         void destroy_resource(ManagedResource& resource) const;
 
-        std::deque<std::pair<u64, ManagedResource>> _to_destroy;
+        concurrent::MPMCQueue<std::pair<u64, ManagedResource>> _destroy_queue;
+        std::deque<std::pair<u64, ManagedResource>> _to_destroy; // Guarded by _resources_lock
         std::deque<CmdBufferData*> _in_flight;
 
         mutable std::mutex _resources_lock;
@@ -118,5 +118,14 @@ ImageData::ImageData(const math::Vec2ui& size, const void* data, ImageFormat for
     std::memcpy(_data.data(), data, data_size);
 }
 
+ImageData::ImageData(const math::Vec2ui& size, core::FixedArray<byte> data, ImageFormat format, usize mips) :
+        _size(size, 1),
+        _format(format),
+        _mips(u32(mips)),
+        _data(std::move(data)) {
+
+    y_always_assert(_data.size() == byte_size(), "Invalid image data size");
+}
+
 }
 
@@ -38,8 +38,13 @@ class ImageData : NonCopyable {
             math::Vec3ui size;
         };
 
+        // Streamed images (see StreamedImageData.h) store their high mips after the serialized data,
+        // which is never read when loading an ImageData.
+        static constexpr bool reads_partial_data = true;
+
         ImageData() = default;
         ImageData(const math::Vec2ui& size, const void* data, ImageFormat format, usize mips = 1);
+        ImageData(const math::Vec2ui& size, core::FixedArray<byte> data, ImageFormat format, usize mips = 1);
 
         static usize mip_count(const math::Vec3ui& size);
         static math::Vec3ui mip_size(const math::Vec3ui& size, usize mip = 0);
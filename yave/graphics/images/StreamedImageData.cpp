@@ -0,0 +1,181 @@
+/*******************************
+Copyright (c) 2016-2023 Grégoire Angerand
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+**********************************/
+#include "StreamedImageData.h"
+
+#include <y/serde3/archives.h>
+
+#include <cmath>
+#include <cstring>
+
+namespace yave {
+
+struct StreamedImageFooter {
+    static constexpr u64 streamed_magic = 0x0053524d49415453; // "STAIMRS"
+
+    StreamedImageInfo info;
+    u64 magic = 0;
+};
+
+static_assert(std::is_trivially_copyable_v<StreamedImageFooter>);
+
+
+usize StreamedImageInfo::first_resident_mip() const {
+    return mips - resident_mips;
+}
+
+u64 StreamedImageInfo::mip_offset(usize mip) const {
+    y_debug_assert(mip < first_resident_mip());
+
+    u64 offset = streamed_offset;
+    for(usize i = first_resident_mip() - 1; i > mip; --i) {
+        offset += ImageData::mip_byte_size(size, format, i);
+    }
+    return offset;
+}
+
+usize StreamedImageInfo::mip_for_screen_size(float screen_size) const {
+    const float ratio = float(std::max(size.x(), size.y())) / std::max(screen_size, 1.0f);
+    if(ratio <= 1.0f) {
+        return 0;
+    }
+    return std::min(usize(std::log2(ratio)), usize(mips - 1));
+}
+
+
+
+serde3::Result write_streamed_image(io2::Writer& writer, const ImageData& image, u32 resident_size) {
+    y_profile();
+
+    usize first_resident = 0;
+    while(first_resident + 1 < image.mipmaps() && image.mip_size(first_resident).max_component() > resident_size) {
+        ++first_resident;
+    }
+
+    if(!first_resident || image.size().z() != 1) {
+        serde3::WritableArchive arc(writer);
+        return arc.serialize(image);
+    }
+
+    const usize start = writer.tell();
+
+    {
+        const ImageData resident(
+            image.mip_size(first_resident).to<2>(),
+            image.data() + image.data_offset(first_resident),
+            image.format(),
+            image.mipmaps() - first_resident
+        );
+
+        serde3::WritableArchive arc(writer);
+        y_try(arc.serialize(resident));
+    }
+
+    StreamedImageFooter footer;
+    footer.magic = StreamedImageFooter::streamed_magic;
+    footer.info.size = image.size();
+    footer.info.format = image.format();
+    footer.info.mips = u32(image.mipmaps());
+    footer.info.resident_mips = u32(image.mipmaps() - first_resident);
+    footer.info.streamed_offset = writer.tell() - start;
+
+    for(usize i = first_resident; i != 0; --i) {
+        const ImageData::Mip mip = image.mip_data(i - 1);
+        if(!writer.write(mip.data.data(), mip.data.size())) {
+            return core::Err(serde3::Error(serde3::ErrorType::IOError));
+        }
+    }
+
+    if(!writer.write_one(footer)) {
+        return core::Err(serde3::Error(serde3::ErrorType::IOError));
+    }
+
+    return core::Ok(serde3::Success::Full);
+}
+
+core::Result<StreamedImageInfo> read_streamed_image_info(io2::Reader& reader) {
+    const usize total_size = reader.tell() + reader.remaining();
+    if(total_size < sizeof(StreamedImageFooter)) {
+        return core::Err();
+    }
+
+    reader.seek(total_size - sizeof(StreamedImageFooter));
+
+    StreamedImageFooter footer;
+    if(!reader.read_one(footer) || footer.magic != StreamedImageFooter::streamed_magic) {
+        return core::Err();
+    }
+
+    const StreamedImageInfo& info = footer.info;
+    if(!info.resident_mips || info.resident_mips >= info.mips || info.mips > ImageData::mip_count(info.size) || info.streamed_offset >= total_size) {
+        return core::Err();
+    }
+
+    return core::Ok(info);
+}
+
+core::Result<ImageData> read_streamed_image(io2::Reader& reader, usize first_mip) {
+    y_profile();
+
+    const auto info_res = read_streamed_image_info(reader);
+    if(!info_res) {
+        return core::Err();
+    }
+
+    const StreamedImageInfo& info = info_res.unwrap();
+    const usize first_resident = info.first_resident_mip();
+    first_mip = std::min(first_mip, first_resident);
+
+    ImageData resident;
+    {
+        reader.seek(0);
+        const serde3::Result res = serde3::ReadableArchive(reader).deserialize(resident);
+        if(!res || resident.mipmaps() != info.resident_mips || resident.size() != ImageData::mip_size(info.size, first_resident)) {
+            return core::Err();
+        }
+    }
+
+    const math::Vec3ui size = ImageData::mip_size(info.size, first_mip);
+    const usize mips = info.mips - first_mip;
+
+    core::FixedArray<byte> data(ImageData::byte_size(size, info.format, mips));
+
+    if(first_mip != first_resident) {
+        y_profile_zone("reading streamed mips");
+
+        // Streamed mips are stored smallest first: we read them in order, starting with the one right above the resident mips
+        reader.seek(info.mip_offset(first_resident - 1));
+        for(usize i = first_resident; i != first_mip; --i) {
+            const usize mip = i - 1;
+            const usize offset = ImageData::byte_size(size, info.format, mip - first_mip);
+            if(!reader.read(data.data() + offset, ImageData::mip_byte_size(info.size, info.format, mip))) {
+                return core::Err();
+            }
+        }
+    }
+
+    std::memcpy(data.data() + ImageData::byte_size(size, info.format, first_resident - first_mip), resident.data(), resident.byte_size());
+
+    return core::Ok(ImageData(size.to<2>(), std::move(data), info.format, mips));
+}
+
+}
+
@@ -0,0 +1,70 @@
+/*******************************
+Copyright (c) 2016-2023 Grégoire Angerand
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+**********************************/
+#ifndef YAVE_GRAPHICS_IMAGES_STREAMEDIMAGEDATA_H
+#define YAVE_GRAPHICS_IMAGES_STREAMEDIMAGEDATA_H
+
+#include "ImageData.h"
+
+#include <y/serde3/result.h>
+#include <y/io2/io.h>
+
+namespace yave {
+
+// Streamed images are laid out as:
+//     [ImageData holding the resident (smallest) mips][streamed mips, smallest first][footer]
+// Loading them as a plain ImageData only reads the resident mips.
+// Since streamed mips are stored smallest first, loading more of them only ever reads one contiguous range.
+
+struct StreamedImageInfo {
+    // Mips with a size of at most resident_size are stored in the ImageData
+    static constexpr u32 default_resident_size = 256;
+
+    math::Vec3ui size;
+    ImageFormat format;
+    u32 mips = 0;
+    u32 resident_mips = 0;
+
+    // Offset of the smallest streamed mip
+    u64 streamed_offset = 0;
+
+    usize first_resident_mip() const;
+
+    // Offset of a streamed mip, data for mips [mip, first_resident_mip) starts there
+    u64 mip_offset(usize mip) const;
+
+    // Smallest mip that can be displayed on screen_size pixels without losing detail
+    usize mip_for_screen_size(float screen_size) const;
+};
+
+// Writes a plain ImageData if the image is small enough to be fully resident
+serde3::Result write_streamed_image(io2::Writer& writer, const ImageData& image, u32 resident_size = StreamedImageInfo::default_resident_size);
+
+// Fails if the image was not written as a streamed image
+core::Result<StreamedImageInfo> read_streamed_image_info(io2::Reader& reader);
+
+// Reads mips [first_mip, mips)
+core::Result<ImageData> read_streamed_image(io2::Reader& reader, usize first_mip);
+
+}
+
+#endif // YAVE_GRAPHICS_IMAGES_STREAMEDIMAGEDATA_H
+
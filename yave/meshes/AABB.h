@@ -24,6 +24,8 @@ SOFTWARE.
 
 #include <yave/yave.h>
 
+#include <array>
+
 namespace yave {
 
 class AABB {
@@ -102,6 +104,37 @@ class AABB {
 
 static_assert(std::is_trivially_copyable_v<AABB>);
 
+
+// AABBs stored as structure of arrays, in groups that can be tested at once with SIMD
+// The size is fixed regardless of the instruction set so the layout is the same in every translation unit
+struct AABBBatch {
+    static constexpr usize size = 8;
+
+    std::array<float, size> min_x = {};
+    std::array<float, size> min_y = {};
+    std::array<float, size> min_z = {};
+    std::array<float, size> max_x = {};
+    std::array<float, size> max_y = {};
+    std::array<float, size> max_z = {};
+
+    void set(usize index, const AABB& aabb) {
+        y_debug_assert(index < size);
+        min_x[index] = aabb.min().x();
+        min_y[index] = aabb.min().y();
+        min_z[index] = aabb.min().z();
+        max_x[index] = aabb.max().x();
+        max_y[index] = aabb.max().y();
+        max_z[index] = aabb.max().z();
+    }
+
+    AABB get(usize index) const {
+        y_debug_assert(index < size);
+        return AABB(math::Vec3(min_x[index], min_y[index], min_z[index]), math::Vec3(max_x[index], max_y[index], max_z[index]));
+    }
+};
+
+static_assert(std::is_trivially_copyable_v<AABBBatch>);
+
 }
 
 #endif // YAVE_MESHES_AABB_H
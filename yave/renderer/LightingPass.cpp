@@ -144,22 +144,16 @@ static FrameGraphMutableImageId ambient_pass(FrameGraph& framegraph,
 
 
 
-static u32 fill_point_light_buffer(uniform::PointLight* points, const SceneView& scene) {
+// Lights have already been culled against the camera frustum by VisibleLights::find
+static u32 fill_point_light_buffer(uniform::PointLight* points, const SceneView& scene, const VisibleLights& lights) {
     y_profile();
 
-    Y_TODO(Use octree)
-    const Frustum frustum = scene.camera().frustum();
-
     u32 count = 0;
 
-    const std::array tags = {ecs::tags::not_hidden};
-    for(auto point : scene.world().query<TransformableComponent, PointLightComponent>(tags)) {
+    for(auto point : scene.world().query<TransformableComponent, PointLightComponent>(lights.point_lights)) {
         const auto& [t, l] = point.components;
 
         const float scaled_range = l.range() * t.transform().scale().max_component();
-        if(!frustum.is_inside(t.position(), scaled_range)) {
-            continue;
-        }
 
         points[count++] = {
             t.position(),
@@ -177,6 +171,7 @@ static u32 fill_point_light_buffer(uniform::PointLight* points, const SceneView&
             break;
         }
     }
+
     return count;
 }
 
@@ -191,13 +186,9 @@ static u32 fill_spot_light_buffer(
 
     y_debug_assert(Transforms == !!transforms);
 
-    Y_TODO(Use octree)
-    const Frustum frustum = scene.camera().frustum();
-
     u32 count = 0;
 
-    const std::array tags = {ecs::tags::not_hidden};
-    for(auto&& [id, comp] : scene.world().query<TransformableComponent, SpotLightComponent>(tags)) {
+    for(auto&& [id, comp] : scene.world().query<TransformableComponent, SpotLightComponent>(shadow_pass.visible_lights->spot_lights)) {
         const auto& [t, l] = comp;
 
         const math::Vec3 forward = t.forward().normalized();
@@ -211,9 +202,6 @@ static u32 fill_spot_light_buffer(
         }
 
         const math::Vec3 encl_sphere_center =  t.position() + forward * enclosing_sphere.dist_to_center;
-        if(!frustum.is_inside(encl_sphere_center, enclosing_sphere.radius)) {
-            continue;
-        }
 
         auto shadow_indices = math::Vec4ui(u32(-1));
         if(l.cast_shadow() && render_shadows) {
@@ -285,7 +273,7 @@ static void local_lights_pass_compute(FrameGraph& framegraph,
         TypedMapping<uniform::PointLight> points = self->resources().map_buffer(point_buffer);
         TypedMapping<uniform::SpotLight> spots = self->resources().map_buffer(spot_buffer);
 
-        const u32 point_count = fill_point_light_buffer(points.data(), scene);
+        const u32 point_count = fill_point_light_buffer(points.data(), scene, *shadow_pass.visible_lights);
         const u32 spot_count = fill_spot_light_buffer<false>(spots.data(), nullptr, scene, render_shadows, shadow_pass);
 
         if(point_count || spot_count) {
@@ -327,7 +315,7 @@ static void local_lights_pass(FrameGraph& framegraph,
         builder.map_buffer(point_buffer);
         builder.set_render_func([=](RenderPassRecorder& render_pass, const FrameGraphPass* self) {
             TypedMapping<uniform::PointLight> points = self->resources().map_buffer(point_buffer);
-            const u32 point_count = fill_point_light_buffer(points.data(), scene);
+            const u32 point_count = fill_point_light_buffer(points.data(), scene, *shadow_pass.visible_lights);
 
             if(!point_count) {
                 return;
@@ -36,7 +36,7 @@ SOFTWARE.
 
 namespace yave {
 
-SceneRenderSubPass SceneRenderSubPass::create(FrameGraphPassBuilder& builder, const SceneView& view) {
+SceneRenderSubPass SceneRenderSubPass::create(FrameGraphPassBuilder& builder, const SceneView& view, std::shared_ptr<const core::Vector<ecs::EntityId>> visible) {
     const usize buffer_size = view.world().components<TransformableComponent>().size();
 
     auto camera_buffer = builder.declare_typed_buffer<Renderable::CameraData>();
@@ -47,6 +47,7 @@ SceneRenderSubPass SceneRenderSubPass::create(FrameGraphPassBuilder& builder, co
     pass.descriptor_set_index = builder.next_descriptor_set_index();
     pass.camera_buffer = camera_buffer;
     pass.transform_buffer = transform_buffer;
+    pass.visible_entities = std::move(visible);
 
     builder.add_uniform_input(camera_buffer, pass.descriptor_set_index);
     builder.add_attrib_input(transform_buffer);
@@ -81,11 +82,13 @@ static usize render_world(const SceneRenderSubPass* sub_pass, RenderPassRecorder
     };
 
     const std::array tags = {ecs::tags::not_hidden};
-    if(const OctreeSystem* octree_system = world.find_system<OctreeSystem>()) {
-        const core::Vector<ecs::EntityId> visible = octree_system->octree().find_entities(camera.frustum(), camera.far_plane_dist());
+    if(sub_pass->visible_entities) {
+        render_query(world.query<TransformableComponent, StaticMeshComponent>(*sub_pass->visible_entities, tags));
+    } else if(const OctreeSystem* octree_system = world.find_system<OctreeSystem>()) {
+        const core::Vector<ecs::EntityId> visible = octree_system->spatial_index().find_entities(camera.frustum(), camera.far_plane_dist());
         render_query(world.query<TransformableComponent, StaticMeshComponent>(visible, tags));
     } else {
-        render_query(world.query<TransformableComponent, StaticMeshComponent>(tags));
+        render_query(world.cached_query<TransformableComponent, StaticMeshComponent>(tags));
     }
 
     y_profile_msg(fmt_c_str("% meshes", index));
@@ -27,6 +27,10 @@ SOFTWARE.
 
 #include <yave/scene/Renderable.h>
 
+#include <y/core/Vector.h>
+
+#include <memory>
+
 namespace yave {
 
 struct SceneRenderSubPass {
@@ -37,7 +41,10 @@ struct SceneRenderSubPass {
     FrameGraphMutableTypedBufferId<Renderable::CameraData> camera_buffer;
     FrameGraphMutableTypedBufferId<math::Transform<>> transform_buffer;
 
-    static SceneRenderSubPass create(FrameGraphPassBuilder& builder, const SceneView& view);
+    // Entities visible from scene_view, if already known. Otherwise they are queried from the octree.
+    std::shared_ptr<const core::Vector<ecs::EntityId>> visible_entities;
+
+    static SceneRenderSubPass create(FrameGraphPassBuilder& builder, const SceneView& view, std::shared_ptr<const core::Vector<ecs::EntityId>> visible = nullptr);
     void render(RenderPassRecorder& recorder, const FrameGraphPass* pass) const;
 };
 
@@ -27,7 +27,9 @@ SOFTWARE.
 #include <yave/framegraph/FrameGraphFrameResources.h>
 
 #include <yave/systems/OctreeSystem.h>
+#include <yave/components/PointLightComponent.h>
 #include <yave/components/SpotLightComponent.h>
+#include <yave/components/TransformableComponent.h>
 #include <yave/components/DirectionalLightComponent.h>
 #include <yave/graphics/commands/CmdBufferRecorder.h>
 #include <yave/ecs/EntityWorld.h>
@@ -87,9 +89,44 @@ struct SubPass {
     uniform::ShadowMapParams params;
 };
 
+struct ShadowView {
+    math::Vec2ui offset;
+    u32 size = 0;
+    Camera camera;
+};
+
+using VisibleEntities = std::shared_ptr<const core::Vector<ecs::EntityId>>;
+
+// Every shadow view is culled in the same octree traversal
+static core::Vector<VisibleEntities> find_visible_entities(const ecs::EntityWorld& world, core::Span<ShadowView> views) {
+    y_profile();
+
+    core::Vector<VisibleEntities> visible(views.size(), VisibleEntities());
+
+    const OctreeSystem* octree_system = world.find_system<OctreeSystem>();
+    if(!octree_system || views.is_empty()) {
+        return visible;
+    }
+
+    auto frustums = core::vector_with_capacity<Frustum>(views.size());
+    auto far_dists = core::vector_with_capacity<float>(views.size());
+    for(const ShadowView& view : views) {
+        frustums << view.camera.frustum();
+        far_dists << view.camera.far_plane_dist();
+    }
+
+    core::Vector<core::Vector<ecs::EntityId>> entities = octree_system->spatial_index().find_entities_for_views(frustums, far_dists);
+    for(usize i = 0; i != views.size(); ++i) {
+        visible[i] = std::make_shared<const core::Vector<ecs::EntityId>>(std::move(entities[i]));
+    }
+
+    return visible;
+}
+
 static SubPass create_sub_pass(FrameGraphPassBuilder& builder,
                             math::Vec2ui offset, u32 size, // from allocator
                             const SceneView& light_view,
+                            VisibleEntities visible,
                             const math::Vec2& uv_mul) {
     y_profile();
 
@@ -108,7 +145,7 @@ static SubPass create_sub_pass(FrameGraphPassBuilder& builder,
     };
 
     return SubPass{
-        SceneRenderSubPass::create(builder, light_view),
+        SceneRenderSubPass::create(builder, light_view, std::move(visible)),
         offset, size,
         params
     };
@@ -177,7 +214,7 @@ struct ShadowCastingLights {
     core::Vector<std::tuple<ecs::EntityId, const TransformableComponent*, const SpotLightComponent*>> spots;
 };
 
-static ShadowCastingLights collect_shadow_casting_lights(const SceneView& scene) {
+static ShadowCastingLights collect_shadow_casting_lights(const SceneView& scene, const VisibleLights& visible_lights) {
     const std::array tags = {ecs::tags::not_hidden};
     const ecs::EntityWorld& world = scene.world();
 
@@ -192,23 +229,13 @@ static ShadowCastingLights collect_shadow_casting_lights(const SceneView& scene)
         shadow_casters.directionals.push_back({id, &l});
     }
 
-    auto collect_spots = [&](auto&& query) {
-        shadow_casters.spots.set_min_capacity(query.size());
-        for(auto&& [id, comp] : query) {
-            const auto& [t, l] = comp;
-            if(!l.cast_shadow()) {
-                continue;
-            }
-            shadow_casters.spots.push_back({id, &t, &l});
+    shadow_casters.spots.set_min_capacity(visible_lights.spot_lights.size());
+    for(auto&& [id, comp] : world.query<TransformableComponent, SpotLightComponent>(visible_lights.spot_lights)) {
+        const auto& [t, l] = comp;
+        if(!l.cast_shadow()) {
+            continue;
         }
-    };
-
-    if(const OctreeSystem* octree_system = world.find_system<OctreeSystem>()) {
-        const Camera& camera = scene.camera();
-        const core::Vector<ecs::EntityId> visible = octree_system->octree().find_entities(camera.frustum(), camera.far_plane_dist());
-        collect_spots(world.query<TransformableComponent, SpotLightComponent>(visible, tags));
-    } else {
-        collect_spots(world.query<TransformableComponent, SpotLightComponent>(tags));
+        shadow_casters.spots.push_back({id, &t, &l});
     }
 
     return shadow_casters;
@@ -234,6 +261,36 @@ static float total_occupancy(const ShadowCastingLights& lights) {
 
 
 
+VisibleLights VisibleLights::find(const SceneView& scene) {
+    y_profile();
+
+    const std::array tags = {ecs::tags::not_hidden};
+    const ecs::EntityWorld& world = scene.world();
+    const Frustum frustum = scene.camera().frustum();
+
+    // Lights are few, and reach further than their AABB: test their range directly rather than querying the spatial index
+    VisibleLights lights;
+
+    for(auto&& [id, comp] : world.cached_query<TransformableComponent, PointLightComponent>(tags)) {
+        const auto& [t, l] = comp;
+        if(frustum.is_inside(t.position(), l.range() * t.transform().scale().max_component())) {
+            lights.point_lights << id;
+        }
+    }
+
+    for(auto&& [id, comp] : world.cached_query<TransformableComponent, SpotLightComponent>(tags)) {
+        const auto& [t, l] = comp;
+        const float scale = t.transform().scale().max_component();
+        const auto enclosing_sphere = l.enclosing_sphere();
+        const math::Vec3 center = t.position() + t.forward().normalized() * (enclosing_sphere.dist_to_center * scale);
+        if(frustum.is_inside(center, enclosing_sphere.radius * scale)) {
+            lights.spot_lights << id;
+        }
+    }
+
+    return lights;
+}
+
 ShadowMapPass ShadowMapPass::create(FrameGraph& framegraph, const SceneView& scene, const ShadowMapSettings& settings) {
     const auto region = framegraph.region("Shadows");
 
@@ -253,18 +310,20 @@ ShadowMapPass ShadowMapPass::create(FrameGraph& framegraph, const SceneView& sce
 
     const auto shadow_map = builder.declare_image(shadow_format, shadow_map_size);
 
-    const ShadowCastingLights lights = collect_shadow_casting_lights(scene);
+    ShadowMapPass pass;
+    pass.visible_lights = std::make_shared<const VisibleLights>(VisibleLights::find(scene));
+
+    const ShadowCastingLights lights = collect_shadow_casting_lights(scene, *pass.visible_lights);
 
     const float downsample_factor = settings.spill_policy == ShadowMapSpillPolicy::DownSample
         ? total_occupancy(lights) / settings.shadow_atlas_size
         : 1.0f;
     const u32 lod_offset = log2ui(u32(std::ceil(downsample_factor)));
 
-    ShadowMapPass pass;
     pass.shadow_map = shadow_map;
     pass.shadow_indices = std::make_shared<core::FlatHashMap<u64, math::Vec4ui>>();
 
-    core::Vector<SubPass> sub_passes;
+    core::Vector<ShadowView> views;
     {
         SubAtlasAllocator allocator(first_level_size);
 
@@ -285,9 +344,8 @@ ShadowMapPass ShadowMapPass::create(FrameGraph& framegraph, const SceneView& sce
                 const u32 level = light->shadow_lod() + lod_offset;
                 const auto [offset, size] = allocator.alloc(level);
 
-                indices[i] = u32(sub_passes.size());
-                const Camera light_cam = directional_camera(scene.camera(), *light, size, near_dist, cascade_dist);
-                sub_passes.emplace_back(create_sub_pass(builder, offset, size, SceneView(&world, light_cam), uv_mul));
+                indices[i] = u32(views.size());
+                views.emplace_back(ShadowView{offset, size, directional_camera(scene.camera(), *light, size, near_dist, cascade_dist)});
 
                 near_dist = cascade_dist;
             }
@@ -300,8 +358,19 @@ ShadowMapPass ShadowMapPass::create(FrameGraph& framegraph, const SceneView& sce
             const u32 level = light->shadow_lod() + lod_offset;
             const auto [offset, size] = allocator.alloc(level);
 
-            indices[0] = u32(sub_passes.size());
-            sub_passes.emplace_back(create_sub_pass(builder, offset, size, SceneView(&world, spotlight_camera(*transform, *light)), uv_mul));
+            indices[0] = u32(views.size());
+            views.emplace_back(ShadowView{offset, size, spotlight_camera(*transform, *light)});
+        }
+    }
+
+    core::Vector<SubPass> sub_passes;
+    {
+        const core::Vector<VisibleEntities> visible = find_visible_entities(world, views);
+
+        sub_passes.set_min_capacity(views.size());
+        for(usize i = 0; i != views.size(); ++i) {
+            const ShadowView& view = views[i];
+            sub_passes.emplace_back(create_sub_pass(builder, view.offset, view.size, SceneView(&world, view.camera), visible[i], uv_mul));
         }
     }
 
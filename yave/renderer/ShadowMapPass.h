@@ -39,11 +39,21 @@ struct ShadowMapSettings {
     ShadowMapSpillPolicy spill_policy = ShadowMapSpillPolicy::DownSample;
 };
 
+// Point and spot lights that can light something in the camera frustum.
+// Gathered once per frame and shared by the shadow and lighting passes.
+struct VisibleLights {
+    core::Vector<ecs::EntityId> point_lights;
+    core::Vector<ecs::EntityId> spot_lights;
+
+    static VisibleLights find(const SceneView& scene);
+};
+
 struct ShadowMapPass {
     FrameGraphImageId shadow_map;
     FrameGraphTypedBufferId<uniform::ShadowMapParams> shadow_params;
 
     std::shared_ptr<core::FlatHashMap<u64, math::Vec4ui>> shadow_indices;
+    std::shared_ptr<const VisibleLights> visible_lights;
 
     static ShadowMapPass create(FrameGraph& framegraph, const SceneView& scene, const ShadowMapSettings& settings = ShadowMapSettings());
 };
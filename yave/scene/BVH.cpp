@@ -0,0 +1,704 @@
+/*******************************
+Copyright (c) 2016-2023 Grégoire Angerand
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+**********************************/
+#include "BVH.h"
+
+#include <yave/camera/Frustum.h>
+
+#include <y/concurrent/WorkStealingThreadPool.h>
+#include <y/utils/format.h>
+
+#include <algorithm>
+#include <limits>
+
+namespace yave {
+
+// Subtrees with more primitives are built concurrently
+static constexpr usize parallel_build_threshold = 16 * 1024;
+
+// Relative to the cost of testing a primitive
+static constexpr float traversal_cost = 1.0f;
+
+static constexpr usize min_pending_for_rebuild = 64;
+
+// Partitioned in place during the build, so every node reads its primitives sequentially
+struct BuildPrimitive {
+    AABB aabb;
+    math::Vec3 center;
+    u32 index = 0;
+};
+
+struct BuildContext {
+    BuildPrimitive* primitives = nullptr;
+
+    // The subtree of a node with n primitives uses the 2n - 1 nodes starting at its own index
+    BVH::Node* nodes = nullptr;
+};
+
+struct BuildBin {
+    math::Vec3 min = math::Vec3(std::numeric_limits<float>::max());
+    math::Vec3 max = math::Vec3(std::numeric_limits<float>::lowest());
+    u32 count = 0;
+
+    void add(const AABB& aabb) {
+        min = min.min(aabb.min());
+        max = max.max(aabb.max());
+        ++count;
+    }
+
+    void add(const BuildBin& other) {
+        min = min.min(other.min);
+        max = max.max(other.max);
+        count += other.count;
+    }
+};
+
+static float surface_area(const math::Vec3& min, const math::Vec3& max) {
+    const math::Vec3 extent = max - min;
+    return 2.0f * (extent.x() * extent.y() + extent.y() * extent.z() + extent.z() * extent.x());
+}
+
+static void build_node(const BuildContext& ctx, u32 index, u32 first, u32 count) {
+    BVH::Node& node = ctx.nodes[index];
+    node.first = first;
+    node.count = count;
+
+    BuildPrimitive* begin = ctx.primitives + first;
+    BuildPrimitive* end = begin + count;
+
+    math::Vec3 centroid_min = begin->center;
+    math::Vec3 centroid_max = centroid_min;
+    node.min = begin->aabb.min();
+    node.max = begin->aabb.max();
+    for(const BuildPrimitive* it = begin + 1; it != end; ++it) {
+        node.min = node.min.min(it->aabb.min());
+        node.max = node.max.max(it->aabb.max());
+        centroid_min = centroid_min.min(it->center);
+        centroid_max = centroid_max.max(it->center);
+    }
+
+    if(count <= 2) {
+        return;
+    }
+
+    const math::Vec3 centroid_extent = centroid_max - centroid_min;
+    usize axis = 0;
+    for(usize i = 1; i != 3; ++i) {
+        if(centroid_extent[i] > centroid_extent[axis]) {
+            axis = i;
+        }
+    }
+
+    u32 split = 0;
+    if(centroid_extent[axis] > 0.0f) {
+        const float bin_scale = float(BVH::bin_count) / centroid_extent[axis];
+        const auto bin_index = [&](const BuildPrimitive& primitive) {
+            const float pos = (primitive.center[axis] - centroid_min[axis]) * bin_scale;
+            return std::min(usize(pos), BVH::bin_count - 1);
+        };
+
+        std::array<BuildBin, BVH::bin_count> bins;
+        for(const BuildPrimitive* it = begin; it != end; ++it) {
+            bins[bin_index(*it)].add(it->aabb);
+        }
+
+        // Cost of the primitives right of each split, a split at i puts bins [0, i] on the left
+        std::array<float, BVH::bin_count - 1> right_costs = {};
+        {
+            BuildBin right;
+            for(usize i = BVH::bin_count - 1; i != 0; --i) {
+                right.add(bins[i]);
+                right_costs[i - 1] = right.count ? surface_area(right.min, right.max) * right.count : 0.0f;
+            }
+        }
+
+        float best_cost = std::numeric_limits<float>::max();
+        usize best_split = 0;
+        {
+            BuildBin left;
+            for(usize i = 0; i != BVH::bin_count - 1; ++i) {
+                left.add(bins[i]);
+                const float cost = (left.count ? surface_area(left.min, left.max) * left.count : 0.0f) + right_costs[i];
+                if(cost < best_cost) {
+                    best_cost = cost;
+                    best_split = i;
+                }
+            }
+        }
+
+        const float node_area = surface_area(node.min, node.max);
+        const float leaf_cost = node_area * count;
+        const float split_cost = node_area * traversal_cost + best_cost;
+        if(count <= BVH::max_leaf_size && leaf_cost <= split_cost) {
+            return;
+        }
+
+        const BuildPrimitive* mid = std::partition(begin, end, [&](const BuildPrimitive& primitive) { return bin_index(primitive) <= best_split; });
+        split = u32(mid - begin);
+    }
+
+    // Every centroid in the same place or in the same bin
+    if(!split || split == count) {
+        if(count <= BVH::max_leaf_size) {
+            return;
+        }
+
+        split = count / 2;
+        std::nth_element(begin, begin + split, end, [&](const BuildPrimitive& a, const BuildPrimitive& b) {
+            return a.center[axis] < b.center[axis];
+        });
+    }
+
+    const u32 left = index + 1;
+    const u32 right = index + 2 * split;
+    node.right = right;
+
+    if(count >= parallel_build_threshold) {
+        auto& pool = ecs::thread_pool();
+        concurrent::DependencyGroup done;
+        pool.schedule([&ctx, left, first, split] {
+            build_node(ctx, left, first, split);
+        }, &done);
+
+        build_node(ctx, right, first + split, count - split);
+
+        pool.process_until_ready(done);
+    } else {
+        build_node(ctx, left, first, split);
+        build_node(ctx, right, first + split, count - split);
+    }
+}
+
+// Stores the nodes depth first, so left children directly follow their parent
+static u32 compact_node(core::Span<BVH::Node> nodes, u32 index, u32 parent, core::Vector<BVH::Node>& compacted, core::Vector<u32>& leaves) {
+    const u32 compacted_index = u32(compacted.size());
+
+    BVH::Node node = nodes[index];
+    node.parent = parent;
+    compacted << node;
+
+    if(node.is_leaf()) {
+        for(u32 i = 0; i != node.count; ++i) {
+            leaves[node.first + i] = compacted_index;
+        }
+    } else {
+        compact_node(nodes, index + 1, compacted_index, compacted, leaves);
+        compacted[compacted_index].right = compact_node(nodes, node.right, compacted_index, compacted, leaves);
+    }
+
+    return compacted_index;
+}
+
+
+struct TreeView {
+    const BVH::Node* nodes = nullptr;
+    const ecs::EntityId* ids = nullptr;
+    const AABB* bounds = nullptr;
+};
+
+static void push_range(core::Vector<ecs::EntityId>& entities, const TreeView& tree, u32 first, u32 count) {
+    for(u32 i = first; i != first + count; ++i) {
+        if(tree.ids[i].is_valid()) {
+            entities << tree.ids[i];
+        }
+    }
+}
+
+static void visit_node(core::Vector<ecs::EntityId>& entities, const Frustum& frustum, float far_dist, const TreeView& tree, u32 index) {
+    const BVH::Node& node = tree.nodes[index];
+
+    switch(frustum.intersection(node.aabb(), far_dist)) {
+        case Intersection::Outside:
+        break;
+
+        case Intersection::Inside:
+            push_range(entities, tree, node.first, node.count);
+        break;
+
+        case Intersection::Intersects:
+            if(node.is_leaf()) {
+                for(u32 i = node.first; i != node.first + node.count; ++i) {
+                    if(tree.ids[i].is_valid() && frustum.intersection(tree.bounds[i], far_dist) != Intersection::Outside) {
+                        entities << tree.ids[i];
+                    }
+                }
+            } else {
+                visit_node(entities, frustum, far_dist, tree, index + 1);
+                visit_node(entities, frustum, far_dist, tree, node.right);
+            }
+        break;
+    }
+}
+
+struct MultiViewQuery {
+    const Frustum* frustums = nullptr;
+    const float* far_dists = nullptr;
+    core::Vector<ecs::EntityId>* entities = nullptr;
+
+    float far_dist(usize view) const {
+        return far_dists ? far_dists[view] : -1.0f;
+    }
+};
+
+// Each bit of partial and inside is a view, views in inside contain the whole node and are not tested again
+static void visit_node(const MultiViewQuery& query, const TreeView& tree, u32 index, u64 partial, u64 inside) {
+    const BVH::Node& node = tree.nodes[index];
+    const AABB aabb = node.aabb();
+
+    u64 node_partial = 0;
+    detail::for_each_view(partial, [&](usize view) {
+        const u64 bit = u64(1) << view;
+        switch(query.frustums[view].intersection(aabb, query.far_dist(view))) {
+            case Intersection::Outside:
+            break;
+
+            case Intersection::Inside:
+                inside |= bit;
+            break;
+
+            case Intersection::Intersects:
+                node_partial |= bit;
+            break;
+        }
+    });
+
+    if(!node_partial) {
+        // Only reached by the views that contain the node
+        detail::for_each_view(inside, [&](usize view) {
+            push_range(query.entities[view], tree, node.first, node.count);
+        });
+        return;
+    }
+
+    if(node.is_leaf()) {
+        for(u32 i = node.first; i != node.first + node.count; ++i) {
+            if(!tree.ids[i].is_valid()) {
+                continue;
+            }
+
+            detail::for_each_view(inside, [&](usize view) {
+                query.entities[view] << tree.ids[i];
+            });
+
+            detail::for_each_view(node_partial, [&](usize view) {
+                if(query.frustums[view].intersection(tree.bounds[i], query.far_dist(view)) != Intersection::Outside) {
+                    query.entities[view] << tree.ids[i];
+                }
+            });
+        }
+    } else {
+        visit_node(query, tree, index + 1, node_partial, inside);
+        visit_node(query, tree, node.right, node_partial, inside);
+    }
+}
+
+
+BVH::BVH() {
+}
+
+BVH::~BVH() {
+    if(_rebuild.valid()) {
+        _rebuild.wait();
+    }
+}
+
+void BVH::update(core::Span<Entry> entries) {
+    y_profile();
+
+    finish_rebuild(false);
+
+    for(const Entry& entry : entries) {
+        set_entity(entry.id, entry.aabb);
+    }
+
+    if(should_rebuild()) {
+        start_rebuild();
+    }
+}
+
+void BVH::remove(core::Span<ecs::EntityId> ids) {
+    y_profile();
+
+    finish_rebuild(false);
+
+    for(const ecs::EntityId id : ids) {
+        remove_entity(id);
+    }
+
+    if(should_rebuild()) {
+        start_rebuild();
+    }
+}
+
+core::Vector<ecs::EntityId> BVH::all_entities() const {
+    y_profile();
+
+    auto entities = core::vector_with_capacity<ecs::EntityId>(_tree.ids.size() + _pending_ids.size());
+    for(const ecs::EntityId id : _tree.ids) {
+        if(id.is_valid()) {
+            entities << id;
+        }
+    }
+    entities.push_back(_pending_ids.begin(), _pending_ids.end());
+    return entities;
+}
+
+core::Vector<ecs::EntityId> BVH::find_entities(const Frustum& frustum, float far_dist) const {
+    y_profile();
+
+    auto entities = core::vector_with_capacity<ecs::EntityId>(1024);
+    if(!_tree.nodes.is_empty()) {
+        visit_node(entities, frustum, far_dist, TreeView{_tree.nodes.data(), _tree.ids.data(), _tree.bounds.data()}, 0);
+    }
+
+    for(usize i = 0; i != _pending_ids.size(); ++i) {
+        if(frustum.intersection(_pending_bounds[i], far_dist) != Intersection::Outside) {
+            entities << _pending_ids[i];
+        }
+    }
+
+    return entities;
+}
+
+core::Vector<core::Vector<ecs::EntityId>> BVH::find_entities_for_views(core::Span<Frustum> frustums, core::Span<float> far_dists) const {
+    y_profile();
+
+    y_debug_assert(far_dists.is_empty() || far_dists.size() == frustums.size());
+
+    core::Vector<core::Vector<ecs::EntityId>> entities(frustums.size(), core::Vector<ecs::EntityId>());
+    for(auto& e : entities) {
+        e.set_min_capacity(1024);
+    }
+
+    const TreeView tree = {_tree.nodes.data(), _tree.ids.data(), _tree.bounds.data()};
+    for(usize first = 0; first < frustums.size(); first += max_views_per_traversal) {
+        const usize count = std::min(max_views_per_traversal, frustums.size() - first);
+
+        MultiViewQuery query;
+        query.frustums = frustums.data() + first;
+        query.far_dists = far_dists.is_empty() ? nullptr : far_dists.data() + first;
+        query.entities = entities.data() + first;
+
+        if(!_tree.nodes.is_empty()) {
+            const u64 views = count == 64 ? u64(-1) : (u64(1) << count) - 1;
+            visit_node(query, tree, 0, views, 0);
+        }
+
+        for(usize i = 0; i != _pending_ids.size(); ++i) {
+            for(usize view = 0; view != count; ++view) {
+                if(query.frustums[view].intersection(_pending_bounds[i], query.far_dist(view)) != Intersection::Outside) {
+                    query.entities[view] << _pending_ids[i];
+                }
+            }
+        }
+    }
+
+    return entities;
+}
+
+usize BVH::memory_usage() const {
+    return _tree.ids.capacity() * sizeof(ecs::EntityId)
+         + _tree.bounds.capacity() * sizeof(AABB)
+         + _tree.leaves.capacity() * sizeof(u32)
+         + _tree.nodes.capacity() * sizeof(Node)
+         + _pending_ids.capacity() * sizeof(ecs::EntityId)
+         + _pending_bounds.capacity() * sizeof(AABB)
+         + _locations.capacity() * sizeof(EntityLocation)
+         + _changed.capacity() * sizeof(ecs::EntityId);
+}
+
+void BVH::audit() const {
+#ifdef Y_DEBUG
+    y_profile();
+
+    for(usize i = 0; i != _tree.nodes.size(); ++i) {
+        const Node& node = _tree.nodes[i];
+        const AABB aabb = node.aabb();
+        if(node.is_leaf()) {
+            for(u32 p = node.first; p != node.first + node.count; ++p) {
+                y_debug_assert(_tree.leaves[p] == i);
+                y_debug_assert(aabb.contains(_tree.bounds[p]));
+            }
+        } else {
+            y_debug_assert(_tree.nodes[i + 1].parent == i);
+            y_debug_assert(_tree.nodes[node.right].parent == i);
+            y_debug_assert(aabb.contains(_tree.nodes[i + 1].aabb()));
+            y_debug_assert(aabb.contains(_tree.nodes[node.right].aabb()));
+        }
+    }
+
+    core::Vector<ecs::EntityId> all = all_entities();
+    for(const ecs::EntityId id : all) {
+        y_debug_assert(find_entity(id).primitive != invalid_index || find_entity(id).pending != invalid_index);
+    }
+    y_profile_dyn_zone(fmt_c_str("auditing % entities", all.size()));
+    std::sort(all.begin(), all.end());
+    y_debug_assert(std::unique(all.begin(), all.end()) == all.end());
+#endif
+}
+
+void BVH::rebuild() {
+    y_profile();
+
+    finish_rebuild(true);
+
+    if(!_pending_ids.is_empty() || _removed || _refits) {
+        start_rebuild();
+        finish_rebuild(true);
+    }
+}
+
+bool BVH::is_rebuilding() const {
+    return _rebuild.valid();
+}
+
+usize BVH::node_count() const {
+    return _tree.nodes.size();
+}
+
+usize BVH::pending_count() const {
+    return _pending_ids.size();
+}
+
+void BVH::build(Tree& tree) {
+    y_profile();
+
+    const u32 primitive_count = u32(tree.ids.size());
+    y_debug_assert(tree.bounds.size() == primitive_count);
+
+    tree.nodes.make_empty();
+    tree.leaves.make_empty();
+    tree.leaves.set_min_size(primitive_count, invalid_index);
+
+    if(!primitive_count) {
+        return;
+    }
+
+    auto primitives = core::vector_with_capacity<BuildPrimitive>(primitive_count);
+    for(u32 i = 0; i != primitive_count; ++i) {
+        primitives.emplace_back(BuildPrimitive{tree.bounds[i], tree.bounds[i].center(), i});
+    }
+
+    core::Vector<Node> nodes(2 * primitive_count - 1, Node());
+
+    BuildContext ctx;
+    ctx.primitives = primitives.data();
+    ctx.nodes = nodes.data();
+    build_node(ctx, 0, 0, primitive_count);
+
+    {
+        auto ids = core::vector_with_capacity<ecs::EntityId>(primitive_count);
+        for(const BuildPrimitive& primitive : primitives) {
+            ids << tree.ids[primitive.index];
+        }
+        tree.ids = std::move(ids);
+    }
+
+    tree.bounds = core::vector_with_capacity<AABB>(primitive_count);
+    for(const BuildPrimitive& primitive : primitives) {
+        tree.bounds << primitive.aabb;
+    }
+
+    tree.nodes.set_min_capacity(primitive_count);
+    compact_node(nodes, 0, invalid_index, tree.nodes, tree.leaves);
+    tree.nodes.squeeze();
+}
+
+BVH::EntityLocation BVH::find_entity(ecs::EntityId id) const {
+    y_debug_assert(id.is_valid());
+
+    if(id.index() >= _locations.size()) {
+        return EntityLocation{};
+    }
+
+    const EntityLocation loc = _locations[id.index()];
+    if(loc.primitive != invalid_index && _tree.ids[loc.primitive] == id) {
+        return loc;
+    }
+    if(loc.pending != invalid_index && _pending_ids[loc.pending] == id) {
+        return loc;
+    }
+    return EntityLocation{};
+}
+
+void BVH::set_location(ecs::EntityId id, EntityLocation loc) {
+    _locations.set_min_size(id.index() + 1);
+    _locations[id.index()] = loc;
+}
+
+void BVH::set_entity(ecs::EntityId id, const AABB& aabb) {
+    const EntityLocation loc = find_entity(id);
+    if(loc.primitive != invalid_index) {
+        _tree.bounds[loc.primitive] = aabb;
+        refit(_tree.leaves[loc.primitive]);
+        ++_refits;
+    } else if(loc.pending != invalid_index) {
+        _pending_bounds[loc.pending] = aabb;
+    } else {
+        set_location(id, EntityLocation{invalid_index, u32(_pending_ids.size())});
+        _pending_ids << id;
+        _pending_bounds << aabb;
+    }
+
+    if(_rebuild.valid()) {
+        _changed << id;
+    }
+}
+
+void BVH::remove_entity(ecs::EntityId id) {
+    const EntityLocation loc = find_entity(id);
+    if(loc.primitive != invalid_index) {
+        // The slot stays in the tree until the next rebuild
+        _tree.ids[loc.primitive] = ecs::EntityId();
+        ++_removed;
+    } else if(loc.pending != invalid_index) {
+        const ecs::EntityId last = _pending_ids.last();
+        _pending_ids[loc.pending] = last;
+        _pending_bounds[loc.pending] = _pending_bounds.last();
+        set_location(last, loc);
+        _pending_ids.pop();
+        _pending_bounds.pop();
+    } else {
+        return;
+    }
+
+    set_location(id, EntityLocation{});
+
+    if(_rebuild.valid()) {
+        _changed << id;
+    }
+}
+
+// Bounds of removed primitives are kept, so nodes might be larger than needed until the next rebuild
+void BVH::refit(u32 index) {
+    for(; index != invalid_index; index = _tree.nodes[index].parent) {
+        Node& node = _tree.nodes[index];
+
+        math::Vec3 min;
+        math::Vec3 max;
+        if(node.is_leaf()) {
+            min = _tree.bounds[node.first].min();
+            max = _tree.bounds[node.first].max();
+            for(u32 i = node.first + 1; i != node.first + node.count; ++i) {
+                min = min.min(_tree.bounds[i].min());
+                max = max.max(_tree.bounds[i].max());
+            }
+        } else {
+            const Node& left = _tree.nodes[index + 1];
+            const Node& right = _tree.nodes[node.right];
+            min = left.min.min(right.min);
+            max = left.max.max(right.max);
+        }
+
+        if(min == node.min && max == node.max) {
+            break;
+        }
+
+        node.min = min;
+        node.max = max;
+    }
+}
+
+bool BVH::should_rebuild() const {
+    if(_rebuild.valid()) {
+        return false;
+    }
+
+    const usize built = _tree.ids.size();
+    return _pending_ids.size() > std::max(min_pending_for_rebuild, built / 16)
+        || (built && _removed > built / 4)
+        || (built && _refits > built);
+}
+
+void BVH::start_rebuild() {
+    y_profile();
+
+    y_debug_assert(!_rebuild.valid());
+
+    auto snapshot = std::make_shared<Tree>();
+    snapshot->ids = core::vector_with_capacity<ecs::EntityId>(_tree.ids.size() - _removed + _pending_ids.size());
+    snapshot->bounds = core::vector_with_capacity<AABB>(snapshot->ids.capacity());
+    for(usize i = 0; i != _tree.ids.size(); ++i) {
+        if(_tree.ids[i].is_valid()) {
+            snapshot->ids << _tree.ids[i];
+            snapshot->bounds << _tree.bounds[i];
+        }
+    }
+    snapshot->ids.push_back(_pending_ids.begin(), _pending_ids.end());
+    snapshot->bounds.push_back(_pending_bounds.begin(), _pending_bounds.end());
+
+    _changed.make_empty();
+    _rebuild = ecs::thread_pool().schedule_with_future([snapshot] {
+        build(*snapshot);
+        return snapshot;
+    });
+}
+
+void BVH::finish_rebuild(bool wait) {
+    if(!_rebuild.valid()) {
+        return;
+    }
+
+    if(!wait && _rebuild.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+        return;
+    }
+
+    y_profile();
+
+    const std::shared_ptr<Tree> tree = _rebuild.get();
+
+    // Entities changed while the tree was being built, read before the tree is replaced
+    core::Vector<Entry> changed;
+    core::Vector<ecs::EntityId> removed;
+    for(const ecs::EntityId id : _changed) {
+        const EntityLocation loc = find_entity(id);
+        if(loc.primitive != invalid_index) {
+            changed.emplace_back(Entry{id, _tree.bounds[loc.primitive]});
+        } else if(loc.pending != invalid_index) {
+            changed.emplace_back(Entry{id, _pending_bounds[loc.pending]});
+        } else {
+            removed << id;
+        }
+    }
+    _changed.make_empty();
+
+    _tree = std::move(*tree);
+    _pending_ids.clear();
+    _pending_bounds.clear();
+    _removed = 0;
+    _refits = 0;
+
+    std::fill(_locations.begin(), _locations.end(), EntityLocation{});
+    for(u32 i = 0; i != _tree.ids.size(); ++i) {
+        set_location(_tree.ids[i], EntityLocation{i, invalid_index});
+    }
+
+    for(const Entry& entry : changed) {
+        set_entity(entry.id, entry.aabb);
+    }
+
+    for(const ecs::EntityId id : removed) {
+        remove_entity(id);
+    }
+}
+
+}
+
@@ -0,0 +1,137 @@
+/*******************************
+Copyright (c) 2016-2023 Grégoire Angerand
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+**********************************/
+#ifndef YAVE_SCENE_BVH_H
+#define YAVE_SCENE_BVH_H
+
+#include "SpatialIndex.h"
+
+#include <future>
+
+namespace yave {
+
+// Bounding volume hierarchy built using a binned surface area heuristic.
+// Nodes adapt to the objects they contain, so very uneven object sizes don't pile up near the root like in the octree.
+// Moving entities are refitted in place, new entities are kept in a pending list tested linearly until the next rebuild.
+// Rebuilds start once refits, insertions or removals have degraded the tree enough and run in the background on the ECS thread pool.
+// They are applied by the first update or remove after they complete.
+class BVH final : public SpatialIndex {
+    public:
+        static constexpr u32 invalid_index = u32(-1);
+
+        static constexpr usize max_leaf_size = 8;
+        static constexpr usize bin_count = 12;
+
+        struct Node {
+            math::Vec3 min;
+            // Every subtree owns a contiguous range of primitives
+            u32 first = 0;
+
+            math::Vec3 max;
+            u32 count = 0;
+
+            // The left child directly follows its parent, leaves have no right child
+            u32 right = invalid_index;
+            u32 parent = invalid_index;
+
+            bool is_leaf() const {
+                return right == invalid_index;
+            }
+
+            AABB aabb() const {
+                return AABB(min, max);
+            }
+        };
+
+        BVH();
+        ~BVH() override;
+
+        void update(core::Span<Entry> entries) override;
+        void remove(core::Span<ecs::EntityId> ids) override;
+
+        core::Vector<ecs::EntityId> all_entities() const override;
+        core::Vector<ecs::EntityId> find_entities(const Frustum& frustum, float far_dist = -1.0f) const override;
+        core::Vector<core::Vector<ecs::EntityId>> find_entities_for_views(core::Span<Frustum> frustums, core::Span<float> far_dists = {}) const override;
+
+        usize memory_usage() const override;
+
+        void audit() const override;
+
+        // Waits for the background rebuild if any, then rebuilds the tree if it is not up to date
+        void rebuild();
+
+        bool is_rebuilding() const;
+
+        usize node_count() const;
+        usize pending_count() const;
+
+    private:
+        struct Tree {
+            // Primitives in tree order, removed entities keep their slot with an invalid id until the next rebuild
+            core::Vector<ecs::EntityId> ids;
+            core::Vector<AABB> bounds;
+
+            // Leaf of each primitive
+            core::Vector<u32> leaves;
+
+            core::Vector<Node> nodes;
+        };
+
+        struct EntityLocation {
+            u32 primitive = invalid_index;
+            u32 pending = invalid_index;
+        };
+
+        static void build(Tree& tree);
+
+        EntityLocation find_entity(ecs::EntityId id) const;
+        void set_location(ecs::EntityId id, EntityLocation loc);
+
+        void set_entity(ecs::EntityId id, const AABB& aabb);
+        void remove_entity(ecs::EntityId id);
+
+        void refit(u32 index);
+
+        bool should_rebuild() const;
+        void start_rebuild();
+        void finish_rebuild(bool wait);
+
+        Tree _tree;
+
+        core::Vector<ecs::EntityId> _pending_ids;
+        core::Vector<AABB> _pending_bounds;
+
+        // Indexed by entity index
+        core::Vector<EntityLocation> _locations;
+
+        usize _removed = 0;
+        usize _refits = 0;
+
+        std::future<std::shared_ptr<Tree>> _rebuild;
+
+        // Entities changed since the snapshot of the running rebuild was taken
+        core::Vector<ecs::EntityId> _changed;
+};
+
+}
+
+#endif // YAVE_SCENE_BVH_H
+
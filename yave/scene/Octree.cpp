@@ -19,67 +19,302 @@ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
 OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
 SOFTWARE.
 **********************************/
-
 #include "Octree.h"
 
 #include <yave/camera/Frustum.h>
 
 #include <y/utils/format.h>
 
+#include <algorithm>
+#include <mutex>
+
 namespace yave {
 
-static void push_all_entities(core::Vector<ecs::EntityId>& entities, const OctreeNode& node) {
-    for(const ecs::EntityId id : node.entities()) {
-        entities << id;
+static constexpr usize update_chunk_size = 1024;
+
+struct MovedEntity {
+    ecs::EntityId id;
+    AABB aabb;
+    OctreeNodeId node;
+    OctreeNodeId hint;
+
+    u64 sort_key() const {
+        return (u64(hint.index()) << 32) | id.index();
     }
-    for(const auto& child : node.children()) {
-        push_all_entities(entities, *child);
+};
+
+static void push_all_entities(core::Vector<ecs::EntityId>& entities, const OctreeData& data, u32 index) {
+    const OctreeData::Node& node = data.node(index);
+
+    data.for_each_page(index, [&](const ecs::EntityId* ids, const AABBBatch*, usize count) {
+        for(usize i = 0; i != count; ++i) {
+            entities << ids[i];
+        }
+    });
+
+    if(node.children[0] != OctreeData::invalid_index) {
+        for(const u32 child : node.children) {
+            push_all_entities(entities, data, child);
+        }
     }
 }
 
-static void visit_node(core::Vector<ecs::EntityId>& entities, const Frustum& frustum, float far_dist, const OctreeNode& node) {
-    switch(frustum.intersection(node.aabb(), far_dist)) {
+// Entities of nodes that intersect the frustum are tested one batch at a time
+static void push_visible_entities(core::Vector<ecs::EntityId>& entities, const Frustum& frustum, float far_dist, const OctreeData& data, u32 index) {
+    data.for_each_page(index, [&](const ecs::EntityId* ids, const AABBBatch* bounds, usize count) {
+        for(usize first = 0; first < count; first += AABBBatch::size) {
+            const u32 mask = frustum.visible_mask(bounds[first / AABBBatch::size], far_dist);
+            if(!mask) {
+                continue;
+            }
+
+            // Lanes past the last entity are ignored
+            const usize lanes = std::min(AABBBatch::size, count - first);
+            for(usize lane = 0; lane != lanes; ++lane) {
+                if(mask & (1u << lane)) {
+                    entities << ids[first + lane];
+                }
+            }
+        }
+    });
+}
+
+static void visit_node(core::Vector<ecs::EntityId>& entities, const Frustum& frustum, float far_dist, const OctreeData& data, u32 index) {
+    const OctreeData::Node& node = data.node(index);
+
+    switch(frustum.intersection(OctreeNode::aabb(node), far_dist)) {
         case Intersection::Outside:
         break;
 
         case Intersection::Inside:
-            push_all_entities(entities, node);
+            push_all_entities(entities, data, index);
         break;
 
         case Intersection::Intersects:
-            for(const ecs::EntityId id : node.entities()) {
-                Y_TODO(Check entity AABB against frustum)
-                entities << id;
-            }
-            for(const auto& child : node.children()) {
-                visit_node(entities, frustum, far_dist, *child);
+            push_visible_entities(entities, frustum, far_dist, data, index);
+            if(node.children[0] != OctreeData::invalid_index) {
+                for(const u32 child : node.children) {
+                    visit_node(entities, frustum, far_dist, data, child);
+                }
             }
         break;
     }
 }
 
-Octree::Octree() : _root(std::make_unique<OctreeNode>(math::Vec3(), 1024.0f, &_data)) {
+
+struct MultiViewQuery {
+    const Frustum* frustums = nullptr;
+    const float* far_dists = nullptr;
+    core::Vector<ecs::EntityId>* entities = nullptr;
+
+    float far_dist(usize view) const {
+        return far_dists ? far_dists[view] : -1.0f;
+    }
+};
+
+// Each bit of partial and inside is a view, views in inside contain the whole node and are not tested again
+static void visit_node(const MultiViewQuery& query, const OctreeData& data, u32 index, u64 partial, u64 inside) {
+    const OctreeData::Node& node = data.node(index);
+    const AABB aabb = OctreeNode::aabb(node);
+
+    u64 node_partial = 0;
+    detail::for_each_view(partial, [&](usize view) {
+        const u64 bit = u64(1) << view;
+        switch(query.frustums[view].intersection(aabb, query.far_dist(view))) {
+            case Intersection::Outside:
+            break;
+
+            case Intersection::Inside:
+                inside |= bit;
+            break;
+
+            case Intersection::Intersects:
+                node_partial |= bit;
+            break;
+        }
+    });
+
+    if(!(node_partial | inside)) {
+        return;
+    }
+
+    data.for_each_page(index, [&](const ecs::EntityId* ids, const AABBBatch* bounds, usize count) {
+        detail::for_each_view(inside, [&](usize view) {
+            for(usize i = 0; i != count; ++i) {
+                query.entities[view] << ids[i];
+            }
+        });
+
+        for(usize first = 0; first < count && node_partial; first += AABBBatch::size) {
+            const AABBBatch& batch = bounds[first / AABBBatch::size];
+            const usize lanes = std::min(AABBBatch::size, count - first);
+
+            detail::for_each_view(node_partial, [&](usize view) {
+                const u32 mask = query.frustums[view].visible_mask(batch, query.far_dist(view));
+                for(usize lane = 0; lane != lanes; ++lane) {
+                    if(mask & (1u << lane)) {
+                        query.entities[view] << ids[first + lane];
+                    }
+                }
+            });
+        }
+    });
+
+    if(node.children[0] != OctreeData::invalid_index) {
+        for(const u32 child : node.children) {
+            visit_node(query, data, child, node_partial, inside);
+        }
+    }
 }
 
-OctreeNode* Octree::insert(ecs::EntityId id, const AABB& bbox) {
+Octree::Octree() : _root(_data.add_node(math::Vec3(), 1024.0f)) {
+}
+
+void Octree::update(core::Span<Entry> entries) {
+    y_profile();
+
+    core::Vector<MovedEntity> moved;
+    std::mutex moved_lock;
+
+    // Entities that stay in their node are updated in place, the tree structure doesn't change here
+    ecs::parallel_for_chunks(entries.size(), update_chunk_size, [&](usize begin, usize end) {
+        core::Vector<MovedEntity> chunk_moved;
+        for(usize i = begin; i != end; ++i) {
+            const Entry& entry = entries[i];
+            const OctreeNodeId node = entity_node(entry.id);
+            if(node.is_valid() && update(node, entry.id, entry.aabb)) {
+                continue;
+            }
+
+            chunk_moved.emplace_back(MovedEntity{entry.id, entry.aabb, node, insertion_hint(entry.aabb)});
+        }
+
+        if(!chunk_moved.is_empty()) {
+            const auto lock = std::unique_lock(moved_lock);
+            moved.push_back(chunk_moved.begin(), chunk_moved.end());
+        }
+    });
+
+    for(const MovedEntity& m : moved) {
+        if(m.node.is_valid()) {
+            remove(m.node, m.id);
+        }
+    }
+
+    // Entities going to the same node are inserted together, chunks finish in any order so ids break ties
+    std::sort(moved.begin(), moved.end(), [](const MovedEntity& a, const MovedEntity& b) {
+        return a.sort_key() < b.sort_key();
+    });
+
+    for(const MovedEntity& m : moved) {
+        insert(m.id, m.aabb, m.hint);
+    }
+
+    y_profile_msg(fmt_c_str("%/% objects reinserted", moved.size(), entries.size()));
+}
+
+void Octree::remove(core::Span<ecs::EntityId> ids) {
+    y_profile();
+
+    for(const ecs::EntityId id : ids) {
+        const u32 node = _data.entity_node(id);
+        if(node != OctreeData::invalid_index) {
+            _data.remove_entity(node, id);
+        }
+    }
+}
+
+OctreeNodeId Octree::insert(ecs::EntityId id, const AABB& bbox, OctreeNodeId hint) {
     y_debug_assert(id.is_valid());
 
-    while(!_root->contains(bbox)) {
-        const math::Vec3 pos = bbox.center();
-        _root = OctreeNode::create_parent_from_child(std::move(_root), pos);
+    u32 index = hint.index();
+    if(!hint.is_valid() || !OctreeNode::aabb(_data.node(index)).contains(bbox)) {
+        while(!OctreeNode::aabb(_data.node(_root)).contains(bbox)) {
+            _root = create_parent(_root, bbox.center());
+        }
+        index = _root;
     }
-    return _root->insert(id, bbox);
+
+    for(;;) {
+        {
+            const OctreeData::Node& node = _data.node(index);
+            const bool split_small = OctreeNode::split_small_object && bbox.half_extent().length() < node.half_extent / OctreeNode::min_object_size_ratio;
+            const bool should_insert_into_children = node.entity_count >= OctreeNode::max_entities_per_node || split_small;
+            if(node.children[0] == OctreeData::invalid_index && should_insert_into_children && node.half_extent * 2.0f > OctreeNode::min_node_extent) {
+                // Invalidates node
+                build_children(index);
+            }
+        }
+
+        const OctreeData::Node& node = _data.node(index);
+        if(node.children[0] != OctreeData::invalid_index) {
+            const u32 child = node.children[OctreeNode::children_index(node, bbox.center())];
+            if(OctreeNode::aabb(_data.node(child)).contains(bbox)) {
+                index = child;
+                continue;
+            }
+        }
+
+        break;
+    }
+
+    _data.add_entity(index, id, bbox);
+    return OctreeNodeId(index);
 }
 
-const OctreeNode& Octree::root() const {
-    return *_root;
+OctreeNodeId Octree::insertion_hint(const AABB& bbox) const {
+    if(!OctreeNode::aabb(_data.node(_root)).contains(bbox)) {
+        return OctreeNodeId();
+    }
+
+    u32 index = _root;
+    for(;;) {
+        const OctreeData::Node& node = _data.node(index);
+        if(node.children[0] == OctreeData::invalid_index) {
+            break;
+        }
+
+        const u32 child = node.children[OctreeNode::children_index(node, bbox.center())];
+        if(!OctreeNode::aabb(_data.node(child)).contains(bbox)) {
+            break;
+        }
+        index = child;
+    }
+
+    return OctreeNodeId(index);
+}
+
+void Octree::remove(OctreeNodeId node, ecs::EntityId id) {
+    y_debug_assert(node.is_valid());
+    _data.remove_entity(node.index(), id);
+}
+
+OctreeNodeId Octree::entity_node(ecs::EntityId id) const {
+    return OctreeNodeId(_data.entity_node(id));
+}
+
+bool Octree::update(OctreeNodeId node, ecs::EntityId id, const AABB& bbox) {
+    y_debug_assert(node.is_valid());
+    if(!OctreeNode::aabb(_data.node(node.index())).contains(bbox)) {
+        return false;
+    }
+    _data.set_entity_aabb(id, bbox);
+    return true;
+}
+
+OctreeNode Octree::root() const {
+    return OctreeNode(&_data, OctreeNodeId(_root));
+}
+
+OctreeNode Octree::node(OctreeNodeId id) const {
+    return OctreeNode(&_data, id);
 }
 
 core::Vector<ecs::EntityId> Octree::all_entities() const {
     y_profile();
 
     auto entities = core::vector_with_capacity<ecs::EntityId>(1024 * 8);
-    push_all_entities(entities, *_root);
+    push_all_entities(entities, _data, _root);
     return entities;
 }
 
@@ -87,17 +322,87 @@ core::Vector<ecs::EntityId> Octree::find_entities(const Frustum& frustum, float
     y_profile();
 
     auto entities = core::vector_with_capacity<ecs::EntityId>(1024);
-    visit_node(entities, frustum, far_dist, *_root);
+    visit_node(entities, frustum, far_dist, _data, _root);
+    return entities;
+}
+
+core::Vector<core::Vector<ecs::EntityId>> Octree::find_entities_for_views(core::Span<Frustum> frustums, core::Span<float> far_dists) const {
+    y_profile();
+
+    y_debug_assert(far_dists.is_empty() || far_dists.size() == frustums.size());
+
+    core::Vector<core::Vector<ecs::EntityId>> entities(frustums.size(), core::Vector<ecs::EntityId>());
+    for(auto& e : entities) {
+        e.set_min_capacity(1024);
+    }
+
+    for(usize first = 0; first < frustums.size(); first += max_views_per_traversal) {
+        const usize count = std::min(max_views_per_traversal, frustums.size() - first);
+
+        MultiViewQuery query;
+        query.frustums = frustums.data() + first;
+        query.far_dists = far_dists.is_empty() ? nullptr : far_dists.data() + first;
+        query.entities = entities.data() + first;
+
+        const u64 views = count == 64 ? u64(-1) : (u64(1) << count) - 1;
+        visit_node(query, _data, _root, views, 0);
+    }
+
     return entities;
 }
 
+usize Octree::memory_usage() const {
+    return _data.memory_usage();
+}
+
+u32 Octree::create_parent(u32 child, const math::Vec3& toward) {
+    const OctreeData::Node child_node = _data.node(child);
+
+    const usize index = OctreeNode::children_index(child_node, toward);
+    const float child_half_extent = child_node.half_extent;
+    const math::Vec3 parent_offset = {
+        (index & 0x01 ? child_half_extent : -child_half_extent),
+        (index & 0x02 ? child_half_extent : -child_half_extent),
+        (index & 0x04 ? child_half_extent : -child_half_extent)
+    };
+
+    const usize self_index = 7 - index;
+
+    const u32 parent = _data.add_node(child_node.center + parent_offset, child_half_extent * 2.0f);
+    build_children(parent, child, self_index);
+
+    y_debug_assert(OctreeNode::children_index(_data.node(parent), child_node.center) == self_index);
+    return parent;
+}
+
+void Octree::build_children(u32 index, u32 existing_child, usize existing_index) {
+    y_debug_assert(_data.node(index).children[0] == OctreeData::invalid_index);
+
+    const math::Vec3 center = _data.node(index).center;
+    const float child_extent = _data.node(index).half_extent * 0.5f;
+
+    // Siblings are allocated next to each other
+    std::array<u32, 8> children = {};
+    for(usize i = 0; i != 8; ++i) {
+        const math::Vec3 offset = {
+            (i & 0x01 ? child_extent : -child_extent),
+            (i & 0x02 ? child_extent : -child_extent),
+            (i & 0x04 ? child_extent : -child_extent)
+        };
+
+        children[i] = i == existing_index ? existing_child : _data.add_node(center + offset, child_extent);
+        y_debug_assert(OctreeNode::aabb(_data.node(index)).contains(OctreeNode::aabb(_data.node(children[i]))));
+    }
+
+    _data.node(index).children = children;
+}
+
 void Octree::audit() const {
 #ifdef Y_DEBUG
     y_profile();
     core::Vector<ecs::EntityId> all = all_entities();
     y_profile_dyn_zone(fmt_c_str("auditing % entities", all.size()));
     std::sort(all.begin(), all.end());
-    y_debug_assert(_root->entity_count() == all.size());
     y_debug_assert(std::unique(all.begin(), all.end()) == all.end());
 #endif
 }
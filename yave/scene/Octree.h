@@ -23,28 +23,55 @@ SOFTWARE.
 #define YAVE_SCENE_OCTREE_H
 
 #include "OctreeNode.h"
+#include "SpatialIndex.h"
 
 namespace yave {
 
-class Octree : NonMovable {
+// Loose octree: objects are stored in the deepest node whose extended bounds contain them
+class Octree final : public SpatialIndex {
 
     public:
         Octree();
 
-        OctreeNode* insert(ecs::EntityId id, const AABB& bbox);
+        void update(core::Span<Entry> entries) override;
+        void remove(core::Span<ecs::EntityId> ids) override;
 
-        const OctreeNode& root() const;
+        // Insertion starts from hint if it contains bbox, from the root otherwise
+        OctreeNodeId insert(ecs::EntityId id, const AABB& bbox, OctreeNodeId hint = {});
 
-        core::Vector<ecs::EntityId> all_entities() const;
-        core::Vector<ecs::EntityId> find_entities(const Frustum& frustum, float far_dist = -1.0f) const;
+        // Returns the deepest existing node insert would reach, or an invalid id if the root would have to grow.
+        // Any node that contains bbox is a valid hint, so hints can be computed before a batch of insertions.
+        OctreeNodeId insertion_hint(const AABB& bbox) const;
+
+        // id must be stored in node, O(1)
+        void remove(OctreeNodeId node, ecs::EntityId id);
+
+        // Invalid if id isn't in the octree
+        OctreeNodeId entity_node(ecs::EntityId id) const;
+
+        // Updates the AABB of an entity stored in node.
+        // Returns false, without changing anything, if the node can not contain the new AABB.
+        // Can be called concurrently for different entities, as long as nothing is inserted or removed.
+        bool update(OctreeNodeId node, ecs::EntityId id, const AABB& bbox);
+
+        OctreeNode root() const;
+        OctreeNode node(OctreeNodeId id) const;
+
+        core::Vector<ecs::EntityId> all_entities() const override;
+        core::Vector<ecs::EntityId> find_entities(const Frustum& frustum, float far_dist = -1.0f) const override;
+        core::Vector<core::Vector<ecs::EntityId>> find_entities_for_views(core::Span<Frustum> frustums, core::Span<float> far_dists = {}) const override;
+
+        usize memory_usage() const override;
+
+        void audit() const override;
 
     private:
-        friend class OctreeSystem;
+        u32 create_parent(u32 child, const math::Vec3& toward);
+        // existing_child is used as the existing_index-th child instead of a new node
+        void build_children(u32 index, u32 existing_child = OctreeData::invalid_index, usize existing_index = 8);
 
         OctreeData _data;
-        std::unique_ptr<OctreeNode> _root;
-
-        void audit() const;
+        u32 _root = OctreeData::invalid_index;
 };
 
 }
@@ -19,10 +19,148 @@ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
 OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
 SOFTWARE.
 **********************************/
-
 #include "OctreeData.h"
 
 namespace yave {
 
+u32 OctreeData::add_node(const math::Vec3& center, float half_extent) {
+    const u32 index = u32(_nodes.size());
+    Node& node = _nodes.emplace_back();
+    node.center = center;
+    node.half_extent = half_extent;
+    return index;
+}
+
+OctreeData::Node& OctreeData::node(u32 index) {
+    return _nodes[index];
+}
+
+const OctreeData::Node& OctreeData::node(u32 index) const {
+    return _nodes[index];
+}
+
+const OctreeData::Page& OctreeData::page(u32 index) const {
+    return _pages[index];
+}
+
+usize OctreeData::node_count() const {
+    return _nodes.size();
+}
+
+usize OctreeData::page_count() const {
+    return _pages.size() - _free_pages.size();
+}
+
+usize OctreeData::memory_usage() const {
+    return _nodes.capacity() * sizeof(Node)
+         + _pages.capacity() * sizeof(Page)
+         + _free_pages.capacity() * sizeof(u32)
+         + _locations.capacity() * sizeof(EntityLocation);
+}
+
+u32 OctreeData::entity_node(ecs::EntityId id) const {
+    return find_entity(id).node;
+}
+
+void OctreeData::add_entity(u32 node_index, ecs::EntityId id, const AABB& bbox) {
+    y_debug_assert(id.is_valid());
+    y_debug_assert(find_entity(id).page == invalid_index);
+
+    const u32 slot = _nodes[node_index].entity_count % page_size;
+    if(!slot) {
+        const u32 page = alloc_page();
+
+        Node& node = _nodes[node_index];
+        _pages[page].prev = node.last_page;
+        if(node.last_page != invalid_index) {
+            _pages[node.last_page].next = page;
+        } else {
+            node.first_page = page;
+        }
+        node.last_page = page;
+    }
+
+    Node& node = _nodes[node_index];
+    const EntityLocation loc = {node_index, node.last_page, slot};
+    _pages[loc.page].ids[slot] = id;
+    set_aabb(loc, bbox);
+    set_location(id, loc);
+    ++node.entity_count;
+}
+
+void OctreeData::remove_entity(u32 node_index, ecs::EntityId id) {
+    const EntityLocation loc = find_entity(id);
+    y_debug_assert(loc.page != invalid_index);
+
+    Node& node = _nodes[node_index];
+    const usize last_slot = (node.entity_count - 1) % page_size;
+    const Page& last_page = _pages[node.last_page];
+    const ecs::EntityId last_id = last_page.ids[last_slot];
+
+    // Move the last entity into the hole
+    _pages[loc.page].ids[loc.slot] = last_id;
+    set_aabb(loc, last_page.bounds[last_slot / AABBBatch::size].get(last_slot % AABBBatch::size));
+    set_location(last_id, loc);
+    set_location(id, EntityLocation{});
+
+    --node.entity_count;
+
+    if(!last_slot) {
+        const u32 page = node.last_page;
+        node.last_page = _pages[page].prev;
+        if(node.last_page != invalid_index) {
+            _pages[node.last_page].next = invalid_index;
+        } else {
+            node.first_page = invalid_index;
+        }
+        free_page(page);
+    }
+}
+
+void OctreeData::set_entity_aabb(ecs::EntityId id, const AABB& bbox) {
+    const EntityLocation loc = find_entity(id);
+    y_debug_assert(loc.page != invalid_index);
+    set_aabb(loc, bbox);
+}
+
+OctreeData::EntityLocation OctreeData::find_entity(ecs::EntityId id) const {
+    y_debug_assert(id.is_valid());
+
+    if(id.index() >= _locations.size()) {
+        return EntityLocation{};
+    }
+
+    const EntityLocation loc = _locations[id.index()];
+    if(loc.page == invalid_index || _pages[loc.page].ids[loc.slot] != id) {
+        return EntityLocation{};
+    }
+    return loc;
+}
+
+void OctreeData::set_location(ecs::EntityId id, EntityLocation loc) {
+    _locations.set_min_size(id.index() + 1);
+    _locations[id.index()] = loc;
+}
+
+void OctreeData::set_aabb(EntityLocation loc, const AABB& bbox) {
+    _pages[loc.page].bounds[loc.slot / AABBBatch::size].set(loc.slot % AABBBatch::size, bbox);
+}
+
+u32 OctreeData::alloc_page() {
+    if(!_free_pages.is_empty()) {
+        const u32 index = _free_pages.pop();
+        _pages[index] = Page();
+        return index;
+    }
+
+    const u32 index = u32(_pages.size());
+    _pages.emplace_back();
+    return index;
+}
+
+void OctreeData::free_page(u32 index) {
+    _free_pages << index;
+}
+
 }
 
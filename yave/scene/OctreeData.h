@@ -23,19 +23,138 @@ SOFTWARE.
 #define YAVE_SCENE_OCTREEDATA_H
 
 #include <yave/ecs/ecs.h>
+#include <yave/meshes/AABB.h>
 
 #include <y/core/Vector.h>
 
-#include <utility>
+#include <array>
 
 namespace yave {
 
-class OctreeData : NonMovable {
+class OctreeNodeId {
     public:
+        OctreeNodeId() = default;
+
+        bool is_valid() const {
+            return _index != invalid_index;
+        }
+
+        u32 index() const {
+            return _index;
+        }
+
+        bool operator==(const OctreeNodeId& other) const {
+            return _index == other._index;
+        }
+
+        bool operator!=(const OctreeNodeId& other) const {
+            return _index != other._index;
+        }
 
+    private:
+        friend class Octree;
+        friend class OctreeNode;
+
+        static constexpr u32 invalid_index = u32(-1);
+
+        explicit OctreeNodeId(u32 index) : _index(index) {
+        }
+
+        u32 _index = invalid_index;
 };
 
 
+// Nodes live in a single array and reference each other by index, they are never freed.
+// Entity lists are linked lists of fixed size pages, shared by all the nodes.
+// The position of every entity is indexed by entity index, so entities can be found and removed in O(1).
+class OctreeData : NonMovable {
+    public:
+        static constexpr u32 invalid_index = u32(-1);
+
+        static constexpr usize page_size = 16;
+        static_assert(page_size % AABBBatch::size == 0);
+
+        struct Node {
+            math::Vec3 center;
+            float half_extent = -1.0f;
+
+            // Either all valid or all invalid
+            std::array<u32, 8> children = {invalid_index, invalid_index, invalid_index, invalid_index, invalid_index, invalid_index, invalid_index, invalid_index};
+
+            u32 first_page = invalid_index;
+            u32 last_page = invalid_index;
+            u32 entity_count = 0;
+        };
+
+        // Only the first entity_count % page_size entities of the last page of a node are valid
+        struct Page {
+            std::array<ecs::EntityId, page_size> ids;
+            std::array<AABBBatch, page_size / AABBBatch::size> bounds;
+
+            u32 next = invalid_index;
+            u32 prev = invalid_index;
+        };
+
+
+        OctreeData() = default;
+
+        u32 add_node(const math::Vec3& center, float half_extent);
+
+        Node& node(u32 index);
+        const Node& node(u32 index) const;
+
+        const Page& page(u32 index) const;
+
+        usize node_count() const;
+        usize page_count() const;
+
+        usize memory_usage() const;
+
+        // Node containing id, invalid_index if id isn't in the octree
+        u32 entity_node(ecs::EntityId id) const;
+
+        void add_entity(u32 node_index, ecs::EntityId id, const AABB& bbox);
+        void remove_entity(u32 node_index, ecs::EntityId id);
+
+        // Can be called concurrently for different entities, as long as no entity is added or removed
+        void set_entity_aabb(ecs::EntityId id, const AABB& bbox);
+
+        // Calls func(ids, bounds, count) for each page of the node
+        template<typename F>
+        void for_each_page(u32 node_index, F&& func) const {
+            const Node& n = _nodes[node_index];
+            usize remaining = n.entity_count;
+            for(u32 p = n.first_page; p != invalid_index; p = _pages[p].next) {
+                const Page& pg = _pages[p];
+                const usize count = std::min(remaining, page_size);
+                func(pg.ids.data(), pg.bounds.data(), count);
+                remaining -= count;
+            }
+            y_debug_assert(!remaining);
+        }
+
+    private:
+        struct EntityLocation {
+            u32 node = invalid_index;
+            u32 page = invalid_index;
+            u32 slot = 0;
+        };
+
+        EntityLocation find_entity(ecs::EntityId id) const;
+        void set_location(ecs::EntityId id, EntityLocation loc);
+        void set_aabb(EntityLocation loc, const AABB& bbox);
+
+        u32 alloc_page();
+        void free_page(u32 index);
+
+        core::Vector<Node> _nodes;
+        core::Vector<Page> _pages;
+        core::Vector<u32> _free_pages;
+
+        // Indexed by entity index
+        core::Vector<EntityLocation> _locations;
+};
+
 }
 
 #endif // YAVE_SCENE_OCTREEDATA_H
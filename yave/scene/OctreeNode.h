@@ -26,30 +26,24 @@ SOFTWARE.
 
 #include <yave/meshes/AABB.h>
 
-#include <array>
-#include <memory>
-
 namespace yave {
 
+// Read only view of a node stored in an OctreeData, only valid as long as the octree isn't modified
+class OctreeNode {
 
-class OctreeNode : NonMovable {
-
-    static constexpr bool split_small_object = false;
-    static constexpr float min_object_size_ratio = 16.0f;
-
-    static constexpr usize max_entities_per_node = 32;
-    static constexpr float min_node_extent = 1.0f;
+    public:
+        static constexpr bool split_small_object = false;
+        static constexpr float min_object_size_ratio = 16.0f;
 
-    static constexpr float overlap_extent_multiplier = 1.25f;
-    static constexpr float full_extent_multiplier = overlap_extent_multiplier * 2.0f;
+        static constexpr usize max_entities_per_node = 32;
+        static constexpr float min_node_extent = 1.0f;
 
-    public:
-        OctreeNode() = default;
-        OctreeNode(const math::Vec3& center, float half_extent, OctreeData* data);
+        static constexpr float overlap_extent_multiplier = 1.25f;
+        static constexpr float full_extent_multiplier = overlap_extent_multiplier * 2.0f;
 
-        static std::unique_ptr<OctreeNode> create_parent_from_child(std::unique_ptr<OctreeNode> child, const math::Vec3& toward);
+        OctreeNode(const OctreeData* data, OctreeNodeId id);
 
-        OctreeNode* insert(ecs::EntityId id, const AABB& bbox);
+        OctreeNodeId id() const;
 
         AABB aabb() const;
         AABB strict_aabb() const;
@@ -60,32 +54,30 @@ class OctreeNode : NonMovable {
         bool has_children() const;
         bool is_empty() const;
 
-        core::Span<std::unique_ptr<OctreeNode>> children() const;
-        core::Span<ecs::EntityId> entities() const;
+        // 0 or 8
+        usize child_count() const;
+        OctreeNode child(usize index) const;
 
-        Y_TODO(Make thread safe)
-        void remove(ecs::EntityId id);
+        usize entity_count() const;
 
-    private:
-        friend class Octree;
-        friend class OctreeSystem;
-
-        usize entity_count() const; // debug
+        // Calls func(id, aabb) for every entity stored directly in the node
+        template<typename F>
+        void for_each_entity(F&& func) const {
+            _data->for_each_page(_index, [&](const ecs::EntityId* ids, const AABBBatch* bounds, usize count) {
+                for(usize i = 0; i != count; ++i) {
+                    func(ids[i], bounds[i / AABBBatch::size].get(i % AABBBatch::size));
+                }
+            });
+        }
 
+        static usize children_index(const OctreeData::Node& node, const math::Vec3& pos);
+        static AABB aabb(const OctreeData::Node& node);
 
     private:
-        void build_children();
-        usize children_index(const math::Vec3& pos);
-
-        math::Vec3 _center;
-        float _half_extent = -1.0f;
-
-        Y_TODO(pool allocs)
-        std::array<std::unique_ptr<OctreeNode>, 8> _children;
-
-        core::Vector<ecs::EntityId> _entities;
+        const OctreeData::Node& node() const;
 
-        OctreeData* _data = nullptr;
+        const OctreeData* _data = nullptr;
+        u32 _index = OctreeData::invalid_index;
 };
 
 }
@@ -0,0 +1,94 @@
+/*******************************
+Copyright (c) 2016-2023 Grégoire Angerand
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+**********************************/
+#ifndef YAVE_SCENE_SPATIALINDEX_H
+#define YAVE_SCENE_SPATIALINDEX_H
+
+#include <yave/ecs/ecs.h>
+#include <yave/meshes/AABB.h>
+
+#include <y/core/Vector.h>
+#include <y/core/Span.h>
+
+#include <memory>
+
+namespace yave {
+
+enum class SpatialIndexType {
+    Octree,
+    BVH,
+};
+
+// Scene acceleration structure used for culling, entities are identified by their id
+class SpatialIndex : NonMovable {
+    public:
+        struct Entry {
+            ecs::EntityId id;
+            AABB aabb;
+        };
+
+        // Views tested in a single traversal by find_entities_for_views
+        static constexpr usize max_views_per_traversal = 64;
+
+        static std::unique_ptr<SpatialIndex> create(SpatialIndexType type);
+
+        virtual ~SpatialIndex();
+
+        // Inserts the entities that are not in the index, updates the AABB of the others.
+        // Each entity should appear at most once.
+        virtual void update(core::Span<Entry> entries) = 0;
+
+        // Entities that are not in the index are ignored
+        virtual void remove(core::Span<ecs::EntityId> ids) = 0;
+
+        virtual core::Vector<ecs::EntityId> all_entities() const = 0;
+        virtual core::Vector<ecs::EntityId> find_entities(const Frustum& frustum, float far_dist = -1.0f) const = 0;
+
+        // Same as calling find_entities for each frustum, but the index is traversed once for up to max_views_per_traversal frustums.
+        // far_dists is either empty or has one entry per frustum.
+        virtual core::Vector<core::Vector<ecs::EntityId>> find_entities_for_views(core::Span<Frustum> frustums, core::Span<float> far_dists = {}) const = 0;
+
+        // Bytes allocated by the index
+        virtual usize memory_usage() const = 0;
+
+        // Checks the consistency of the index, only in debug
+        virtual void audit() const;
+
+    protected:
+        SpatialIndex() = default;
+};
+
+namespace detail {
+// Calls func with the index of every set bit
+template<typename F>
+void for_each_view(u64 views, F&& func) {
+    for(usize view = 0; views; ++view, views >>= 1) {
+        if(views & 1) {
+            func(view);
+        }
+    }
+}
+}
+
+}
+
+#endif // YAVE_SCENE_SPATIALINDEX_H
+
@@ -30,6 +30,7 @@ SOFTWARE.
 namespace yave {
 
 AABBUpdateSystem::AABBUpdateSystem() : ecs::System("AABBUpdateSystem") {
+    declare_access<ecs::Mutate<TransformableComponent>>();
 }
 
 void AABBUpdateSystem::setup(ecs::EntityWorld& world) {
@@ -39,9 +40,8 @@ void AABBUpdateSystem::setup(ecs::EntityWorld& world) {
 void AABBUpdateSystem::tick(ecs::EntityWorld& world) {
     ecs::SparseComponentSet<AABB> aabbs;
     for(const AABBTypeInfo& info : _infos) {
-        const core::Span<ecs::EntityId> ids = world.recently_mutated(info.type);
-        y_profile_dyn_zone(fmt_c_str("collecting % %", ids.size(), world.component_type_name(info.type)));
-        info.collect_aabbs(world, ids, aabbs);
+        y_profile_dyn_zone(fmt_c_str("collecting %", world.component_type_name(info.type)));
+        info.collect_aabbs(world, aabbs);
     }
 
     for(auto&& [id, comp] : world.query<ecs::Mutate<TransformableComponent>>(aabbs.ids())) {
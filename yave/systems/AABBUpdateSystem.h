@@ -39,16 +39,18 @@ class AABBUpdateSystem : public ecs::System {
 
         template<typename T>
         void register_component_type() {
+            declare_access<T>();
             _infos << AABBTypeInfo {
-                [](const ecs::EntityWorld& world, core::Span<ecs::EntityId> ids, ecs::SparseComponentSet<AABB>& aabbs) {
-                    for(auto&& [id, comp] : world.query<T>(ids)) {
-                        auto&& [c] = comp;
+                [](const ecs::EntityWorld& world, ecs::SparseComponentSet<AABB>& aabbs) {
+                    const ecs::SparseComponentSet<T>& components = world.component_set<T>();
+                    world.for_each_mutated<T>([&](ecs::EntityId id) {
+                        const AABB component_aabb = components[id].aabb();
                         if(AABB* aabb = aabbs.try_get(id)) {
-                            *aabb = aabb->merged(c.aabb());
+                            *aabb = aabb->merged(component_aabb);
                         } else {
-                            aabbs.insert(id, c.aabb());
+                            aabbs.insert(id, component_aabb);
                         }
-                    }
+                    });
                 },
                 ecs::type_index<T>(),
             };
@@ -56,7 +58,7 @@ class AABBUpdateSystem : public ecs::System {
 
     private:
         struct AABBTypeInfo {
-            void (*collect_aabbs)(const ecs::EntityWorld&, core::Span<ecs::EntityId>, ecs::SparseComponentSet<AABB>&);
+            void (*collect_aabbs)(const ecs::EntityWorld&, ecs::SparseComponentSet<AABB>&);
             ecs::ComponentTypeIndex type;
         };
 
@@ -24,9 +24,13 @@ SOFTWARE.
 
 #include <yave/assets/AssetLoader.h>
 
+#include <y/utils/log.h>
+#include <y/utils/format.h>
+
 namespace yave {
 
 AssetLoaderSystem::AssetLoaderSystem(AssetLoader& loader) : ecs::System("AssetLoaderSystem"), _loader(&loader) {
+    declare_access<>();
 }
 
 void AssetLoaderSystem::setup(ecs::EntityWorld& world) {
@@ -56,6 +60,26 @@ void AssetLoaderSystem::post_load(ecs::EntityWorld& world) {
     for(const LoadableComponentTypeInfo& info : _infos) {
         info.update_status(world, _loading[info.type], _recently_loaded);
     }
+
+    for(usize i = 0; i != _preloads.size(); ++i) {
+        if(_preloads[i]->poll()) {
+            log_msg(fmt("Preloaded %", _preloads[i]->report().to_string()), Log::Perf);
+            _preloads.erase_unordered(_preloads.begin() + i);
+            --i;
+        }
+    }
+}
+
+void AssetLoaderSystem::preload(const ecs::EntityScene& scene) {
+    y_profile();
+
+    auto preloader = std::make_unique<AssetPreloader>(*_loader);
+    for(const LoadableComponentTypeInfo& info : _infos) {
+        info.collect_assets(scene, *preloader);
+    }
+
+    preloader->start();
+    _preloads.emplace_back(std::move(preloader));
 }
 
 core::Span<ecs::EntityId> AssetLoaderSystem::recently_loaded() const {
@@ -23,6 +23,8 @@ SOFTWARE.
 #define YAVE_SYSTEMS_ASSETLOADERSYSTEM_H
 
 #include <yave/ecs/EntityWorld.h>
+#include <yave/ecs/EntityScene.h>
+#include <yave/assets/AssetPreloader.h>
 
 #include <y/core/Vector.h>
 #include <y/core/HashMap.h>
@@ -38,12 +40,18 @@ class AssetLoaderSystem : public ecs::System {
 
         core::Span<ecs::EntityId> recently_loaded() const;
 
+        // Requests every asset referenced by the scene's loadable components at once, rather than as new components are found.
+        // Keeps the preloaded assets alive until the preload is done, and logs how it went.
+        void preload(const ecs::EntityScene& scene);
+
 
         template<typename T>
         void register_component_type() {
+            declare_access<ecs::Mutate<T>>();
             _infos << LoadableComponentTypeInfo {
                 &start_loading_components<T>,
                 &update_loading_status<T>,
+                &collect_assets<T>,
                 ecs::type_index<T>()
             };
         }
@@ -55,27 +63,31 @@ class AssetLoaderSystem : public ecs::System {
         core::FlatHashMap<ecs::ComponentTypeIndex, core::Vector<ecs::EntityId>> _loading;
         core::Vector<ecs::EntityId> _recently_loaded;
 
+        core::Vector<std::unique_ptr<AssetPreloader>> _preloads;
+
         AssetLoader* _loader = nullptr;
 
     private:
         struct LoadableComponentTypeInfo {
             void (*start_loading)(ecs::EntityWorld&, AssetLoadingContext&, bool, core::Vector<ecs::EntityId>&) = nullptr;
             void (*update_status)(ecs::EntityWorld&, core::Vector<ecs::EntityId>&, core::Vector<ecs::EntityId>&) = nullptr;
+            void (*collect_assets)(const ecs::EntityScene&, AssetPreloader&) = nullptr;
             ecs::ComponentTypeIndex type;
         };
 
-        template<typename T>
-        static core::Span<ecs::EntityId> ids(ecs::EntityWorld& world, bool recent) {
-            return recent
-                ? world.recently_mutated<T>()
-                : world.component_ids<T>();
-        }
-
         template<typename T>
         static void start_loading_components(ecs::EntityWorld& world, AssetLoadingContext& loading_ctx, bool recent, core::Vector<ecs::EntityId>& out_ids) {
-            for(auto id_comp : world.query<ecs::Mutate<T>>(ids<T>(world, recent))) {
-                id_comp.template component<T>().load_assets(loading_ctx);
-                out_ids << id_comp.id;
+            if(recent) {
+                // Components are already marked as mutated, so getting them mutably doesn't change the set we iterate
+                world.for_each_mutated<T>([&](ecs::EntityId id) {
+                    world.component_mut<T>(id)->load_assets(loading_ctx);
+                    out_ids << id;
+                });
+            } else {
+                for(auto id_comp : world.query<ecs::Mutate<T>>()) {
+                    id_comp.template component<T>().load_assets(loading_ctx);
+                    out_ids << id_comp.id;
+                }
             }
         }
 
@@ -91,6 +103,25 @@ class AssetLoaderSystem : public ecs::System {
             }
         }
 
+        template<typename T>
+        static void collect_assets(const ecs::EntityScene& scene, AssetPreloader& preloader) {
+            for(const auto& column : scene.columns()) {
+                if(column->runtime_info().type_id == ecs::type_index<T>()) {
+                    for(const T& component : static_cast<const ecs::ComponentColumn<T>&>(*column).components()) {
+                        preloader.add_recursive(component);
+                    }
+                }
+            }
+
+            for(const ecs::EntityPrefab& prefab : scene.prefabs()) {
+                for(const auto& box : prefab.components()) {
+                    if(box && box->runtime_info().type_id == ecs::type_index<T>()) {
+                        preloader.add_recursive(static_cast<const ecs::ComponentBox<T>&>(*box).component());
+                    }
+                }
+            }
+        }
+
         core::Vector<LoadableComponentTypeInfo> _infos;
 };
 
@@ -30,24 +30,16 @@ SOFTWARE.
 
 #include <y/core/Chrono.h>
 
-namespace yave {
-
-static core::Span<ecs::EntityId> transformable_ids(ecs::EntityWorld& world, bool recent) {
-    return recent
-        ? world.recently_mutated<TransformableComponent>()
-        : world.component_ids<TransformableComponent>();
-}
-
+#include <mutex>
 
+namespace yave {
 
-OctreeSystem::OctreeSystem() : ecs::System("OctreeSystem") {
+OctreeSystem::OctreeSystem(SpatialIndexType type) : ecs::System("OctreeSystem"), _type(type), _index(SpatialIndex::create(type)) {
+    declare_access<TransformableComponent>();
 }
 
-void OctreeSystem::destroy(ecs::EntityWorld& world) {
-    auto query = world.query<ecs::Mutate<TransformableComponent>>();
-    for(auto&& [tr] : query.components()) {
-        tr._node = nullptr;
-    }
+void OctreeSystem::destroy(ecs::EntityWorld&) {
+    _index = SpatialIndex::create(_type);
 }
 
 void OctreeSystem::setup(ecs::EntityWorld& world) {
@@ -63,50 +55,49 @@ void OctreeSystem::run_tick(ecs::EntityWorld& world, bool only_recent) {
 
     {
         y_profile_zone("updating moved objects");
-        usize insertions = 0;
-        for(auto&& [id, comp] : world.query<TransformableComponent>(transformable_ids(world, only_recent))) {
-            auto&& [tr] = comp;
-
-            if(tr.local_aabb().is_empty()) {
-                continue;
+        const auto push_entry = [](core::Vector<SpatialIndex::Entry>& entries, ecs::EntityId id, const TransformableComponent& tr) {
+            if(!tr.local_aabb().is_empty()) {
+                entries.emplace_back(SpatialIndex::Entry{id, tr.global_aabb()});
             }
-
-            const AABB aabb = tr.global_aabb();
-
-            if(tr._node) {
-                if(tr._node->contains(aabb)) {
-                    continue;
+        };
+
+        core::Vector<SpatialIndex::Entry> entries;
+
+        if(only_recent) {
+            const ecs::SparseComponentSet<TransformableComponent>& transformables = world.component_set<TransformableComponent>();
+            world.for_each_mutated<TransformableComponent>([&](ecs::EntityId id) {
+                push_entry(entries, id, transformables[id]);
+            });
+        } else {
+            std::mutex entries_lock;
+            world.query<TransformableComponent>().for_each_chunk([&](const auto& chunk) {
+                core::Vector<SpatialIndex::Entry> chunk_entries;
+                for(auto&& [id, comp] : chunk) {
+                    auto&& [tr] = comp;
+                    push_entry(chunk_entries, id, tr);
                 }
-                tr._node->remove(id);
-            }
 
-            tr._node = _tree.insert(id, aabb);
-            ++insertions;
+                const auto lock = std::unique_lock(entries_lock);
+                entries.push_back(chunk_entries.begin(), chunk_entries.end());
+            });
         }
 
-        unused(insertions);
-        y_profile_msg(fmt_c_str("%/% objects reinserted", insertions, transformable_ids(world, only_recent).size()));
+        _index->update(entries);
     }
 
     if(only_recent) {
-        for(auto&& [id, comp] : world.query<TransformableComponent>(world.to_be_removed<TransformableComponent>())) {
-            auto&& [tr] = comp;
-
-            if(tr._node) {
-                tr._node->remove(id);
-            }
-        }
+        _index->remove(world.to_be_removed<TransformableComponent>());
     }
 
-    _tree.audit();
+    _index->audit();
 }
 
-const OctreeNode& OctreeSystem::root() const {
-    return _tree.root();
+const SpatialIndex& OctreeSystem::spatial_index() const {
+    return *_index;
 }
 
-const Octree& OctreeSystem::octree() const {
-    return _tree;
+const Octree* OctreeSystem::octree() const {
+    return _type == SpatialIndexType::Octree ? static_cast<const Octree*>(_index.get()) : nullptr;
 }
 
 }
@@ -30,21 +30,25 @@ SOFTWARE.
 
 namespace yave {
 
+// Keeps the spatial index used for culling up to date
 class OctreeSystem : public ecs::System {
     public:
-        OctreeSystem();
+        OctreeSystem(SpatialIndexType type = SpatialIndexType::Octree);
 
         void destroy(ecs::EntityWorld& world) override;
         void setup(ecs::EntityWorld& world) override;
         void tick(ecs::EntityWorld& world) override;
 
-        const OctreeNode& root() const;
-        const Octree& octree() const;
+        const SpatialIndex& spatial_index() const;
+
+        // Null if the system doesn't use an octree
+        const Octree* octree() const;
 
     private:
         void run_tick(ecs::EntityWorld& world, bool only_recent);
 
-        Octree _tree;
+        SpatialIndexType _type;
+        std::unique_ptr<SpatialIndex> _index;
 };
 
 }
@@ -0,0 +1,279 @@
+/*******************************
+Copyright (c) 2016-2023 Grégoire Angerand
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+**********************************/
+#include "TextureStreamingSystem.h"
+#include "OctreeSystem.h"
+
+#include <yave/components/TransformableComponent.h>
+#include <yave/components/StaticMeshComponent.h>
+#include <yave/material/Material.h>
+#include <yave/assets/AssetLoader.h>
+#include <yave/scene/SceneView.h>
+#include <yave/ecs/EntityWorld.h>
+
+#include <y/utils/log.h>
+#include <y/utils/format.h>
+
+#include <algorithm>
+
+namespace yave {
+
+TextureStreamingSystem::TextureStreamingSystem(AssetLoader& loader) : ecs::System("TextureStreamingSystem"), _loader(&loader) {
+    // We only flush reloaded materials
+    declare_access<ecs::Mutate<StaticMeshComponent>>();
+}
+
+void TextureStreamingSystem::destroy(ecs::EntityWorld&) {
+    _requests.make_empty();
+    _materials.make_empty();
+    _pending.make_empty();
+    _infos.make_empty();
+}
+
+void TextureStreamingSystem::set_budget(u64 bytes_per_tick) {
+    _budget = bytes_per_tick;
+}
+
+u64 TextureStreamingSystem::budget() const {
+    return _budget;
+}
+
+void TextureStreamingSystem::request_visible(const SceneView& view, const math::Vec2ui& viewport_size) {
+    y_profile();
+
+    if(!view.has_world()) {
+        return;
+    }
+
+    const ecs::EntityWorld& world = view.world();
+    const OctreeSystem* octree_system = world.find_system<OctreeSystem>();
+    if(!octree_system) {
+        return;
+    }
+
+    const Camera& camera = view.camera();
+    const math::Vec3 camera_pos = camera.position();
+    const bool is_ortho = camera.is_orthographic();
+
+    // Pixels covered by one unit at a distance of one (or at any distance for orthographic cameras)
+    const float pixels_per_unit = float(viewport_size.y()) * std::abs(camera.proj_matrix()[1][1]) * 0.5f;
+
+    const core::Vector<ecs::EntityId> visible = octree_system->spatial_index().find_entities(camera.frustum(), camera.far_plane_dist());
+    auto query = world.query<TransformableComponent, StaticMeshComponent>(visible);
+    for(const auto& [tr, mesh] : query.components()) {
+        const AABB aabb = tr.global_aabb();
+
+        // This assumes that textures are mapped once over the whole object
+        const float dist = is_ortho ? 1.0f : std::max((aabb.center() - camera_pos).length() - aabb.radius(), 0.01f);
+        const float screen_size = aabb.radius() * 2.0f * pixels_per_unit / dist;
+
+        for(const AssetPtr<Material>& material : mesh.materials()) {
+            if(!material.is_loaded()) {
+                continue;
+            }
+
+            MaterialRequest& request = _requests[material.id()];
+            if(request.material.is_empty()) {
+                request.material = material;
+            }
+            request.screen_size = std::max(request.screen_size, screen_size);
+        }
+    }
+}
+
+void TextureStreamingSystem::tick(ecs::EntityWorld& world) {
+    y_profile();
+
+    for(auto&& [id, material] : _materials) {
+        material.screen_size = 0.0f;
+        ++material.idle_ticks;
+    }
+
+    for(auto&& [id, request] : _requests) {
+        MaterialRequest& material = _materials[id];
+        if(material.material.is_empty()) {
+            material.material = std::move(request.material);
+        }
+        material.screen_size = request.screen_size;
+        material.idle_ticks = 0;
+    }
+    _requests.make_empty();
+
+    if(_materials.is_empty()) {
+        return;
+    }
+
+    // A texture can be used by several materials: keep the largest screen size
+    core::FlatHashMap<AssetId, TextureRequest> textures;
+    for(auto&& [id, material] : _materials) {
+        material.material.flush_reload();
+
+        for(const AssetPtr<Texture>& texture : material.material->data().textures()) {
+            if(!texture.is_loaded()) {
+                continue;
+            }
+
+            TextureRequest& request = textures[texture.id()];
+            if(request.texture.is_empty()) {
+                request.texture = texture;
+
+                // Reloaded by someone else (after a reimport for example): the layout might have changed
+                if(request.texture.flush_reload() && !is_pending_replacement(request.texture)) {
+                    _infos.erase(texture.id());
+                }
+            }
+            request.screen_size = std::max(request.screen_size, material.screen_size);
+        }
+    }
+
+    {
+        core::Vector<AssetId> done;
+        for(auto&& [id, texture] : _pending) {
+            if(!texture.is_loading()) {
+                done << id;
+            }
+        }
+        for(const AssetId id : done) {
+            _pending.erase(id);
+        }
+    }
+
+    {
+        core::Vector<TextureRequest> requests = core::vector_with_capacity<TextureRequest>(textures.size());
+        for(auto& request : textures.values()) {
+            requests.emplace_back(std::move(request));
+        }
+
+        // Largest first, so they get streamed in first if we run out of budget
+        std::sort(requests.begin(), requests.end(), [](const TextureRequest& a, const TextureRequest& b) {
+            return a.screen_size > b.screen_size;
+        });
+
+        u64 budget = _budget;
+        for(const TextureRequest& request : requests) {
+            stream_texture(request.texture, request.screen_size, budget);
+        }
+    }
+
+    usize replaced = 0;
+    core::Vector<AssetId> dropped;
+
+    for(auto&& [id, material] : _materials) {
+        SimpleMaterialData data = material.material->data();
+
+        bool changed = false;
+        bool pending = false;
+        for(usize i = 0; i != SimpleMaterialData::texture_count; ++i) {
+            AssetPtr<Texture> texture = data.textures()[i];
+            pending |= _pending.contains(texture.id());
+
+            // Swapped in by the loader once the new mips are ready
+            if(texture.flush_reload()) {
+                data.set_texture(SimpleMaterialData::Textures(i), std::move(texture));
+                changed = true;
+            }
+        }
+
+        if(changed) {
+            material.material = _loader->replace(material.material, Material(material.material->material_template(), std::move(data)));
+            ++replaced;
+        } else if(!pending && material.idle_ticks > eviction_delay) {
+            dropped << id;
+        }
+    }
+
+    for(const AssetId id : dropped) {
+        _materials.erase(id);
+    }
+
+    if(replaced) {
+        y_profile_zone("flushing materials");
+        auto query = world.query<ecs::Mutate<StaticMeshComponent>>();
+        for(auto&& [mesh] : query.components()) {
+            for(AssetPtr<Material>& material : mesh.materials()) {
+                material.flush_reload();
+            }
+        }
+    }
+
+    y_profile_msg(fmt_c_str("% materials updated, % textures streaming", replaced, _pending.size()));
+}
+
+bool TextureStreamingSystem::is_pending_replacement(const AssetPtr<Texture>& texture) const {
+    const auto it = _pending.find(texture.id());
+    return it != _pending.end() && it->second.is_loaded() && it->second.get() == texture.get();
+}
+
+bool TextureStreamingSystem::stream_texture(const AssetPtr<Texture>& texture, float screen_size, u64& budget) {
+    // Only one replacement at a time per texture, the next one will start from it
+    if(_pending.contains(texture.id())) {
+        return false;
+    }
+
+    const TextureInfo& texture_info = this->texture_info(texture.id());
+    if(!texture_info.is_streamed) {
+        return false;
+    }
+
+    const StreamedImageInfo& info = texture_info.info;
+    const usize loaded_mip = info.mips - texture->mipmaps();
+    const usize mip = std::min(info.mip_for_screen_size(screen_size), info.first_resident_mip());
+
+    // Visible textures keep one more mip than they need, so they don't keep bouncing between two sizes
+    const bool evict = mip > loaded_mip && (screen_size <= 0.0f || mip > loaded_mip + 1);
+    if(mip >= loaded_mip && !evict) {
+        return false;
+    }
+
+    if(!evict) {
+        // Always allow the first texture of a tick, so that textures larger than the budget still get streamed in
+        const u64 byte_size = ImageData::byte_size(ImageData::mip_size(info.size, mip), info.format, loaded_mip - mip);
+        if(byte_size > budget && budget != _budget) {
+            return false;
+        }
+        budget -= std::min(byte_size, budget);
+    }
+
+    const auto read = [mip](io2::Reader& reader) {
+        return read_streamed_image(reader, mip);
+    };
+
+    _pending[texture.id()] = _loader->replace_async(texture, read, evict ? AssetLoadingPriority::Low : AssetLoadingPriority::Normal);
+    return true;
+}
+
+const TextureStreamingSystem::TextureInfo& TextureStreamingSystem::texture_info(AssetId id) {
+    if(const auto it = _infos.find(id); it != _infos.end()) {
+        return it->second;
+    }
+
+    TextureInfo& texture_info = _infos[id];
+    if(auto reader = _loader->store().data(id)) {
+        if(auto info = read_streamed_image_info(*reader.unwrap())) {
+            texture_info.info = info.unwrap();
+            texture_info.is_streamed = true;
+        }
+    }
+    return texture_info;
+}
+
+}
+
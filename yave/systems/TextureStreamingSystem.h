@@ -0,0 +1,94 @@
+/*******************************
+Copyright (c) 2016-2023 Grégoire Angerand
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+**********************************/
+#ifndef YAVE_SYSTEMS_TEXTURESTREAMINGSYSTEM_H
+#define YAVE_SYSTEMS_TEXTURESTREAMINGSYSTEM_H
+
+#include <yave/ecs/System.h>
+
+#include <yave/assets/AssetPtr.h>
+#include <yave/graphics/images/StreamedImageData.h>
+
+#include <y/core/HashMap.h>
+
+namespace yave {
+
+// Streams in the high mips of streamed textures (see StreamedImageData.h) based on how large their materials are on screen,
+// and drops them once they aren't needed anymore. Mips are read on the asset loading threads and swapped in once ready.
+class TextureStreamingSystem : public ecs::System {
+    public:
+        // Bytes of texture data requested per tick
+        static constexpr u64 default_budget = 32 * 1024 * 1024;
+
+        // Ticks a material has to stay out of view before its textures go back to their resident mips
+        static constexpr u32 eviction_delay = 120;
+
+        TextureStreamingSystem(AssetLoader& loader);
+
+        void destroy(ecs::EntityWorld& world) override;
+        void tick(ecs::EntityWorld& world) override;
+
+        // Estimates the on screen size of visible materials, their textures are streamed in on the next tick
+        void request_visible(const SceneView& view, const math::Vec2ui& viewport_size);
+
+        void set_budget(u64 bytes_per_tick);
+        u64 budget() const;
+
+    private:
+        struct MaterialRequest {
+            AssetPtr<Material> material;
+            float screen_size = 0.0f;
+            u32 idle_ticks = 0;
+        };
+
+        struct TextureRequest {
+            AssetPtr<Texture> texture;
+            float screen_size = 0.0f;
+        };
+
+        struct TextureInfo {
+            StreamedImageInfo info;
+            bool is_streamed = false;
+        };
+
+        const TextureInfo& texture_info(AssetId id);
+        bool is_pending_replacement(const AssetPtr<Texture>& texture) const;
+        bool stream_texture(const AssetPtr<Texture>& texture, float screen_size, u64& budget);
+
+        core::FlatHashMap<AssetId, MaterialRequest> _requests;
+
+        // Materials that have been visible recently, or whose textures still have streamed mips to drop
+        core::FlatHashMap<AssetId, MaterialRequest> _materials;
+
+        // Texture replacements being loaded. Holding them prevents the loader from cancelling them.
+        core::FlatHashMap<AssetId, AssetPtr<Texture>> _pending;
+
+        core::FlatHashMap<AssetId, TextureInfo> _infos;
+
+        u64 _budget = default_budget;
+
+        AssetLoader* _loader = nullptr;
+};
+
+}
+
+#endif // YAVE_SYSTEMS_TEXTURESTREAMINGSYSTEM_H
+
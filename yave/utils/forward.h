@@ -35,6 +35,7 @@ class AssetLoader;
 class AssetLoaderSystem;
 class AssetLoadingContext;
 class AssetLoadingThreadPool;
+class AssetPreloader;
 class AssetStore;
 class AtmosphereComponent;
 class BufferBarrier;